@@ -186,7 +186,9 @@ SOURCES += \
     backend/richpresencemanager.cpp \
     cli/commandlineparser.cpp \
     cli/listapps.cpp \
+    cli/loadtest.cpp \
     cli/quitstream.cpp \
+    cli/renderbench.cpp \
     cli/startstream.cpp \
     settings/compatfetcher.cpp \
     settings/mappingfetcher.cpp \
@@ -204,9 +206,16 @@ SOURCES += \
     gui/computermodel.cpp \
     gui/appmodel.cpp \
     streaming/bandwidth.cpp \
+    streaming/latencyprobe.cpp \
+    streaming/startuptimeline.cpp \
+    streaming/bitratecontroller.cpp \
+    streaming/lowlatencyprofile.cpp \
+    streaming/networkimpairment.cpp \
+    streaming/avsynccontroller.cpp \
     streaming/streamutils.cpp \
     backend/autoupdatechecker.cpp \
     path.cpp \
+    settings/mappingindex.cpp \
     settings/mappingmanager.cpp \
     gui/sdlgamepadkeynavigation.cpp \
     streaming/video/overlaymanager.cpp \
@@ -231,7 +240,9 @@ HEADERS += \
     backend/richpresencemanager.h \
     cli/commandlineparser.h \
     cli/listapps.h \
+    cli/loadtest.h \
     cli/quitstream.h \
+    cli/renderbench.h \
     cli/startstream.h \
     settings/streamingpreferences.h \
     streaming/input/input.h \
@@ -243,14 +254,27 @@ HEADERS += \
     gui/appmodel.h \
     streaming/video/decoder.h \
     streaming/bandwidth.h \
+    streaming/latencyprobe.h \
+    streaming/startuptimeline.h \
+    streaming/bitratecontroller.h \
+    streaming/lowlatencyprofile.h \
+    streaming/networkimpairment.h \
+    streaming/avsynccontroller.h \
     streaming/streamutils.h \
     backend/autoupdatechecker.h \
     path.h \
+    settings/mappingindex.h \
     settings/mappingmanager.h \
     gui/sdlgamepadkeynavigation.h \
     streaming/video/overlaymanager.h \
     backend/systemproperties.h
 
+# Raw evdev mouse input
+linux {
+    SOURCES += streaming/input/evdevmouse.cpp
+    HEADERS += streaming/input/evdevmouse.h
+}
+
 # Platform-specific renderers and decoders
 ffmpeg {
     message(FFmpeg decoder selected)
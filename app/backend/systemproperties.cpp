@@ -1,8 +1,10 @@
 #include "systemproperties.h"
 #include "utils.h"
 
+#include <QElapsedTimer>
 #include <QGuiApplication>
 #include <QLibraryInfo>
+#include <QSharedPointer>
 
 #include "streaming/session.h"
 #include "streaming/streamutils.h"
@@ -12,7 +14,32 @@
 #include <Windows.h>
 #endif
 
+SystemProperties* SystemProperties::s_Instance = nullptr;
+
+class QuerySdlVideoThread : public QThread
+{
+public:
+    QuerySdlVideoThread(SystemProperties::VideoInfo& info)
+        : m_Info(info)
+    {
+        setObjectName("SDL Video Probe");
+    }
+
+    void run() override
+    {
+        SystemProperties::querySdlVideoInfo(m_Info);
+    }
+
+private:
+    SystemProperties::VideoInfo& m_Info;
+};
+
 SystemProperties::SystemProperties()
+    : hasHardwareAcceleration(false),
+      rendererAlwaysFullScreen(false),
+      supportsHdr(false),
+      videoInfoReady(false),
+      m_VideoInfoThread(nullptr)
 {
     versionString = QString(VERSION_STR);
     hasDesktopEnvironment = WMUtils::isRunningDesktopEnvironment();
@@ -68,46 +95,140 @@ SystemProperties::SystemProperties()
 
     unmappedGamepads = SdlInputHandler::getUnmappedGamepads();
 
-    // Populate data that requires talking to SDL. We do it all in one shot
-    // and cache the results to speed up future queries on this data.
-    querySdlVideoInfo();
+    s_Instance = this;
+
+    // The main thread holds the SDL video reference while the probe runs,
+    // because SDL's subsystem reference counts aren't thread-safe.
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "SDL_InitSubSystem(SDL_INIT_VIDEO) failed: %s",
+                     SDL_GetError());
+        videoInfoReady = true;
+        return;
+    }
+
+#ifdef Q_OS_DARWIN
+    // Cocoa windows can only be created on the main thread
+    querySdlVideoInfo(m_VideoInfo);
+    applyVideoInfo();
+#else
+    // Populate data that requires talking to SDL. Decoder detection fully
+    // initializes several decoders and renderers, so we do it all in one shot
+    // on a separate thread to let the UI paint in the meantime. The results
+    // are cached to speed up future queries on this data.
+    m_VideoInfoThread = new QuerySdlVideoThread(m_VideoInfo);
+    connect(m_VideoInfoThread, &QThread::finished,
+            this, &SystemProperties::applyVideoInfo);
+    m_VideoInfoThread->start();
+#endif
+}
 
-    Q_ASSERT(!monitorRefreshRates.isEmpty());
-    Q_ASSERT(!monitorNativeResolutions.isEmpty());
-    Q_ASSERT(!monitorSafeAreaResolutions.isEmpty());
+SystemProperties::~SystemProperties()
+{
+    if (!videoInfoReady) {
+        if (m_VideoInfoThread != nullptr) {
+            m_VideoInfoThread->wait();
+            delete m_VideoInfoThread;
+        }
+
+        SDL_QuitSubSystem(SDL_INIT_VIDEO);
+    }
+
+    s_Instance = nullptr;
+}
+
+void SystemProperties::waitForVideoInfo()
+{
+    if (s_Instance != nullptr) {
+        s_Instance->applyVideoInfo();
+    }
+}
+
+void SystemProperties::applyVideoInfo()
+{
+    // We may have already been called by waitForVideoInfo()
+    // before the thread's finished signal was delivered.
+    if (videoInfoReady) {
+        return;
+    }
+
+    if (m_VideoInfoThread != nullptr) {
+        m_VideoInfoThread->wait();
+        delete m_VideoInfoThread;
+        m_VideoInfoThread = nullptr;
+    }
+
+    SDL_QuitSubSystem(SDL_INIT_VIDEO);
+
+    hasHardwareAcceleration = m_VideoInfo.hasHardwareAcceleration;
+    rendererAlwaysFullScreen = m_VideoInfo.rendererAlwaysFullScreen;
+    supportsHdr = m_VideoInfo.supportsHdr;
+    maximumResolution = m_VideoInfo.maximumResolution;
+    monitorNativeResolutions = m_VideoInfo.monitorNativeResolutions;
+    monitorSafeAreaResolutions = m_VideoInfo.monitorSafeAreaResolutions;
+    monitorRefreshRates = m_VideoInfo.monitorRefreshRates;
+    videoInfoReady = true;
+
+    // Headless systems and some remote sessions have no displays. Callers
+    // get default values for out of bounds displays, so we can keep going.
+    if (monitorNativeResolutions.isEmpty() || monitorRefreshRates.isEmpty()) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "No usable displays were found");
+    }
+
+    emit videoInfoChanged();
+}
+
+void SystemProperties::runWhenVideoInfoReady(QObject* context, std::function<void()> callback)
+{
+    if (s_Instance == nullptr || s_Instance->videoInfoReady) {
+        callback();
+        return;
+    }
+
+    // applyVideoInfo() always runs on the main thread, either from the probe
+    // thread's finished signal or from waitForVideoInfo().
+    auto readyConnection = QSharedPointer<QMetaObject::Connection>::create();
+    *readyConnection = connect(s_Instance, &SystemProperties::videoInfoChanged, context, [readyConnection, callback]() {
+        QObject::disconnect(*readyConnection);
+        callback();
+    });
 }
 
 QRect SystemProperties::getNativeResolution(int displayIndex)
 {
+    waitForVideoInfo();
+
     // Returns default constructed QRect if out of bounds
     return monitorNativeResolutions.value(displayIndex);
 }
 
 QRect SystemProperties::getSafeAreaResolution(int displayIndex)
 {
+    waitForVideoInfo();
+
     // Returns default constructed QRect if out of bounds
     return monitorSafeAreaResolutions.value(displayIndex);
 }
 
 int SystemProperties::getRefreshRate(int displayIndex)
 {
+    waitForVideoInfo();
+
     // Returns 0 if out of bounds
     return monitorRefreshRates.value(displayIndex);
 }
 
-void SystemProperties::querySdlVideoInfo()
+void SystemProperties::querySdlVideoInfo(VideoInfo& info)
 {
-    hasHardwareAcceleration = false;
+    // The caller holds a reference on SDL_INIT_VIDEO for us
+    SDL_assert(SDL_WasInit(SDL_INIT_VIDEO));
 
-    if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "SDL_InitSubSystem(SDL_INIT_VIDEO) failed: %s",
-                     SDL_GetError());
-        return;
-    }
+    QElapsedTimer timer;
+    timer.start();
 
     // Update display related attributes (max FPS, native resolution, etc).
-    refreshDisplays();
+    queryDisplays(info);
 
     SDL_Window* testWindow = SDL_CreateWindow("", 0, 0, 1280, 720,
                                               SDL_WINDOW_HIDDEN | StreamUtils::getPlatformWindowFlags());
@@ -121,20 +242,25 @@ void SystemProperties::querySdlVideoInfo()
             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                          "Failed to create window for hardware decode test: %s",
                          SDL_GetError());
-            SDL_QuitSubSystem(SDL_INIT_VIDEO);
             return;
         }
     }
 
-    Session::getDecoderInfo(testWindow, hasHardwareAcceleration, rendererAlwaysFullScreen, supportsHdr, maximumResolution);
+    Session::getDecoderInfo(testWindow, info.hasHardwareAcceleration, info.rendererAlwaysFullScreen,
+                            info.supportsHdr, info.maximumResolution);
 
     SDL_DestroyWindow(testWindow);
 
-    SDL_QuitSubSystem(SDL_INIT_VIDEO);
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Video capability probe took %lld ms",
+                (long long)timer.elapsed());
 }
 
 void SystemProperties::refreshDisplays()
 {
+    // Let the startup probe finish with SDL video first
+    waitForVideoInfo();
+
     if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "SDL_InitSubSystem(SDL_INIT_VIDEO) failed: %s",
@@ -142,8 +268,18 @@ void SystemProperties::refreshDisplays()
         return;
     }
 
-    monitorNativeResolutions.clear();
+    VideoInfo info;
+    queryDisplays(info);
+
+    monitorNativeResolutions = info.monitorNativeResolutions;
+    monitorSafeAreaResolutions = info.monitorSafeAreaResolutions;
+    monitorRefreshRates = info.monitorRefreshRates;
+
+    SDL_QuitSubSystem(SDL_INIT_VIDEO);
+}
 
+void SystemProperties::queryDisplays(VideoInfo& info)
+{
     SDL_DisplayMode bestMode;
     for (int displayIndex = 0; displayIndex < SDL_GetNumVideoDisplays(); displayIndex++) {
         SDL_DisplayMode desktopMode;
@@ -151,8 +287,8 @@ void SystemProperties::refreshDisplays()
 
         if (StreamUtils::getNativeDesktopMode(displayIndex, &desktopMode, &safeArea)) {
             if (desktopMode.w <= 8192 && desktopMode.h <= 8192) {
-                monitorNativeResolutions.insert(displayIndex, QRect(0, 0, desktopMode.w, desktopMode.h));
-                monitorSafeAreaResolutions.insert(displayIndex, QRect(0, 0, safeArea.w, safeArea.h));
+                info.monitorNativeResolutions.insert(displayIndex, QRect(0, 0, desktopMode.w, desktopMode.h));
+                info.monitorSafeAreaResolutions.insert(displayIndex, QRect(0, 0, safeArea.w, safeArea.h));
             }
             else {
                 SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
@@ -176,16 +312,14 @@ void SystemProperties::refreshDisplays()
             // Try to normalize values around our our standard refresh rates.
             // Some displays/OSes report values that are slightly off.
             if (bestMode.refresh_rate >= 58 && bestMode.refresh_rate <= 62) {
-                monitorRefreshRates.append(60);
+                info.monitorRefreshRates.append(60);
             }
             else if (bestMode.refresh_rate >= 28 && bestMode.refresh_rate <= 32) {
-                monitorRefreshRates.append(30);
+                info.monitorRefreshRates.append(30);
             }
             else {
-                monitorRefreshRates.append(bestMode.refresh_rate);
+                info.monitorRefreshRates.append(bestMode.refresh_rate);
             }
         }
     }
-
-    SDL_QuitSubSystem(SDL_INIT_VIDEO);
 }
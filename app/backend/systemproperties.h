@@ -2,6 +2,10 @@
 
 #include <QObject>
 #include <QRect>
+#include <QSize>
+#include <QThread>
+
+#include <functional>
 
 class SystemProperties : public QObject
 {
@@ -13,8 +17,10 @@ class SystemProperties : public QObject
 public:
     SystemProperties();
 
-    Q_PROPERTY(bool hasHardwareAcceleration MEMBER hasHardwareAcceleration CONSTANT)
-    Q_PROPERTY(bool rendererAlwaysFullScreen MEMBER rendererAlwaysFullScreen CONSTANT)
+    ~SystemProperties();
+
+    Q_PROPERTY(bool hasHardwareAcceleration MEMBER hasHardwareAcceleration NOTIFY videoInfoChanged)
+    Q_PROPERTY(bool rendererAlwaysFullScreen MEMBER rendererAlwaysFullScreen NOTIFY videoInfoChanged)
     Q_PROPERTY(bool isRunningWayland MEMBER isRunningWayland CONSTANT)
     Q_PROPERTY(bool isRunningXWayland MEMBER isRunningXWayland CONSTANT)
     Q_PROPERTY(bool isWow64 MEMBER isWow64 CONSTANT)
@@ -23,21 +29,52 @@ public:
     Q_PROPERTY(bool hasBrowser MEMBER hasBrowser CONSTANT)
     Q_PROPERTY(bool hasDiscordIntegration MEMBER hasDiscordIntegration CONSTANT)
     Q_PROPERTY(QString unmappedGamepads MEMBER unmappedGamepads NOTIFY unmappedGamepadsChanged)
-    Q_PROPERTY(QSize maximumResolution MEMBER maximumResolution CONSTANT)
+    Q_PROPERTY(QSize maximumResolution MEMBER maximumResolution NOTIFY videoInfoChanged)
     Q_PROPERTY(QString versionString MEMBER versionString CONSTANT)
-    Q_PROPERTY(bool supportsHdr MEMBER supportsHdr CONSTANT)
+    Q_PROPERTY(bool supportsHdr MEMBER supportsHdr NOTIFY videoInfoChanged)
     Q_PROPERTY(bool usesMaterial3Theme MEMBER usesMaterial3Theme CONSTANT)
+    Q_PROPERTY(bool videoInfoReady MEMBER videoInfoReady NOTIFY videoInfoChanged)
 
     Q_INVOKABLE void refreshDisplays();
     Q_INVOKABLE QRect getNativeResolution(int displayIndex);
     Q_INVOKABLE QRect getSafeAreaResolution(int displayIndex);
     Q_INVOKABLE int getRefreshRate(int displayIndex);
 
+    // Blocks until the background SDL video probe has finished and its results
+    // have been applied. This must be called on the main thread before it uses
+    // SDL video, since SDL isn't safe to use from two threads at once.
+    static void waitForVideoInfo();
+
+    // Runs the callback on the main thread once the background SDL video probe
+    // has finished, or right away if it already has. The callback is dropped
+    // if the context object is destroyed first.
+    static void runWhenVideoInfoReady(QObject* context, std::function<void()> callback);
+
 signals:
     void unmappedGamepadsChanged();
+    void videoInfoChanged();
 
 private:
-    void querySdlVideoInfo();
+    // Results of the SDL video probe. These are produced by the probe thread
+    // and only copied into the properties on the main thread.
+    struct VideoInfo {
+        bool hasHardwareAcceleration = false;
+        bool rendererAlwaysFullScreen = false;
+        bool supportsHdr = false;
+        QSize maximumResolution;
+        QList<QRect> monitorNativeResolutions;
+        QList<QRect> monitorSafeAreaResolutions;
+        QList<int> monitorRefreshRates;
+    };
+
+    static void querySdlVideoInfo(VideoInfo& info);
+    static void queryDisplays(VideoInfo& info);
+    void applyVideoInfo();
+
+    static SystemProperties* s_Instance;
+
+    QThread* m_VideoInfoThread;
+    VideoInfo m_VideoInfo;
 
     bool hasHardwareAcceleration;
     bool rendererAlwaysFullScreen;
@@ -56,5 +93,6 @@ private:
     QString versionString;
     bool supportsHdr;
     bool usesMaterial3Theme;
+    bool videoInfoReady;
 };
 
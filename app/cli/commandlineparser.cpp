@@ -1,4 +1,5 @@
 #include "commandlineparser.h"
+#include "streaming/networkimpairment.h"
 
 #include <QCommandLineParser>
 #include <QRegularExpression>
@@ -114,6 +115,58 @@ public:
         return qMakePair(match.captured(1).toInt(), match.captured(2).toInt());
     }
 
+    void applyVideoModeOptions(StreamingPreferences *preferences) const
+    {
+        // Resolve display's width and height
+        static QRegularExpression resolutionRexExp("^(720|1080|1440|4K|resolution)$");
+        QStringList resoOptions = optionNames().filter(resolutionRexExp);
+        bool displaySet = !resoOptions.isEmpty();
+        if (displaySet) {
+            QString name = resoOptions.last();
+            if (name == "720") {
+                preferences->width  = 1280;
+                preferences->height = 720;
+            } else if (name == "1080") {
+                preferences->width  = 1920;
+                preferences->height = 1080;
+            } else if (name == "1440") {
+                preferences->width  = 2560;
+                preferences->height = 1440;
+            } else if (name == "4K") {
+                preferences->width  = 3840;
+                preferences->height = 2160;
+            } else if (name == "resolution") {
+                if (value(name).toLower() == "auto") {
+                    preferences->width = 0;
+                    preferences->height = 0;
+                } else {
+                    auto resolution = getResolutionOptionValue(name);
+                    preferences->width  = resolution.first;
+                    preferences->height = resolution.second;
+                }
+            }
+        }
+
+        // Resolve --fps option
+        if (isSet("fps")) {
+            preferences->fps = getIntOption("fps");
+            if (!inRange(preferences->fps, 10, 480)) {
+                fprintf(stderr, "Warning: FPS is out of the supported range (10 - 480 FPS). Performance may suffer!\n");
+            }
+        }
+
+        // Resolve --bitrate option
+        if (isSet("bitrate")) {
+            preferences->bitrateKbps = getIntOption("bitrate");
+            if (!inRange(preferences->bitrateKbps, 500, 500000)) {
+                fprintf(stderr, "Warning: Bitrate is out of the supported range (500 - 500000 Kbps). Performance may suffer!\n");
+            }
+        } else if (displaySet || isSet("fps")) {
+            preferences->bitrateKbps = preferences->getDefaultBitrate(
+                preferences->width, preferences->height, preferences->fps, preferences->enableYUV444);
+        }
+    }
+
     void addFlagOption(QString name, QString descriptiveName)
     {
         addOption(QCommandLineOption(name, QString("Use %1.").arg(descriptiveName)));
@@ -136,6 +189,21 @@ public:
         m_Choices[name] = choices;
     }
 
+    void applyNetworkImpairmentOption() const
+    {
+        // Streams read the impairment from the environment, which also
+        // passes it on to the processes of a multi-stream load test
+        if (isSet("network-impairment")) {
+            NETWORK_IMPAIRMENT impairment;
+            QString errorMessage;
+
+            if (!NetworkImpairment::parse(value("network-impairment"), &impairment, &errorMessage)) {
+                showError(errorMessage);
+            }
+            qputenv("NETWORK_IMPAIRMENT", value("network-impairment").toUtf8());
+        }
+    }
+
 private:
     QMap<QString, QStringList> m_Choices;
 };
@@ -161,6 +229,8 @@ GlobalCommandLineParser::ParseResult GlobalCommandLineParser::parse(const QStrin
         "  quit            Quit the currently running app\n"
         "  stream          Start streaming an app\n"
         "  pair            Pair a new host\n"
+        "  loadtest        Stream an app without decoding it to load test a host\n"
+        "  renderbench     Time the Vulkan renderer on synthetic frames without a window\n"
         "\n"
         "See 'dancherlink <action> --help' for help of specific action."
     );
@@ -192,6 +262,10 @@ GlobalCommandLineParser::ParseResult GlobalCommandLineParser::parse(const QStrin
                 return PairRequested;
             } else if (action == "list") {
                 return ListRequested;
+            } else if (action == "loadtest") {
+                return LoadTestRequested;
+            } else if (action == "renderbench") {
+                return RenderBenchRequested;
             }
         }
 
@@ -321,6 +395,11 @@ StreamCommandLineParser::StreamCommandLineParser()
         {"fullscreen", StreamingPreferences::CSK_FULLSCREEN},
         {"always",     StreamingPreferences::CSK_ALWAYS},
     };
+    m_LatencyTestModeMap = {
+        {"off",     StreamingPreferences::LTM_OFF},
+        {"text",    StreamingPreferences::LTM_TEXT},
+        {"gamepad", StreamingPreferences::LTM_GAMEPAD},
+    };
 }
 
 StreamCommandLineParser::~StreamCommandLineParser()
@@ -371,6 +450,9 @@ void StreamCommandLineParser::parse(const QStringList &args, StreamingPreference
     parser.addChoiceOption("capture-system-keys", "capture system key combos", m_CaptureSysKeysModeMap.keys());
     parser.addChoiceOption("video-codec", "video codec", m_VideoCodecMap.keys());
     parser.addChoiceOption("video-decoder", "video decoder", m_VideoDecoderMap.keys());
+    parser.addChoiceOption("latency-test", "glass-to-glass latency test input marker", m_LatencyTestModeMap.keys());
+    parser.addFlagOption("startup-timeline", "startup timeline mode (quit after the first frame is rendered)");
+    parser.addValueOption("network-impairment", "simulated network impairment <key>=<value>,...");
 
     if (!parser.parse(args)) {
         parser.showError(parser.errorText());
@@ -378,54 +460,8 @@ void StreamCommandLineParser::parse(const QStringList &args, StreamingPreference
 
     parser.handleUnknownOptions();
 
-    // Resolve display's width and height
-    static QRegularExpression resolutionRexExp("^(720|1080|1440|4K|resolution)$");
-    QStringList resoOptions = parser.optionNames().filter(resolutionRexExp);
-    bool displaySet = !resoOptions.isEmpty();
-    if (displaySet) {
-        QString name = resoOptions.last();
-        if (name == "720") {
-            preferences->width  = 1280;
-            preferences->height = 720;
-        } else if (name == "1080") {
-            preferences->width  = 1920;
-            preferences->height = 1080;
-        } else if (name == "1440") {
-            preferences->width  = 2560;
-            preferences->height = 1440;
-        } else if (name == "4K") {
-            preferences->width  = 3840;
-            preferences->height = 2160;
-        } else if (name == "resolution") {
-            if (parser.value(name).toLower() == "auto") {
-                preferences->width = 0;
-                preferences->height = 0;
-            } else {
-                auto resolution = parser.getResolutionOptionValue(name);
-                preferences->width  = resolution.first;
-                preferences->height = resolution.second;
-            }
-        }
-    }
-
-    // Resolve --fps option
-    if (parser.isSet("fps")) {
-        preferences->fps = parser.getIntOption("fps");
-        if (!inRange(preferences->fps, 10, 480)) {
-            fprintf(stderr, "Warning: FPS is out of the supported range (10 - 480 FPS). Performance may suffer!\n");
-        }
-    }
-
-    // Resolve --bitrate option
-    if (parser.isSet("bitrate")) {
-        preferences->bitrateKbps = parser.getIntOption("bitrate");
-        if (!inRange(preferences->bitrateKbps, 500, 500000)) {
-            fprintf(stderr, "Warning: Bitrate is out of the supported range (500 - 500000 Kbps). Performance may suffer!\n");
-        }
-    } else if (displaySet || parser.isSet("fps")) {
-        preferences->bitrateKbps = preferences->getDefaultBitrate(
-            preferences->width, preferences->height, preferences->fps, preferences->enableYUV444);
-    }
+    // Resolve the resolution, --fps and --bitrate options
+    parser.applyVideoModeOptions(preferences);
 
     // Resolve --packet-size option
     if (parser.isSet("packet-size")) {
@@ -511,6 +547,17 @@ void StreamCommandLineParser::parse(const QStringList &args, StreamingPreference
         preferences->videoDecoderSelection = mapValue(m_VideoDecoderMap, parser.getChoiceOptionValue("video-decoder"));
     }
 
+    // Resolve --latency-test option
+    if (parser.isSet("latency-test")) {
+        preferences->latencyTestMode = mapValue(m_LatencyTestModeMap, parser.getChoiceOptionValue("latency-test"));
+    }
+
+    // Resolve --startup-timeline option
+    preferences->startupTimelineMode = parser.isSet("startup-timeline");
+
+    // Resolve --network-impairment option
+    parser.applyNetworkImpairmentOption();
+
     // This method will not return and terminates the process if --version or
     // --help is specified
     parser.handleHelpAndVersionOptions();
@@ -596,3 +643,275 @@ bool ListCommandLineParser::isVerbose() const
 {
     return m_Verbose;
 }
+
+LoadTestCommandLineParser::LoadTestCommandLineParser()
+    : m_StreamCount(1),
+      m_StreamIndex(-1),
+      m_DurationSecs(0),
+      m_ReportIntervalSecs(5),
+      m_RampUpMs(2000),
+      m_ValidateBitstream(false),
+      m_VideoEncryption(false)
+{
+    m_AudioConfigMap = {
+        {"stereo",       StreamingPreferences::AC_STEREO},
+        {"5.1-surround", StreamingPreferences::AC_51_SURROUND},
+        {"7.1-surround", StreamingPreferences::AC_71_SURROUND},
+    };
+    m_VideoCodecMap = {
+        {"auto",  StreamingPreferences::VCC_AUTO},
+        {"H.264", StreamingPreferences::VCC_FORCE_H264},
+        {"HEVC",  StreamingPreferences::VCC_FORCE_HEVC},
+        {"AV1", StreamingPreferences::VCC_FORCE_AV1},
+    };
+}
+
+LoadTestCommandLineParser::~LoadTestCommandLineParser()
+{
+}
+
+void LoadTestCommandLineParser::parse(const QStringList &args, StreamingPreferences *preferences)
+{
+    CommandLineParser parser;
+    parser.setupCommonOptions();
+    parser.setApplicationDescription(
+        "\n"
+        "Streams an app without a window, decoder or audio device, and logs\n"
+        "the throughput, loss, FEC recovery and RTT of each stream. Each stream\n"
+        "runs in its own process, so many streams can run from one machine."
+    );
+    parser.addPositionalArgument("loadtest", "Load test host");
+    parser.addPositionalArgument("host", "Host computer name, UUID, or IP address", "<host>");
+    parser.addPositionalArgument("app", "App to stream", "\"<app>\"");
+
+    parser.addValueOption("streams", "number of concurrent streams");
+    parser.addValueOption("duration", "test duration in seconds (0 runs until interrupted)");
+    parser.addValueOption("report-interval", "seconds between stream reports");
+    parser.addValueOption("ramp-up", "delay in milliseconds between starting streams");
+    parser.addFlagOption("validate", "cheap bitstream validation of received frames");
+    parser.addToggleOption("video-encryption", "video encryption");
+    parser.addFlagOption("720",  "1280x720 resolution");
+    parser.addFlagOption("1080", "1920x1080 resolution");
+    parser.addFlagOption("1440", "2560x1440 resolution");
+    parser.addFlagOption("4K", "3840x2160 resolution");
+    parser.addValueOption("resolution", "custom <width>x<height> resolution");
+    parser.addValueOption("fps", "FPS");
+    parser.addValueOption("bitrate", "bitrate in Kbps");
+    parser.addValueOption("packet-size", "video packet size");
+    parser.addChoiceOption("audio-config", "audio config", m_AudioConfigMap.keys());
+    parser.addChoiceOption("video-codec", "video codec", m_VideoCodecMap.keys());
+    parser.addValueOption("network-impairment", "simulated network impairment <key>=<value>,...");
+
+    // Set on the processes started for each stream of a multi-stream test
+    QCommandLineOption streamIndexOption("stream-index", "Index of this stream.", "stream-index");
+    streamIndexOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOption(streamIndexOption);
+
+    if (!parser.parse(args)) {
+        parser.showError(parser.errorText());
+    }
+
+    parser.handleUnknownOptions();
+
+    // Resolve the resolution, --fps and --bitrate options
+    parser.applyVideoModeOptions(preferences);
+
+    // There's no screen to match, so streams use a fixed resolution
+    if (preferences->width == 0 || preferences->height == 0) {
+        preferences->width = 1280;
+        preferences->height = 720;
+    }
+
+    // Resolve --packet-size option
+    if (parser.isSet("packet-size")) {
+        preferences->packetSize = parser.getIntOption("packet-size");
+        if (preferences->packetSize < 1024) {
+            parser.showError("Packet size must be greater than 1024 bytes");
+        }
+    }
+
+    // Resolve --audio-config option
+    if (parser.isSet("audio-config")) {
+        preferences->audioConfig = mapValue(m_AudioConfigMap, parser.getChoiceOptionValue("audio-config"));
+    }
+
+    // Resolve --video-codec option
+    if (parser.isSet("video-codec")) {
+        preferences->videoCodecConfig = mapValue(m_VideoCodecMap, parser.getChoiceOptionValue("video-codec"));
+    }
+
+    // Resolve --streams option
+    if (parser.isSet("streams")) {
+        m_StreamCount = parser.getIntOption("streams");
+        if (m_StreamCount < 1) {
+            parser.showError("At least 1 stream is required");
+        }
+    }
+
+    // Resolve --duration option
+    if (parser.isSet("duration")) {
+        m_DurationSecs = parser.getIntOption("duration");
+        if (m_DurationSecs < 0) {
+            parser.showError("Duration must not be negative");
+        }
+    }
+
+    // Resolve --report-interval option
+    if (parser.isSet("report-interval")) {
+        m_ReportIntervalSecs = parser.getIntOption("report-interval");
+        if (m_ReportIntervalSecs < 1) {
+            parser.showError("Report interval must be at least 1 second");
+        }
+    }
+
+    // Resolve --ramp-up option
+    if (parser.isSet("ramp-up")) {
+        m_RampUpMs = parser.getIntOption("ramp-up");
+        if (m_RampUpMs < 0) {
+            parser.showError("Ramp up delay must not be negative");
+        }
+    }
+
+    // Resolve --stream-index option
+    if (parser.isSet("stream-index")) {
+        m_StreamIndex = parser.getIntOption("stream-index");
+    }
+
+    // Resolve --network-impairment option
+    parser.applyNetworkImpairmentOption();
+
+    m_ValidateBitstream = parser.isSet("validate");
+    m_VideoEncryption = parser.getToggleOptionValue("video-encryption", false);
+
+    // This method will not return and terminates the process if --version or
+    // --help is specified
+    parser.handleHelpAndVersionOptions();
+
+    // Verify that both host and app has been provided
+    auto posArgs = parser.positionalArguments();
+    if (posArgs.length() < 2) {
+        parser.showError("Host not provided");
+    }
+    m_Host = parser.positionalArguments().at(1);
+
+    if (posArgs.length() < 3) {
+        parser.showError("App not provided");
+    }
+    m_AppName = parser.positionalArguments().at(2);
+}
+
+QString LoadTestCommandLineParser::getHost() const
+{
+    return m_Host;
+}
+
+QString LoadTestCommandLineParser::getAppName() const
+{
+    return m_AppName;
+}
+
+int LoadTestCommandLineParser::getStreamCount() const
+{
+    return m_StreamCount;
+}
+
+int LoadTestCommandLineParser::getStreamIndex() const
+{
+    return m_StreamIndex;
+}
+
+int LoadTestCommandLineParser::getDurationSecs() const
+{
+    return m_DurationSecs;
+}
+
+int LoadTestCommandLineParser::getReportIntervalSecs() const
+{
+    return m_ReportIntervalSecs;
+}
+
+int LoadTestCommandLineParser::getRampUpMs() const
+{
+    return m_RampUpMs;
+}
+
+bool LoadTestCommandLineParser::isValidateBitstream() const
+{
+    return m_ValidateBitstream;
+}
+
+bool LoadTestCommandLineParser::isVideoEncryption() const
+{
+    return m_VideoEncryption;
+}
+
+RenderBenchCommandLineParser::RenderBenchCommandLineParser()
+    : m_FrameCount(600),
+      m_Hdr(false)
+{
+}
+
+RenderBenchCommandLineParser::~RenderBenchCommandLineParser()
+{
+}
+
+void RenderBenchCommandLineParser::parse(const QStringList &args, StreamingPreferences *preferences)
+{
+    CommandLineParser parser;
+    parser.setupCommonOptions();
+    parser.setApplicationDescription(
+        "\n"
+        "Renders synthetic software frames with the Vulkan renderer into an\n"
+        "offscreen target, and prints the upload and render time of each frame.\n"
+        "No window or host is needed, so this also runs on Mesa's lavapipe."
+    );
+    parser.addPositionalArgument("renderbench", "Benchmark the Vulkan renderer");
+
+    parser.addValueOption("frames", "number of frames to render");
+    parser.addFlagOption("hdr", "10-bit HDR frames");
+    parser.addFlagOption("720",  "1280x720 resolution");
+    parser.addFlagOption("1080", "1920x1080 resolution");
+    parser.addFlagOption("1440", "2560x1440 resolution");
+    parser.addFlagOption("4K", "3840x2160 resolution");
+    parser.addValueOption("resolution", "custom <width>x<height> resolution");
+    parser.addValueOption("fps", "FPS");
+
+    if (!parser.parse(args)) {
+        parser.showError(parser.errorText());
+    }
+
+    parser.handleUnknownOptions();
+
+    // Resolve the resolution and --fps options
+    parser.applyVideoModeOptions(preferences);
+
+    // There's no screen to match, so frames use a fixed resolution
+    if (preferences->width == 0 || preferences->height == 0) {
+        preferences->width = 1920;
+        preferences->height = 1080;
+    }
+
+    // Resolve --frames option
+    if (parser.isSet("frames")) {
+        m_FrameCount = parser.getIntOption("frames");
+        if (m_FrameCount < 1) {
+            parser.showError("At least 1 frame is required");
+        }
+    }
+
+    m_Hdr = parser.isSet("hdr");
+
+    // This method will not return and terminates the process if --version or
+    // --help is specified
+    parser.handleHelpAndVersionOptions();
+}
+
+int RenderBenchCommandLineParser::getFrameCount() const
+{
+    return m_FrameCount;
+}
+
+bool RenderBenchCommandLineParser::isHdr() const
+{
+    return m_Hdr;
+}
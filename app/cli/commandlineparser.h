@@ -14,6 +14,8 @@ public:
         QuitRequested,
         PairRequested,
         ListRequested,
+        LoadTestRequested,
+        RenderBenchRequested,
     };
 
     GlobalCommandLineParser();
@@ -72,6 +74,7 @@ private:
     QMap<QString, StreamingPreferences::VideoCodecConfig> m_VideoCodecMap;
     QMap<QString, StreamingPreferences::VideoDecoderSelection> m_VideoDecoderMap;
     QMap<QString, StreamingPreferences::CaptureSysKeysMode> m_CaptureSysKeysModeMap;
+    QMap<QString, StreamingPreferences::LatencyTestMode> m_LatencyTestModeMap;
 };
 
 class ListCommandLineParser
@@ -91,3 +94,51 @@ private:
     bool m_PrintCSV;
     bool m_Verbose;
 };
+
+class LoadTestCommandLineParser
+{
+public:
+    LoadTestCommandLineParser();
+    virtual ~LoadTestCommandLineParser();
+
+    void parse(const QStringList &args, StreamingPreferences *preferences);
+
+    QString getHost() const;
+    QString getAppName() const;
+    int getStreamCount() const;
+    int getStreamIndex() const;
+    int getDurationSecs() const;
+    int getReportIntervalSecs() const;
+    int getRampUpMs() const;
+    bool isValidateBitstream() const;
+    bool isVideoEncryption() const;
+
+private:
+    QString m_Host;
+    QString m_AppName;
+    int m_StreamCount;
+    int m_StreamIndex;
+    int m_DurationSecs;
+    int m_ReportIntervalSecs;
+    int m_RampUpMs;
+    bool m_ValidateBitstream;
+    bool m_VideoEncryption;
+    QMap<QString, StreamingPreferences::AudioConfig> m_AudioConfigMap;
+    QMap<QString, StreamingPreferences::VideoCodecConfig> m_VideoCodecMap;
+};
+
+class RenderBenchCommandLineParser
+{
+public:
+    RenderBenchCommandLineParser();
+    virtual ~RenderBenchCommandLineParser();
+
+    void parse(const QStringList &args, StreamingPreferences *preferences);
+
+    int getFrameCount() const;
+    bool isHdr() const;
+
+private:
+    int m_FrameCount;
+    bool m_Hdr;
+};
@@ -0,0 +1,829 @@
+#include "loadtest.h"
+
+#include "backend/computermanager.h"
+#include "backend/computerseeker.h"
+#include "backend/nvhttp.h"
+#include "settings/streamingpreferences.h"
+#include "streaming/networkimpairment.h"
+
+#include <Limelight.h>
+#include "SDL_compat.h"
+
+#include <openssl/rand.h>
+
+#include <QCoreApplication>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <atomic>
+
+#define COMPUTER_SEEK_TIMEOUT 30000
+
+// moonlight-common-c supports a single connection per process, so a test with
+// several streams runs each of them in a child process of its own. The null
+// decoder and audio renderer below don't need a window, GPU or audio device,
+// so each of these processes only costs the network threads of the library.
+
+namespace CliLoadTest
+{
+
+enum State {
+    StateInit,
+    StateSeekComputer,
+    StateStartConnection,
+    StateStreaming,
+    StateRunStreamProcesses,
+    StateFinished,
+    StateFailure,
+};
+
+// Updated by the library's receive threads and read by the report timer
+struct StreamCounters
+{
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> idrFrames;
+    std::atomic<uint64_t> videoBytes;
+    std::atomic<uint64_t> framesLost;
+    std::atomic<uint64_t> invalidFrames;
+    std::atomic<uint64_t> audioPackets;
+};
+
+struct StreamSnapshot
+{
+    uint64_t timeMs;
+    uint64_t frames;
+    uint64_t idrFrames;
+    uint64_t videoBytes;
+    uint64_t framesLost;
+    uint64_t invalidFrames;
+    uint64_t audioPackets;
+    RTP_VIDEO_STATS videoStats;
+    RTP_AUDIO_STATS audioStats;
+    RECOVERY_REQUEST_STATS recoveryStats;
+    NETWORK_IMPAIRMENT_STATS impairmentStats;
+};
+
+static StreamCounters s_Counters;
+static int s_VideoFormat;
+static bool s_ValidateBitstream;
+static Launcher* s_ActiveLauncher;
+
+// Only touched on the video receive thread
+static int s_LastFrameNumber;
+static bool s_InPartialFrame;
+
+static bool isAnnexBStartCode(const char* data, int length)
+{
+    return (length >= 3 && data[0] == 0 && data[1] == 0 && data[2] == 1) ||
+           (length >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1);
+}
+
+// These checks are cheap enough to run on every frame of hundreds of streams.
+// They catch depacketizer and host bugs that would upset a real decoder, but
+// they don't parse the bitstream itself.
+static bool validateFrameStart(PDECODE_UNIT du)
+{
+    int totalLength = 0;
+
+    for (PLENTRY entry = du->bufferList; entry != nullptr; entry = entry->next) {
+        totalLength += entry->length;
+    }
+    if (totalLength != du->fullLength) {
+        return false;
+    }
+
+    if (s_VideoFormat & VIDEO_FORMAT_MASK_AV1) {
+        // The forbidden bit of the first OBU header must be clear
+        return (du->bufferList->data[0] & 0x80) == 0;
+    }
+
+    // IDR frames must start with the parameter sets
+    if (du->frameType == FRAME_TYPE_IDR && du->bufferList->bufferType == BUFFER_TYPE_PICDATA) {
+        return false;
+    }
+
+    // Parameter sets and the picture data that follows them each start with
+    // a start code. The rest of the picture data is split at packet boundaries.
+    for (PLENTRY entry = du->bufferList; entry != nullptr; entry = entry->next) {
+        if (!isAnnexBStartCode(entry->data, entry->length)) {
+            return false;
+        }
+        if (entry->bufferType == BUFFER_TYPE_PICDATA) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+static int drSetup(int videoFormat, int width, int height, int frameRate, void*, int)
+{
+    s_VideoFormat = videoFormat;
+    s_LastFrameNumber = 0;
+    s_InPartialFrame = false;
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Load test stream: video format 0x%x, %dx%d at %d FPS",
+                videoFormat, width, height, frameRate);
+    return 0;
+}
+
+static int drSubmitDecodeUnit(PDECODE_UNIT du)
+{
+    s_Counters.videoBytes.fetch_add(du->fullLength, std::memory_order_relaxed);
+
+    if (!s_InPartialFrame) {
+        // The depacketizer only submits whole frames, so gaps in the frame
+        // numbers are frames the network lost and FEC couldn't recover
+        if (s_LastFrameNumber != 0 && du->frameNumber > s_LastFrameNumber + 1) {
+            s_Counters.framesLost.fetch_add(du->frameNumber - s_LastFrameNumber - 1, std::memory_order_relaxed);
+        }
+        s_LastFrameNumber = du->frameNumber;
+
+        if (s_ValidateBitstream && !validateFrameStart(du)) {
+            s_Counters.invalidFrames.fetch_add(1, std::memory_order_relaxed);
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Frame %d failed bitstream validation",
+                        du->frameNumber);
+            s_InPartialFrame = du->partialFrame;
+            return DR_NEED_IDR;
+        }
+    }
+
+    s_InPartialFrame = du->partialFrame;
+    if (!du->partialFrame) {
+        s_Counters.frames.fetch_add(1, std::memory_order_relaxed);
+        if (du->frameType == FRAME_TYPE_IDR) {
+            s_Counters.idrFrames.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    return DR_OK;
+}
+
+static int arInit(int, const POPUS_MULTISTREAM_CONFIGURATION, void*, int)
+{
+    return 0;
+}
+
+static void arDecodeAndPlaySample(char*, int)
+{
+    s_Counters.audioPackets.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void clStageFailed(int stage, int errorCode)
+{
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "Load test stream: %s failed: %d",
+                 LiGetStageName(stage), errorCode);
+}
+
+static void clConnectionTerminated(int errorCode)
+{
+    QMetaObject::invokeMethod(s_ActiveLauncher, "onConnectionTerminated",
+                              Qt::QueuedConnection, Q_ARG(int, errorCode));
+}
+
+static void clLogMessage(const char* format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    SDL_LogMessageV(SDL_LOG_CATEGORY_APPLICATION,
+                    SDL_LOG_PRIORITY_INFO,
+                    format,
+                    ap);
+    va_end(ap);
+}
+
+class LauncherPrivate
+{
+    Q_DECLARE_PUBLIC(Launcher)
+
+public:
+    LauncherPrivate(Launcher *q) : q_ptr(q) {}
+
+    int streamIndex() const
+    {
+        return qMax(m_Arguments.getStreamIndex(), 0);
+    }
+
+    void printLine(const QString& text) const
+    {
+        // Stream processes write to a pipe, so flush each line to keep the
+        // output of concurrent streams from interleaving mid-line
+        fprintf(stdout, "[stream %d] %s\n", streamIndex(), qPrintable(text));
+        fflush(stdout);
+    }
+
+    void fail(const QString& text)
+    {
+        m_State = StateFailure;
+        printLine(QString("failed: %1").arg(text));
+        QCoreApplication::exit(1);
+    }
+
+    void startStreamProcesses()
+    {
+        Q_Q(Launcher);
+
+        m_State = StateRunStreamProcesses;
+        m_ProcessesStarted = 0;
+        m_ProcessesRunning = 0;
+        m_ProcessesFailed = 0;
+
+        fprintf(stdout, "Starting %d streams to %s, %d ms apart\n",
+                m_Arguments.getStreamCount(),
+                qPrintable(m_Arguments.getHost()),
+                m_Arguments.getRampUpMs());
+        fflush(stdout);
+
+        // Starting all streams at once would also load test the host's
+        // launch handling, which isn't what we're measuring
+        m_RampUpTimer = new QTimer(q);
+        q->connect(m_RampUpTimer, &QTimer::timeout,
+                   q, &Launcher::onStartNextStreamProcess);
+        m_RampUpTimer->start(m_Arguments.getRampUpMs());
+        q->onStartNextStreamProcess();
+    }
+
+    void startStreamProcess()
+    {
+        Q_Q(Launcher);
+
+        QProcess* process = new QProcess(q);
+        process->setProgram(QCoreApplication::applicationFilePath());
+        process->setArguments(QCoreApplication::arguments().mid(1)
+                              << "--stream-index" << QString::number(m_ProcessesStarted));
+
+        // Console logs from hundreds of streams would bury their reports,
+        // so only the reports are passed through
+        process->setStandardErrorFile(QProcess::nullDevice());
+
+        q->connect(process, &QProcess::readyReadStandardOutput,
+                   q, &Launcher::onStreamProcessOutput);
+        q->connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                   q, &Launcher::onStreamProcessFinished);
+
+        process->start();
+        m_ProcessesStarted++;
+
+        if (!process->waitForStarted()) {
+            fprintf(stdout, "[stream %d] failed: %s\n",
+                    m_ProcessesStarted - 1, qPrintable(process->errorString()));
+            fflush(stdout);
+            m_ProcessesFailed++;
+            delete process;
+            return;
+        }
+
+        m_ProcessesRunning++;
+    }
+
+    void startConnection()
+    {
+        Q_Q(Launcher);
+
+        int appIndex = -1;
+        for (int i = 0; i < m_AppList.length(); i++) {
+            if (m_AppList[i].name.toLower() == m_Arguments.getAppName().toLower()) {
+                appIndex = i;
+                break;
+            }
+        }
+        if (appIndex < 0) {
+            fail(QString("Failed to find application %1").arg(m_Arguments.getAppName()));
+            return;
+        }
+
+        // Streams join the app that the first stream launched, but they
+        // mustn't replace an app that someone else is running
+        NvApp app = m_AppList[appIndex];
+        if (m_Computer->currentGameId != 0 && m_Computer->currentGameId != app.id) {
+            fail(QString("%1 is running a different app").arg(m_Computer->name));
+            return;
+        }
+
+        LiInitializeStreamConfiguration(&m_StreamConfig);
+        m_StreamConfig.width = m_Preferences->width;
+        m_StreamConfig.height = m_Preferences->height;
+        m_StreamConfig.fps = m_Preferences->fps;
+        m_StreamConfig.bitrate = m_Preferences->bitrateKbps;
+
+        // Video decryption is the largest per-stream cost on the client,
+        // so it's off unless the host's encryption cost is being measured
+        m_StreamConfig.encryptionFlags = m_Arguments.isVideoEncryption() ? ENCFLG_ALL : ENCFLG_AUDIO;
+
+        switch (m_Preferences->audioConfig)
+        {
+        case StreamingPreferences::AC_STEREO:
+            m_StreamConfig.audioConfiguration = AUDIO_CONFIGURATION_STEREO;
+            break;
+        case StreamingPreferences::AC_51_SURROUND:
+            m_StreamConfig.audioConfiguration = AUDIO_CONFIGURATION_51_SURROUND;
+            break;
+        case StreamingPreferences::AC_71_SURROUND:
+            m_StreamConfig.audioConfiguration = AUDIO_CONFIGURATION_71_SURROUND;
+            break;
+        }
+
+        // Nothing is decoded, so any codec the host can encode will do
+        switch (m_Preferences->videoCodecConfig)
+        {
+        case StreamingPreferences::VCC_AUTO:
+            m_StreamConfig.supportedVideoFormats = VIDEO_FORMAT_H264;
+            if (m_Computer->serverCodecModeSupport & SCM_HEVC) {
+                m_StreamConfig.supportedVideoFormats |= VIDEO_FORMAT_H265;
+            }
+            if (m_Computer->serverCodecModeSupport & SCM_AV1_MAIN8) {
+                m_StreamConfig.supportedVideoFormats |= VIDEO_FORMAT_AV1_MAIN8;
+            }
+            break;
+        case StreamingPreferences::VCC_FORCE_H264:
+            m_StreamConfig.supportedVideoFormats = VIDEO_FORMAT_H264;
+            break;
+        case StreamingPreferences::VCC_FORCE_HEVC:
+        case StreamingPreferences::VCC_FORCE_HEVC_HDR_DEPRECATED:
+            m_StreamConfig.supportedVideoFormats = VIDEO_FORMAT_H265;
+            break;
+        case StreamingPreferences::VCC_FORCE_AV1:
+            m_StreamConfig.supportedVideoFormats = VIDEO_FORMAT_AV1_MAIN8;
+            break;
+        }
+
+        if (m_Preferences->packetSize != 0) {
+            m_StreamConfig.streamingRemotely = STREAM_CFG_LOCAL;
+            m_StreamConfig.packetSize = m_Preferences->packetSize;
+        }
+        else {
+            m_StreamConfig.streamingRemotely = STREAM_CFG_AUTO;
+            m_StreamConfig.packetSize = 1392;
+        }
+
+        // Each stream gets its own loss pattern, which is still the same on every run
+        m_NetworkImpairment.load();
+        m_NetworkImpairment.applyToStreamConfig(&m_StreamConfig);
+        m_StreamConfig.networkImpairment.seed += streamIndex();
+
+        RAND_bytes(reinterpret_cast<unsigned char*>(m_StreamConfig.remoteInputAesKey),
+                   sizeof(m_StreamConfig.remoteInputAesKey));
+
+        // Only the first 4 bytes are populated in the RI key IV
+        RAND_bytes(reinterpret_cast<unsigned char*>(m_StreamConfig.remoteInputAesIv), 4);
+
+        LiInitializeVideoCallbacks(&m_VideoCallbacks);
+        m_VideoCallbacks.setup = drSetup;
+        m_VideoCallbacks.submitDecodeUnit = drSubmitDecodeUnit;
+        m_VideoCallbacks.capabilities = CAPABILITY_DIRECT_SUBMIT;
+
+        LiInitializeAudioCallbacks(&m_AudioCallbacks);
+        m_AudioCallbacks.init = arInit;
+        m_AudioCallbacks.decodeAndPlaySample = arDecodeAndPlaySample;
+        m_AudioCallbacks.capabilities = CAPABILITY_DIRECT_SUBMIT;
+
+        LiInitializeConnectionCallbacks(&m_ConnCallbacks);
+        m_ConnCallbacks.stageFailed = clStageFailed;
+        m_ConnCallbacks.connectionTerminated = clConnectionTerminated;
+        m_ConnCallbacks.logMessage = clLogMessage;
+
+        s_ValidateBitstream = m_Arguments.isValidateBitstream();
+
+        m_State = StateStartConnection;
+
+        // The launch request and LiStartConnection() both block, so they run
+        // off the main thread like they do for a normal session
+        NvComputer* computer = m_Computer;
+        STREAM_CONFIGURATION streamConfig = m_StreamConfig;
+        PDECODER_RENDERER_CALLBACKS videoCallbacks = &m_VideoCallbacks;
+        PAUDIO_RENDERER_CALLBACKS audioCallbacks = &m_AudioCallbacks;
+        PCONNECTION_LISTENER_CALLBACKS connCallbacks = &m_ConnCallbacks;
+        int appId = app.id;
+        QtConcurrent::run([q, computer, streamConfig, videoCallbacks, audioCallbacks, connCallbacks, appId]() mutable {
+            QString rtspSessionUrl;
+
+            try {
+                NvHTTP http(computer);
+                http.startApp(computer->currentGameId != 0 ? "resume" : "launch",
+                              computer->isNvidiaServerSoftware,
+                              appId, &streamConfig,
+                              false, false, 0, false,
+                              rtspSessionUrl);
+            } catch (const GfeHttpResponseException& e) {
+                QMetaObject::invokeMethod(q, "onConnectionStarted", Qt::QueuedConnection,
+                                          Q_ARG(bool, false),
+                                          Q_ARG(QString, QString("Host returned error: %1").arg(e.toQString())));
+                return;
+            } catch (const QtNetworkReplyException& e) {
+                QMetaObject::invokeMethod(q, "onConnectionStarted", Qt::QueuedConnection,
+                                          Q_ARG(bool, false),
+                                          Q_ARG(QString, e.toQString()));
+                return;
+            }
+
+            QByteArray hostnameStr = computer->activeAddress.address().toLatin1();
+            QByteArray siAppVersion = computer->appVersion.toLatin1();
+            QByteArray siGfeVersion = computer->gfeVersion.toLatin1();
+            QByteArray rtspSessionUrlStr = rtspSessionUrl.toLatin1();
+
+            SERVER_INFORMATION hostInfo;
+            LiInitializeServerInformation(&hostInfo);
+            hostInfo.address = hostnameStr.data();
+            hostInfo.serverInfoAppVersion = siAppVersion.data();
+            hostInfo.serverCodecModeSupport = computer->serverCodecModeSupport;
+            hostInfo.preferredAddressFamily = computer->preferredAddressFamily;
+            if (!siGfeVersion.isEmpty()) {
+                hostInfo.serverInfoGfeVersion = siGfeVersion.data();
+            }
+            if (!rtspSessionUrlStr.isEmpty()) {
+                hostInfo.rtspSessionUrl = rtspSessionUrlStr.data();
+            }
+
+            int err = LiStartConnection(&hostInfo, &streamConfig, connCallbacks,
+                                        videoCallbacks, audioCallbacks,
+                                        NULL, 0, NULL, 0);
+            QMetaObject::invokeMethod(q, "onConnectionStarted", Qt::QueuedConnection,
+                                      Q_ARG(bool, err == 0),
+                                      Q_ARG(QString, err == 0 ? QString() : QString("Connection failed: %1").arg(err)));
+        });
+    }
+
+    StreamSnapshot takeSnapshot() const
+    {
+        StreamSnapshot snapshot;
+
+        snapshot.timeMs = LiGetMillis();
+        snapshot.frames = s_Counters.frames.load(std::memory_order_relaxed);
+        snapshot.idrFrames = s_Counters.idrFrames.load(std::memory_order_relaxed);
+        snapshot.videoBytes = s_Counters.videoBytes.load(std::memory_order_relaxed);
+        snapshot.framesLost = s_Counters.framesLost.load(std::memory_order_relaxed);
+        snapshot.invalidFrames = s_Counters.invalidFrames.load(std::memory_order_relaxed);
+        snapshot.audioPackets = s_Counters.audioPackets.load(std::memory_order_relaxed);
+        snapshot.videoStats = *LiGetRTPVideoStats();
+        snapshot.audioStats = *LiGetRTPAudioStats();
+        LiGetRecoveryRequestStats(&snapshot.recoveryStats);
+        snapshot.impairmentStats = *LiGetVideoImpairmentStats();
+
+        return snapshot;
+    }
+
+    void report(const QString& label, const StreamSnapshot& from, const StreamSnapshot& to) const
+    {
+        double seconds = qMax<uint64_t>(to.timeMs - from.timeMs, 1) / 1000.0;
+        uint32_t rtt = 0, rttVariance = 0;
+
+        LiGetEstimatedRttInfo(&rtt, &rttVariance);
+
+        printLine(QString("%1 %2 s: video %3 FPS %4 Mbps, %5 IDR, %6 frames lost, %7 invalid, "
+                          "FEC recovered %8 (%9 failed) | audio %10 packets/s, FEC recovered %11 (%12 failed) | "
+                          "RTT %13 ms (variance %14 ms) | %15 RFI, %16 IDR requests")
+                  .arg(label)
+                  .arg(seconds, 0, 'f', 1)
+                  .arg((to.frames - from.frames) / seconds, 0, 'f', 1)
+                  .arg((to.videoBytes - from.videoBytes) * 8 / seconds / 1000000.0, 0, 'f', 2)
+                  .arg(to.idrFrames - from.idrFrames)
+                  .arg(to.framesLost - from.framesLost)
+                  .arg(to.invalidFrames - from.invalidFrames)
+                  .arg(to.videoStats.packetCountFecRecovered - from.videoStats.packetCountFecRecovered)
+                  .arg(to.videoStats.packetCountFecFailed - from.videoStats.packetCountFecFailed)
+                  .arg((to.audioPackets - from.audioPackets) / seconds, 0, 'f', 0)
+                  .arg(to.audioStats.packetCountFecRecovered - from.audioStats.packetCountFecRecovered)
+                  .arg(to.audioStats.packetCountFecFailed - from.audioStats.packetCountFecFailed)
+                  .arg(rtt)
+                  .arg(rttVariance)
+                  .arg(to.recoveryStats.rfiRequestsSent - from.recoveryStats.rfiRequestsSent)
+                  .arg(to.recoveryStats.idrRequestsSent - from.recoveryStats.idrRequestsSent));
+
+        if (m_NetworkImpairment.isEnabled()) {
+            const NETWORK_IMPAIRMENT_STATS& fromStats = from.impairmentStats;
+            const NETWORK_IMPAIRMENT_STATS& toStats = to.impairmentStats;
+            uint32_t delivered = toStats.packetsDelivered - fromStats.packetsDelivered;
+
+            printLine(QString("%1 impairment: %2 video packets lost, %3 over bandwidth, %4 reordered, "
+                              "%5 duplicated, %6 ms average added delay")
+                      .arg(label)
+                      .arg(toStats.packetsLost - fromStats.packetsLost)
+                      .arg(toStats.packetsOverBandwidth - fromStats.packetsOverBandwidth)
+                      .arg(toStats.packetsReordered - fromStats.packetsReordered)
+                      .arg(toStats.packetsDuplicated - fromStats.packetsDuplicated)
+                      .arg(delivered != 0 ? (toStats.totalAddedDelayUs - fromStats.totalAddedDelayUs) / 1000.0 / delivered : 0.0, 0, 'f', 2));
+        }
+    }
+
+    void finishStreamProcesses()
+    {
+        fprintf(stdout, "%d of %d streams completed successfully\n",
+                m_ProcessesStarted - m_ProcessesFailed,
+                m_ProcessesStarted);
+        fflush(stdout);
+
+        m_State = StateFinished;
+        QCoreApplication::exit(m_ProcessesFailed != 0 ? 1 : 0);
+    }
+
+    void stopStreaming(int exitCode)
+    {
+        report("total", m_StartSnapshot, takeSnapshot());
+
+        m_State = StateFinished;
+        m_ReportTimer->stop();
+        LiStopConnection();
+        QCoreApplication::exit(exitCode);
+    }
+
+    Launcher *q_ptr;
+    LoadTestCommandLineParser m_Arguments;
+    StreamingPreferences *m_Preferences;
+    NetworkImpairment m_NetworkImpairment;
+    ComputerManager *m_ComputerManager;
+    ComputerSeeker *m_ComputerSeeker;
+    NvComputer *m_Computer;
+    QVector<NvApp> m_AppList;
+    State m_State;
+    STREAM_CONFIGURATION m_StreamConfig;
+    DECODER_RENDERER_CALLBACKS m_VideoCallbacks;
+    AUDIO_RENDERER_CALLBACKS m_AudioCallbacks;
+    CONNECTION_LISTENER_CALLBACKS m_ConnCallbacks;
+    QTimer *m_ReportTimer;
+    StreamSnapshot m_StartSnapshot;
+    StreamSnapshot m_LastSnapshot;
+    QTimer *m_RampUpTimer;
+    int m_ProcessesStarted;
+    int m_ProcessesRunning;
+    int m_ProcessesFailed;
+    bool m_Interrupted;
+};
+
+Launcher::Launcher(LoadTestCommandLineParser arguments,
+                   StreamingPreferences *preferences,
+                   QObject *parent)
+    : QObject(parent),
+      m_DPtr(new LauncherPrivate(this))
+{
+    Q_D(Launcher);
+    d->m_Arguments = arguments;
+    d->m_Preferences = preferences;
+    d->m_State = StateInit;
+    d->m_Interrupted = false;
+    d->m_ReportTimer = new QTimer(this);
+    connect(d->m_ReportTimer, &QTimer::timeout,
+            this, &Launcher::onReportTimer);
+
+    s_ActiveLauncher = this;
+}
+
+Launcher::~Launcher()
+{
+    if (s_ActiveLauncher == this) {
+        s_ActiveLauncher = nullptr;
+    }
+}
+
+Launcher* Launcher::get()
+{
+    return s_ActiveLauncher;
+}
+
+void Launcher::execute(ComputerManager *manager)
+{
+    Q_D(Launcher);
+
+    if (d->m_State != StateInit) {
+        return;
+    }
+
+    if (d->m_Arguments.getStreamIndex() < 0 && d->m_Arguments.getStreamCount() > 1) {
+        d->startStreamProcesses();
+        return;
+    }
+
+    d->m_State = StateSeekComputer;
+    d->m_ComputerManager = manager;
+    d->m_ComputerSeeker = new ComputerSeeker(manager, d->m_Arguments.getHost(), this);
+    connect(d->m_ComputerSeeker, &ComputerSeeker::computerFound,
+            this, &Launcher::onComputerFound);
+    connect(d->m_ComputerSeeker, &ComputerSeeker::errorTimeout,
+            this, &Launcher::onComputerSeekTimeout);
+    d->m_ComputerSeeker->start(COMPUTER_SEEK_TIMEOUT);
+}
+
+bool Launcher::isExecuted() const
+{
+    Q_D(const Launcher);
+    return d->m_State != StateInit;
+}
+
+void Launcher::interrupt()
+{
+    Q_D(Launcher);
+
+    switch (d->m_State) {
+    case StateInit:
+    case StateSeekComputer:
+        d->fail("interrupted");
+        break;
+
+    case StateStartConnection:
+        // The launch request can't be interrupted, so onConnectionStarted()
+        // stops the stream if LiStartConnection() still succeeds
+        if (!d->m_Interrupted) {
+            d->m_Interrupted = true;
+            LiInterruptConnection();
+        }
+        break;
+
+    case StateStreaming:
+        d->printLine("interrupted");
+        d->stopStreaming(0);
+        break;
+
+    case StateRunStreamProcesses:
+        if (d->m_Interrupted) {
+            // Don't wait for streams that are stuck. The remaining stream
+            // processes are killed when the launcher is destroyed.
+            fprintf(stdout, "Interrupted again, abandoning %d streams\n", d->m_ProcessesRunning);
+            fflush(stdout);
+            d->m_State = StateFailure;
+            QCoreApplication::exit(1);
+            break;
+        }
+
+        d->m_Interrupted = true;
+        d->m_RampUpTimer->stop();
+
+        fprintf(stdout, "Interrupted, stopping %d streams\n", d->m_ProcessesRunning);
+        fflush(stdout);
+
+        // Each stream process reports its totals on SIGTERM just like on SIGINT,
+        // which a terminal will usually have sent them already
+        for (QProcess* process : findChildren<QProcess*>()) {
+            process->terminate();
+        }
+
+        if (d->m_ProcessesRunning == 0) {
+            d->finishStreamProcesses();
+        }
+        break;
+
+    case StateFinished:
+    case StateFailure:
+        break;
+    }
+}
+
+void Launcher::onComputerFound(NvComputer *computer)
+{
+    Q_D(Launcher);
+
+    if (d->m_State != StateSeekComputer) {
+        return;
+    }
+
+    if (computer->pairState != NvComputer::PS_PAIRED) {
+        d->fail(QString("Computer %1 has not been paired").arg(computer->name));
+        return;
+    }
+
+    d->m_Computer = computer;
+
+    // Polling every host from hundreds of stream processes would add load of its own
+    d->m_ComputerManager->stopPollingAsync();
+
+    // Fetch the app list ourselves, like the list command, rather than
+    // waiting for the poller to update it
+    try {
+        NvHTTP http{computer};
+        d->m_AppList = http.getAppList();
+    } catch (std::exception& exception) {
+        d->fail(exception.what());
+        return;
+    }
+
+    d->startConnection();
+}
+
+void Launcher::onComputerSeekTimeout()
+{
+    Q_D(Launcher);
+
+    if (d->m_State == StateSeekComputer) {
+        d->fail(QString("Failed to connect to %1").arg(d->m_Arguments.getHost()));
+    }
+}
+
+void Launcher::onConnectionStarted(bool success, QString errorMessage)
+{
+    Q_D(Launcher);
+
+    if (d->m_State != StateStartConnection) {
+        return;
+    }
+
+    if (!success) {
+        d->fail(d->m_Interrupted ? QString("interrupted") : errorMessage);
+        return;
+    }
+
+    d->m_State = StateStreaming;
+    d->printLine(QString("streaming %1 at %2x%3 %4 FPS %5 Kbps")
+                 .arg(d->m_Arguments.getAppName())
+                 .arg(d->m_StreamConfig.width)
+                 .arg(d->m_StreamConfig.height)
+                 .arg(d->m_StreamConfig.fps)
+                 .arg(d->m_StreamConfig.bitrate));
+
+    d->m_StartSnapshot = d->takeSnapshot();
+    d->m_LastSnapshot = d->m_StartSnapshot;
+    d->m_ReportTimer->start(d->m_Arguments.getReportIntervalSecs() * 1000);
+
+    if (d->m_Interrupted) {
+        d->printLine("interrupted");
+        d->stopStreaming(0);
+        return;
+    }
+
+    if (d->m_Arguments.getDurationSecs() > 0) {
+        QTimer::singleShot(d->m_Arguments.getDurationSecs() * 1000,
+                           this, &Launcher::onDurationElapsed);
+    }
+}
+
+void Launcher::onConnectionTerminated(int errorCode)
+{
+    Q_D(Launcher);
+
+    if (d->m_State != StateStreaming) {
+        return;
+    }
+
+    d->printLine(QString("connection terminated: %1").arg(errorCode));
+    d->stopStreaming(errorCode == ML_ERROR_GRACEFUL_TERMINATION ? 0 : 1);
+}
+
+void Launcher::onReportTimer()
+{
+    Q_D(Launcher);
+
+    StreamSnapshot snapshot = d->takeSnapshot();
+    d->report("last", d->m_LastSnapshot, snapshot);
+    d->m_LastSnapshot = snapshot;
+}
+
+void Launcher::onDurationElapsed()
+{
+    Q_D(Launcher);
+
+    if (d->m_State == StateStreaming) {
+        d->stopStreaming(0);
+    }
+}
+
+void Launcher::onStartNextStreamProcess()
+{
+    Q_D(Launcher);
+
+    d->startStreamProcess();
+    if (d->m_ProcessesStarted >= d->m_Arguments.getStreamCount()) {
+        d->m_RampUpTimer->stop();
+
+        // Every stream process may have failed to start
+        if (d->m_ProcessesRunning == 0) {
+            QCoreApplication::exit(1);
+        }
+    }
+}
+
+void Launcher::onStreamProcessOutput()
+{
+    QProcess* process = qobject_cast<QProcess*>(sender());
+
+    // Stream processes write whole lines, so pass them through as they come
+    while (process->canReadLine()) {
+        QByteArray line = process->readLine();
+        fwrite(line.constData(), 1, line.size(), stdout);
+    }
+    fflush(stdout);
+}
+
+void Launcher::onStreamProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_D(Launcher);
+    QProcess* process = qobject_cast<QProcess*>(sender());
+
+    // Pass through anything the stream wrote after the last full line
+    QByteArray output = process->readAllStandardOutput();
+    fwrite(output.constData(), 1, output.size(), stdout);
+    fflush(stdout);
+    process->deleteLater();
+
+    if (exitStatus != QProcess::NormalExit || exitCode != 0) {
+        d->m_ProcessesFailed++;
+    }
+
+    d->m_ProcessesRunning--;
+    if (d->m_State == StateRunStreamProcesses && d->m_ProcessesRunning == 0 &&
+            (d->m_Interrupted || d->m_ProcessesStarted >= d->m_Arguments.getStreamCount())) {
+        d->finishStreamProcesses();
+    }
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "commandlineparser.h"
+
+#include <QObject>
+#include <QProcess>
+
+class ComputerManager;
+class NvComputer;
+class StreamingPreferences;
+
+namespace CliLoadTest
+{
+
+class LauncherPrivate;
+
+class Launcher : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE_D(m_DPtr, Launcher)
+
+public:
+    explicit Launcher(LoadTestCommandLineParser arguments,
+                      StreamingPreferences *preferences,
+                      QObject *parent = nullptr);
+    ~Launcher();
+
+    // Returns the load test of this process, if any
+    static Launcher* get();
+
+    Q_INVOKABLE void execute(ComputerManager *manager);
+    Q_INVOKABLE bool isExecuted() const;
+
+    // Stops streaming and reports the totals. The launcher of a test with
+    // several streams forwards this to its stream processes and exits once
+    // they have reported theirs.
+    Q_INVOKABLE void interrupt();
+
+private slots:
+    void onComputerFound(NvComputer *computer);
+    void onComputerSeekTimeout();
+    void onConnectionStarted(bool success, QString errorMessage);
+    void onConnectionTerminated(int errorCode);
+    void onReportTimer();
+    void onDurationElapsed();
+    void onStartNextStreamProcess();
+    void onStreamProcessOutput();
+    void onStreamProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+private:
+    QScopedPointer<LauncherPrivate> m_DPtr;
+};
+
+}
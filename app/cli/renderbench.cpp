@@ -0,0 +1,254 @@
+#include "renderbench.h"
+
+#include "settings/streamingpreferences.h"
+
+#ifdef HAVE_LIBPLACEBO_VULKAN
+#include "streaming/video/ffmpeg-renderers/plvk.h"
+#endif
+
+#include <QCoreApplication>
+#include <QTimer>
+
+#include <algorithm>
+#include <vector>
+
+// This runs synthetic frames through PlVkRenderer's headless mode. Frames get
+// their buffers the way a software decoder's frames do, so they take the same
+// upload path as in a stream, but there's no decoder, window or host involved.
+
+namespace CliRenderBench
+{
+
+class LauncherPrivate
+{
+public:
+    RenderBenchCommandLineParser m_Arguments;
+    StreamingPreferences *m_Preferences;
+};
+
+#ifdef HAVE_LIBPLACEBO_VULKAN
+
+// Draws gradients that move with each frame, so no two frames are the same
+static void fillFrame(AVFrame* frame, int frameIndex, bool hdr)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+
+    for (int plane = 0; plane < 3; plane++) {
+        int width = frame->width;
+        int height = frame->height;
+        if (plane != 0) {
+            width = AV_CEIL_RSHIFT(width, desc->log2_chroma_w);
+            height = AV_CEIL_RSHIFT(height, desc->log2_chroma_h);
+        }
+
+        for (int y = 0; y < height; y++) {
+            uint8_t* row = frame->data[plane] + (ptrdiff_t)y * frame->linesize[plane];
+
+            for (int x = 0; x < width; x++) {
+                int value;
+                if (plane == 0) {
+                    value = (x + y + frameIndex * 4) & 0xFF;
+                }
+                else {
+                    value = ((plane == 1 ? x : y) + frameIndex) & 0xFF;
+                }
+
+                if (hdr) {
+                    ((uint16_t*)row)[x] = (uint16_t)(value << 2);
+                }
+                else {
+                    row[x] = (uint8_t)value;
+                }
+            }
+        }
+    }
+}
+
+static void printTimes(const char* name, std::vector<uint64_t> timesUs)
+{
+    if (timesUs.empty()) {
+        return;
+    }
+
+    std::sort(timesUs.begin(), timesUs.end());
+
+    uint64_t totalUs = 0;
+    for (uint64_t timeUs : timesUs) {
+        totalUs += timeUs;
+    }
+
+    fprintf(stdout, "%s: %.3f ms average, %.3f ms median, %.3f ms 99th percentile, %.3f ms max\n",
+            name,
+            totalUs / 1000.0 / timesUs.size(),
+            timesUs[timesUs.size() / 2] / 1000.0,
+            timesUs[(timesUs.size() - 1) * 99 / 100] / 1000.0,
+            timesUs.back() / 1000.0);
+}
+
+static int runBenchmark(const RenderBenchCommandLineParser& arguments, StreamingPreferences* preferences)
+{
+    bool hdr = arguments.isHdr();
+    int width = preferences->width;
+    int height = preferences->height;
+
+    // Software HEVC Main10 decoders output 10-bit planar frames
+    AVPixelFormat format = hdr ? AV_PIX_FMT_YUV420P10 : AV_PIX_FMT_YUV420P;
+
+    // Render into an offscreen texture. This also allows software Vulkan
+    // devices, so the benchmark runs on lavapipe too.
+    qputenv("PLVK_HEADLESS", "1");
+
+    PlVkRenderer renderer;
+
+    DECODER_PARAMETERS params = {};
+    params.vds = StreamingPreferences::VDS_FORCE_SOFTWARE;
+    params.videoFormat = hdr ? VIDEO_FORMAT_H265_MAIN10 : VIDEO_FORMAT_H264;
+    params.width = width;
+    params.height = height;
+    params.frameRate = preferences->fps;
+    if (!renderer.initialize(&params)) {
+        fprintf(stdout, "Failed to initialize the Vulkan renderer\n");
+        return 1;
+    }
+
+    // The renderer picks the frame allocator like it does for a software decoder
+    const AVCodec* codec = avcodec_find_decoder(hdr ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264);
+    if (codec == nullptr) {
+        fprintf(stdout, "No software decoder is available for this format\n");
+        return 1;
+    }
+
+    AVCodecContext* context = avcodec_alloc_context3(codec);
+    if (context == nullptr) {
+        fprintf(stdout, "Failed to allocate codec context\n");
+        return 1;
+    }
+    context->width = width;
+    context->height = height;
+    context->pix_fmt = format;
+    if (!renderer.prepareDecoderContext(context, nullptr)) {
+        fprintf(stdout, "Failed to prepare the codec context\n");
+        avcodec_free_context(&context);
+        return 1;
+    }
+    bool mappedUpload = context->get_buffer2 != avcodec_default_get_buffer2;
+
+    fprintf(stdout, "Rendering %d %dx%d %s frames%s\n",
+            arguments.getFrameCount(),
+            width,
+            height,
+            hdr ? "10-bit HDR" : "8-bit SDR",
+            mappedUpload ? " from mapped buffers" : "");
+
+    std::vector<uint64_t> uploadTimesUs;
+    std::vector<uint64_t> renderTimesUs;
+    int mappedFrames = 0;
+    int failedFrames = 0;
+
+    for (int i = 0; i < arguments.getFrameCount(); i++) {
+        AVFrame* frame = av_frame_alloc();
+        if (frame == nullptr) {
+            failedFrames++;
+            break;
+        }
+
+        frame->format = format;
+        frame->width = width;
+        frame->height = height;
+        frame->color_range = AVCOL_RANGE_MPEG;
+        frame->chroma_location = AVCHROMA_LOC_LEFT;
+        if (hdr) {
+            frame->color_primaries = AVCOL_PRI_BT2020;
+            frame->color_trc = AVCOL_TRC_SMPTE2084;
+            frame->colorspace = AVCOL_SPC_BT2020_NCL;
+        }
+        else {
+            frame->color_primaries = AVCOL_PRI_BT709;
+            frame->color_trc = AVCOL_TRC_BT709;
+            frame->colorspace = AVCOL_SPC_BT709;
+        }
+
+        if ((!mappedUpload || !renderer.allocateMappedFrame(context, frame)) &&
+                av_frame_get_buffer(frame, 0) < 0) {
+            fprintf(stdout, "Failed to allocate frame %d\n", i + 1);
+            av_frame_free(&frame);
+            failedFrames++;
+            break;
+        }
+
+        fillFrame(frame, i, hdr);
+        renderer.renderFrame(frame);
+        av_frame_free(&frame);
+
+        uint64_t uploadUs, renderUs;
+        bool mappedFrame;
+        if (!renderer.takeLastFrameTimings(&uploadUs, &renderUs, &mappedFrame)) {
+            fprintf(stdout, "frame %d: failed\n", i + 1);
+            failedFrames++;
+            continue;
+        }
+
+        fprintf(stdout, "frame %d: upload %.3f ms%s, render %.3f ms\n",
+                i + 1,
+                uploadUs / 1000.0,
+                mappedFrame ? " (mapped)" : "",
+                renderUs / 1000.0);
+
+        uploadTimesUs.push_back(uploadUs);
+        renderTimesUs.push_back(renderUs);
+        if (mappedFrame) {
+            mappedFrames++;
+        }
+    }
+
+    avcodec_free_context(&context);
+
+    fprintf(stdout, "%d frames rendered (%d from mapped buffers), %d failed\n",
+            (int)uploadTimesUs.size(),
+            mappedFrames,
+            failedFrames);
+    printTimes("upload", uploadTimesUs);
+    printTimes("render", renderTimesUs);
+    fflush(stdout);
+
+    return failedFrames != 0 ? 1 : 0;
+}
+
+#endif
+
+Launcher::Launcher(RenderBenchCommandLineParser arguments,
+                   StreamingPreferences *preferences,
+                   QObject *parent)
+    : QObject(parent),
+      m_DPtr(new LauncherPrivate())
+{
+    Q_D(Launcher);
+    d->m_Arguments = arguments;
+    d->m_Preferences = preferences;
+}
+
+Launcher::~Launcher()
+{
+}
+
+void Launcher::execute()
+{
+    // QCoreApplication::exit() only works once the event loop is running
+    QTimer::singleShot(0, this, &Launcher::onExecute);
+}
+
+void Launcher::onExecute()
+{
+    Q_D(Launcher);
+
+#ifdef HAVE_LIBPLACEBO_VULKAN
+    QCoreApplication::exit(runBenchmark(d->m_Arguments, d->m_Preferences));
+#else
+    Q_UNUSED(d);
+    fprintf(stdout, "This build doesn't include the Vulkan renderer\n");
+    fflush(stdout);
+    QCoreApplication::exit(1);
+#endif
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "commandlineparser.h"
+
+#include <QObject>
+
+class StreamingPreferences;
+
+namespace CliRenderBench
+{
+
+class LauncherPrivate;
+
+class Launcher : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE_D(m_DPtr, Launcher)
+
+public:
+    explicit Launcher(RenderBenchCommandLineParser arguments,
+                      StreamingPreferences *preferences,
+                      QObject *parent = nullptr);
+    ~Launcher();
+
+    Q_INVOKABLE void execute();
+
+private slots:
+    void onExecute();
+
+private:
+    QScopedPointer<LauncherPrivate> m_DPtr;
+};
+
+}
@@ -103,6 +103,9 @@ public:
                     if (isNotStreaming() || isStreamingApp(app)) {
                         m_State = StateStartSession;
                         session = new Session(m_Computer, app, m_Preferences);
+                        q->connect(session, &Session::preferredAddressFamilyChanged, m_ComputerManager, [this]() {
+                            m_ComputerManager->clientSideAttributeUpdated(m_Computer);
+                        });
                         emit q->sessionCreated(app.name, session);
                     } else {
                         emit q->appQuitRequired(getCurrentAppName());
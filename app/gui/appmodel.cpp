@@ -57,7 +57,11 @@ Session* AppModel::createSessionForApp(int appIndex)
     Q_ASSERT(appIndex < m_VisibleApps.count());
     NvApp app = m_VisibleApps.at(appIndex);
 
-    return new Session(m_Computer, app);
+    Session* session = new Session(m_Computer, app);
+    connect(session, &Session::preferredAddressFamilyChanged, m_ComputerManager, [this]() {
+        m_ComputerManager->clientSideAttributeUpdated(m_Computer);
+    });
+    return session;
 }
 
 int AppModel::getDirectLaunchAppIndex()
@@ -125,7 +125,11 @@ Session* ComputerModel::createSessionForCurrentGame(int computerIndex)
 
     for (NvApp& app : computer->appList) {
         if (app.id == computer->currentGameId) {
-            return new Session(computer, app);
+            Session* session = new Session(computer, app);
+            connect(session, &Session::preferredAddressFamilyChanged, m_ComputerManager, [this, computer]() {
+                m_ComputerManager->clientSideAttributeUpdated(computer);
+            });
+            return session;
         }
     }
 
@@ -58,7 +58,20 @@ ApplicationWindow {
         if (SystemProperties.isWow64) {
             wow64Dialog.open()
         }
-        else if (!SystemProperties.hasHardwareAcceleration && StreamingPreferences.videoDecoderSelection !== StreamingPreferences.VDS_FORCE_SOFTWARE) {
+        else if (SystemProperties.videoInfoReady) {
+            checkHardwareAcceleration()
+        }
+
+        if (SystemProperties.unmappedGamepads) {
+            unmappedGamepadDialog.unmappedGamepads = SystemProperties.unmappedGamepads
+            unmappedGamepadDialog.open()
+        }
+    }
+
+    // Decoder detection runs in the background, so this may
+    // be called after the window is already on screen.
+    function checkHardwareAcceleration() {
+        if (!SystemProperties.hasHardwareAcceleration && StreamingPreferences.videoDecoderSelection !== StreamingPreferences.VDS_FORCE_SOFTWARE) {
             if (SystemProperties.isRunningXWayland) {
                 xWaylandDialog.open()
             }
@@ -66,15 +79,19 @@ ApplicationWindow {
                 noHwDecoderDialog.open()
             }
         }
+    }
 
-        if (SystemProperties.unmappedGamepads) {
-            unmappedGamepadDialog.unmappedGamepads = SystemProperties.unmappedGamepads
-            unmappedGamepadDialog.open()
+    // Use Connections to handle singleton signals globally
+    Connections {
+        target: SystemProperties
+
+        function onVideoInfoChanged() {
+            if (!SystemProperties.isWow64) {
+                checkHardwareAcceleration()
+            }
         }
     }
 
-    // Use Connections to handle singleton signals globally
-  
     // Use Connections to handle singleton signals globally
     Connections {
         target: AutoUpdateChecker
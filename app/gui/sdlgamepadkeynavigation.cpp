@@ -4,6 +4,7 @@
 #include <QGuiApplication>
 #include <QWindow>
 
+#include "backend/systemproperties.h"
 #include "settings/mappingmanager.h"
 
 #define AXIS_NAVIGATION_REPEAT_DELAY 150
@@ -11,6 +12,7 @@
 SdlGamepadKeyNavigation::SdlGamepadKeyNavigation(StreamingPreferences* prefs)
     : m_Prefs(prefs),
       m_Enabled(false),
+      m_EnablePending(false),
       m_UiNavMode(false),
       m_FirstPoll(false),
       m_HasFocus(false),
@@ -27,10 +29,27 @@ SdlGamepadKeyNavigation::~SdlGamepadKeyNavigation()
 
 void SdlGamepadKeyNavigation::enable()
 {
-    if (m_Enabled) {
+    if (m_Enabled || m_EnablePending) {
         return;
     }
 
+    // The startup video probe may still be using SDL on its own thread,
+    // and SDL isn't safe to use from two threads at once. Pumping events
+    // here would race with its window creation, so wait for it to finish.
+    m_EnablePending = true;
+    SystemProperties::runWhenVideoInfoReady(this, [this]() {
+        // We may have been disabled while we were waiting
+        if (m_EnablePending) {
+            m_EnablePending = false;
+            enableNow();
+        }
+    });
+}
+
+void SdlGamepadKeyNavigation::enableNow()
+{
+    Q_ASSERT(!m_Enabled);
+
     // We have to initialize and uninitialize this in enable()/disable()
     // because we need to get out of the way of the Session class. If it
     // doesn't get to reinitialize the GC subsystem, it won't get initial
@@ -73,6 +92,8 @@ void SdlGamepadKeyNavigation::enable()
 
 void SdlGamepadKeyNavigation::disable()
 {
+    m_EnablePending = false;
+
     if (!m_Enabled) {
         return;
     }
@@ -192,6 +213,10 @@ void SdlGamepadKeyNavigation::onPollingTimerFired()
             }
             break;
         }
+        case SDL_JOYDEVICEADDED:
+            // This queues SDL_CONTROLLERDEVICEADDED if the index has a mapping for it
+            MappingManager::applyMappingsForJoystick(event.jdevice.which);
+            break;
         case SDL_CONTROLLERDEVICEADDED:
             SDL_GameController* gc = SDL_GameControllerOpen(event.cdevice.which);
             if (gc != nullptr) {
@@ -287,7 +312,11 @@ void SdlGamepadKeyNavigation::setUiNavMode(bool uiNavMode)
 
 int SdlGamepadKeyNavigation::getConnectedGamepads()
 {
-    Q_ASSERT(m_Enabled);
+    // We can't ask SDL until we're enabled, which may still be waiting
+    // on the startup video probe. Nothing can navigate until then anyway.
+    if (!m_Enabled) {
+        return 0;
+    }
 
     int count = 0;
     int numJoysticks = SDL_NumJoysticks();
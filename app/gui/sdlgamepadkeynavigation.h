@@ -27,6 +27,8 @@ public:
     Q_INVOKABLE int getConnectedGamepads();
 
 private:
+    void enableNow();
+
     void sendKey(QEvent::Type type, Qt::Key key, Qt::KeyboardModifiers modifiers = Qt::NoModifier);
 
     void updateTimerState();
@@ -39,6 +41,7 @@ private:
     QTimer* m_PollingTimer;
     QList<SDL_GameController*> m_Gamepads;
     bool m_Enabled;
+    bool m_EnablePending;
     bool m_UiNavMode;
     bool m_FirstPoll;
     bool m_HasFocus;
@@ -3,6 +3,8 @@
 #include <QQmlContext>
 #include <QIcon>
 #include <QQuickStyle>
+#include <QQuickWindow>
+#include <QSharedPointer>
 #include <QMutex>
 #include <QtDebug>
 #include <QNetworkProxyFactory>
@@ -38,7 +40,9 @@
 #endif
 
 #include "cli/listapps.h"
+#include "cli/loadtest.h"
 #include "cli/quitstream.h"
+#include "cli/renderbench.h"
 #include "cli/startstream.h"
 #include "cli/pair.h"
 #include "cli/commandlineparser.h"
@@ -343,11 +347,13 @@ int SDLCALL signalHandlerThread(void* data)
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Received signal: %d", sig);
 
         Session* session;
+        CliLoadTest::Launcher* loadTest;
         switch (sig) {
         case SIGINT:
         case SIGTERM:
             // Check if we have an active streaming session
             session = Session::get();
+            loadTest = CliLoadTest::Launcher::get();
             if (session != nullptr) {
                 if (sig == SIGTERM) {
                     // If this is a SIGTERM, set the flag to quit
@@ -357,6 +363,11 @@ int SDLCALL signalHandlerThread(void* data)
                 // Stop the streaming session
                 session->interrupt();
             }
+            else if (loadTest != nullptr) {
+                // Let the load test stop its streams and report their totals
+                // before it exits
+                QMetaObject::invokeMethod(loadTest, "interrupt", Qt::QueuedConnection);
+            }
             else {
                 // If we're not streaming, we'll close the whole app
                 QCoreApplication::instance()->quit();
@@ -496,6 +507,18 @@ int main(int argc, char *argv[])
     // created when open() is called, this doesn't do any harm for other platforms.
     QTemporaryFile eglfsConfigFile;
 
+    // Load tests don't show any UI, so they shouldn't need a display either.
+    // We have to look for the action ourselves, since the command line is
+    // parsed after the QGuiApplication is created.
+    for (int i = 1; i < argc; i++) {
+        if (QString(argv[i]).toLower() == "loadtest") {
+            if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+                qputenv("QT_QPA_PLATFORM", "offscreen");
+            }
+            break;
+        }
+    }
+
     // Avoid using High DPI on EGLFS. It breaks font rendering.
     // https://bugreports.qt.io/browse/QTBUG-64377
     //
@@ -743,6 +766,7 @@ int main(int argc, char *argv[])
     GlobalCommandLineParser::ParseResult commandLineParserResult = parser.parse(app.arguments());
     switch (commandLineParserResult) {
     case GlobalCommandLineParser::ListRequested:
+    case GlobalCommandLineParser::LoadTestRequested:
         // Don't log to the console since it will jumble the command output
         s_SuppressVerboseOutput = true;
         break;
@@ -931,6 +955,26 @@ int main(int argc, char *argv[])
             hasGUI = false;
             break;
         }
+    case GlobalCommandLineParser::LoadTestRequested:
+        {
+            StreamingPreferences* preferences = StreamingPreferences::get();
+            LoadTestCommandLineParser loadTestParser;
+            loadTestParser.parse(app.arguments(), preferences);
+            auto launcher = new CliLoadTest::Launcher(loadTestParser, preferences, &app);
+            launcher->execute(new ComputerManager(preferences));
+            hasGUI = false;
+            break;
+        }
+    case GlobalCommandLineParser::RenderBenchRequested:
+        {
+            StreamingPreferences* preferences = StreamingPreferences::get();
+            RenderBenchCommandLineParser renderBenchParser;
+            renderBenchParser.parse(app.arguments(), preferences);
+            auto launcher = new CliRenderBench::Launcher(renderBenchParser, preferences, &app);
+            launcher->execute();
+            hasGUI = false;
+            break;
+        }
     }
 
     if (hasGUI) {
@@ -940,6 +984,36 @@ int main(int argc, char *argv[])
         engine.load(QUrl(QStringLiteral("qrc:/gui/main.qml")));
         if (engine.rootObjects().isEmpty())
             return -1;
+
+        // Measure the cold start time to the first painted frame of the UI.
+        // STARTUP_BENCHMARK=1 also waits for the video capability probe and
+        // exits, so launches can be timed repeatedly from a script.
+        QQuickWindow* rootWindow = qobject_cast<QQuickWindow*>(engine.rootObjects().first());
+        if (rootWindow != nullptr) {
+            auto firstFrameConnection = QSharedPointer<QMetaObject::Connection>::create();
+            *firstFrameConnection = QObject::connect(rootWindow, &QQuickWindow::frameSwapped, rootWindow, [firstFrameConnection, &app]() {
+                // This runs on the render thread, so we capture the time here
+                // rather than after a trip through the main thread's event loop.
+                qint64 firstFrameMs = s_LoggerTime.elapsed();
+                QObject::disconnect(*firstFrameConnection);
+
+                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                            "First UI frame presented %lld ms after launch",
+                            (long long)firstFrameMs);
+
+                if (qEnvironmentVariableIntValue("STARTUP_BENCHMARK")) {
+                    QMetaObject::invokeMethod(&app, [firstFrameMs, &app]() {
+                        SystemProperties::waitForVideoInfo();
+
+                        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                                    "Startup benchmark: first frame %lld ms, video info ready %lld ms",
+                                    (long long)firstFrameMs,
+                                    (long long)s_LoggerTime.elapsed());
+                        app.quit();
+                    }, Qt::QueuedConnection);
+                }
+            }, Qt::DirectConnection);
+        }
     }
 
     int err = app.exec();
@@ -0,0 +1,277 @@
+#include "mappingindex.h"
+#include "path.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QVector>
+
+#include <algorithm>
+#include <cctype>
+
+#define MAPPING_DB_FILE "gamecontrollerdb.txt"
+#define MAPPING_INDEX_FILE "gamecontrollerdb.idx"
+
+#define MAPPING_INDEX_MAGIC "GCDBIDX1"
+#define MAPPING_PLATFORM_FIELD "platform:"
+
+// The index is only ever read by the machine that wrote it, so it's stored
+// in native byte order. Entries are sorted by GUID and point at the mapping
+// strings (NUL-terminated) that follow them.
+struct MappingIndex::Header {
+    char magic[8];
+    qint64 sourceSize;
+    qint64 sourceModifiedMs;
+    char appVersion[32];
+    char platform[32];
+    quint32 entryCount;
+    quint32 reserved;
+};
+
+struct MappingIndex::Entry {
+    SDL_JoystickGUID guid;
+    quint32 offset;
+    quint32 length;
+};
+
+static bool operator<(const SDL_JoystickGUID& a, const SDL_JoystickGUID& b)
+{
+    return memcmp(a.data, b.data, sizeof(a.data)) < 0;
+}
+
+static bool operator==(const SDL_JoystickGUID& a, const SDL_JoystickGUID& b)
+{
+    return memcmp(a.data, b.data, sizeof(a.data)) == 0;
+}
+
+MappingIndex::MappingIndex()
+    : m_Data(nullptr),
+      m_Size(0)
+{
+
+}
+
+MappingIndex::~MappingIndex()
+{
+    close();
+}
+
+void MappingIndex::close()
+{
+    // Closing the file also unmaps it
+    m_IndexFile.close();
+    m_IndexData.clear();
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+bool MappingIndex::open()
+{
+    QString sourcePath = Path::getDataFilePath(MAPPING_DB_FILE);
+    QFileInfo sourceInfo(sourcePath);
+
+    // Nothing to do if we're already using the index for this database
+    if (m_Data != nullptr && isIndexCurrent(m_Data, m_Size, sourceInfo)) {
+        return true;
+    }
+
+    close();
+
+    // Use the index from a previous launch if it's still current
+    QFileInfo indexInfo = Path::getCacheFileInfo(MAPPING_INDEX_FILE);
+    m_IndexFile.setFileName(indexInfo.absoluteFilePath());
+    if (m_IndexFile.open(QIODevice::ReadOnly)) {
+        uchar* data = m_IndexFile.map(0, m_IndexFile.size());
+        if (data != nullptr && isIndexCurrent(data, m_IndexFile.size(), sourceInfo)) {
+            m_Data = data;
+            m_Size = m_IndexFile.size();
+            return true;
+        }
+
+        m_IndexFile.close();
+    }
+
+    QFile sourceFile(sourcePath);
+    if (!sourceFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray index = build(sourceFile.readAll(), sourceInfo);
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Rebuilt gamepad mapping index: %d mappings for %s",
+                (int)reinterpret_cast<const Header*>(index.constData())->entryCount,
+                SDL_GetPlatform());
+
+    // Replace the old index atomically, since another instance may have it mapped
+    QDir().mkpath(indexInfo.absolutePath());
+    QSaveFile indexSaveFile(indexInfo.absoluteFilePath());
+    if (indexSaveFile.open(QIODevice::WriteOnly) &&
+            indexSaveFile.write(index) == index.size() &&
+            indexSaveFile.commit() &&
+            m_IndexFile.open(QIODevice::ReadOnly)) {
+        uchar* data = m_IndexFile.map(0, m_IndexFile.size());
+        if (data != nullptr && isIndexCurrent(data, m_IndexFile.size(), sourceInfo)) {
+            m_Data = data;
+            m_Size = m_IndexFile.size();
+            return true;
+        }
+
+        m_IndexFile.close();
+    }
+
+    // Keep the index in memory if we can't use the cache directory
+    m_IndexData = index;
+    m_Data = reinterpret_cast<const uchar*>(m_IndexData.constData());
+    m_Size = m_IndexData.size();
+    return true;
+}
+
+bool MappingIndex::isIndexCurrent(const uchar* data, qint64 size, const QFileInfo& sourceInfo) const
+{
+    if (size < (qint64)sizeof(Header)) {
+        return false;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+    return memcmp(header->magic, MAPPING_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+            header->sourceSize == sourceInfo.size() &&
+            header->sourceModifiedMs == sourceInfo.lastModified().toMSecsSinceEpoch() &&
+            qstrncmp(header->appVersion, VERSION_STR, sizeof(header->appVersion)) == 0 &&
+            qstrncmp(header->platform, SDL_GetPlatform(), sizeof(header->platform)) == 0 &&
+            (qint64)sizeof(Header) + (qint64)header->entryCount * (qint64)sizeof(Entry) <= size;
+}
+
+QByteArray MappingIndex::build(const QByteArray& source, const QFileInfo& sourceInfo) const
+{
+    const char* platform = SDL_GetPlatform();
+    QVector<Entry> entries;
+    QByteArray strings;
+
+    for (const QByteArray& rawLine : source.split('\n')) {
+        QByteArray line = rawLine.trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        // Like SDL_GameControllerAddMappingsFromRW(), skip mappings without
+        // a platform field and mappings for other platforms.
+        int platformStart = line.indexOf(MAPPING_PLATFORM_FIELD);
+        if (platformStart < 0) {
+            continue;
+        }
+        platformStart += (int)strlen(MAPPING_PLATFORM_FIELD);
+        int platformEnd = line.indexOf(',', platformStart);
+        if (platformEnd < 0 ||
+                platformEnd - platformStart != (int)strlen(platform) ||
+                qstrnicmp(line.constData() + platformStart, platform, platformEnd - platformStart) != 0) {
+            continue;
+        }
+
+        // Mappings without a real GUID (like "xinput") are stored under the zero GUID
+        Entry entry = {};
+        QByteArray guidString = line.left(line.indexOf(','));
+        bool isHexGuid = guidString.size() == 32 &&
+                std::all_of(guidString.cbegin(), guidString.cend(), [](char c) { return isxdigit((unsigned char)c); });
+        if (isHexGuid) {
+            entry.guid = SDL_JoystickGetGUIDFromString(guidString.constData());
+        }
+
+        entry.offset = (quint32)strings.size();
+        entry.length = (quint32)line.size();
+        strings.append(line);
+        strings.append('\0');
+        entries.append(entry);
+    }
+
+    // Later mappings for a GUID replace earlier ones in SDL, so keep them in file order
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.guid < b.guid; });
+
+    Header header = {};
+    memcpy(header.magic, MAPPING_INDEX_MAGIC, sizeof(header.magic));
+    header.sourceSize = sourceInfo.size();
+    header.sourceModifiedMs = sourceInfo.lastModified().toMSecsSinceEpoch();
+    qstrncpy(header.appVersion, VERSION_STR, sizeof(header.appVersion));
+    qstrncpy(header.platform, platform, sizeof(header.platform));
+    header.entryCount = (quint32)entries.size();
+
+    quint32 stringsOffset = (quint32)(sizeof(Header) + entries.size() * sizeof(Entry));
+    for (Entry& entry : entries) {
+        entry.offset += stringsOffset;
+    }
+
+    QByteArray index;
+    index.reserve(stringsOffset + strings.size());
+    index.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    index.append(reinterpret_cast<const char*>(entries.constData()), entries.size() * sizeof(Entry));
+    index.append(strings);
+    return index;
+}
+
+const MappingIndex::Entry* MappingIndex::getEntries() const
+{
+    return reinterpret_cast<const Entry*>(m_Data + sizeof(Header));
+}
+
+int MappingIndex::getMappingCount() const
+{
+    return m_Data != nullptr ? (int)reinterpret_cast<const Header*>(m_Data)->entryCount : 0;
+}
+
+void MappingIndex::appendMappings(const SDL_JoystickGUID& guid, QList<QByteArray>& mappings) const
+{
+    const Entry* begin = getEntries();
+    const Entry* end = begin + getMappingCount();
+
+    for (const Entry* entry = std::lower_bound(begin, end, guid, [](const Entry& e, const SDL_JoystickGUID& g) { return e.guid < g; });
+         entry != end && entry->guid == guid;
+         entry++) {
+        if ((qint64)entry->offset + entry->length < m_Size) {
+            mappings.append(QByteArray(reinterpret_cast<const char*>(m_Data + entry->offset), (int)entry->length));
+        }
+    }
+}
+
+QList<QByteArray> MappingIndex::findMappings(SDL_JoystickGUID guid) const
+{
+    QList<QByteArray> mappings;
+
+    if (m_Data == nullptr) {
+        return mappings;
+    }
+
+    // SDL matches mappings without the name CRC (bytes 2-3) or the product
+    // version (bytes 12-13), which the database entries usually don't have.
+    // Gather every variant and let SDL pick the best match among them.
+    QVector<SDL_JoystickGUID> candidates;
+    for (int variant = 0; variant < 4; variant++) {
+        SDL_JoystickGUID candidate = guid;
+        if (variant & 1) {
+            candidate.data[2] = candidate.data[3] = 0;
+        }
+        if (variant & 2) {
+            candidate.data[12] = candidate.data[13] = 0;
+        }
+
+        if (!std::any_of(candidates.cbegin(), candidates.cend(), [&](const SDL_JoystickGUID& g) { return g == candidate; })) {
+            candidates.append(candidate);
+        }
+    }
+
+    for (const SDL_JoystickGUID& candidate : candidates) {
+        appendMappings(candidate, mappings);
+    }
+
+    return mappings;
+}
+
+QList<QByteArray> MappingIndex::getGenericMappings() const
+{
+    QList<QByteArray> mappings;
+
+    if (m_Data != nullptr) {
+        appendMappings(SDL_JoystickGUID {}, mappings);
+    }
+
+    return mappings;
+}
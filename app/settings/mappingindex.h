@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+
+#include "SDL_compat.h"
+
+// A compact index of gamecontrollerdb.txt keyed by joystick GUID. Only mappings
+// for the current platform are included. The index is written to the cache
+// directory and memory-mapped on later launches, so we don't parse thousands of
+// mappings just to use the one or two for the gamepads that are plugged in.
+class MappingIndex
+{
+public:
+    MappingIndex();
+
+    ~MappingIndex();
+
+    // Maps the cached index, rebuilding it first if gamecontrollerdb.txt changed
+    bool open();
+
+    // Returns the mappings that could apply to a joystick with this GUID
+    QList<QByteArray> findMappings(SDL_JoystickGUID guid) const;
+
+    // Returns mappings that aren't tied to a GUID (like "xinput")
+    QList<QByteArray> getGenericMappings() const;
+
+    int getMappingCount() const;
+
+private:
+    struct Header;
+    struct Entry;
+
+    void close();
+
+    bool isIndexCurrent(const uchar* data, qint64 size, const QFileInfo& sourceInfo) const;
+
+    QByteArray build(const QByteArray& source, const QFileInfo& sourceInfo) const;
+
+    const Entry* getEntries() const;
+
+    void appendMappings(const SDL_JoystickGUID& guid, QList<QByteArray>& mappings) const;
+
+    QFile m_IndexFile;
+
+    // Only used if we couldn't write the index to the cache directory
+    QByteArray m_IndexData;
+
+    const uchar* m_Data;
+    qint64 m_Size;
+};
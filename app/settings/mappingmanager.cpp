@@ -11,6 +11,8 @@
 #define SER_MAPPING "mapping"
 
 MappingFetcher* MappingManager::s_MappingFetcher;
+MappingIndex* MappingManager::s_MappingIndex;
+QList<QByteArray> MappingManager::s_UserMappings;
 
 MappingManager::MappingManager()
 {
@@ -68,39 +70,43 @@ void MappingManager::save()
 
 void MappingManager::applyMappings()
 {
-    QByteArray mappingData = Path::readDataFile("gamecontrollerdb.txt");
-    if (!mappingData.isEmpty()) {
-        int newMappings = SDL_GameControllerAddMappingsFromRW(
-                    SDL_RWFromConstMem(mappingData.constData(), mappingData.size()), 1);
+    if (s_MappingIndex == nullptr) {
+        s_MappingIndex = new MappingIndex();
+    }
 
-        if (newMappings > 0) {
-            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                        "Loaded %d new gamepad mappings",
-                        newMappings);
-        }
-        else {
-            if (newMappings < 0) {
-                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                             "Error loading gamepad mappings: %s",
-                             SDL_GetError());
-            }
-            else if (newMappings == 0) {
-                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                            "0 new mappings found in gamecontrollerdb.txt. Is it corrupt?");
-            }
-
-            // Try deleting the cached mapping list just in case it's corrupt
-            Path::deleteCacheFile("gamecontrollerdb.txt");
+    if (s_MappingIndex->open() && s_MappingIndex->getMappingCount() > 0) {
+        // Mappings from gamecontrollerdb.txt are only given to SDL when a matching
+        // joystick arrives, except for generic ones and those for joysticks that
+        // are already attached.
+        int newMappings = addIndexedMappings(s_MappingIndex->getGenericMappings());
+        int numJoysticks = SDL_NumJoysticks();
+        for (int i = 0; i < numJoysticks; i++) {
+            newMappings += addIndexedMappings(s_MappingIndex->findMappings(SDL_JoystickGetDeviceGUID(i)));
         }
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Indexed %d gamepad mappings (%d loaded for attached devices)",
+                    s_MappingIndex->getMappingCount(),
+                    newMappings);
+    }
+    else if (s_MappingIndex->getMappingCount() == 0 && Path::getCacheFileInfo("gamecontrollerdb.txt").exists()) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "0 mappings found in gamecontrollerdb.txt. Is it corrupt?");
+
+        // Try deleting the cached mapping list just in case it's corrupt
+        Path::deleteCacheFile("gamecontrollerdb.txt");
     }
     else {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "Unable to load gamepad mapping file");
     }
 
+    s_UserMappings.clear();
+
     QList<SdlGamepadMapping> mappings = m_Mappings.values();
     for (const SdlGamepadMapping& mapping : mappings) {
         QString sdlMappingString = mapping.getSdlMappingString();
+        s_UserMappings.append(sdlMappingString.toUtf8());
         int ret = SDL_GameControllerAddMapping(qPrintable(sdlMappingString));
         if (ret < 0) {
             SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
@@ -125,3 +131,53 @@ void MappingManager::addMapping(SdlGamepadMapping& mapping)
 {
     m_Mappings[mapping.getGuid()] = mapping;
 }
+
+bool MappingManager::applyMappingsForJoystick(int deviceIndex)
+{
+    if (s_MappingIndex == nullptr) {
+        return false;
+    }
+
+    bool wasGameController = SDL_IsGameController(deviceIndex);
+    if (addIndexedMappings(s_MappingIndex->findMappings(SDL_JoystickGetDeviceGUID(deviceIndex))) == 0 &&
+            wasGameController) {
+        return false;
+    }
+
+    // Put the user's mappings back in case we just replaced one of them
+    for (const QByteArray& userMapping : s_UserMappings) {
+        SDL_GameControllerAddMapping(userMapping.constData());
+    }
+
+    if (wasGameController || !SDL_IsGameController(deviceIndex)) {
+        return false;
+    }
+
+    // SDL only reports SDL_CONTROLLERDEVICEADDED for joysticks that had a
+    // mapping when they arrived, so we need to report this one ourselves.
+    SDL_Event event = {};
+    event.type = SDL_CONTROLLERDEVICEADDED;
+    event.cdevice.timestamp = SDL_GetTicks();
+    event.cdevice.which = deviceIndex;
+    SDL_PushEvent(&event);
+    return true;
+}
+
+int MappingManager::addIndexedMappings(const QList<QByteArray>& mappings)
+{
+    int newMappings = 0;
+
+    for (const QByteArray& mapping : mappings) {
+        int ret = SDL_GameControllerAddMapping(mapping.constData());
+        if (ret < 0) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Unable to add mapping: %s",
+                        mapping.constData());
+        }
+        else if (ret == 1) {
+            newMappings++;
+        }
+    }
+
+    return newMappings;
+}
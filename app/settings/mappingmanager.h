@@ -1,6 +1,7 @@
 #pragma once
 
 #include "mappingfetcher.h"
+#include "mappingindex.h"
 
 #include <QSettings>
 
@@ -68,11 +69,22 @@ public:
 
     void applyMappings();
 
+    // Loads mappings for a joystick that arrived after applyMappings(). Returns
+    // true if the joystick became a gamepad, in which case an SDL_CONTROLLERDEVICEADDED
+    // event has been queued for it.
+    static bool applyMappingsForJoystick(int deviceIndex);
+
     void save();
 
 private:
+    static int addIndexedMappings(const QList<QByteArray>& mappings);
+
     QMap<QString, SdlGamepadMapping> m_Mappings;
 
     static MappingFetcher* s_MappingFetcher;
+    static MappingIndex* s_MappingIndex;
+
+    // Reapplied over any mappings loaded from the index later
+    static QList<QByteArray> s_UserMappings;
 };
 
@@ -178,7 +178,8 @@ void StreamingPreferences::reload()
 #endif
     language = static_cast<Language>(settings.value(SER_LANGUAGE,
                                                     static_cast<int>(Language::LANG_AUTO)).toInt());
-
+    latencyTestMode = LatencyTestMode::LTM_OFF;
+    startupTimelineMode = false;
 
     // Perform default settings updates as required based on last default version
     if (defaultVer < 1) {
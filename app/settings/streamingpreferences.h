@@ -114,6 +114,13 @@ public:
     };
     Q_ENUM(CaptureSysKeysMode);
 
+    enum LatencyTestMode
+    {
+        LTM_OFF,
+        LTM_TEXT,
+        LTM_GAMEPAD,
+    };
+
     Q_PROPERTY(int width READ getWidth WRITE setWidth NOTIFY displayModeChanged)
     Q_PROPERTY(int height READ getHeight WRITE setHeight NOTIFY displayModeChanged)
     Q_PROPERTY(int fps MEMBER fps NOTIFY displayModeChanged)
@@ -205,6 +212,10 @@ public:
     Language language;
     CaptureSysKeysMode captureSysKeysMode;
 
+    // Only set from the command line and never persisted
+    LatencyTestMode latencyTestMode;
+    bool startupTimelineMode;
+
 signals:
     void displayModeChanged();
     void bitrateChanged();
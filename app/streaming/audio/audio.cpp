@@ -90,6 +90,9 @@ bool Session::initializeAudioRenderer()
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                 "Audio stream has %d channels",
                 m_ActiveAudioConfig.channelCount);
+
+    // Any audio delay added for A/V sync was lost with the old renderer
+    m_AvSyncController.resetAudio(m_AudioRenderer->getMaxQueuedAudioDurationUs());
     return true;
 }
 
@@ -133,6 +136,16 @@ int Session::arInit(int /* audioConfiguration */,
                     const POPUS_MULTISTREAM_CONFIGURATION opusConfig,
                     void* /* arContext */, int /* arFlags */)
 {
+    // Keep using the renderer from before a video reconfiguration if the format matches
+    if (s_ActiveSession->m_AudioRenderer != nullptr) {
+        if (SDL_memcmp(&s_ActiveSession->m_OriginalAudioConfig, opusConfig, sizeof(*opusConfig)) == 0) {
+            opus_multistream_decoder_ctl(s_ActiveSession->m_OpusDecoder, OPUS_RESET_STATE);
+            return 0;
+        }
+
+        arCleanup();
+    }
+
     SDL_memcpy(&s_ActiveSession->m_OriginalAudioConfig, opusConfig, sizeof(*opusConfig));
     s_ActiveSession->initializeAudioRenderer();
     return 0;
@@ -140,6 +153,10 @@ int Session::arInit(int /* audioConfiguration */,
 
 void Session::arCleanup()
 {
+    if (s_ActiveSession->m_KeepAudioRenderer) {
+        return;
+    }
+
     delete s_ActiveSession->m_AudioRenderer;
     s_ActiveSession->m_AudioRenderer = nullptr;
 
@@ -147,10 +164,62 @@ void Session::arCleanup()
     s_ActiveSession->m_OpusDecoder = nullptr;
 }
 
-void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
+void Session::decodeAndSubmitAudio(char* sampleData, int sampleLength, bool play)
 {
     int samplesDecoded;
 
+    int sampleSize = m_AudioRenderer->getAudioBufferSampleSize();
+    int frameSize = sampleSize * m_ActiveAudioConfig.channelCount;
+    int desiredBufferSize = frameSize * m_ActiveAudioConfig.samplesPerFrame;
+    void* buffer = m_AudioRenderer->getAudioBuffer(&desiredBufferSize);
+    if (buffer == nullptr) {
+        return;
+    }
+
+    if (m_AudioRenderer->getAudioBufferFormat() == IAudioRenderer::AudioFormat::Float32NE) {
+        samplesDecoded = opus_multistream_decode_float(m_OpusDecoder,
+                                                       (unsigned char*)sampleData,
+                                                       sampleLength,
+                                                       (float*)buffer,
+                                                       desiredBufferSize / frameSize,
+                                                       0);
+    }
+    else {
+        samplesDecoded = opus_multistream_decode(m_OpusDecoder,
+                                                 (unsigned char*)sampleData,
+                                                 sampleLength,
+                                                 (short*)buffer,
+                                                 desiredBufferSize / frameSize,
+                                                 0);
+    }
+
+    // Update desiredSize with the number of bytes actually populated by the decoding operation
+    if (samplesDecoded > 0) {
+        SDL_assert(desiredBufferSize >= frameSize * samplesDecoded);
+        desiredBufferSize = frameSize * samplesDecoded;
+    }
+    else {
+        desiredBufferSize = 0;
+    }
+
+    if (!play) {
+        return;
+    }
+
+    if (!m_AudioRenderer->submitAudio(desiredBufferSize)) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Reinitializing audio renderer after failure");
+
+        opus_multistream_decoder_destroy(m_OpusDecoder);
+        m_OpusDecoder = nullptr;
+
+        delete m_AudioRenderer;
+        m_AudioRenderer = nullptr;
+    }
+}
+
+void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
+{
 #ifndef STEAM_LINK
     // Set this thread to high priority to reduce the chance of missing
     // our sample delivery time. On Steam Link, this causes starvation
@@ -188,49 +257,24 @@ void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
     }
 
     if (s_ActiveSession->m_AudioRenderer != nullptr) {
-        int sampleSize = s_ActiveSession->m_AudioRenderer->getAudioBufferSampleSize();
-        int frameSize = sampleSize * s_ActiveSession->m_ActiveAudioConfig.channelCount;
-        int desiredBufferSize = frameSize * s_ActiveSession->m_ActiveAudioConfig.samplesPerFrame;
-        void* buffer = s_ActiveSession->m_AudioRenderer->getAudioBuffer(&desiredBufferSize);
-        if (buffer == nullptr) {
-            return;
-        }
-
-        if (s_ActiveSession->m_AudioRenderer->getAudioBufferFormat() == IAudioRenderer::AudioFormat::Float32NE) {
-            samplesDecoded = opus_multistream_decode_float(s_ActiveSession->m_OpusDecoder,
-                                                           (unsigned char*)sampleData,
-                                                           sampleLength,
-                                                           (float*)buffer,
-                                                           desiredBufferSize / frameSize,
-                                                           0);
-        }
-        else {
-            samplesDecoded = opus_multistream_decode(s_ActiveSession->m_OpusDecoder,
-                                                     (unsigned char*)sampleData,
-                                                     sampleLength,
-                                                     (short*)buffer,
-                                                     desiredBufferSize / frameSize,
-                                                     0);
+        AvSyncController::AudioCorrection correction = AvSyncController::AC_NONE;
+        int queuedUs = s_ActiveSession->m_AudioRenderer->getQueuedAudioDurationUs();
+        if (queuedUs >= 0) {
+            int frameDurationUs = (int)((int64_t)s_ActiveSession->m_ActiveAudioConfig.samplesPerFrame * 1000000 /
+                                        s_ActiveSession->m_ActiveAudioConfig.sampleRate);
+            correction = s_ActiveSession->m_AvSyncController.submitAudioFrame(LiGetCurrentAudioSampleTimestamp(),
+                                                                              queuedUs, frameDurationUs);
         }
 
-        // Update desiredSize with the number of bytes actually populated by the decoding operation
-        if (samplesDecoded > 0) {
-            SDL_assert(desiredBufferSize >= frameSize * samplesDecoded);
-            desiredBufferSize = frameSize * samplesDecoded;
+        // Deepen the audio buffer by playing a frame of loss concealment ahead of this one
+        if (correction == AvSyncController::AC_INSERT_FRAME) {
+            s_ActiveSession->decodeAndSubmitAudio(nullptr, 0, true);
         }
-        else {
-            desiredBufferSize = 0;
-        }
-
-        if (!s_ActiveSession->m_AudioRenderer->submitAudio(desiredBufferSize)) {
-            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                        "Reinitializing audio renderer after failure");
-
-            opus_multistream_decoder_destroy(s_ActiveSession->m_OpusDecoder);
-            s_ActiveSession->m_OpusDecoder = nullptr;
 
-            delete s_ActiveSession->m_AudioRenderer;
-            s_ActiveSession->m_AudioRenderer = nullptr;
+        // A dropped sample is still decoded to keep the decoder state intact
+        if (s_ActiveSession->m_AudioRenderer != nullptr) {
+            s_ActiveSession->decodeAndSubmitAudio(sampleData, sampleLength,
+                                                  correction != AvSyncController::AC_DROP_FRAME);
         }
     }
 
@@ -15,6 +15,17 @@ public:
     // Return false if an unrecoverable error has occurred and the renderer must be reinitialized
     virtual bool submitAudio(int bytesWritten) = 0;
 
+    // Returns how long until audio submitted now would be heard, or -1 if unknown
+    virtual int getQueuedAudioDurationUs() {
+        return -1;
+    }
+
+    // Returns the most audio that can be queued before submitAudio() starts
+    // blocking or discarding samples, or -1 if unknown
+    virtual int getMaxQueuedAudioDurationUs() {
+        return -1;
+    }
+
     virtual void remapChannels(POPUS_MULTISTREAM_CONFIGURATION) {
         // Use default channel mapping:
         // 0 - Front Left
@@ -18,8 +18,14 @@ public:
 
     virtual AudioFormat getAudioBufferFormat();
 
+    virtual int getQueuedAudioDurationUs();
+
+    virtual int getMaxQueuedAudioDurationUs();
+
 private:
     SDL_AudioDeviceID m_AudioDevice;
     void* m_AudioBuffer;
     int m_FrameSize;
+    int m_BytesPerSecond;
+    int m_DeviceBufferUs;
 };
@@ -2,9 +2,13 @@
 
 #include <Limelight.h>
 
+#define MAX_QUEUED_FRAMES 10
+
 SdlAudioRenderer::SdlAudioRenderer()
     : m_AudioDevice(0),
-      m_AudioBuffer(nullptr)
+      m_AudioBuffer(nullptr),
+      m_BytesPerSecond(0),
+      m_DeviceBufferUs(0)
 {
     SDL_assert(!SDL_WasInit(SDL_INIT_AUDIO));
 
@@ -56,6 +60,9 @@ bool SdlAudioRenderer::prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION*
         return false;
     }
 
+    m_BytesPerSecond = have.freq * have.channels * getAudioBufferSampleSize();
+    m_DeviceBufferUs = (int)((int64_t)have.samples * 1000000 / have.freq);
+
     m_AudioBuffer = SDL_malloc(m_FrameSize);
     if (m_AudioBuffer == nullptr) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -133,7 +140,7 @@ bool SdlAudioRenderer::submitAudio(int bytesWritten)
         }
 
         // Only queue more samples where there are 10 frames or less in SDL's queue
-        if (SDL_GetQueuedAudioSize(m_AudioDevice) / m_FrameSize <= 10) {
+        if (SDL_GetQueuedAudioSize(m_AudioDevice) / m_FrameSize <= MAX_QUEUED_FRAMES) {
             break;
         }
 
@@ -149,6 +156,18 @@ bool SdlAudioRenderer::submitAudio(int bytesWritten)
     return true;
 }
 
+int SdlAudioRenderer::getQueuedAudioDurationUs()
+{
+    // Audio waits in SDL's queue and then in the device buffer
+    return (int)((int64_t)SDL_GetQueuedAudioSize(m_AudioDevice) * 1000000 / m_BytesPerSecond) + m_DeviceBufferUs;
+}
+
+int SdlAudioRenderer::getMaxQueuedAudioDurationUs()
+{
+    // Beyond this, submitAudio() waits for the queue to drain
+    return (int)((int64_t)MAX_QUEUED_FRAMES * m_FrameSize * 1000000 / m_BytesPerSecond) + m_DeviceBufferUs;
+}
+
 IAudioRenderer::AudioFormat SdlAudioRenderer::getAudioBufferFormat()
 {
     return AudioFormat::Float32NE;
@@ -0,0 +1,255 @@
+#include "avsynccontroller.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+#include "SDL_compat.h"
+
+#define VIDEO_CLOCK_RATE 90000
+#define AUDIO_CLOCK_RATE 1000
+
+// The lowest transit time is re-learned periodically, so it follows drift
+// between the host and client clocks and route changes
+#define MIN_TRANSIT_WINDOW_US 10000000
+
+// Playout delays are smoothed over roughly this many frames
+#define DELAY_SMOOTHING_FRAMES 16
+
+// Offsets this small aren't noticeable and are mostly measurement noise
+#define SYNC_DEADBAND_US 15000
+
+// Leave time for a correction to show up in the smoothed delays
+#define MIN_CORRECTION_INTERVAL_US 200000
+
+// Don't correct against a video delay measured this long ago
+#define MAX_VIDEO_DELAY_AGE_US 1000000
+
+// Draining audio below this many frames risks an underrun
+#define MIN_QUEUED_AUDIO_FRAMES 2
+
+AvSyncController::AvSyncController()
+    : m_BudgetUs(0),
+      m_VideoDelayUs(0),
+      m_AudioDelayUs(0),
+      m_HaveVideoDelay(false),
+      m_HaveAudioDelay(false),
+      m_LastVideoPresentedUs(0),
+      m_MaxQueuedAudioUs(-1),
+      m_MinQueuedAudioUs(-1),
+      m_AddedAudioDelayUs(0),
+      m_LastCorrectionUs(0),
+      m_TotalAbsOffsetUs(0),
+      m_MaxAbsOffsetUs(0),
+      m_OffsetSamples(0),
+      m_InsertedFrames(0),
+      m_DroppedFrames(0)
+{
+    resetMapping(m_VideoMapping);
+    resetMapping(m_AudioMapping);
+}
+
+void AvSyncController::load()
+{
+    m_BudgetUs = std::max(0, qEnvironmentVariableIntValue("AV_SYNC_BUDGET_MS")) * 1000;
+
+    if (m_BudgetUs > 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "A/V sync correction enabled: up to %d ms of added audio delay",
+                    m_BudgetUs / 1000);
+    }
+}
+
+void AvSyncController::resetMapping(ClockMapping& mapping)
+{
+    mapping.valid = false;
+    mapping.lastTimestamp = 0;
+    mapping.lastExtendedTimestamp = 0;
+    mapping.minTransitUs = 0;
+    mapping.previousMinTransitUs = 0;
+    mapping.windowStartUs = 0;
+}
+
+int64_t AvSyncController::getTimestampUs(const ClockMapping& mapping, uint32_t timestamp, int clockRate)
+{
+    int64_t extendedTimestamp = mapping.lastExtendedTimestamp + (int32_t)(timestamp - mapping.lastTimestamp);
+    return extendedTimestamp * 1000000 / clockRate;
+}
+
+void AvSyncController::updateMapping(ClockMapping& mapping, uint32_t timestamp, int clockRate, uint64_t arrivalTimeUs)
+{
+    if (mapping.valid) {
+        mapping.lastExtendedTimestamp += (int32_t)(timestamp - mapping.lastTimestamp);
+    }
+    else {
+        mapping.lastExtendedTimestamp = timestamp;
+    }
+    mapping.lastTimestamp = timestamp;
+
+    int64_t transitUs = (int64_t)arrivalTimeUs - mapping.lastExtendedTimestamp * 1000000 / clockRate;
+
+    if (!mapping.valid) {
+        mapping.valid = true;
+        mapping.minTransitUs = transitUs;
+        mapping.previousMinTransitUs = transitUs;
+        mapping.windowStartUs = arrivalTimeUs;
+    }
+    else if (arrivalTimeUs - mapping.windowStartUs >= MIN_TRANSIT_WINDOW_US) {
+        // Keep the last window's minimum until this one has seen enough frames
+        mapping.previousMinTransitUs = mapping.minTransitUs;
+        mapping.minTransitUs = transitUs;
+        mapping.windowStartUs = arrivalTimeUs;
+    }
+    else {
+        mapping.minTransitUs = std::min(mapping.minTransitUs, transitUs);
+    }
+}
+
+int64_t AvSyncController::getPlayoutDelayUs(const ClockMapping& mapping, uint32_t timestamp, int clockRate, uint64_t playoutTimeUs)
+{
+    int64_t bestArrivalTimeUs = getTimestampUs(mapping, timestamp, clockRate) +
+                                std::min(mapping.minTransitUs, mapping.previousMinTransitUs);
+    return (int64_t)playoutTimeUs - bestArrivalTimeUs;
+}
+
+void AvSyncController::submitVideoReceived(uint32_t rtpTimestamp, uint64_t receiveTimeUs)
+{
+    QMutexLocker locker(&m_Lock);
+
+    updateMapping(m_VideoMapping, rtpTimestamp, VIDEO_CLOCK_RATE, receiveTimeUs);
+}
+
+void AvSyncController::submitVideoPresented(uint32_t rtpTimestamp, uint64_t presentTimeUs)
+{
+    QMutexLocker locker(&m_Lock);
+
+    if (!m_VideoMapping.valid) {
+        return;
+    }
+
+    int64_t delayUs = getPlayoutDelayUs(m_VideoMapping, rtpTimestamp, VIDEO_CLOCK_RATE, presentTimeUs);
+    if (m_HaveVideoDelay) {
+        m_VideoDelayUs += (delayUs - m_VideoDelayUs) / DELAY_SMOOTHING_FRAMES;
+    }
+    else {
+        m_VideoDelayUs = delayUs;
+        m_HaveVideoDelay = true;
+    }
+    m_LastVideoPresentedUs = presentTimeUs;
+
+    // Sample the offset at the video frame rate, since that's what's shown
+    if (m_HaveAudioDelay) {
+        int64_t absOffsetUs = qAbs((int64_t)(m_VideoDelayUs - m_AudioDelayUs));
+        m_TotalAbsOffsetUs += absOffsetUs;
+        m_MaxAbsOffsetUs = std::max(m_MaxAbsOffsetUs, absOffsetUs);
+        m_OffsetSamples++;
+    }
+}
+
+AvSyncController::AudioCorrection AvSyncController::submitAudioFrame(uint32_t rtpTimestampMs, int queuedUs, int frameDurationUs)
+{
+    QMutexLocker locker(&m_Lock);
+    uint64_t nowUs = LiGetMicroseconds();
+
+    // Audio doesn't have a receive time, but frames are decoded as soon as
+    // they're received unless they're waiting on a lost one
+    updateMapping(m_AudioMapping, rtpTimestampMs, AUDIO_CLOCK_RATE, nowUs);
+
+    // The shallowest the queue has been is its natural depth, so anything
+    // above that is delay we've added and the renderer has kept
+    if (m_MinQueuedAudioUs < 0 || queuedUs < m_MinQueuedAudioUs) {
+        m_MinQueuedAudioUs = queuedUs;
+    }
+    m_AddedAudioDelayUs = queuedUs - m_MinQueuedAudioUs;
+
+    int64_t delayUs = getPlayoutDelayUs(m_AudioMapping, rtpTimestampMs, AUDIO_CLOCK_RATE, nowUs + queuedUs);
+    if (m_HaveAudioDelay) {
+        m_AudioDelayUs += (delayUs - m_AudioDelayUs) / DELAY_SMOOTHING_FRAMES;
+    }
+    else {
+        m_AudioDelayUs = delayUs;
+        m_HaveAudioDelay = true;
+    }
+
+    if (m_BudgetUs == 0 || !m_HaveVideoDelay ||
+            nowUs - m_LastVideoPresentedUs > MAX_VIDEO_DELAY_AGE_US ||
+            nowUs - m_LastCorrectionUs < MIN_CORRECTION_INTERVAL_US) {
+        return AC_NONE;
+    }
+
+    // Don't deepen the queue past where the renderer would block or discard samples
+    int budgetUs = m_BudgetUs;
+    if (m_MaxQueuedAudioUs >= 0) {
+        budgetUs = std::min(budgetUs, m_MaxQueuedAudioUs - m_MinQueuedAudioUs);
+    }
+
+    // The smoothed delay is moved by the size of the correction right away,
+    // so we don't keep correcting while the average catches up.
+    double offsetUs = m_VideoDelayUs - m_AudioDelayUs;
+    if (offsetUs > SYNC_DEADBAND_US && m_AddedAudioDelayUs + frameDurationUs <= budgetUs) {
+        m_AudioDelayUs += frameDurationUs;
+        m_LastCorrectionUs = nowUs;
+        m_InsertedFrames++;
+        return AC_INSERT_FRAME;
+    }
+    else if (offsetUs < -SYNC_DEADBAND_US && queuedUs > MIN_QUEUED_AUDIO_FRAMES * frameDurationUs) {
+        m_AudioDelayUs -= frameDurationUs;
+        m_LastCorrectionUs = nowUs;
+        m_DroppedFrames++;
+        return AC_DROP_FRAME;
+    }
+
+    return AC_NONE;
+}
+
+void AvSyncController::resetAudio(int maxQueuedUs)
+{
+    QMutexLocker locker(&m_Lock);
+
+    // The new renderer starts with an empty buffer
+    m_MaxQueuedAudioUs = maxQueuedUs;
+    m_MinQueuedAudioUs = -1;
+    m_AddedAudioDelayUs = 0;
+    m_HaveAudioDelay = false;
+
+    if (m_BudgetUs > 0 && maxQueuedUs >= 0 && maxQueuedUs < m_BudgetUs) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "A/V sync correction limited to %d ms by the audio renderer",
+                    maxQueuedUs / 1000);
+    }
+}
+
+bool AvSyncController::getOffsetMs(int* offsetMs)
+{
+    QMutexLocker locker(&m_Lock);
+
+    if (!m_HaveVideoDelay || !m_HaveAudioDelay) {
+        return false;
+    }
+
+    *offsetMs = (int)((m_VideoDelayUs - m_AudioDelayUs) / 1000);
+    return true;
+}
+
+void AvSyncController::logResults()
+{
+    QMutexLocker locker(&m_Lock);
+
+    if (m_OffsetSamples == 0) {
+        return;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "A/V offset: %+.1f ms (mean absolute %.1f ms, max %.1f ms)",
+                (m_VideoDelayUs - m_AudioDelayUs) / 1000.0,
+                m_TotalAbsOffsetUs / m_OffsetSamples / 1000.0,
+                m_MaxAbsOffsetUs / 1000.0);
+
+    if (m_BudgetUs > 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "A/V sync corrections: %u audio frames inserted, %u dropped (%d ms added delay)",
+                    m_InsertedFrames,
+                    m_DroppedFrames,
+                    m_AddedAudioDelayUs / 1000);
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QMutex>
+
+#include <Limelight.h>
+
+/**
+ * @brief Measures and corrects the offset between audio and video playout.
+ *
+ * Video is paced to the display while audio plays as soon as it is decoded,
+ * so nothing keeps the two streams together when the network delays one
+ * more than the other. The controller maps the RTP timestamps of each
+ * stream onto the local clock using the lowest transit time seen recently
+ * (receive time minus RTP time), the same way an RTCP-less receiver would.
+ * The playout delay of a frame is then how long after that best case it
+ * reaches the display or the audio device. The A/V offset is the smoothed
+ * video playout delay minus the audio playout delay, so a positive offset
+ * means audio is heard before the matching video is shown.
+ *
+ * The host doesn't share a clock between the two streams, so this assumes
+ * the audio and video captured at the same time have the same best case
+ * transit time. That holds closely enough to catch the drift caused by
+ * jitter and queueing, which is what we're after.
+ *
+ * The offset is always measured. Correction is enabled with
+ * AV_SYNC_BUDGET_MS=<ms>, which bounds how much latency may be added to the
+ * audio to wait for video. The budget is also limited to the audio the
+ * renderer will queue without blocking or discarding samples, and the delay
+ * added so far is read from the depth of the renderer's queue above the
+ * shallowest it has been, since the renderer may discard what we inserted.
+ * While the offset is outside the deadband, a frame
+ * of loss concealment is inserted ahead of the next audio frame to deepen the
+ * audio buffer, or an audio frame is dropped to drain it. Video present time
+ * is left to the pacer, since delaying video would add latency to input too.
+ */
+class AvSyncController
+{
+public:
+    enum AudioCorrection
+    {
+        AC_NONE,
+        AC_INSERT_FRAME,
+        AC_DROP_FRAME,
+    };
+
+    AvSyncController();
+
+    // Reads the correction budget from the environment
+    void load();
+
+    // Called by the decoder for each complete frame received
+    void submitVideoReceived(uint32_t rtpTimestamp, uint64_t receiveTimeUs);
+
+    // Called by the pacer after a frame is presented
+    void submitVideoPresented(uint32_t rtpTimestamp, uint64_t presentTimeUs);
+
+    // Called for each audio frame before it's decoded. queuedUs is the audio
+    // already waiting to be played by the renderer. Returns the correction
+    // to apply around this frame.
+    AudioCorrection submitAudioFrame(uint32_t rtpTimestampMs, int queuedUs, int frameDurationUs);
+
+    // Called when the audio renderer is recreated, which discards any delay we added.
+    // maxQueuedUs is the most audio the new renderer will queue, or -1 if unknown.
+    void resetAudio(int maxQueuedUs);
+
+    // Returns false until both streams have been measured
+    bool getOffsetMs(int* offsetMs);
+
+    void logResults();
+
+private:
+    // Maps one stream's RTP clock onto the local clock
+    struct ClockMapping
+    {
+        bool valid;
+        uint32_t lastTimestamp;
+        int64_t lastExtendedTimestamp;
+        int64_t minTransitUs;
+        int64_t previousMinTransitUs;
+        uint64_t windowStartUs;
+    };
+
+    static void resetMapping(ClockMapping& mapping);
+
+    // Unwraps a 32-bit RTP timestamp relative to the last one received and
+    // converts it to microseconds
+    static int64_t getTimestampUs(const ClockMapping& mapping, uint32_t timestamp, int clockRate);
+
+    static void updateMapping(ClockMapping& mapping, uint32_t timestamp, int clockRate, uint64_t arrivalTimeUs);
+
+    // Time from the best case arrival of the timestamp to its playout
+    static int64_t getPlayoutDelayUs(const ClockMapping& mapping, uint32_t timestamp, int clockRate, uint64_t playoutTimeUs);
+
+    QMutex m_Lock;
+    int m_BudgetUs;
+
+    ClockMapping m_VideoMapping;
+    ClockMapping m_AudioMapping;
+
+    double m_VideoDelayUs;
+    double m_AudioDelayUs;
+    bool m_HaveVideoDelay;
+    bool m_HaveAudioDelay;
+    uint64_t m_LastVideoPresentedUs;
+
+    int m_MaxQueuedAudioUs;
+    int m_MinQueuedAudioUs;
+    int m_AddedAudioDelayUs;
+    uint64_t m_LastCorrectionUs;
+
+    double m_TotalAbsOffsetUs;
+    int64_t m_MaxAbsOffsetUs;
+    uint32_t m_OffsetSamples;
+    uint32_t m_InsertedFrames;
+    uint32_t m_DroppedFrames;
+};
@@ -0,0 +1,345 @@
+#include "bitratecontroller.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+#define SAMPLE_INTERVAL_MS 250
+
+// Floor for the target bitrate, unless the stream was started below it
+#define MIN_BITRATE_KBPS 2000
+
+// Queueing delay above the lowest recent RTT that counts as overuse. The
+// minimum is re-learned periodically so route changes don't pin it low.
+#define QUEUEING_DELAY_THRESHOLD_MS 10
+#define MIN_RTT_WINDOW_MS 10000
+
+// Consecutive delay overuse samples required before reacting, to avoid
+// cutting the bitrate on a single RTT spike
+#define OVERUSE_SAMPLES_REQUIRED 2
+
+// Frames waiting for the decoder that indicate it can't keep up
+#define MAX_PENDING_FRAMES 3
+
+// Fraction of video packets that needed FEC recovery or arrived out of order
+#define LOSS_OVERUSE_RATIO 0.10
+#define LOSS_NORMAL_RATIO 0.02
+
+#define DECREASE_FACTOR 0.85
+#define MIN_DECREASE_INTERVAL_MS 500
+#define HOLD_AFTER_DECREASE_MS 2000
+
+// Per-sample growth while far from the last congested bitrate (about 8%/s)
+// and additive growth in percent of the maximum bitrate once near it
+#define MULTIPLICATIVE_INCREASE_FACTOR 1.02
+#define ADDITIVE_INCREASE_PERCENT 0.5
+#define NEAR_CONVERGENCE_RATIO 0.9
+
+// Increases smaller than this wouldn't be worth an encoder reconfiguration,
+// so they aren't reported either
+#define MIN_INCREASE_REPORT_PERCENT 5
+#define MIN_INCREASE_REPORT_INTERVAL_MS 1000
+
+// Restarting the connection stalls the stream, so the target must differ
+// from the stream's bitrate by this much and hold there before we do it.
+// Decreases are held briefly since congestion is already hurting the stream.
+#define RECONFIGURE_HYSTERESIS_PERCENT 20
+#define RECONFIGURE_DECREASE_HOLD_MS 3000
+#define RECONFIGURE_INCREASE_HOLD_MS 20000
+#define MIN_RECONFIGURE_INTERVAL_MS 30000
+
+BitrateController::BitrateController(int maxBitrateKbps)
+    : m_Thread(nullptr),
+      m_Stopping(false),
+      m_MaxBitrateKbps(maxBitrateKbps),
+      m_MinBitrateKbps(std::min(maxBitrateKbps, std::max(MIN_BITRATE_KBPS, maxBitrateKbps / 10))),
+      m_TargetBitrateKbps(maxBitrateKbps),
+      m_ReportedBitrateKbps(maxBitrateKbps),
+      m_LowestBitrateKbps(maxBitrateKbps),
+      m_LastOveruseBitrateKbps(0),
+      m_LastDecreaseMs(0),
+      m_LastReportMs(0),
+      m_StreamBitrateKbps(maxBitrateKbps),
+      m_PendingDirection(0),
+      m_PendingSinceMs(0),
+      m_LastReconfigureMs(0),
+      m_ReconfigureRequested(false),
+      m_LastStats({}),
+      m_SmoothedRttMs(0),
+      m_LastSmoothedRttMs(0),
+      m_MinRttMs(UINT32_MAX),
+      m_MinRttResetMs(0),
+      m_OveruseSamples(0)
+{
+}
+
+BitrateController::~BitrateController()
+{
+    stop();
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Bitrate controller finished: lowest recommended bitrate %d of %d Kbps",
+                m_LowestBitrateKbps,
+                m_MaxBitrateKbps);
+}
+
+bool BitrateController::start(int streamBitrateKbps)
+{
+    SDL_assert(m_Thread == nullptr);
+
+    // The connection was restarted, so its stats and RTT start over
+    m_LastStats = *LiGetRTPVideoStats();
+    m_SmoothedRttMs = 0;
+    m_LastSmoothedRttMs = 0;
+    m_MinRttMs = UINT32_MAX;
+    m_MinRttResetMs = LiGetMillis();
+    m_OveruseSamples = 0;
+
+    m_StreamBitrateKbps = streamBitrateKbps;
+    m_PendingDirection = 0;
+    m_LastReconfigureMs = LiGetMillis();
+    m_ReconfigureRequested = false;
+
+    m_Stopping = false;
+    m_Thread = SDL_CreateThread(BitrateController::controllerThreadProc, "BitrateCtl", this);
+    if (m_Thread == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to create bitrate controller thread: %s",
+                     SDL_GetError());
+        return false;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Experimental bitrate controller enabled: %d Kbps (%d-%d Kbps)",
+                m_StreamBitrateKbps,
+                m_MinBitrateKbps,
+                m_MaxBitrateKbps);
+    return true;
+}
+
+void BitrateController::stop()
+{
+    if (m_Thread == nullptr) {
+        return;
+    }
+
+    m_Lock.lock();
+    m_Stopping = true;
+    m_StopCond.wakeAll();
+    m_Lock.unlock();
+
+    SDL_WaitThread(m_Thread, nullptr);
+    m_Thread = nullptr;
+}
+
+int BitrateController::getMaxBitrateKbps()
+{
+    return m_MaxBitrateKbps;
+}
+
+int BitrateController::controllerThreadProc(void* context)
+{
+    BitrateController* me = reinterpret_cast<BitrateController*>(context);
+
+    QMutexLocker locker(&me->m_Lock);
+
+    while (!me->m_Stopping) {
+        me->m_StopCond.wait(&me->m_Lock, SAMPLE_INTERVAL_MS);
+        if (me->m_Stopping) {
+            break;
+        }
+
+        me->update();
+        me->checkReconfiguration();
+    }
+
+    return 0;
+}
+
+BitrateController::Signal BitrateController::detectDelaySignal(uint32_t rttMs, int pendingFrames)
+{
+    uint64_t now = LiGetMillis();
+
+    if (now - m_MinRttResetMs >= MIN_RTT_WINDOW_MS) {
+        m_MinRttMs = rttMs;
+        m_MinRttResetMs = now;
+    }
+    else {
+        m_MinRttMs = std::min(m_MinRttMs, rttMs);
+    }
+
+    m_LastSmoothedRttMs = m_SmoothedRttMs;
+    if (m_SmoothedRttMs == 0) {
+        m_SmoothedRttMs = rttMs;
+    }
+    else {
+        m_SmoothedRttMs = 0.7 * m_SmoothedRttMs + 0.3 * rttMs;
+    }
+
+    double queueingDelayMs = m_SmoothedRttMs - m_MinRttMs;
+    bool rttGrowing = m_SmoothedRttMs >= m_LastSmoothedRttMs;
+
+    if ((queueingDelayMs > QUEUEING_DELAY_THRESHOLD_MS && rttGrowing) || pendingFrames > MAX_PENDING_FRAMES) {
+        m_OveruseSamples++;
+    }
+    else {
+        m_OveruseSamples = 0;
+    }
+
+    if (m_OveruseSamples >= OVERUSE_SAMPLES_REQUIRED) {
+        return SignalOveruse;
+    }
+    else if (queueingDelayMs > QUEUEING_DELAY_THRESHOLD_MS / 2) {
+        // The queue is draining or just starting to build, so hold steady
+        return SignalUnderuse;
+    }
+    else {
+        return SignalNormal;
+    }
+}
+
+BitrateController::Signal BitrateController::detectLossSignal(const RTP_VIDEO_STATS& delta, uint32_t totalPackets)
+{
+    // Any unrecoverable FEC block is a lost frame and an RFI/IDR round trip
+    if (delta.packetCountFecFailed != 0) {
+        return SignalOveruse;
+    }
+
+    double lossRatio = (double)(delta.packetCountFecRecovered + delta.packetCountOOS) / totalPackets;
+    if (lossRatio > LOSS_OVERUSE_RATIO) {
+        return SignalOveruse;
+    }
+    else if (lossRatio > LOSS_NORMAL_RATIO) {
+        return SignalUnderuse;
+    }
+    else {
+        return SignalNormal;
+    }
+}
+
+void BitrateController::update()
+{
+    const RTP_VIDEO_STATS* stats = LiGetRTPVideoStats();
+    RTP_VIDEO_STATS delta;
+
+    delta.packetCountVideo = stats->packetCountVideo - m_LastStats.packetCountVideo;
+    delta.packetCountFec = stats->packetCountFec - m_LastStats.packetCountFec;
+    delta.packetCountFecRecovered = stats->packetCountFecRecovered - m_LastStats.packetCountFecRecovered;
+    delta.packetCountFecFailed = stats->packetCountFecFailed - m_LastStats.packetCountFecFailed;
+    delta.packetCountOOS = stats->packetCountOOS - m_LastStats.packetCountOOS;
+    delta.packetCountInvalid = stats->packetCountInvalid - m_LastStats.packetCountInvalid;
+    delta.packetCountFecInvalid = stats->packetCountFecInvalid - m_LastStats.packetCountFecInvalid;
+    m_LastStats = *stats;
+
+    uint32_t totalPackets = delta.packetCountVideo + delta.packetCountFec;
+    uint32_t rttMs;
+    if (totalPackets == 0 || !LiGetEstimatedRttInfo(&rttMs, nullptr)) {
+        // Nothing was streamed (or the control stream is gone), so there's nothing to learn from
+        return;
+    }
+
+    Signal delaySignal = detectDelaySignal(rttMs, LiGetPendingVideoFrames());
+    Signal lossSignal = detectLossSignal(delta, totalPackets);
+    uint64_t now = LiGetMillis();
+
+    if (delaySignal == SignalOveruse || lossSignal == SignalOveruse) {
+        if (now - m_LastDecreaseMs < MIN_DECREASE_INTERVAL_MS) {
+            // Let the previous decrease take effect first
+            return;
+        }
+
+        m_LastOveruseBitrateKbps = m_TargetBitrateKbps;
+        m_TargetBitrateKbps = std::max(m_MinBitrateKbps, (int)(m_TargetBitrateKbps * DECREASE_FACTOR));
+        m_LastDecreaseMs = now;
+        m_OveruseSamples = 0;
+    }
+    else if (delaySignal == SignalUnderuse || lossSignal == SignalUnderuse ||
+             now - m_LastDecreaseMs < HOLD_AFTER_DECREASE_MS) {
+        return;
+    }
+    else if (m_LastOveruseBitrateKbps != 0 && m_TargetBitrateKbps >= m_LastOveruseBitrateKbps * NEAR_CONVERGENCE_RATIO) {
+        m_TargetBitrateKbps += std::max(1, (int)(m_MaxBitrateKbps * ADDITIVE_INCREASE_PERCENT / 100));
+    }
+    else {
+        m_TargetBitrateKbps = (int)(m_TargetBitrateKbps * MULTIPLICATIVE_INCREASE_FACTOR) + 1;
+    }
+
+    m_TargetBitrateKbps = std::min(m_MaxBitrateKbps, m_TargetBitrateKbps);
+
+    if (m_TargetBitrateKbps == m_ReportedBitrateKbps) {
+        return;
+    }
+    else if (m_TargetBitrateKbps > m_ReportedBitrateKbps) {
+        // Batch up increases, except for returning to the full bitrate
+        if (now - m_LastReportMs < MIN_INCREASE_REPORT_INTERVAL_MS) {
+            return;
+        }
+        else if (m_TargetBitrateKbps != m_MaxBitrateKbps &&
+                 m_TargetBitrateKbps - m_ReportedBitrateKbps < m_ReportedBitrateKbps * MIN_INCREASE_REPORT_PERCENT / 100) {
+            return;
+        }
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Recommended bitrate: %d -> %d Kbps (RTT: %u ms, min RTT: %u ms, FEC recovered: %u, FEC failed: %u, OOS: %u)",
+                m_ReportedBitrateKbps,
+                m_TargetBitrateKbps,
+                rttMs,
+                m_MinRttMs,
+                delta.packetCountFecRecovered,
+                delta.packetCountFecFailed,
+                delta.packetCountOOS);
+
+    m_ReportedBitrateKbps = m_TargetBitrateKbps;
+    m_LowestBitrateKbps = std::min(m_LowestBitrateKbps, m_ReportedBitrateKbps);
+    m_LastReportMs = now;
+}
+
+void BitrateController::checkReconfiguration()
+{
+    if (m_ReconfigureRequested) {
+        // Wait for the session to restart the connection
+        return;
+    }
+
+    int direction;
+    if (m_ReportedBitrateKbps <= m_StreamBitrateKbps * (100 - RECONFIGURE_HYSTERESIS_PERCENT) / 100) {
+        direction = -1;
+    }
+    else if (m_ReportedBitrateKbps >= m_StreamBitrateKbps * (100 + RECONFIGURE_HYSTERESIS_PERCENT) / 100 ||
+             (m_ReportedBitrateKbps == m_MaxBitrateKbps && m_StreamBitrateKbps < m_MaxBitrateKbps)) {
+        // Always allow returning to the full bitrate once congestion is gone
+        direction = 1;
+    }
+    else {
+        direction = 0;
+    }
+
+    uint64_t now = LiGetMillis();
+    if (direction != m_PendingDirection) {
+        m_PendingDirection = direction;
+        m_PendingSinceMs = now;
+        return;
+    }
+    else if (direction == 0) {
+        return;
+    }
+
+    uint64_t holdMs = direction < 0 ? RECONFIGURE_DECREASE_HOLD_MS : RECONFIGURE_INCREASE_HOLD_MS;
+    if (now - m_PendingSinceMs < holdMs || now - m_LastReconfigureMs < MIN_RECONFIGURE_INTERVAL_MS) {
+        return;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Requesting stream bitrate change: %d -> %d Kbps",
+                m_StreamBitrateKbps,
+                m_ReportedBitrateKbps);
+
+    SDL_Event event = {};
+    event.type = SDL_USEREVENT;
+    event.user.code = SDL_CODE_BITRATE_RECONFIGURE;
+    event.user.data1 = (void*)(intptr_t)m_ReportedBitrateKbps;
+    SDL_PushEvent(&event);
+
+    m_ReconfigureRequested = true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <Limelight.h>
+
+#include "SDL_compat.h"
+
+// Posted when the controller wants the stream restarted at a new bitrate.
+// data1 holds the bitrate in Kbps.
+#define SDL_CODE_BITRATE_RECONFIGURE 109
+
+/**
+ * @brief Experimental bitrate control based on client-side congestion signals.
+ *
+ * A controller thread samples the connection a few times per second and
+ * combines two congestion detectors, loosely modeled after Google
+ * Congestion Control:
+ *
+ * - A delay-based detector that compares the smoothed control stream RTT
+ *   against the lowest RTT seen recently. A growing gap (or a decoder that
+ *   can't drain its queue) means packets are queueing somewhere, which
+ *   shows up well before actual loss on most Wi-Fi links.
+ * - A loss-based detector that uses the RTP video stats deltas. FEC-recovered
+ *   and out-of-sequence packets are treated as early warning, unrecoverable
+ *   FEC blocks as definite loss.
+ *
+ * On overuse the target is cut multiplicatively. After a hold period, it is
+ * grown again, multiplicatively while far below the last bitrate that caused
+ * congestion and additively when close to it. The target never exceeds the
+ * bitrate the stream was started with.
+ *
+ * No host protocol can retarget the encoder mid-stream, so a new bitrate is
+ * applied by restarting the connection (see Session::reconfigureBitrate()).
+ * That stalls the stream briefly, so the session is only asked to do it when
+ * the target has moved far from the stream's bitrate and stayed there for a
+ * while, and never more often than once per reconfiguration interval. It only
+ * runs when EXPERIMENTAL_BITRATE_CONTROLLER is set in the environment.
+ */
+class BitrateController
+{
+public:
+    explicit BitrateController(int maxBitrateKbps);
+    ~BitrateController();
+
+    // Starts sampling a connection streaming at the given bitrate. The
+    // congestion state is kept across stop() and start() when the
+    // connection is restarted with a new bitrate.
+    bool start(int streamBitrateKbps);
+
+    void stop();
+
+    int getMaxBitrateKbps();
+
+private:
+    enum Signal {
+        SignalUnderuse,
+        SignalNormal,
+        SignalOveruse,
+    };
+
+    static int controllerThreadProc(void* context);
+
+    Signal detectDelaySignal(uint32_t rttMs, int pendingFrames);
+
+    Signal detectLossSignal(const RTP_VIDEO_STATS& delta, uint32_t totalPackets);
+
+    void update();
+
+    void checkReconfiguration();
+
+    SDL_Thread* m_Thread;
+    bool m_Stopping;
+    QMutex m_Lock;
+    QWaitCondition m_StopCond;
+
+    int m_MaxBitrateKbps;
+    int m_MinBitrateKbps;
+    int m_TargetBitrateKbps;
+    int m_ReportedBitrateKbps;
+    int m_LowestBitrateKbps;
+
+    // Bitrate in effect the last time we detected overuse
+    int m_LastOveruseBitrateKbps;
+    uint64_t m_LastDecreaseMs;
+    uint64_t m_LastReportMs;
+
+    // Bitrate the connection is running at and the pending change to it
+    int m_StreamBitrateKbps;
+    int m_PendingDirection;
+    uint64_t m_PendingSinceMs;
+    uint64_t m_LastReconfigureMs;
+    bool m_ReconfigureRequested;
+
+    RTP_VIDEO_STATS m_LastStats;
+    double m_SmoothedRttMs;
+    double m_LastSmoothedRttMs;
+    uint32_t m_MinRttMs;
+    uint64_t m_MinRttResetMs;
+    int m_OveruseSamples;
+};
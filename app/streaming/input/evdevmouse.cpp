@@ -0,0 +1,675 @@
+#include "evdevmouse.h"
+
+#include <Limelight.h>
+
+#include <QDir>
+#include <QFile>
+#include <QVector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+// How often to look for newly connected mice
+#define RESCAN_INTERVAL_MS 2000
+
+#define EVENTS_PER_READ 64
+
+#define WHEEL_DELTA 120
+
+#ifndef input_event_sec
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
+#define TEST_BIT(bit, array) ((array)[(bit) / (sizeof(unsigned long) * 8)] & (1UL << ((bit) % (sizeof(unsigned long) * 8))))
+#define BITS_TO_LONGS(bits) (((bits) + sizeof(unsigned long) * 8 - 1) / (sizeof(unsigned long) * 8))
+
+static uint64_t getMonotonicTimeUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t getEventTimeUs(const input_event& event)
+{
+    return (uint64_t)event.input_event_sec * 1000000 + event.input_event_usec;
+}
+
+EvdevMouse::EvdevMouse(bool swapMouseButtons, bool reverseScrollDirection)
+    : m_SwapMouseButtons(swapMouseButtons),
+      m_ReverseScrollDirection(reverseScrollDirection),
+      m_ReplayPath(qgetenv("EVDEV_MOUSE_REPLAY")),
+      m_Thread(nullptr),
+      m_WakeFd(-1),
+      m_ButtonsDown(0),
+      m_PendingDeltaX(0),
+      m_PendingDeltaY(0),
+      m_PendingScroll(0),
+      m_PendingHScroll(0),
+      m_PendingEventTimeUs(0),
+      m_LatencyHistogram{},
+      m_LatencyTotalUs(0),
+      m_LatencyMaxUs(0),
+      m_ReportsSent(0)
+{
+}
+
+EvdevMouse::~EvdevMouse()
+{
+    stop();
+}
+
+EvdevMouse* EvdevMouse::create(bool swapMouseButtons, bool reverseScrollDirection)
+{
+    if (qEnvironmentVariableIntValue("EVDEV_MOUSE") == 0 && !qEnvironmentVariableIsSet("EVDEV_MOUSE_REPLAY")) {
+        return nullptr;
+    }
+
+    EvdevMouse* mouse = new EvdevMouse(swapMouseButtons, reverseScrollDirection);
+    if (!mouse->start()) {
+        delete mouse;
+        return nullptr;
+    }
+
+    return mouse;
+}
+
+bool EvdevMouse::start()
+{
+    SDL_assert(m_Thread == nullptr);
+
+    m_WakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_WakeFd < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "eventfd() failed: %d",
+                     errno);
+        return false;
+    }
+
+    if (!m_ReplayPath.isEmpty()) {
+        // Replayed input replaces the real mouse entirely
+        m_DeviceCount.storeRelaxed(1);
+    }
+    else {
+        // Open the devices up front, so we know whether SDL needs to handle the mouse
+        scanDevices();
+        if (m_Devices.isEmpty()) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "No usable evdev mice found; using SDL mouse input");
+        }
+    }
+
+    m_Stopping.storeRelaxed(0);
+    m_Thread = SDL_CreateThread(EvdevMouse::inputThreadProc, "EvdevMouse", this);
+    if (m_Thread == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to create evdev mouse thread: %s",
+                     SDL_GetError());
+        closeDevices();
+        close(m_WakeFd);
+        m_WakeFd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+void EvdevMouse::stop()
+{
+    if (m_Thread == nullptr) {
+        return;
+    }
+
+    m_Stopping.storeRelaxed(1);
+    wakeThread();
+
+    SDL_WaitThread(m_Thread, nullptr);
+    m_Thread = nullptr;
+
+    close(m_WakeFd);
+    m_WakeFd = -1;
+
+    logStats();
+}
+
+void EvdevMouse::setForwarding(bool forwarding)
+{
+    int wasForwarding = m_Forwarding.fetchAndStoreRelaxed(forwarding ? 1 : 0);
+    if (forwarding || !wasForwarding) {
+        return;
+    }
+
+    // Release the buttons right here, since the caller may be about to stop
+    // the connection. The input thread checks m_Forwarding under the same
+    // lock, so it can't send anything after this.
+    m_SendLock.lock();
+    releaseButtons();
+    m_SendLock.unlock();
+
+    // Have the input thread drop the motion it has already read
+    wakeThread();
+}
+
+bool EvdevMouse::isForwarding()
+{
+    return m_Forwarding.loadRelaxed() && m_DeviceCount.loadRelaxed() > 0;
+}
+
+int EvdevMouse::inputThreadProc(void* context)
+{
+    EvdevMouse* me = reinterpret_cast<EvdevMouse*>(context);
+
+    me->raiseThreadPriority();
+
+    if (!me->m_ReplayPath.isEmpty()) {
+        me->runReplay();
+    }
+    else {
+        me->runDevices();
+    }
+
+    me->m_SendLock.lock();
+    me->releaseButtons();
+    me->m_SendLock.unlock();
+
+    me->closeDevices();
+    return 0;
+}
+
+void EvdevMouse::wakeThread()
+{
+    uint64_t value = 1;
+
+    if (m_WakeFd < 0) {
+        return;
+    }
+
+    if (write(m_WakeFd, &value, sizeof(value)) < 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Failed to wake evdev mouse thread: %d",
+                    errno);
+    }
+}
+
+void EvdevMouse::clearWakeFd()
+{
+    uint64_t value;
+
+    // Reading an eventfd resets it, however many wakeups were queued
+    if (read(m_WakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Failed to read evdev mouse wake fd: %d",
+                    errno);
+    }
+}
+
+void EvdevMouse::raiseThreadPriority()
+{
+    struct sched_param param = {};
+
+    // Even the lowest real-time priority preempts every normal thread,
+    // which is all we need to avoid waiting behind the render and decode
+    // threads. This requires CAP_SYS_NICE or an RLIMIT_RTPRIO allowance.
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err == 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Evdev mouse thread is using SCHED_FIFO");
+        return;
+    }
+
+    if (SDL_SetThreadPriority(SDL_THREAD_PRIORITY_TIME_CRITICAL) < 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Unable to raise evdev mouse thread priority: %d, %s",
+                    err,
+                    SDL_GetError());
+    }
+    else {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "SCHED_FIFO unavailable (error %d); evdev mouse thread is using high priority",
+                    err);
+    }
+}
+
+void EvdevMouse::scanDevices()
+{
+    QStringList entries = QDir("/dev/input").entryList(QStringList() << "event*", QDir::System);
+    QSet<QByteArray> presentPaths;
+
+    for (const QString& entry : entries) {
+        QByteArray path = QString("/dev/input/" + entry).toLocal8Bit();
+        presentPaths.insert(path);
+
+        if (m_Devices.contains(path) || m_RejectedPaths.contains(path)) {
+            continue;
+        }
+
+        int fd = open(path.constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EACCES) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "No permission to read %s (is the user in the input group?)",
+                            path.constData());
+            }
+            m_RejectedPaths.insert(path);
+            continue;
+        }
+
+        unsigned long relBits[BITS_TO_LONGS(REL_CNT)] = {};
+        unsigned long keyBits[BITS_TO_LONGS(KEY_CNT)] = {};
+        if (ioctl(fd, EVIOCGBIT(EV_REL, sizeof(relBits)), relBits) < 0 ||
+                ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) < 0 ||
+                !TEST_BIT(REL_X, relBits) || !TEST_BIT(REL_Y, relBits) || !TEST_BIT(BTN_LEFT, keyBits)) {
+            // Not a mouse
+            close(fd);
+            m_RejectedPaths.insert(path);
+            continue;
+        }
+
+        // Timestamp events with the same clock we use to measure latency
+        int clockId = CLOCK_MONOTONIC;
+        if (ioctl(fd, EVIOCSCLOCKID, &clockId) < 0) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "EVIOCSCLOCKID failed on %s: %d",
+                        path.constData(),
+                        errno);
+        }
+
+        char name[128] = {};
+        ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+
+        Device device;
+        device.fd = fd;
+#ifdef REL_WHEEL_HI_RES
+        device.hasHiResWheel = TEST_BIT(REL_WHEEL_HI_RES, relBits);
+#else
+        device.hasHiResWheel = false;
+#endif
+        m_Devices.insert(path, device);
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Using evdev mouse: %s (%s)",
+                    name,
+                    path.constData());
+    }
+
+    // Event nodes get reused for new devices after a disconnect
+    m_RejectedPaths.intersect(presentPaths);
+
+    m_DeviceCount.storeRelaxed(m_Devices.size());
+}
+
+void EvdevMouse::closeDevices()
+{
+    for (const Device& device : m_Devices) {
+        close(device.fd);
+    }
+
+    m_Devices.clear();
+    m_DeviceCount.storeRelaxed(0);
+}
+
+void EvdevMouse::runDevices()
+{
+    QVector<struct pollfd> pfds;
+    QVector<QByteArray> pfdPaths;
+    uint64_t lastScanUs = getMonotonicTimeUs();
+
+    while (!m_Stopping.loadRelaxed()) {
+        if (getMonotonicTimeUs() - lastScanUs >= RESCAN_INTERVAL_MS * 1000) {
+            scanDevices();
+            lastScanUs = getMonotonicTimeUs();
+        }
+
+        pfds.clear();
+        pfdPaths.clear();
+
+        struct pollfd pfd = { m_WakeFd, POLLIN, 0 };
+        pfds.append(pfd);
+        pfdPaths.append(QByteArray());
+        for (auto it = m_Devices.cbegin(); it != m_Devices.cend(); ++it) {
+            pfd.fd = it.value().fd;
+            pfds.append(pfd);
+            pfdPaths.append(it.key());
+        }
+
+        int ret = poll(pfds.data(), pfds.size(), RESCAN_INTERVAL_MS);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "poll() failed: %d",
+                         errno);
+            break;
+        }
+        else if (pfds[0].revents != 0) {
+            // Woken up by stop() or by setForwarding()
+            clearWakeFd();
+            if (m_Stopping.loadRelaxed()) {
+                break;
+            }
+        }
+
+        // setForwarding() has already released any buttons when we lost capture
+        bool forwarding = m_Forwarding.loadRelaxed();
+
+        for (int i = 1; i < pfds.size(); i++) {
+            Device device = m_Devices.value(pfdPaths[i]);
+
+            if (pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                            "Evdev mouse removed: %s",
+                            pfdPaths[i].constData());
+                close(device.fd);
+                m_Devices.remove(pfdPaths[i]);
+                m_DeviceCount.storeRelaxed(m_Devices.size());
+                continue;
+            }
+            else if (!(pfds[i].revents & POLLIN)) {
+                continue;
+            }
+
+            input_event events[EVENTS_PER_READ];
+            ssize_t bytesRead;
+            while ((bytesRead = read(device.fd, events, sizeof(events))) > 0) {
+                for (int j = 0; j < (int)(bytesRead / sizeof(input_event)); j++) {
+                    if (forwarding) {
+                        handleEvent(events[j], device.hasHiResWheel, getEventTimeUs(events[j]));
+                    }
+                }
+            }
+        }
+
+        if (!forwarding) {
+            // Drop anything that arrived while SDL owned the mouse
+            m_PendingDeltaX = m_PendingDeltaY = 0;
+            m_PendingScroll = m_PendingHScroll = 0;
+            m_PendingEventTimeUs = 0;
+        }
+    }
+}
+
+void EvdevMouse::runReplay()
+{
+    QFile file(QString::fromLocal8Bit(m_ReplayPath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to open evdev replay file: %s",
+                     m_ReplayPath.constData());
+        return;
+    }
+
+    QByteArray data = file.readAll();
+    const input_event* events = reinterpret_cast<const input_event*>(data.constData());
+    int eventCount = data.size() / sizeof(input_event);
+    if (eventCount == 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Evdev replay file is empty: %s",
+                     m_ReplayPath.constData());
+        return;
+    }
+
+    bool hasHiResWheel = false;
+#ifdef REL_WHEEL_HI_RES
+    for (int i = 0; i < eventCount; i++) {
+        if (events[i].type == EV_REL && events[i].code == REL_WHEEL_HI_RES) {
+            hasHiResWheel = true;
+            break;
+        }
+    }
+#endif
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Replaying %d evdev events from %s",
+                eventCount,
+                m_ReplayPath.constData());
+
+    // Replay with the recorded spacing between events, starting now
+    uint64_t recordedBaseUs = getEventTimeUs(events[0]);
+    uint64_t replayBaseUs = getMonotonicTimeUs();
+    int i;
+
+    for (i = 0; i < eventCount && !m_Stopping.loadRelaxed(); i++) {
+        uint64_t targetUs = replayBaseUs + (getEventTimeUs(events[i]) - recordedBaseUs);
+
+        // Wait on the wake fd for long gaps so stop() isn't delayed,
+        // then sleep precisely for the remainder
+        for (uint64_t nowUs = getMonotonicTimeUs(); nowUs + 2000 < targetUs; nowUs = getMonotonicTimeUs()) {
+            struct pollfd pfd = { m_WakeFd, POLLIN, 0 };
+            if (poll(&pfd, 1, (int)((targetUs - nowUs) / 1000) - 1) > 0) {
+                clearWakeFd();
+                if (m_Stopping.loadRelaxed()) {
+                    break;
+                }
+            }
+        }
+        if (m_Stopping.loadRelaxed()) {
+            break;
+        }
+
+        struct timespec target;
+        target.tv_sec = targetUs / 1000000;
+        target.tv_nsec = (targetUs % 1000000) * 1000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, nullptr) == EINTR);
+
+        if (m_Forwarding.loadRelaxed()) {
+            // The target time is when the kernel would have delivered this event
+            handleEvent(events[i], hasHiResWheel, targetUs);
+        }
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Replayed %d of %d evdev events in %.1f ms",
+                i,
+                eventCount,
+                (getMonotonicTimeUs() - replayBaseUs) / 1000.0);
+}
+
+void EvdevMouse::handleEvent(const input_event& event, bool hasHiResWheel, uint64_t eventTimeUs)
+{
+    switch (event.type) {
+    case EV_REL:
+        switch (event.code) {
+        case REL_X:
+            m_PendingDeltaX += event.value;
+            break;
+        case REL_Y:
+            m_PendingDeltaY += event.value;
+            break;
+        case REL_WHEEL:
+            if (hasHiResWheel) {
+                return;
+            }
+            m_PendingScroll += event.value * WHEEL_DELTA;
+            break;
+        case REL_HWHEEL:
+            if (hasHiResWheel) {
+                return;
+            }
+            m_PendingHScroll += event.value * WHEEL_DELTA;
+            break;
+#ifdef REL_WHEEL_HI_RES
+        case REL_WHEEL_HI_RES:
+            // Same units as WHEEL_DELTA
+            m_PendingScroll += event.value;
+            break;
+        case REL_HWHEEL_HI_RES:
+            m_PendingHScroll += event.value;
+            break;
+#endif
+        default:
+            return;
+        }
+
+        // Latency is measured from the oldest event in the report
+        if (m_PendingEventTimeUs == 0) {
+            m_PendingEventTimeUs = eventTimeUs;
+        }
+        break;
+
+    case EV_KEY:
+    {
+        int button;
+
+        switch (event.code) {
+        case BTN_LEFT:
+            button = m_SwapMouseButtons ? BUTTON_RIGHT : BUTTON_LEFT;
+            break;
+        case BTN_RIGHT:
+            button = m_SwapMouseButtons ? BUTTON_LEFT : BUTTON_RIGHT;
+            break;
+        case BTN_MIDDLE:
+            button = BUTTON_MIDDLE;
+            break;
+        case BTN_SIDE:
+            button = BUTTON_X1;
+            break;
+        case BTN_EXTRA:
+            button = BUTTON_X2;
+            break;
+        default:
+            return;
+        }
+
+        if (event.value == 2) {
+            // Autorepeat
+            return;
+        }
+
+        // Motion that preceded the click within the report must arrive first
+        flushReport(getMonotonicTimeUs());
+
+        QMutexLocker locker(&m_SendLock);
+
+        // setForwarding() may have released the buttons since we read this
+        if (!m_Forwarding.loadRelaxed()) {
+            return;
+        }
+
+        if (event.value != 0) {
+            m_ButtonsDown |= 1 << button;
+        }
+        else if (m_ButtonsDown & (1 << button)) {
+            m_ButtonsDown &= ~(1 << button);
+        }
+        else {
+            // We never sent the press, so don't send a release
+            return;
+        }
+
+        LiSendMouseButtonEvent(event.value != 0 ? BUTTON_ACTION_PRESS : BUTTON_ACTION_RELEASE, button);
+        addLatencySample(getMonotonicTimeUs() - eventTimeUs);
+        break;
+    }
+
+    case EV_SYN:
+        if (event.code == SYN_REPORT) {
+            flushReport(getMonotonicTimeUs());
+        }
+        else if (event.code == SYN_DROPPED) {
+            // The kernel buffer overflowed, so the partial report is unusable
+            m_PendingDeltaX = m_PendingDeltaY = 0;
+            m_PendingScroll = m_PendingHScroll = 0;
+            m_PendingEventTimeUs = 0;
+        }
+        break;
+    }
+}
+
+void EvdevMouse::flushReport(uint64_t nowUs)
+{
+    if (m_PendingEventTimeUs == 0) {
+        return;
+    }
+
+    QMutexLocker locker(&m_SendLock);
+
+    if (!m_Forwarding.loadRelaxed()) {
+        // Capture was lost after this motion was read
+        m_PendingDeltaX = m_PendingDeltaY = 0;
+        m_PendingScroll = m_PendingHScroll = 0;
+        m_PendingEventTimeUs = 0;
+        return;
+    }
+
+    if (m_PendingDeltaX != 0 || m_PendingDeltaY != 0) {
+        LiSendMouseMoveEvent((short)qBound(SHRT_MIN, m_PendingDeltaX, SHRT_MAX),
+                             (short)qBound(SHRT_MIN, m_PendingDeltaY, SHRT_MAX));
+    }
+
+    if (m_PendingScroll != 0) {
+        int scroll = m_ReverseScrollDirection ? -m_PendingScroll : m_PendingScroll;
+        LiSendHighResScrollEvent((short)qBound(SHRT_MIN, scroll, SHRT_MAX));
+    }
+
+    if (m_PendingHScroll != 0) {
+        int scroll = m_ReverseScrollDirection ? -m_PendingHScroll : m_PendingHScroll;
+        LiSendHighResHScrollEvent((short)qBound(SHRT_MIN, scroll, SHRT_MAX));
+    }
+
+    addLatencySample(nowUs - m_PendingEventTimeUs);
+
+    m_PendingDeltaX = m_PendingDeltaY = 0;
+    m_PendingScroll = m_PendingHScroll = 0;
+    m_PendingEventTimeUs = 0;
+}
+
+void EvdevMouse::releaseButtons()
+{
+    for (int button = BUTTON_LEFT; m_ButtonsDown != 0 && button <= BUTTON_X2; button++) {
+        if (m_ButtonsDown & (1 << button)) {
+            LiSendMouseButtonEvent(BUTTON_ACTION_RELEASE, button);
+            m_ButtonsDown &= ~(1 << button);
+        }
+    }
+}
+
+void EvdevMouse::addLatencySample(uint64_t latencyUs)
+{
+    int bucket = (int)qMin<uint64_t>(latencyUs / k_LatencyBucketUs, k_LatencyBucketCount - 1);
+
+    m_LatencyHistogram[bucket]++;
+    m_LatencyTotalUs += latencyUs;
+    m_LatencyMaxUs = qMax(m_LatencyMaxUs, latencyUs);
+    m_ReportsSent++;
+}
+
+void EvdevMouse::logStats()
+{
+    if (m_ReportsSent == 0) {
+        return;
+    }
+
+    auto percentileUs = [this](int percentile) {
+        uint64_t target = ((uint64_t)m_ReportsSent * percentile + 99) / 100;
+        uint64_t seen = 0;
+        for (int i = 0; i < k_LatencyBucketCount; i++) {
+            seen += m_LatencyHistogram[i];
+            if (seen >= target) {
+                return (i + 1) * k_LatencyBucketUs;
+            }
+        }
+        return k_LatencyBucketCount * k_LatencyBucketUs;
+    };
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Evdev mouse: %u reports sent, event-to-send latency: mean %.1f us, p50 < %d us, p99 < %d us, max %llu us",
+                m_ReportsSent,
+                (double)m_LatencyTotalUs / m_ReportsSent,
+                percentileUs(50),
+                percentileUs(99),
+                (unsigned long long)m_LatencyMaxUs);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QSet>
+
+#include "SDL_compat.h"
+
+struct input_event;
+
+/**
+ * @brief Relative mouse input read straight from Linux evdev devices.
+ *
+ * SDL delivers mouse input on the main thread, where it competes with window
+ * events, overlay updates and dialogs. With 1-8 kHz mice that adds latency
+ * and jitter, so this reads all mice from /dev/input on a dedicated thread
+ * running at real-time priority and sends each report to the host as soon
+ * as the kernel delivers it. SDL remains responsible for focus and capture;
+ * events are only forwarded while the input handler says the mouse is
+ * captured in relative mode.
+ *
+ * Enabled with EVDEV_MOUSE=1. The user needs read access to the event
+ * devices (usually membership in the input group).
+ *
+ * Setting EVDEV_MOUSE_REPLAY to a file of raw input_event records (as
+ * captured with "cat /dev/input/eventN > file") replays those instead of
+ * reading devices, using the recorded timing. Together with the latency
+ * statistics logged on shutdown, this measures event-to-send latency
+ * reproducibly.
+ */
+class EvdevMouse
+{
+public:
+    explicit EvdevMouse(bool swapMouseButtons, bool reverseScrollDirection);
+    ~EvdevMouse();
+
+    // Returns nullptr if evdev mouse input is disabled or unavailable
+    static EvdevMouse* create(bool swapMouseButtons, bool reverseScrollDirection);
+
+    bool start();
+
+    void stop();
+
+    // Set by the input handler whenever the capture state changes. Once this
+    // returns false, held buttons have been released and nothing more is sent.
+    void setForwarding(bool forwarding);
+
+    // True if mouse input is being sent by us rather than SDL
+    bool isForwarding();
+
+private:
+    struct Device {
+        int fd;
+        bool hasHiResWheel;
+    };
+
+    static int inputThreadProc(void* context);
+
+    void raiseThreadPriority();
+
+    void scanDevices();
+
+    void closeDevices();
+
+    void runDevices();
+
+    void runReplay();
+
+    void handleEvent(const input_event& event, bool hasHiResWheel, uint64_t eventTimeUs);
+
+    void wakeThread();
+
+    void clearWakeFd();
+
+    void flushReport(uint64_t nowUs);
+
+    // Must be called with m_SendLock held
+    void releaseButtons();
+
+    void addLatencySample(uint64_t latencyUs);
+
+    void logStats();
+
+    bool m_SwapMouseButtons;
+    bool m_ReverseScrollDirection;
+    QByteArray m_ReplayPath;
+
+    SDL_Thread* m_Thread;
+    int m_WakeFd;
+    QAtomicInt m_Stopping;
+    QAtomicInt m_Forwarding;
+    QAtomicInt m_DeviceCount;
+
+    // Held while sending, so setForwarding() can release the buttons
+    // without racing a press from the input thread
+    QMutex m_SendLock;
+    int m_ButtonsDown;
+
+    // Only touched by the input thread
+    QMap<QByteArray, Device> m_Devices;
+    QSet<QByteArray> m_RejectedPaths;
+    int m_PendingDeltaX;
+    int m_PendingDeltaY;
+    int m_PendingScroll;
+    int m_PendingHScroll;
+    uint64_t m_PendingEventTimeUs;
+
+    // Event-to-send latency in 10 us buckets, plus one for anything slower
+    static const int k_LatencyBucketUs = 10;
+    static const int k_LatencyBucketCount = 2001;
+    uint32_t m_LatencyHistogram[k_LatencyBucketCount];
+    uint64_t m_LatencyTotalUs;
+    uint64_t m_LatencyMaxUs;
+    uint32_t m_ReportsSent;
+};
@@ -763,6 +763,9 @@ void SdlInputHandler::handleJoystickArrivalEvent(SDL_JoyDeviceEvent* event)
 {
     SDL_assert(event->type == SDL_JOYDEVICEADDED);
 
+    // Load the mapping for this joystick if it wasn't attached when we started
+    MappingManager::applyMappingsForJoystick(event->which);
+
     if (!SDL_IsGameController(event->which)) {
         char guidStr[33];
         SDL_JoystickGetGUIDString(SDL_JoystickGetDeviceGUID(event->which),
@@ -32,8 +32,13 @@ SdlInputHandler::SdlInputHandler(StreamingPreferences& prefs, int streamWidth, i
       m_RightButtonReleaseTimer(0),
       m_DragTimer(0),
       m_DragButton(0),
-      m_NumFingersDown(0)
+      m_NumFingersDown(0),
+      m_ConnectionRestarting(false)
 {
+#ifdef Q_OS_LINUX
+    m_EvdevMouse = EvdevMouse::create(prefs.swapMouseButtons, prefs.reverseScrollDirection);
+#endif
+
     // System keys are always captured when running without a DE
     if (!WMUtils::isRunningDesktopEnvironment()) {
         m_CaptureSystemKeysMode = StreamingPreferences::CSK_ALWAYS;
@@ -199,6 +204,10 @@ SdlInputHandler::SdlInputHandler(StreamingPreferences& prefs, int streamWidth, i
 
 SdlInputHandler::~SdlInputHandler()
 {
+#ifdef Q_OS_LINUX
+    delete m_EvdevMouse;
+#endif
+
     for (int i = 0; i < MAX_GAMEPADS; i++) {
         if (m_GamepadState[i].mouseEmulationTimer != 0) {
             Session::get()->notifyMouseEmulationMode(false);
@@ -251,6 +260,28 @@ void SdlInputHandler::setWindow(SDL_Window *window)
     m_Window = window;
 }
 
+void SdlInputHandler::setStreamDimensions(int streamWidth, int streamHeight)
+{
+    m_StreamWidth = streamWidth;
+    m_StreamHeight = streamHeight;
+
+    // The stream's position in the window may have changed
+    updatePointerRegionLock();
+}
+
+void SdlInputHandler::setConnectionRestarting(bool restarting)
+{
+    if (restarting) {
+        // The new connection won't know these keys were down
+        raiseAllKeys();
+    }
+
+    m_ConnectionRestarting = restarting;
+
+    // The evdev thread sends mouse input directly
+    updateRawMouseState();
+}
+
 void SdlInputHandler::raiseAllKeys()
 {
     if (m_KeysDown.isEmpty()) {
@@ -302,6 +333,8 @@ void SdlInputHandler::notifyFocusLost()
     // used in shortcuts that cause focus loss (such as Alt+Tab) may get stuck down.
     raiseAllKeys();
 
+    updateRawMouseState();
+
 #ifdef Q_OS_WIN32
     // Re-enable text input when window loses focus as a workaround for an SDL bug.
     // See #1617 for details.
@@ -311,6 +344,8 @@ void SdlInputHandler::notifyFocusLost()
 
 void SdlInputHandler::notifyFocusGained()
 {
+    updateRawMouseState();
+
 #ifdef Q_OS_WIN32
     // Disable text input when window gains focus to prevent IME popup interference.
     // See #1617 for details.
@@ -434,6 +469,30 @@ void SdlInputHandler::setCaptureActive(bool active)
 
     // Now update the keyboard grab
     updateKeyboardGrabState();
+
+    updateRawMouseState();
+}
+
+void SdlInputHandler::updateRawMouseState()
+{
+#ifdef Q_OS_LINUX
+    if (m_EvdevMouse != nullptr) {
+        m_EvdevMouse->setForwarding(m_Window != nullptr &&
+                                    !m_ConnectionRestarting &&
+                                    !m_AbsoluteMouseMode &&
+                                    isCaptureActive() &&
+                                    (SDL_GetWindowFlags(m_Window) & SDL_WINDOW_INPUT_FOCUS));
+    }
+#endif
+}
+
+bool SdlInputHandler::isRawMouseActive()
+{
+#ifdef Q_OS_LINUX
+    return m_EvdevMouse != nullptr && m_EvdevMouse->isForwarding();
+#else
+    return false;
+#endif
 }
 
 void SdlInputHandler::handleTouchFingerEvent(SDL_TouchFingerEvent* event)
@@ -5,6 +5,10 @@
 
 #include "SDL_compat.h"
 
+#ifdef Q_OS_LINUX
+#include "evdevmouse.h"
+#endif
+
 struct GamepadState {
     SDL_GameController* controller;
     SDL_JoystickID jsId;
@@ -90,6 +94,13 @@ public:
 
     void setWindow(SDL_Window* window);
 
+    // Called when the video stream is reconfigured for a new mode
+    void setStreamDimensions(int streamWidth, int streamHeight);
+
+    // Called around restarting the connection. Input that isn't routed
+    // through the session's event loop stops while it's restarting.
+    void setConnectionRestarting(bool restarting);
+
     void handleKeyEvent(SDL_KeyboardEvent* event);
 
     void handleMouseButtonEvent(SDL_MouseButtonEvent* event);
@@ -152,6 +163,10 @@ public:
 
     void updatePointerRegionLock();
 
+    // Hands relative mouse input to the evdev thread while we have
+    // capture and focus, and back to SDL otherwise
+    void updateRawMouseState();
+
     static
     QString getUnmappedGamepads();
 
@@ -193,6 +208,9 @@ private:
     static
     Uint32 mouseEmulationTimerCallback(Uint32 interval, void* param);
 
+    // True if mouse input is being sent by the evdev thread instead of SDL
+    bool isRawMouseActive();
+
     static
     Uint32 releaseLeftButtonTimerCallback(Uint32 interval, void* param);
 
@@ -246,6 +264,11 @@ private:
     SDL_TimerID m_DragTimer;
     char m_DragButton;
     int m_NumFingersDown;
+    bool m_ConnectionRestarting;
+
+#ifdef Q_OS_LINUX
+    EvdevMouse* m_EvdevMouse;
+#endif
 
     static const int k_ButtonMap[];
 };
@@ -30,6 +30,10 @@ void SdlInputHandler::handleMouseButtonEvent(SDL_MouseButtonEvent* event)
         // Ignore button presses outside the video region, but allow button releases
         return;
     }
+    else if (isRawMouseActive()) {
+        // The evdev thread already sent this
+        return;
+    }
 
     switch (event->button)
     {
@@ -78,6 +82,10 @@ void SdlInputHandler::handleMouseMotionEvent(SDL_MouseMotionEvent* event)
         // Ignore synthetic mouse events
         return;
     }
+    else if (isRawMouseActive()) {
+        // The evdev thread already sent this
+        return;
+    }
 
     // Batch all pending mouse motion events to save CPU time
     Sint32 x = event->x, y = event->y, xrel = event->xrel, yrel = event->yrel;
@@ -164,6 +172,10 @@ void SdlInputHandler::handleMouseWheelEvent(SDL_MouseWheelEvent* event)
         // Ignore synthetic mouse events
         return;
     }
+    else if (isRawMouseActive()) {
+        // The evdev thread already sent this
+        return;
+    }
 
     if (m_AbsoluteMouseMode) {
         int mouseX, mouseY;
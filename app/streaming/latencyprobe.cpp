@@ -0,0 +1,212 @@
+#include "latencyprobe.h"
+
+#include <Limelight.h>
+
+#include <QMutexLocker>
+#include <QRandomGenerator>
+
+#include <algorithm>
+
+// Minimum interval between markers. A random amount of up to
+// MARKER_JITTER_MS is added to avoid phase-locking with the
+// host's capture cadence.
+#define MARKER_INTERVAL_MS 500
+#define MARKER_JITTER_MS 250
+
+// Markers that don't produce a visible change in this time are missed
+#define MARKER_TIMEOUT_MS 1000
+
+// Change in mean luma of the probe region that counts as the host's response
+#define LUMA_THRESHOLD 64
+
+LatencyProbe::LatencyProbe(StreamingPreferences::LatencyTestMode mode)
+    : m_Mode(mode),
+      m_Thread(nullptr),
+      m_Stopping(false),
+      m_State(StateNeedBaseline),
+      m_BaselineLuma(0),
+      m_MarkerSentUs(0),
+      m_MarkersSent(0),
+      m_MarkersMissed(0)
+{
+    SDL_assert(mode != StreamingPreferences::LTM_OFF);
+}
+
+LatencyProbe::~LatencyProbe()
+{
+    stop();
+}
+
+bool LatencyProbe::start()
+{
+    SDL_assert(m_Thread == nullptr);
+
+    m_Stopping = false;
+    m_Thread = SDL_CreateThread(LatencyProbe::probeThreadProc, "LatencyProbe", this);
+    if (m_Thread == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to create latency probe thread: %s",
+                     SDL_GetError());
+        return false;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Latency test started using %s markers",
+                m_Mode == StreamingPreferences::LTM_GAMEPAD ? "gamepad" : "text");
+    return true;
+}
+
+void LatencyProbe::stop()
+{
+    if (m_Thread == nullptr) {
+        return;
+    }
+
+    m_Lock.lock();
+    m_Stopping = true;
+    m_StateChanged.wakeAll();
+    m_Lock.unlock();
+
+    SDL_WaitThread(m_Thread, nullptr);
+    m_Thread = nullptr;
+}
+
+bool LatencyProbe::wantsSample()
+{
+    QMutexLocker locker(&m_Lock);
+    return m_State != StateIdle;
+}
+
+void LatencyProbe::submitLuma(int luma, uint64_t presentTimeUs)
+{
+    QMutexLocker locker(&m_Lock);
+
+    switch (m_State) {
+    case StateNeedBaseline:
+        m_BaselineLuma = luma;
+        m_State = StateIdle;
+        m_StateChanged.wakeAll();
+        break;
+
+    case StatePending:
+        if (qAbs(luma - m_BaselineLuma) >= LUMA_THRESHOLD && presentTimeUs > m_MarkerSentUs) {
+            m_SamplesUs.append((uint32_t)(presentTimeUs - m_MarkerSentUs));
+
+            // The new patch state becomes the baseline for the next marker
+            m_BaselineLuma = luma;
+            m_State = StateIdle;
+            m_StateChanged.wakeAll();
+        }
+        break;
+
+    case StateIdle:
+        break;
+    }
+}
+
+void LatencyProbe::sendMarker(int sequence, bool down)
+{
+    switch (m_Mode) {
+    case StreamingPreferences::LTM_TEXT:
+        if (down) {
+            char text[16];
+            SDL_snprintf(text, sizeof(text), "%d\n", sequence);
+            LiSendUtf8TextEvent(text, (unsigned int)strlen(text));
+        }
+        break;
+
+    case StreamingPreferences::LTM_GAMEPAD:
+        LiSendMultiControllerEvent(0, 0x1, down ? A_FLAG : 0, 0, 0, 0, 0, 0, 0);
+        break;
+
+    default:
+        SDL_assert(false);
+        break;
+    }
+}
+
+int LatencyProbe::probeThreadProc(void* context)
+{
+    LatencyProbe* me = reinterpret_cast<LatencyProbe*>(context);
+
+    QMutexLocker locker(&me->m_Lock);
+
+    for (int sequence = 1; !me->m_Stopping; sequence++) {
+        me->m_StateChanged.wait(&me->m_Lock, (unsigned long)(MARKER_INTERVAL_MS + QRandomGenerator::global()->bounded(MARKER_JITTER_MS)));
+        if (me->m_Stopping) {
+            break;
+        }
+        else if (me->m_State != StateIdle) {
+            // We can't send a marker until we've seen the probe region at least once
+            continue;
+        }
+
+        me->m_State = StatePending;
+        me->m_MarkersSent++;
+        me->m_MarkerSentUs = LiGetMicroseconds();
+        locker.unlock();
+
+        me->sendMarker(sequence, true);
+
+        locker.relock();
+
+        uint64_t deadlineUs = me->m_MarkerSentUs + MARKER_TIMEOUT_MS * 1000;
+        while (me->m_State == StatePending && !me->m_Stopping) {
+            uint64_t nowUs = LiGetMicroseconds();
+            if (nowUs >= deadlineUs) {
+                break;
+            }
+
+            me->m_StateChanged.wait(&me->m_Lock, (unsigned long)((deadlineUs - nowUs + 999) / 1000));
+        }
+
+        if (me->m_State == StatePending) {
+            // Resample the baseline in case the response arrived just after the timeout
+            me->m_MarkersMissed++;
+            me->m_State = StateNeedBaseline;
+        }
+
+        locker.unlock();
+        me->sendMarker(sequence, false);
+        locker.relock();
+    }
+
+    return 0;
+}
+
+void LatencyProbe::logResults()
+{
+    QMutexLocker locker(&m_Lock);
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Latency test: %d markers sent, %d missed, %d samples",
+                m_MarkersSent,
+                m_MarkersMissed,
+                (int)m_SamplesUs.size());
+
+    if (m_SamplesUs.isEmpty()) {
+        return;
+    }
+
+    QVector<uint32_t> sorted = m_SamplesUs;
+    std::sort(sorted.begin(), sorted.end());
+
+    uint64_t totalUs = 0;
+    for (uint32_t sampleUs : sorted) {
+        totalUs += sampleUs;
+    }
+
+    auto percentileMs = [&sorted](int percentile) {
+        int index = (int)(((int64_t)(sorted.size() - 1) * percentile) / 100);
+        return sorted[index] / 1000.0;
+    };
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Glass-to-glass latency: min %.1f ms, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms, mean %.1f ms",
+                sorted.first() / 1000.0,
+                percentileMs(50),
+                percentileMs(90),
+                percentileMs(99),
+                sorted.last() / 1000.0,
+                (double)totalUs / sorted.size() / 1000.0);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "settings/streamingpreferences.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+
+#include "SDL_compat.h"
+
+/**
+ * @brief Measures glass-to-glass latency by injecting input markers and
+ * watching for the host's visual response in the decoded video.
+ *
+ * A probe thread periodically sends a marker through the input stream
+ * (a UTF-8 text event carrying the marker sequence number, or a gamepad
+ * A button press). The host is expected to run a test app that flips the
+ * brightness of the top-left corner of the screen each time it receives a
+ * marker. The render path samples the mean luma of that corner for each
+ * presented frame while a marker is outstanding, and the time between
+ * sending the marker and presenting the first frame whose luma crossed the
+ * threshold is recorded as one round-trip sample.
+ *
+ * Only one marker is in flight at a time. Markers that don't produce a
+ * visible change within a timeout are counted as missed.
+ *
+ * wantsSample() and submitLuma() are called from the render thread, the
+ * rest from the main thread.
+ */
+class LatencyProbe
+{
+public:
+    // Size in pixels of the square region sampled at the top-left corner of the frame
+    static const int k_RegionSize = 16;
+
+    explicit LatencyProbe(StreamingPreferences::LatencyTestMode mode);
+    ~LatencyProbe();
+
+    bool start();
+
+    void stop();
+
+    // Returns true if the render path should sample the next presented frame
+    bool wantsSample();
+
+    // Reports the mean luma (0-255) of the probe region for a frame presented at presentTimeUs
+    void submitLuma(int luma, uint64_t presentTimeUs);
+
+    // Logs the round-trip latency distribution collected so far
+    void logResults();
+
+private:
+    enum State {
+        StateNeedBaseline,
+        StateIdle,
+        StatePending,
+    };
+
+    static int probeThreadProc(void* context);
+
+    void sendMarker(int sequence, bool down);
+
+    StreamingPreferences::LatencyTestMode m_Mode;
+    SDL_Thread* m_Thread;
+    bool m_Stopping;
+
+    QMutex m_Lock;
+    QWaitCondition m_StateChanged;
+    State m_State;
+    int m_BaselineLuma;
+    uint64_t m_MarkerSentUs;
+    int m_MarkersSent;
+    int m_MarkersMissed;
+    QVector<uint32_t> m_SamplesUs;
+};
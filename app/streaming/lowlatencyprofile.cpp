@@ -0,0 +1,273 @@
+#include "lowlatencyprofile.h"
+
+#include <QMutexLocker>
+
+#include "SDL_compat.h"
+
+#if defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#define DEFAULT_BUSY_POLL_US 50
+#define DEFAULT_RECEIVE_BUFFER_SIZE (8 * 1024 * 1024)
+
+#ifdef Q_OS_LINUX
+// Kept low so we never outrank kernel threads like IRQ handlers (50), but ordered
+// so packet reception wins over rendering, which wins over decoding.
+static const int k_FifoPriority[LowLatencyProfile::TR_COUNT] = { 3, 1, 2 };
+#endif
+
+static const char* const k_RoleNames[LowLatencyProfile::TR_COUNT] = { "NETWORK", "DECODE", "RENDER" };
+
+LowLatencyProfile::LowLatencyProfile()
+    : m_Enabled(false),
+      m_BusyPollUs(0),
+      m_ReceiveBufferSize(0),
+      m_Reported(false)
+{
+}
+
+void LowLatencyProfile::load()
+{
+    QMutexLocker locker(&m_Lock);
+
+    m_Enabled = qEnvironmentVariableIntValue("LOW_LATENCY_PROFILE") != 0;
+    m_ThreadReports.clear();
+    m_Reported = false;
+
+    if (!m_Enabled) {
+        return;
+    }
+
+    for (int role = 0; role < TR_COUNT; role++) {
+        m_Cpus[role] = parseCpuList(qgetenv(QString("LOW_LATENCY_%1_CPUS").arg(k_RoleNames[role]).toLatin1().constData()));
+    }
+
+    bool ok;
+    m_BusyPollUs = qEnvironmentVariableIntValue("LOW_LATENCY_BUSY_POLL_US", &ok);
+    if (!ok) {
+        m_BusyPollUs = DEFAULT_BUSY_POLL_US;
+    }
+    m_ReceiveBufferSize = qEnvironmentVariableIntValue("LOW_LATENCY_RCVBUF", &ok);
+    if (!ok) {
+        m_ReceiveBufferSize = DEFAULT_RECEIVE_BUFFER_SIZE;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Low-latency profile requested: network CPUs: %s, decode CPUs: %s, render CPUs: %s, busy poll: %d us, receive buffer: %d bytes",
+                qPrintable(cpuListToString(m_Cpus[TR_NETWORK])),
+                qPrintable(cpuListToString(m_Cpus[TR_DECODE])),
+                qPrintable(cpuListToString(m_Cpus[TR_RENDER])),
+                m_BusyPollUs,
+                m_ReceiveBufferSize);
+}
+
+bool LowLatencyProfile::isEnabled()
+{
+    return m_Enabled;
+}
+
+void LowLatencyProfile::applyToStreamConfig(PSTREAM_CONFIGURATION streamConfig)
+{
+    if (!m_Enabled) {
+        return;
+    }
+
+    streamConfig->rtpReceiveBufferSize = m_ReceiveBufferSize;
+    streamConfig->rtpBusyPollUs = m_BusyPollUs;
+}
+
+void LowLatencyProfile::applyToCurrentThread(const char* threadName, ThreadRole role)
+{
+    if (!m_Enabled) {
+        return;
+    }
+
+    QString affinity;
+    if (m_Cpus[role].isEmpty()) {
+        affinity = "unpinned";
+    }
+    else if (setCurrentThreadAffinity(m_Cpus[role])) {
+        affinity = "CPUs " + cpuListToString(m_Cpus[role]);
+    }
+    else {
+        affinity = "unpinned (pinning to CPUs " + cpuListToString(m_Cpus[role]) + " failed)";
+    }
+
+    QString report = QString("%1: %2, %3").arg(threadName, affinity, setCurrentThreadRealtime(role));
+
+    QMutexLocker locker(&m_Lock);
+
+    if (m_Reported) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Low-latency profile: %s",
+                    qPrintable(report));
+    }
+    else {
+        m_ThreadReports.append(report);
+    }
+}
+
+void LowLatencyProfile::applyToLibraryThread(const char* threadName)
+{
+    // Receive and input threads are the ones that can't afford to be preempted.
+    // The decoder thread only exists for decoders that don't pull frames themselves.
+    if (SDL_strcmp(threadName, "VideoRecv") == 0 ||
+            SDL_strcmp(threadName, "AudioRecv") == 0 ||
+            SDL_strcmp(threadName, "InputSend") == 0) {
+        applyToCurrentThread(threadName, TR_NETWORK);
+    }
+    else if (SDL_strcmp(threadName, "VideoDec") == 0) {
+        applyToCurrentThread(threadName, TR_DECODE);
+    }
+}
+
+void LowLatencyProfile::logGrantedSettings()
+{
+    if (!m_Enabled) {
+        return;
+    }
+
+    QMutexLocker locker(&m_Lock);
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Low-latency profile granted:");
+    for (const QString& report : m_ThreadReports) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "  %s",
+                    qPrintable(report));
+    }
+
+    const RTP_SOCKET_OPTIONS* socketOptions = LiGetRtpSocketOptions();
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "  Video socket: receive buffer: %d bytes, busy poll: %d us, kernel timestamps: %s",
+                socketOptions->videoReceiveBufferSize,
+                socketOptions->videoBusyPollUs,
+                socketOptions->videoKernelTimestamps ? "yes" : "no");
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "  Audio socket: receive buffer: %d bytes, busy poll: %d us",
+                socketOptions->audioReceiveBufferSize,
+                socketOptions->audioBusyPollUs);
+
+    m_ThreadReports.clear();
+    m_Reported = true;
+}
+
+QVector<int> LowLatencyProfile::parseCpuList(const QByteArray& list)
+{
+    QVector<int> cpus;
+
+    for (const QByteArray& item : list.split(',')) {
+        QList<QByteArray> range = item.trimmed().split('-');
+        bool firstOk = false, lastOk = false;
+        int first = range.first().toInt(&firstOk);
+        int last = range.last().toInt(&lastOk);
+
+        if (range.size() > 2 || !firstOk || !lastOk || first < 0 || last < first) {
+            if (!item.trimmed().isEmpty()) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Ignoring invalid CPU list entry: %s",
+                            item.constData());
+            }
+            continue;
+        }
+
+        for (int cpu = first; cpu <= last; cpu++) {
+            if (!cpus.contains(cpu)) {
+                cpus.append(cpu);
+            }
+        }
+    }
+
+    return cpus;
+}
+
+QString LowLatencyProfile::cpuListToString(const QVector<int>& cpus)
+{
+    if (cpus.isEmpty()) {
+        return "any";
+    }
+
+    QStringList list;
+    for (int cpu : cpus) {
+        list.append(QString::number(cpu));
+    }
+
+    return list.join(',');
+}
+
+bool LowLatencyProfile::setCurrentThreadAffinity(const QVector<int>& cpus)
+{
+#if defined(Q_OS_LINUX)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(Q_OS_WIN32)
+    DWORD_PTR mask = 0;
+
+    // Only the CPUs of our processor group can be used
+    for (int cpu : cpus) {
+        if (cpu < (int)(sizeof(mask) * 8)) {
+            mask |= (DWORD_PTR)1 << cpu;
+        }
+    }
+
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    // macOS only supports affinity hints, which don't pin anything
+    Q_UNUSED(cpus);
+    return false;
+#endif
+}
+
+QString LowLatencyProfile::setCurrentThreadRealtime(ThreadRole role)
+{
+#if defined(Q_OS_LINUX)
+    struct sched_param param = {};
+
+    param.sched_priority = k_FifoPriority[role];
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) {
+        return QString("SCHED_FIFO %1").arg(param.sched_priority);
+    }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    // Without CAP_SYS_NICE or an RLIMIT_RTPRIO allowance, ask rtkit (which SDL talks to for us)
+    int policy;
+    if (SDL_LinuxSetThreadPriorityAndPolicy((Sint64)syscall(SYS_gettid), SDL_THREAD_PRIORITY_TIME_CRITICAL, SCHED_FIFO) == 0 &&
+            pthread_getschedparam(pthread_self(), &policy, &param) == 0 && policy == SCHED_FIFO) {
+        return QString("SCHED_FIFO %1 (rtkit)").arg(param.sched_priority);
+    }
+#endif
+#elif defined(Q_OS_WIN32)
+    Q_UNUSED(role);
+    if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+        return "time critical priority";
+    }
+#else
+    Q_UNUSED(role);
+#endif
+
+#if SDL_VERSION_ATLEAST(2, 0, 9)
+    if (SDL_SetThreadPriority(SDL_THREAD_PRIORITY_TIME_CRITICAL) == 0) {
+        return "high priority (real-time scheduling not permitted)";
+    }
+#else
+    if (SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH) == 0) {
+        return "high priority (real-time scheduling not permitted)";
+    }
+#endif
+
+    return "default priority (real-time scheduling not permitted)";
+}
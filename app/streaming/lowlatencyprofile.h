@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+
+#include <Limelight.h>
+
+/**
+ * @brief Optional scheduling and socket tuning for the streaming threads.
+ *
+ * On a busy client, a receive thread that gets preempted for a few
+ * milliseconds is enough for the socket buffer to overflow and drop video
+ * packets. This profile moves the network, decode and render threads to
+ * real-time scheduling where the OS permits it (SCHED_FIFO directly or via
+ * rtkit on Linux, time critical priority elsewhere), optionally pins each
+ * group of threads to its own CPUs, and enables busy polling and a larger
+ * receive buffer on the RTP sockets.
+ *
+ * Enabled with LOW_LATENCY_PROFILE=1. Further configuration:
+ * - LOW_LATENCY_NETWORK_CPUS, LOW_LATENCY_DECODE_CPUS, LOW_LATENCY_RENDER_CPUS:
+ *   CPU lists like "2,3" or "4-7". Threads are left unpinned by default.
+ * - LOW_LATENCY_BUSY_POLL_US: busy polling time (default 50, 0 to disable)
+ * - LOW_LATENCY_RCVBUF: RTP socket receive buffer size in bytes (default 8 MB)
+ *
+ * Not everything requested is necessarily granted, so what actually took
+ * effect is logged once the connection is established.
+ */
+class LowLatencyProfile
+{
+public:
+    enum ThreadRole
+    {
+        TR_NETWORK,
+        TR_DECODE,
+        TR_RENDER,
+        TR_COUNT
+    };
+
+    LowLatencyProfile();
+
+    // Reads the profile from the environment
+    void load();
+
+    bool isEnabled();
+
+    // Requests the socket options of the profile from moonlight-common-c
+    void applyToStreamConfig(PSTREAM_CONFIGURATION streamConfig);
+
+    void applyToCurrentThread(const char* threadName, ThreadRole role);
+
+    // For threads created by moonlight-common-c, which are identified by name
+    void applyToLibraryThread(const char* threadName);
+
+    // Logs the thread and socket settings that were granted so far.
+    // Threads starting later are logged individually.
+    void logGrantedSettings();
+
+private:
+    static QVector<int> parseCpuList(const QByteArray& list);
+
+    static QString cpuListToString(const QVector<int>& cpus);
+
+    static bool setCurrentThreadAffinity(const QVector<int>& cpus);
+
+    static QString setCurrentThreadRealtime(ThreadRole role);
+
+    bool m_Enabled;
+    QVector<int> m_Cpus[TR_COUNT];
+    int m_BusyPollUs;
+    int m_ReceiveBufferSize;
+
+    QMutex m_Lock;
+    QStringList m_ThreadReports;
+    bool m_Reported;
+};
@@ -0,0 +1,164 @@
+#include "networkimpairment.h"
+
+#include <QStringList>
+
+#include "SDL_compat.h"
+
+#define DEFAULT_SEED 1
+
+NetworkImpairment::NetworkImpairment()
+    : m_Enabled(false)
+{
+    SDL_zero(m_Impairment);
+}
+
+bool NetworkImpairment::parse(const QString& spec, NETWORK_IMPAIRMENT* impairment, QString* errorMessage)
+{
+    SDL_zerop(impairment);
+    impairment->seed = DEFAULT_SEED;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    const QStringList entries = spec.split(',', Qt::SkipEmptyParts);
+#else
+    const QStringList entries = spec.split(',', QString::SkipEmptyParts);
+#endif
+
+    for (const QString& entry : entries) {
+        int separator = entry.indexOf('=');
+        QString key = entry.left(separator).trimmed();
+        QString value = separator >= 0 ? entry.mid(separator + 1).trimmed() : QString();
+        bool ok = false;
+
+        if (key == "seed") {
+            impairment->seed = value.toUInt(&ok);
+        }
+        else if (key == "loss" || key == "burst-loss" || key == "burst-enter" ||
+                 key == "burst-exit" || key == "reorder" || key == "duplicate") {
+            float percent = value.toFloat(&ok);
+            ok = ok && percent >= 0 && percent <= 100;
+
+            if (key == "loss") {
+                impairment->lossGoodPercent = percent;
+            }
+            else if (key == "burst-loss") {
+                impairment->lossBadPercent = percent;
+            }
+            else if (key == "burst-enter") {
+                impairment->goodToBadPercent = percent;
+            }
+            else if (key == "burst-exit") {
+                impairment->badToGoodPercent = percent;
+            }
+            else if (key == "reorder") {
+                impairment->reorderPercent = percent;
+            }
+            else {
+                impairment->duplicatePercent = percent;
+            }
+        }
+        else if (key == "reorder-delay" || key == "delay" || key == "jitter" ||
+                 key == "rate" || key == "queue") {
+            int number = value.toInt(&ok);
+            ok = ok && number >= 0;
+
+            if (key == "reorder-delay") {
+                impairment->reorderDelayMs = number;
+            }
+            else if (key == "delay") {
+                impairment->delayMs = number;
+            }
+            else if (key == "jitter") {
+                impairment->jitterMs = number;
+            }
+            else if (key == "rate") {
+                impairment->bandwidthKbps = number;
+            }
+            else {
+                impairment->queueLimitMs = number;
+            }
+        }
+        else {
+            *errorMessage = QString("Unknown network impairment: %1").arg(key);
+            return false;
+        }
+
+        if (!ok) {
+            *errorMessage = QString("Invalid network impairment value: %1").arg(entry.trimmed());
+            return false;
+        }
+    }
+
+    // Losing every packet, or loss bursts that never end, would just stop the stream
+    if (impairment->lossGoodPercent >= 100) {
+        *errorMessage = "loss must be less than 100%";
+        return false;
+    }
+    if (impairment->goodToBadPercent > 0 && impairment->badToGoodPercent <= 0) {
+        *errorMessage = "burst-enter requires burst-exit";
+        return false;
+    }
+
+    return true;
+}
+
+void NetworkImpairment::load()
+{
+    QString spec = qgetenv("NETWORK_IMPAIRMENT");
+    QString errorMessage;
+
+    m_Enabled = false;
+    SDL_zero(m_Impairment);
+
+    if (spec.isEmpty()) {
+        return;
+    }
+
+    if (!parse(spec, &m_Impairment, &errorMessage)) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Ignoring NETWORK_IMPAIRMENT: %s",
+                    qPrintable(errorMessage));
+        SDL_zero(m_Impairment);
+        return;
+    }
+
+    // moonlight-common-c logs the impairment it applies to each stream
+    m_Enabled = true;
+}
+
+bool NetworkImpairment::isEnabled()
+{
+    return m_Enabled;
+}
+
+void NetworkImpairment::applyToStreamConfig(PSTREAM_CONFIGURATION streamConfig)
+{
+    if (!m_Enabled) {
+        return;
+    }
+
+    streamConfig->networkImpairment = m_Impairment;
+}
+
+void NetworkImpairment::logStats()
+{
+    if (!m_Enabled) {
+        return;
+    }
+
+    const NETWORK_IMPAIRMENT_STATS* streamStats[] = { LiGetVideoImpairmentStats(), LiGetAudioImpairmentStats() };
+    const char* const streamNames[] = { "Video", "Audio" };
+
+    for (int i = 0; i < 2; i++) {
+        const NETWORK_IMPAIRMENT_STATS* stats = streamStats[i];
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "%s network impairment: %u packets received, %u lost, %u over bandwidth, %u reordered, %u duplicated, %.2f ms average added delay",
+                    streamNames[i],
+                    stats->packetsReceived,
+                    stats->packetsLost,
+                    stats->packetsOverBandwidth,
+                    stats->packetsReordered,
+                    stats->packetsDuplicated,
+                    stats->packetsDelivered != 0 ? (double)stats->totalAddedDelayUs / stats->packetsDelivered / 1000 : 0.0);
+    }
+}
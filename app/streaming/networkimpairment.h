@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QString>
+
+#include <Limelight.h>
+
+/**
+ * @brief Simulated network impairment for testing loss recovery.
+ *
+ * moonlight-common-c applies the impairment to the audio and video packets
+ * between the socket and the RTP queues, so every stream sees the same
+ * reproducible loss pattern on any network, including a host on localhost.
+ *
+ * Enabled with NETWORK_IMPAIRMENT (or --network-impairment) set to a
+ * comma-separated list of key=value pairs, for example
+ * "seed=7,loss=0.5,burst-loss=40,burst-enter=0.5,burst-exit=20,jitter=4":
+ * - seed: random seed (default 1)
+ * - loss: random loss in percent, below 100
+ * - burst-loss, burst-enter, burst-exit: loss in percent while in a loss
+ *   burst, and the per-packet chance in percent of a burst starting and
+ *   ending (Gilbert-Elliott model)
+ * - reorder, reorder-delay: chance in percent of a packet being held back,
+ *   and by how many ms (default 5)
+ * - duplicate: chance in percent of a packet being duplicated
+ * - delay, jitter: fixed and random added delay in ms
+ * - rate, queue: bandwidth limit in Kbps, and the longest time in ms a
+ *   packet may wait for it before it's dropped (default 200)
+ */
+class NetworkImpairment
+{
+public:
+    NetworkImpairment();
+
+    // Parses an impairment specification. Returns false and sets errorMessage
+    // if it's invalid.
+    static bool parse(const QString& spec, NETWORK_IMPAIRMENT* impairment, QString* errorMessage);
+
+    // Reads the impairment from the environment
+    void load();
+
+    bool isEnabled();
+
+    void applyToStreamConfig(PSTREAM_CONFIGURATION streamConfig);
+
+    // Logs what the impairment did to the last stream
+    void logStats();
+
+private:
+    bool m_Enabled;
+    NETWORK_IMPAIRMENT m_Impairment;
+};
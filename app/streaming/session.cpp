@@ -3,6 +3,7 @@
 #include "streaming/streamutils.h"
 #include "backend/richpresencemanager.h"
 #include "backend/nvhttp.h"
+#include "backend/systemproperties.h"
 
 #include <QThreadPool>
 
@@ -179,10 +180,11 @@ static int ResolutionDialogThread(void* data) {
 
 // Custom user event for audio initialization failure
 #define SDL_CODE_AUDIO_INIT_FAILED 107
+#define SDL_CODE_VIDEO_RECONFIGURE_COMPLETE 108
 
 CONNECTION_LISTENER_CALLBACKS Session::k_ConnCallbacks = {
     Session::clStageStarting,
-    nullptr,
+    Session::clStageComplete,
     Session::clStageFailed,
     nullptr,
     Session::clConnectionTerminated,
@@ -193,7 +195,8 @@ CONNECTION_LISTENER_CALLBACKS Session::k_ConnCallbacks = {
     Session::clRumbleTriggers,
     Session::clSetMotionEventState,
     Session::clSetControllerLED,
-    Session::clSetAdaptiveTriggers
+    Session::clSetAdaptiveTriggers,
+    Session::clThreadStarted
 };
 
 Session* Session::s_ActiveSession;
@@ -206,6 +209,18 @@ void Session::clStageStarting(int stage)
     // which happens to be the main thread, so it's cool to interact
     // with the GUI in these callbacks.
     emit s_ActiveSession->stageStarting(QString::fromLocal8Bit(LiGetStageName(stage)));
+
+    s_ActiveSession->m_StartupTimeline.beginStep(LiGetStageName(stage));
+}
+
+void Session::clStageComplete(int stage)
+{
+    s_ActiveSession->m_StartupTimeline.endStep(LiGetStageName(stage));
+}
+
+void Session::clThreadStarted(const char* threadName)
+{
+    s_ActiveSession->m_LowLatencyProfile.applyToLibraryThread(threadName);
 }
 
 void Session::clStageFailed(int stage, int errorCode)
@@ -498,6 +513,8 @@ int Session::drSubmitDecodeUnit(PDECODE_UNIT du)
     // safely return DR_OK and wait for the IDR frame request by
     // the decoder reinitialization code.
 
+    s_ActiveSession->m_StartupTimeline.markFirstDecodeUnit();
+
     if (SDL_TryLockMutex(s_ActiveSession->m_DecoderLock) == 0) {
         IVideoDecoder* decoder = s_ActiveSession->m_VideoDecoder;
         if (decoder != nullptr) {
@@ -700,6 +717,8 @@ Session::Session(NvComputer* computer, NvApp& app, StreamingPreferences *prefere
       m_ResolutionDialogPending(false),
       m_InitialDesktopWidth(0),
       m_InitialDesktopHeight(0),
+      m_VideoReconfigureThread(nullptr),
+      m_KeepAudioRenderer(false),
       m_AsyncConnectionSuccess(false),
       m_PortTestResults(0),
       m_ActiveVideoFormat(0),
@@ -711,8 +730,12 @@ Session::Session(NvComputer* computer, NvApp& app, StreamingPreferences *prefere
       m_AudioSampleCount(0),
       m_DropAudioEndTime(0),
       m_MicThread(nullptr),
-      m_MicStream(nullptr)
+      m_MicStream(nullptr),
+      m_LatencyProbe(nullptr),
+      m_BitrateController(nullptr)
 {
+    SDL_AtomicSet(&m_VideoReconfigureStartTicks, 0);
+    SDL_AtomicSet(&m_LastVideoReconfigureTimeMs, 0);
 }
 
 Session::~Session()
@@ -811,6 +834,8 @@ bool Session::initialize(QQuickWindow* qtWindow)
     m_SessionOptions.windowMode = m_Preferences->windowMode;
     m_SessionOptions.uiDisplayMode = m_Preferences->uiDisplayMode;
     m_SessionOptions.captureSysKeysMode = m_Preferences->captureSysKeysMode;
+    m_SessionOptions.latencyTestMode = m_Preferences->latencyTestMode;
+    m_SessionOptions.startupTimelineMode = m_Preferences->startupTimelineMode;
 
     // Determine if we are in Auto Resolution mode.
     //
@@ -831,6 +856,9 @@ bool Session::initialize(QQuickWindow* qtWindow)
         m_SessionOptions.isAutoResolution = false;
     }
 
+    // Don't use SDL video while the startup capability probe is still using it
+    SystemProperties::waitForVideoInfo();
+
     if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "SDL_InitSubSystem(SDL_INIT_VIDEO) failed: %s",
@@ -1551,6 +1579,8 @@ private:
                 !m_Session->m_UnexpectedTermination &&
                 m_Session->m_Preferences->quitAppAfter;
 
+        NetworkImpairment networkImpairment = m_Session->m_NetworkImpairment;
+
         // Notify the UI
         if (shouldQuit) {
             emit m_Session->quitStarting();
@@ -1585,6 +1615,9 @@ private:
         // Finish cleanup of the connection state
         LiStopConnection();
 
+        // The impairment stats outlive the connection, so they're complete now
+        networkImpairment.logStats();
+
         // Give the window manager and graphics driver a moment to cleanup resources
         // before we potentially create a new window and D3D device in the next session.
         // SDL_Delay(200);
@@ -1852,6 +1885,34 @@ void Session::toggleFullscreen()
     m_InputHandler->updatePointerRegionLock();
 }
 
+void Session::notifyFrameRendered()
+{
+    // Claim the pending reconfiguration request, if any, so we only record it once
+    int reconfigureStartTicks = SDL_AtomicGet(&m_VideoReconfigureStartTicks);
+    if (reconfigureStartTicks != 0 && SDL_AtomicCAS(&m_VideoReconfigureStartTicks, reconfigureStartTicks, 0)) {
+        int reconfigureTimeMs = (int)(SDL_GetTicks() - (Uint32)reconfigureStartTicks);
+        SDL_AtomicSet(&m_LastVideoReconfigureTimeMs, reconfigureTimeMs);
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "First frame in the new video mode rendered %d ms after the request",
+                    reconfigureTimeMs);
+    }
+
+    if (!m_StartupTimeline.markFirstFrame()) {
+        return;
+    }
+
+    if (m_SessionOptions.startupTimelineMode) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Ending session after the first frame for startup timeline mode");
+
+        SDL_Event event;
+        event.type = SDL_QUIT;
+        event.quit.timestamp = SDL_GetTicks();
+        SDL_PushEvent(&event);
+    }
+}
+
 void Session::notifyMouseEmulationMode(bool enabled)
 {
     m_MouseEmulationRefCount += enabled ? 1 : -1;
@@ -1885,6 +1946,74 @@ public:
     Session* m_Session;
 };
 
+// GameStream fixes the video mode during the RTSP handshake, so a new mode needs
+// a new connection to the host. This does only that part, leaving the session's
+// window, input handler and decoder capabilities in place, then lets the event
+// loop know so it can create a decoder for the new mode.
+class VideoReconfigureThread : public QThread
+{
+public:
+    VideoReconfigureThread(Session* session) :
+        QThread(nullptr),
+        m_Session(session)
+    {
+        setObjectName("Video Reconfig");
+    }
+
+    void run() override
+    {
+        // The audio stream restarts with the connection, but the audio device
+        // can stay open if the host sends the same audio format again.
+        m_Session->m_KeepAudioRenderer = true;
+        LiStopConnection();
+        m_Session->m_KeepAudioRenderer = false;
+
+        m_Session->m_AsyncConnectionSuccess = m_Session->startConnectionAsync();
+        if (!m_Session->m_AsyncConnectionSuccess) {
+            // Free the audio renderer if the new connection didn't take it
+            Session::arCleanup();
+        }
+
+        SDL_Event event = {};
+        event.type = SDL_USEREVENT;
+        event.user.code = SDL_CODE_VIDEO_RECONFIGURE_COMPLETE;
+        SDL_PushEvent(&event);
+    }
+
+    Session* m_Session;
+};
+
+// Input that would be sent to the host by the session's event loop
+static bool isInputEvent(Uint32 type)
+{
+    switch (type) {
+    case SDL_KEYUP:
+    case SDL_KEYDOWN:
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    case SDL_MOUSEMOTION:
+    case SDL_MOUSEWHEEL:
+    case SDL_CONTROLLERAXISMOTION:
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP:
+#if SDL_VERSION_ATLEAST(2, 0, 14)
+    case SDL_CONTROLLERSENSORUPDATE:
+    case SDL_CONTROLLERTOUCHPADDOWN:
+    case SDL_CONTROLLERTOUCHPADUP:
+    case SDL_CONTROLLERTOUCHPADMOTION:
+#endif
+#if SDL_VERSION_ATLEAST(2, 24, 0)
+    case SDL_JOYBATTERYUPDATED:
+#endif
+    case SDL_FINGERDOWN:
+    case SDL_FINGERMOTION:
+    case SDL_FINGERUP:
+        return true;
+    default:
+        return false;
+    }
+}
+
 // Called in a non-main thread
 bool Session::startConnectionAsync()
 {
@@ -1918,9 +2047,30 @@ bool Session::startConnectionAsync()
 
     QString rtspSessionUrl;
 
+    // The reachability check and the launch request are independent round trips
+    // to the host, so run the reachability check while the host launches the app.
+    // It's only needed if we're picking the packet size ourselves.
+    QFuture<NvComputer::ReachabilityType> reachabilityFuture;
+    if (m_Preferences->packetSize == 0) {
+        NvComputer* computer = m_Computer;
+        StartupTimeline* timeline = &m_StartupTimeline;
+        reachabilityFuture = QtConcurrent::run([computer, timeline]() {
+            timeline->beginStep("Reachability check");
+            NvComputer::ReachabilityType reachability = computer->getActiveAddressReachability();
+            timeline->endStep("Reachability check");
+            return reachability;
+        });
+    }
+
+    m_StartupTimeline.beginStep("Launch app");
+
     try {
         NvHTTP http(m_Computer);
-        http.startApp(m_Computer->currentGameId != 0 ? "resume" : "launch",
+
+        // currentGameId isn't polled during the stream, so it's still 0 if we
+        // launched the app. It's running either way when reconfiguring.
+        bool resume = m_VideoReconfigureThread != nullptr || m_Computer->currentGameId != 0;
+        http.startApp(resume ? "resume" : "launch",
                       m_Computer->isNvidiaServerSoftware,
                       m_App.id, &m_StreamConfig,
                       enableGameOptimizations,
@@ -1929,20 +2079,26 @@ bool Session::startConnectionAsync()
                       !m_Preferences->multiController,
                       rtspSessionUrl);
     } catch (const GfeHttpResponseException& e) {
+        reachabilityFuture.waitForFinished();
         emit displayLaunchError(tr("Host returned error: %1").arg(e.toQString()));
         return false;
     } catch (const QtNetworkReplyException& e) {
+        reachabilityFuture.waitForFinished();
         emit displayLaunchError(e.toQString());
         return false;
     }
 
+    m_StartupTimeline.endStep("Launch app");
+
     QByteArray hostnameStr = m_Computer->activeAddress.address().toLatin1();
     QByteArray siAppVersion = m_Computer->appVersion.toLatin1();
 
     SERVER_INFORMATION hostInfo;
+    LiInitializeServerInformation(&hostInfo);
     hostInfo.address = hostnameStr.data();
     hostInfo.serverInfoAppVersion = siAppVersion.data();
     hostInfo.serverCodecModeSupport = m_Computer->serverCodecModeSupport;
+    hostInfo.preferredAddressFamily = m_Computer->preferredAddressFamily;
 
     // Older GFE versions didn't have this field
     QByteArray siGfeVersion;
@@ -1973,9 +2129,8 @@ bool Session::startConnectionAsync()
         // Use 1392 byte video packets by default
         m_StreamConfig.packetSize = 1392;
 
-        // getActiveAddressReachability() does network I/O, so we only attempt to check
-        // reachability if we've already contacted the PC successfully.
-        switch (m_Computer->getActiveAddressReachability()) {
+        // This waits for the reachability check started before the launch request
+        switch (reachabilityFuture.result()) {
         case NvComputer::RI_LAN:
             // This address is on-link, so treat it as a local address
             // even if it's not in RFC 1918 space or it's an IPv6 address.
@@ -2012,19 +2167,140 @@ bool Session::startConnectionAsync()
                                                                          false);
     }
 
+    // Opt-in bound on how long frames may wait for the decoder before the
+    // depacketizer starts skipping frames to catch up
+    m_StreamConfig.decodeLatencyBudgetMs = qEnvironmentVariableIntValue("DECODE_LATENCY_BUDGET_MS");
+    if (m_StreamConfig.decodeLatencyBudgetMs > 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Decode latency budget: %d ms",
+                    m_StreamConfig.decodeLatencyBudgetMs);
+    }
+
+    m_LowLatencyProfile.load();
+    m_LowLatencyProfile.applyToStreamConfig(&m_StreamConfig);
+
+    m_NetworkImpairment.load();
+    m_NetworkImpairment.applyToStreamConfig(&m_StreamConfig);
+
+    m_AvSyncController.load();
+
     int err = LiStartConnection(&hostInfo, &m_StreamConfig, &k_ConnCallbacks,
                                 &m_VideoCallbacks, &m_AudioCallbacks,
                                 NULL, 0, NULL, 0);
+
+    // Remember the address family that connected, so the next
+    // connection to this host tries it first
+    if (hostInfo.preferredAddressFamily != m_Computer->preferredAddressFamily) {
+        {
+            QWriteLocker lock(&m_Computer->lock);
+            m_Computer->preferredAddressFamily = hostInfo.preferredAddressFamily;
+        }
+
+        emit preferredAddressFamilyChanged();
+    }
+
     if (err != 0) {
         // We already displayed an error dialog in the stage failure
         // listener.
         return false;
     }
 
-    emit connectionStarted();
+    m_LowLatencyProfile.logGrantedSettings();
+
+    // The UI has already been torn down if we're just changing the video mode
+    if (m_VideoReconfigureThread == nullptr) {
+        emit connectionStarted();
+    }
     return true;
 }
 
+void Session::reconfigureVideo(int width, int height)
+{
+    if (m_VideoReconfigureThread != nullptr) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Ignoring video reconfiguration request while another is in progress");
+        return;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Reconfiguring video stream from %dx%d to %dx%d",
+                m_StreamConfig.width, m_StreamConfig.height,
+                width, height);
+
+    // The new mode starts at the full bitrate, not one the bitrate controller
+    // lowered for the old mode
+    int bitrateKbps = m_BitrateController != nullptr ?
+                          m_BitrateController->getMaxBitrateKbps() : m_StreamConfig.bitrate;
+
+    // Move the bitrate to the default for the new mode, unless the user picked their own
+    if (bitrateKbps == StreamingPreferences::getDefaultBitrate(m_StreamConfig.width,
+                                                               m_StreamConfig.height,
+                                                               m_StreamConfig.fps,
+                                                               m_Preferences->enableYUV444)) {
+        bitrateKbps = StreamingPreferences::getDefaultBitrate(width,
+                                                              height,
+                                                              m_StreamConfig.fps,
+                                                              m_Preferences->enableYUV444);
+    }
+
+    m_StreamConfig.bitrate = bitrateKbps;
+    m_StreamConfig.width = width;
+    m_StreamConfig.height = height;
+    m_InputHandler->setStreamDimensions(width, height);
+
+    // Congestion learned at the old mode doesn't apply to the new one
+    if (m_BitrateController != nullptr) {
+        delete m_BitrateController;
+        m_BitrateController = new BitrateController(bitrateKbps);
+    }
+
+    restartConnection();
+}
+
+void Session::reconfigureBitrate(int bitrateKbps)
+{
+    if (m_VideoReconfigureThread != nullptr) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Ignoring bitrate change while a video reconfiguration is in progress");
+        return;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Reconfiguring video stream from %d to %d Kbps",
+                m_StreamConfig.bitrate,
+                bitrateKbps);
+
+    m_StreamConfig.bitrate = bitrateKbps;
+
+    restartConnection();
+}
+
+void Session::restartConnection()
+{
+    // Use 1 if the tick counter happens to be 0, since that means no request is pending
+    Uint32 startTicks = SDL_GetTicks();
+    SDL_AtomicSet(&m_VideoReconfigureStartTicks, startTicks != 0 ? (int)startTicks : 1);
+
+    // The decoder must be gone before LiStopConnection(), since its
+    // threads are waiting on the connection for more frames.
+    SDL_LockMutex(m_DecoderLock);
+    delete m_VideoDecoder;
+    m_VideoDecoder = nullptr;
+    SDL_UnlockMutex(m_DecoderLock);
+
+    // The connection stats it samples are reset by the restart
+    if (m_BitrateController != nullptr) {
+        m_BitrateController->stop();
+    }
+
+    // Input stops until the new connection is up. Events are dropped by the
+    // event loop, since the connection is torn down and restarted underneath it.
+    m_InputHandler->setConnectionRestarting(true);
+
+    m_VideoReconfigureThread = new VideoReconfigureThread(this);
+    m_VideoReconfigureThread->start();
+}
+
 void Session::flushWindowEvents()
 {
     // Pump events to ensure all pending OS events are posted
@@ -2113,6 +2389,8 @@ void Session::start()
     // We're now active
     s_ActiveSession = this;
 
+    m_StartupTimeline.reset();
+
     // Initialize the gamepad code with our preferences
     // NB: m_InputHandler must be initialize before starting the connection.
     m_InputHandler = new SdlInputHandler(*m_Preferences, m_StreamConfig.width, m_StreamConfig.height);
@@ -2228,6 +2506,8 @@ void Session::exec()
     std::string windowName = QString(m_Computer->name + " - DancherLink").toStdString();
 #endif
 
+    m_StartupTimeline.beginStep("Create window");
+
     if (s_SharedWindow) {
         m_Window = s_SharedWindow;
         SDL_SetWindowTitle(m_Window, windowName.c_str());
@@ -2278,6 +2558,8 @@ void Session::exec()
         s_SharedWindow = m_Window;
     }
 
+    m_StartupTimeline.endStep("Create window");
+
     // HACK: Remove once proper Dark Mode support lands in SDL
 #ifdef Q_OS_WIN32
     if (m_QtWindow != nullptr) {
@@ -2407,6 +2689,24 @@ void Session::exec()
     // Toggle the stats overlay if requested by the user
     m_OverlayManager.setOverlayState(Overlay::OverlayDebug, m_Preferences->showPerformanceOverlay);
 
+    // Start injecting latency test markers if requested
+    if (m_SessionOptions.latencyTestMode != StreamingPreferences::LTM_OFF) {
+        m_LatencyProbe = new LatencyProbe(m_SessionOptions.latencyTestMode);
+        if (!m_LatencyProbe->start()) {
+            delete m_LatencyProbe;
+            m_LatencyProbe = nullptr;
+        }
+    }
+
+    // Adapt the bitrate to congestion by restarting the connection when needed
+    if (qEnvironmentVariableIntValue("EXPERIMENTAL_BITRATE_CONTROLLER") != 0) {
+        m_BitrateController = new BitrateController(m_StreamConfig.bitrate);
+        if (!m_BitrateController->start(m_StreamConfig.bitrate)) {
+            delete m_BitrateController;
+            m_BitrateController = nullptr;
+        }
+    }
+
     // Switch to async logging mode when we enter the SDL loop
     StreamUtils::enterAsyncLoggingMode();
 
@@ -2474,6 +2774,11 @@ void Session::exec()
             continue;
         }
 #endif
+        // Nothing can be sent while the connection is restarted for a new video mode
+        if (m_VideoReconfigureThread != nullptr && isInputEvent(event.type)) {
+            continue;
+        }
+
         switch (event.type) {
         case SDL_QUIT:
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
@@ -2594,12 +2899,12 @@ void Session::exec()
                          // Only handle the button action if it's the latest generation
                          int buttonid = (int)(intptr_t)event.user.data1;
                          if (buttonid == 1) { // Restart
-                             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Restarting stream due to resolution change");
+                             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Reconfiguring video stream due to resolution change");
                              SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Switching to resolution %dx%d",
                                          ctxReceived->width, ctxReceived->height);
                              
-                             // If restarting, we don't need to update preferences for "Auto" mode
-                             // because "Auto" implies we should just redetect the screen resolution
+                             // We don't need to update preferences for "Auto" mode because
+                             // "Auto" implies we should just redetect the screen resolution
                              // on the next start.
                              //
                              // The previous logic incorrectly updated m_Preferences which persisted
@@ -2607,11 +2912,15 @@ void Session::exec()
                              // 1. The next session sees 0x0 (Auto)
                              // 2. It performs standard screen detection (which is correct for device changes)
                              
-                             m_RestartRequest = true;
-                             interrupt();
-                         } else {
-                             // If ignored (or closed), we should also restore the window focus
-                             // because the dialog stole it.
+                             //
+                             // Only the connection is re-established for the new mode. The window,
+                             // input state and decoder capabilities stay as they are.
+                             reconfigureVideo(ctxReceived->width, ctxReceived->height);
+                         }
+
+                         {
+                             // Whether we're reconfiguring or the prompt was ignored (or closed),
+                             // restore the window focus because the dialog stole it.
                              SDL_RaiseWindow(m_Window);
                              if (m_IsFullScreen) {
                                  SDL_SetWindowFullscreen(m_Window, m_FullScreenFlag);
@@ -2735,6 +3044,48 @@ void Session::exec()
                             "Session exit requested");
                 goto DispatchDeferredCleanup;
             
+            case SDL_CODE_VIDEO_RECONFIGURE_COMPLETE:
+                // This may be left over from a reconfiguration we waited for during cleanup
+                if (m_VideoReconfigureThread == nullptr) {
+                    break;
+                }
+
+                m_VideoReconfigureThread->wait();
+                delete m_VideoReconfigureThread;
+                m_VideoReconfigureThread = nullptr;
+                m_InputHandler->setConnectionRestarting(false);
+
+                if (!m_AsyncConnectionSuccess) {
+                    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                                 "Failed to restart the stream with the new video mode");
+                    SDL_AtomicSet(&m_VideoReconfigureStartTicks, 0);
+                    m_UnexpectedTermination = true;
+                    goto DispatchDeferredCleanup;
+                }
+
+                if (m_BitrateController != nullptr && !m_BitrateController->start(m_StreamConfig.bitrate)) {
+                    delete m_BitrateController;
+                    m_BitrateController = nullptr;
+                }
+
+                {
+                    // drSetup() has recorded the new video mode, so create a decoder
+                    // for it the same way we do after a render device reset.
+                    SDL_Event resetEvent = {};
+                    resetEvent.type = SDL_RENDER_TARGETS_RESET;
+                    SDL_PushEvent(&resetEvent);
+                }
+                break;
+
+            case SDL_CODE_BITRATE_RECONFIGURE:
+                // The controller is dropped if it fails to restart with the connection
+                if (m_BitrateController == nullptr) {
+                    break;
+                }
+
+                reconfigureBitrate((int)(intptr_t)event.user.data1);
+                break;
+
             case SDL_CODE_AUDIO_INIT_FAILED:
                 SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                              "Audio initialization failed, aborting session");
@@ -3093,6 +3444,11 @@ void Session::exec()
                 break;
             }
 
+            // We'll create a decoder once the connection for the new video mode is up
+            if (m_VideoReconfigureThread != nullptr) {
+                break;
+            }
+
             // Allow the renderer to handle the state change without being recreated
             if (m_VideoDecoder) {
                 bool forceRecreation = false;
@@ -3194,6 +3550,7 @@ void Session::exec()
 
                 // Choose a new decoder (hopefully the same one, but possibly
                 // not if a GPU was removed or something).
+                m_StartupTimeline.beginStep("Create decoder");
                 if (!chooseDecoder(m_Preferences->videoDecoderSelection,
                                    m_Window, m_ActiveVideoFormat, m_ActiveVideoWidth,
                                    m_ActiveVideoHeight, m_ActiveVideoFrameRate,
@@ -3207,6 +3564,7 @@ void Session::exec()
                     emit displayLaunchError(tr("Unable to initialize video decoder. Please check your streaming settings and try again."));
                     goto DispatchDeferredCleanup;
                 }
+                m_StartupTimeline.endStep("Create decoder");
 
                 // As of SDL 2.0.12, SDL_RecreateWindow() doesn't carry over mouse capture
                 // or mouse hiding state to the new window. By capturing after the decoder
@@ -3293,6 +3651,14 @@ void Session::exec()
     }
 
 DispatchDeferredCleanup:
+    // Don't race a video reconfiguration that's still connecting
+    if (m_VideoReconfigureThread != nullptr) {
+        LiInterruptConnection();
+        m_VideoReconfigureThread->wait();
+        delete m_VideoReconfigureThread;
+        m_VideoReconfigureThread = nullptr;
+    }
+
 #ifdef Q_OS_WIN32
     // Increment the generation counter to invalidate any pending dialog threads
     // that haven't shown their message box yet.
@@ -3315,6 +3681,15 @@ DispatchDeferredCleanup:
     }
 #endif
 
+    // Stop sending latency test markers. The probe itself must
+    // outlive the decoder, since the pacer feeds samples to it.
+    if (m_LatencyProbe != nullptr) {
+        m_LatencyProbe->stop();
+    }
+
+    delete m_BitrateController;
+    m_BitrateController = nullptr;
+
     if (m_MicThread != nullptr) {
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                     "Stopping microphone stream (async)");
@@ -3388,6 +3763,14 @@ DispatchDeferredCleanup:
     m_VideoDecoder = nullptr;
     SDL_UnlockMutex(m_DecoderLock);
 
+    m_AvSyncController.logResults();
+
+    if (m_LatencyProbe != nullptr) {
+        m_LatencyProbe->logResults();
+        delete m_LatencyProbe;
+        m_LatencyProbe = nullptr;
+    }
+
     // Hide the window now that the decoder is destroyed
     if (!m_RestartRequest) {
         SDL_HideWindow(m_Window);
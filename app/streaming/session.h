@@ -12,6 +12,12 @@
 #include "video/decoder.h"
 #include "audio/renderers/renderer.h"
 #include "video/overlaymanager.h"
+#include "latencyprobe.h"
+#include "bitratecontroller.h"
+#include "startuptimeline.h"
+#include "lowlatencyprofile.h"
+#include "networkimpairment.h"
+#include "avsynccontroller.h"
 
 class SupportedVideoFormatList : public QList<int>
 {
@@ -98,6 +104,7 @@ class Session : public QObject
     friend class SdlInputHandler;
     friend class DeferredSessionCleanupTask;
     friend class AsyncConnectionStartThread;
+    friend class VideoReconfigureThread;
 
 public:
     // Configuration for the current session.
@@ -138,6 +145,8 @@ public:
         StreamingPreferences::WindowMode windowMode;
         StreamingPreferences::UIDisplayMode uiDisplayMode;
         StreamingPreferences::CaptureSysKeysMode captureSysKeysMode;
+        StreamingPreferences::LatencyTestMode latencyTestMode;
+        bool startupTimelineMode;
 
         // Tracks if the user's persistent preference was "Auto" (0x0).
         // This allows us to know we should perform auto-resolution logic
@@ -166,11 +175,38 @@ public:
 
     static SDL_Window* getSharedWindow() { return s_SharedWindow; }
 
+    // Returns nullptr unless a latency test was requested
+    LatencyProbe* getLatencyProbe()
+    {
+        return m_LatencyProbe;
+    }
+
+    // Returns nullptr unless the low-latency profile is enabled
+    LowLatencyProfile* getLowLatencyProfile()
+    {
+        return m_LowLatencyProfile.isEnabled() ? &m_LowLatencyProfile : nullptr;
+    }
+
+    AvSyncController& getAvSyncController()
+    {
+        return m_AvSyncController;
+    }
+
     Overlay::OverlayManager& getOverlayManager()
     {
         return m_OverlayManager;
     }
 
+    // Called by the renderer after each frame is presented
+    void notifyFrameRendered();
+
+    // Time from the last video reconfiguration request to the first
+    // frame rendered in the new mode, or 0 if there hasn't been one
+    int getLastVideoReconfigureTimeMs()
+    {
+        return SDL_AtomicGet(&m_LastVideoReconfigureTimeMs);
+    }
+
     void flushWindowEvents();
 
     void setShouldExit(bool quitHostApp = false);
@@ -197,11 +233,20 @@ signals:
 
     void launchWarningsChanged();
 
+    // Emitted when the host's persisted preferred address family changes
+    void preferredAddressFamilyChanged();
+
 private:
     void exec();
 
     bool startConnectionAsync();
 
+    void reconfigureVideo(int width, int height);
+
+    void reconfigureBitrate(int bitrateKbps);
+
+    void restartConnection();
+
     bool validateLaunch(SDL_Window* testWindow);
 
     void emitLaunchWarning(QString text);
@@ -212,6 +257,10 @@ private:
 
     bool initializeAudioRenderer();
 
+    // Decodes an audio sample (or conceals a lost one if sampleData is null)
+    // and plays it unless play is false. Destroys the renderer on failure.
+    void decodeAndSubmitAudio(char* sampleData, int sampleLength, bool play);
+
     bool testAudio(int audioConfiguration);
 
     int getAudioRendererCapabilities(int audioConfiguration);
@@ -246,6 +295,9 @@ private:
     static
     void clStageStarting(int stage);
 
+    static
+    void clStageComplete(int stage);
+
     static
     void clStageFailed(int stage, int errorCode);
 
@@ -276,6 +328,9 @@ private:
     static
     void clSetAdaptiveTriggers(uint16_t controllerNumber, uint8_t eventFlags, uint8_t typeLeft, uint8_t typeRight, uint8_t *left, uint8_t *right);
 
+    static
+    void clThreadStarted(const char* threadName);
+
     static
     int arInit(int audioConfiguration,
                const POPUS_MULTISTREAM_CONFIGURATION opusConfig,
@@ -330,6 +385,15 @@ private:
     int m_InitialDesktopWidth;
     int m_InitialDesktopHeight;
 
+    // Non-null while the connection is being re-established for a new video mode
+    QThread* m_VideoReconfigureThread;
+    SDL_atomic_t m_VideoReconfigureStartTicks;
+    SDL_atomic_t m_LastVideoReconfigureTimeMs;
+
+    // Set while the connection is stopped for a new video mode, so arCleanup()
+    // leaves the audio renderer for the new connection
+    bool m_KeepAudioRenderer;
+
     bool m_AsyncConnectionSuccess;
     int m_PortTestResults;
 
@@ -350,6 +414,13 @@ private:
 
     Overlay::OverlayManager m_OverlayManager;
 
+    LatencyProbe* m_LatencyProbe;
+    BitrateController* m_BitrateController;
+    StartupTimeline m_StartupTimeline;
+    LowLatencyProfile m_LowLatencyProfile;
+    NetworkImpairment m_NetworkImpairment;
+    AvSyncController m_AvSyncController;
+
     static CONNECTION_LISTENER_CALLBACKS k_ConnCallbacks;
     static Session* s_ActiveSession;
     static QSemaphore s_ActiveSessionSemaphore;
@@ -0,0 +1,121 @@
+#include "startuptimeline.h"
+
+#include <Limelight.h>
+
+#include <QMutexLocker>
+
+#include "SDL_compat.h"
+
+StartupTimeline::StartupTimeline()
+    : m_OriginUs(0)
+{
+}
+
+void StartupTimeline::reset()
+{
+    QMutexLocker locker(&m_Lock);
+
+    m_OriginUs = LiGetMicroseconds();
+    m_Steps.clear();
+    m_SeenFirstDecodeUnit.storeRelaxed(0);
+    m_Complete.storeRelaxed(0);
+}
+
+void StartupTimeline::beginStep(const char* name)
+{
+    QMutexLocker locker(&m_Lock);
+
+    if (m_Complete.loadRelaxed()) {
+        // Decoder recreation and the like after the first frame isn't startup
+        return;
+    }
+
+    m_Steps.append({ name, LiGetMicroseconds(), 0 });
+}
+
+void StartupTimeline::endStep(const char* name)
+{
+    QMutexLocker locker(&m_Lock);
+
+    if (m_Complete.loadRelaxed()) {
+        return;
+    }
+
+    // Close the most recent open step with this name
+    for (int i = m_Steps.size() - 1; i >= 0; i--) {
+        if (m_Steps[i].endUs == 0 && SDL_strcmp(m_Steps[i].name, name) == 0) {
+            m_Steps[i].endUs = LiGetMicroseconds();
+            return;
+        }
+    }
+}
+
+void StartupTimeline::mark(const char* name)
+{
+    QMutexLocker locker(&m_Lock);
+
+    if (m_Complete.loadRelaxed()) {
+        return;
+    }
+
+    uint64_t nowUs = LiGetMicroseconds();
+    m_Steps.append({ name, nowUs, nowUs });
+}
+
+void StartupTimeline::markFirstDecodeUnit()
+{
+    if (m_SeenFirstDecodeUnit.loadRelaxed() || !m_SeenFirstDecodeUnit.testAndSetRelaxed(0, 1)) {
+        return;
+    }
+
+    mark("First decode unit");
+}
+
+bool StartupTimeline::markFirstFrame()
+{
+    if (m_Complete.loadRelaxed()) {
+        return false;
+    }
+
+    uint64_t nowUs = LiGetMicroseconds();
+
+    QMutexLocker locker(&m_Lock);
+
+    if (!m_Complete.testAndSetRelaxed(0, 1)) {
+        return false;
+    }
+
+    logTimeline(nowUs);
+    return true;
+}
+
+void StartupTimeline::logTimeline(uint64_t firstFrameUs)
+{
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Startup timeline (time to first frame: %.1f ms):",
+                (firstFrameUs - m_OriginUs) / 1000.0);
+
+    for (const Step& step : m_Steps) {
+        double startMs = (step.startUs - m_OriginUs) / 1000.0;
+
+        if (step.endUs == step.startUs) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "  %8.1f ms  %s",
+                        startMs,
+                        step.name);
+        }
+        else if (step.endUs == 0) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "  %8.1f ms  %s (unfinished)",
+                        startMs,
+                        step.name);
+        }
+        else {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "  %8.1f ms  %s (%.1f ms)",
+                        startMs,
+                        step.name,
+                        (step.endUs - step.startUs) / 1000.0);
+        }
+    }
+}
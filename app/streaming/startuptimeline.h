@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QVector>
+
+/**
+ * @brief Records how long each step of session startup takes.
+ *
+ * Steps are recorded as spans relative to the time the session was started,
+ * so steps that run concurrently (like the reachability check and the app
+ * launch request) show up as overlapping rather than being summed. The
+ * timeline is finalized and logged when the first frame is rendered, which
+ * gives the time-to-first-frame for the session.
+ *
+ * Steps may be recorded from any thread. Names must be string literals or
+ * otherwise outlive the timeline.
+ */
+class StartupTimeline
+{
+public:
+    StartupTimeline();
+
+    // Discards any recorded steps and restarts the clock
+    void reset();
+
+    void beginStep(const char* name);
+
+    void endStep(const char* name);
+
+    // Records an instantaneous event
+    void mark(const char* name);
+
+    // Records the first decode unit received from the host. Cheap to
+    // call for every decode unit.
+    void markFirstDecodeUnit();
+
+    // Records the first rendered frame and logs the timeline. Cheap to call
+    // for every frame. Returns true only for the call that finalized it.
+    bool markFirstFrame();
+
+private:
+    struct Step {
+        const char* name;
+        uint64_t startUs;
+        uint64_t endUs;
+    };
+
+    void logTimeline(uint64_t firstFrameUs);
+
+    QMutex m_Lock;
+    uint64_t m_OriginUs;
+    QVector<Step> m_Steps;
+    QAtomicInt m_SeenFirstDecodeUnit;
+    QAtomicInt m_Complete;
+};
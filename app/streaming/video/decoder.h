@@ -11,6 +11,9 @@
 
 #define MAX_SLICES 4
 
+// Decode queue wait histogram buckets: <0.25, <0.5, <1, <2, <4 and 4+ ms
+#define DECODE_QUEUE_WAIT_BUCKETS 6
+
 typedef struct _VIDEO_STATS {
     uint32_t receivedFrames;
     uint32_t decodedFrames;
@@ -18,6 +21,7 @@ typedef struct _VIDEO_STATS {
     uint32_t totalFrames;
     uint32_t networkDroppedFrames;
     uint32_t pacerDroppedFrames;
+    uint32_t latencySkippedFrames;             // frames not decoded to stay within the decode latency budget
     uint16_t minHostProcessingLatency;         // low-res from RTP
     uint16_t maxHostProcessingLatency;         // low-res from RTP
     uint32_t totalHostProcessingLatency;       // low-res from RTP
@@ -26,6 +30,16 @@ typedef struct _VIDEO_STATS {
     uint64_t totalDecodeTimeUs;                // high-res (1us)
     uint64_t totalPacerTimeUs;                 // high-res (1us)
     uint64_t totalRenderTimeUs;                // high-res (1us)
+    uint64_t totalVsyncSlackUs;                // high-res (1us), just-in-time pacing only
+    uint32_t framesWithVsyncSlack;             // frames that finished rendering before their V-sync
+    uint32_t missedVsyncFrames;                // frames that finished rendering after their V-sync
+    uint64_t totalDecodeQueueWaitUs;           // high-res (1us), time decode units spent queued for the decoder
+    uint32_t maxDecodeQueueWaitUs;             // high-res (1us)
+    uint32_t decodeQueueWaitBuckets[DECODE_QUEUE_WAIT_BUCKETS];
+    uint64_t totalReceiveDelayUs;              // high-res (1us), time the first packet of each frame waited in the socket
+    uint32_t maxReceiveDelayUs;                // high-res (1us)
+    uint32_t framesWithReceiveDelay;           // frames with kernel receive timestamps
+    uint32_t networkJitterUs;                  // high-res (1us), RFC 3550 interarrival jitter of frames
     uint32_t lastRtt;                          // low-res from enet (1ms)
     uint32_t lastRttVariance;                  // low-res from enet (1ms)
     double totalFps;                           // high-res
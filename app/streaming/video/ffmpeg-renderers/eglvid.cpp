@@ -57,6 +57,8 @@ EGLRenderer::EGLRenderer(IFFmpegRenderer *backendRenderer)
         m_OverlayVBOs{0},
         m_OverlayVAOs{0},
         m_OverlayHasValidData{},
+        m_OverlayLayouts{},
+        m_OverlayVertices{},
         m_ShaderProgram(0),
         m_OverlayShaderProgram(0),
         m_Context(0),
@@ -129,9 +131,14 @@ bool EGLRenderer::prepareDecoderContext(AVCodecContext*, AVDictionary**)
     return true;
 }
 
+bool EGLRenderer::usesGlyphAtlas()
+{
+    return true;
+}
+
 void EGLRenderer::notifyOverlayUpdated(Overlay::OverlayType type)
 {
-    // We handle uploading the updated overlay texture in renderOverlay().
+    // We handle uploading the glyph atlas and overlay vertices in renderOverlay().
     // notifyOverlayUpdated() is called on an arbitrary thread, which may
     // not be have the OpenGL context current on it.
 
@@ -160,94 +167,135 @@ AVPixelFormat EGLRenderer::getPreferredPixelFormat(int videoFormat)
     return m_Backend->getPreferredPixelFormat(videoFormat);
 }
 
-void EGLRenderer::renderOverlay(Overlay::OverlayType type, int viewportWidth, int viewportHeight)
+void EGLRenderer::uploadOverlayAtlas(Overlay::OverlayType type, SDL_Surface* atlas)
 {
-    // Do nothing if this overlay is disabled
-    if (!Session::get()->getOverlayManager().isOverlayEnabled(type)) {
-        return;
-    }
+    SDL_assert(!SDL_MUSTLOCK(atlas));
+    SDL_assert(atlas->format->format == SDL_PIXELFORMAT_ARGB8888);
 
-    // Upload a new overlay texture if needed
-    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type);
-    if (newSurface != nullptr) {
-        SDL_assert(!SDL_MUSTLOCK(newSurface));
-        SDL_assert(newSurface->format->format == SDL_PIXELFORMAT_ARGB8888);
-
-        glBindTexture(GL_TEXTURE_2D, m_OverlayTextures[type]);
+    glBindTexture(GL_TEXTURE_2D, m_OverlayTextures[type]);
 
-        // If the pixel data isn't tightly packed, it requires special handling
-        void* packedPixelData = nullptr;
-        if (newSurface->pitch != newSurface->w * newSurface->format->BytesPerPixel) {
-            if (m_GlesMajorVersion >= 3 || m_HasExtUnpackSubimage) {
-                // If we are GLES 3.0+ or have GL_EXT_unpack_subimage, GL can handle any pitch
-                SDL_assert(newSurface->pitch % newSurface->format->BytesPerPixel == 0);
-                glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, newSurface->pitch / newSurface->format->BytesPerPixel);
-            }
-            else {
-                // If we can't use GL_UNPACK_ROW_LENGTH, we must allocate a tightly packed buffer
-                // and copy our pixels there.
-                packedPixelData = malloc(newSurface->w * newSurface->h * newSurface->format->BytesPerPixel);
-                if (!packedPixelData) {
-                    SDL_FreeSurface(newSurface);
-                    return;
-                }
-
-                SDL_ConvertPixels(newSurface->w, newSurface->h,
-                                  newSurface->format->format, newSurface->pixels, newSurface->pitch,
-                                  newSurface->format->format, packedPixelData, newSurface->w * newSurface->format->BytesPerPixel);
+    // If the pixel data isn't tightly packed, it requires special handling
+    void* packedPixelData = nullptr;
+    if (atlas->pitch != atlas->w * atlas->format->BytesPerPixel) {
+        if (m_GlesMajorVersion >= 3 || m_HasExtUnpackSubimage) {
+            // If we are GLES 3.0+ or have GL_EXT_unpack_subimage, GL can handle any pitch
+            SDL_assert(atlas->pitch % atlas->format->BytesPerPixel == 0);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, atlas->pitch / atlas->format->BytesPerPixel);
+        }
+        else {
+            // If we can't use GL_UNPACK_ROW_LENGTH, we must allocate a tightly packed buffer
+            // and copy our pixels there.
+            packedPixelData = malloc(atlas->w * atlas->h * atlas->format->BytesPerPixel);
+            if (!packedPixelData) {
+                return;
             }
+
+            SDL_ConvertPixels(atlas->w, atlas->h,
+                              atlas->format->format, atlas->pixels, atlas->pitch,
+                              atlas->format->format, packedPixelData, atlas->w * atlas->format->BytesPerPixel);
         }
+    }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, newSurface->w, newSurface->h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                     packedPixelData ? packedPixelData : newSurface->pixels);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlas->w, atlas->h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 packedPixelData ? packedPixelData : atlas->pixels);
 
-        if (packedPixelData) {
-            free(packedPixelData);
-        }
-        else if (newSurface->pitch != newSurface->w * newSurface->format->BytesPerPixel) {
-            glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
-        }
+    if (packedPixelData) {
+        free(packedPixelData);
+    }
+    else if (atlas->pitch != atlas->w * atlas->format->BytesPerPixel) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+    }
 
-        SDL_FRect overlayRect;
+    m_OverlayLayouts[type].atlasWidth = atlas->w;
+    m_OverlayLayouts[type].atlasHeight = atlas->h;
+}
 
-        // These overlay positions differ from the other renderers because OpenGL
-        // places the origin in the lower-left corner instead of the upper-left.
-        if (type == Overlay::OverlayStatusUpdate) {
-            // Bottom Left
-            overlayRect.x = 0;
-            overlayRect.y = 0;
-        }
-        else if (type == Overlay::OverlayDebug) {
-            // Top left
-            overlayRect.x = 0;
-            overlayRect.y = viewportHeight - newSurface->h;
-        } else {
-            SDL_assert(false);
-        }
+void EGLRenderer::updateOverlayVertices(Overlay::OverlayType type, int viewportWidth, int viewportHeight)
+{
+    auto& layout = m_OverlayLayouts[type];
+    PVERTEX verts = (PVERTEX)m_OverlayVertices;
+    float originTop;
+
+    // These overlay positions differ from the other renderers because OpenGL
+    // places the origin in the lower-left corner instead of the upper-left.
+    if (type == Overlay::OverlayStatusUpdate) {
+        // Bottom Left
+        originTop = layout.height;
+    }
+    else if (type == Overlay::OverlayDebug) {
+        // Top left
+        originTop = viewportHeight;
+    } else {
+        SDL_assert(false);
+        return;
+    }
 
-        overlayRect.w = newSurface->w;
-        overlayRect.h = newSurface->h;
+    for (int i = 0; i < layout.quadCount; i++) {
+        const Overlay::GlyphQuad& quad = layout.quads[i];
 
-        SDL_FreeSurface(newSurface);
+        SDL_FRect glyphRect;
+        glyphRect.x = quad.dst.x;
+        glyphRect.y = originTop - quad.dst.y - quad.dst.h;
+        glyphRect.w = quad.dst.w;
+        glyphRect.h = quad.dst.h;
 
         // Convert screen space to normalized device coordinates
-        StreamUtils::screenSpaceToNormalizedDeviceCoords(&overlayRect, viewportWidth, viewportHeight);
+        StreamUtils::screenSpaceToNormalizedDeviceCoords(&glyphRect, viewportWidth, viewportHeight);
 
-        VERTEX verts[] =
-        {
-            {overlayRect.x + overlayRect.w, overlayRect.y + overlayRect.h, 1.0f, 0.0f},
-            {overlayRect.x, overlayRect.y + overlayRect.h, 0.0f, 0.0f},
-            {overlayRect.x, overlayRect.y, 0.0f, 1.0f},
-            {overlayRect.x, overlayRect.y, 0.0f, 1.0f},
-            {overlayRect.x + overlayRect.w, overlayRect.y, 1.0f, 1.0f},
-            {overlayRect.x + overlayRect.w, overlayRect.y + overlayRect.h, 1.0f, 0.0f}
-        };
+        float u0 = (float)quad.src.x / layout.atlasWidth;
+        float u1 = (float)(quad.src.x + quad.src.w) / layout.atlasWidth;
+        float v0 = (float)quad.src.y / layout.atlasHeight;
+        float v1 = (float)(quad.src.y + quad.src.h) / layout.atlasHeight;
 
-        // Update the VBO for this overlay (already bound to a VAO)
-        glBindBuffer(GL_ARRAY_BUFFER, m_OverlayVBOs[type]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+        verts[i * 6 + 0] = {glyphRect.x + glyphRect.w, glyphRect.y + glyphRect.h, u1, v0};
+        verts[i * 6 + 1] = {glyphRect.x, glyphRect.y + glyphRect.h, u0, v0};
+        verts[i * 6 + 2] = {glyphRect.x, glyphRect.y, u0, v1};
+        verts[i * 6 + 3] = {glyphRect.x, glyphRect.y, u0, v1};
+        verts[i * 6 + 4] = {glyphRect.x + glyphRect.w, glyphRect.y, u1, v1};
+        verts[i * 6 + 5] = {glyphRect.x + glyphRect.w, glyphRect.y + glyphRect.h, u1, v0};
+    }
+
+    // Update the VBO for this overlay (already bound to a VAO). It was allocated
+    // for the longest possible text, so this never reallocates it.
+    glBindBuffer(GL_ARRAY_BUFFER, m_OverlayVBOs[type]);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, layout.quadCount * 6 * sizeof(VERTEX), verts);
+
+    layout.viewportWidth = viewportWidth;
+    layout.viewportHeight = viewportHeight;
+}
 
-        SDL_AtomicSet(&m_OverlayHasValidData[type], 1);
+void EGLRenderer::renderOverlay(Overlay::OverlayType type, int viewportWidth, int viewportHeight)
+{
+    Overlay::OverlayManager& overlayManager = Session::get()->getOverlayManager();
+    auto& layout = m_OverlayLayouts[type];
+
+    // Do nothing if this overlay is disabled
+    if (!overlayManager.isOverlayEnabled(type)) {
+        return;
+    }
+
+    // Upload the glyph atlas if it changed, which only happens when a glyph
+    // is drawn for the first time rather than for each overlay update
+    SDL_Surface* atlas = overlayManager.lockUpdatedGlyphAtlas(type, &layout.atlasGeneration);
+    if (atlas != nullptr) {
+        uploadOverlayAtlas(type, atlas);
+        overlayManager.unlockGlyphAtlas();
+    }
+
+    int width;
+    int quadCount = overlayManager.getUpdatedOverlayLayout(type, &layout.layoutSerial, layout.quads,
+                                                           &width, &layout.height);
+    if (quadCount >= 0) {
+        layout.quadCount = quadCount;
+        layout.viewportWidth = 0;
+    }
+
+    // Rebuild the vertices if the text changed or the window was resized,
+    // since the overlay is positioned relative to the window
+    if (layout.atlasWidth != 0 &&
+            (layout.viewportWidth != viewportWidth || layout.viewportHeight != viewportHeight)) {
+        updateOverlayVertices(type, viewportWidth, viewportHeight);
+        SDL_AtomicSet(&m_OverlayHasValidData[type], layout.quadCount > 0);
     }
 
     if (!SDL_AtomicGet(&m_OverlayHasValidData[type])) {
@@ -268,7 +316,7 @@ void EGLRenderer::renderOverlay(Overlay::OverlayType type, int viewportWidth, in
 
     // Draw the overlay
     m_glBindVertexArrayOES(m_OverlayVAOs[type]);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glDrawArrays(GL_TRIANGLES, 0, layout.quadCount * 6);
     m_glBindVertexArrayOES(0);
 
     glDisable(GL_BLEND);
@@ -700,6 +748,9 @@ bool EGLRenderer::setupOverlayRenderingState() {
         m_glBindVertexArrayOES(m_OverlayVAOs[i]);
         glBindBuffer(GL_ARRAY_BUFFER, m_OverlayVBOs[i]);
 
+        // Allocate the VBO for the longest possible overlay text up front
+        glBufferData(GL_ARRAY_BUFFER, sizeof(m_OverlayVertices), nullptr, GL_DYNAMIC_DRAW);
+
         // compileShader() ensures that aPosition and aTexCoord are indexes 0 and 1 respectively
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)offsetof(VERTEX, x));
         glEnableVertexAttribArray(0);
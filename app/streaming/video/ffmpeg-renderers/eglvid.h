@@ -18,6 +18,7 @@ public:
     virtual void renderFrame(AVFrame* frame) override;
     virtual bool testRenderFrame(AVFrame* frame) override;
     virtual void notifyOverlayUpdated(Overlay::OverlayType) override;
+    virtual bool usesGlyphAtlas() override;
     virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO) override;
     virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
     virtual AVPixelFormat getPreferredPixelFormat(int videoFormat) override;
@@ -25,6 +26,8 @@ public:
 private:
 
     void renderOverlay(Overlay::OverlayType type, int viewportWidth, int viewportHeight);
+    void uploadOverlayAtlas(Overlay::OverlayType type, SDL_Surface* atlas);
+    void updateOverlayVertices(Overlay::OverlayType type, int viewportWidth, int viewportHeight);
     unsigned compileShader(const char* vertexShaderSrc, const char* fragmentShaderSrc);
     bool compileShaders();
     bool setupVideoRenderingState();
@@ -38,6 +41,23 @@ private:
     unsigned m_OverlayVBOs[Overlay::OverlayMax];
     unsigned m_OverlayVAOs[Overlay::OverlayMax];
     SDL_atomic_t m_OverlayHasValidData[Overlay::OverlayMax];
+
+    // Overlays are drawn glyph by glyph from a texture of the glyph atlas. The
+    // vertices are only rebuilt when the text or the window size changes.
+    struct {
+        int atlasGeneration;
+        int atlasWidth;
+        int atlasHeight;
+        int layoutSerial;
+        int quadCount;
+        int height;
+        int viewportWidth;
+        int viewportHeight;
+        Overlay::GlyphQuad quads[OVERLAY_MAX_GLYPHS];
+    } m_OverlayLayouts[Overlay::OverlayMax];
+
+    // Vertices of one overlay (6 per glyph) on their way to its VBO
+    float m_OverlayVertices[OVERLAY_MAX_GLYPHS * 6 * 4];
     unsigned m_ShaderProgram;
     unsigned m_OverlayShaderProgram;
     SDL_GLContext m_Context;
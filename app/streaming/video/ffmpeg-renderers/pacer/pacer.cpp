@@ -1,5 +1,10 @@
 #include "pacer.h"
 #include "streaming/streamutils.h"
+#include "streaming/session.h"
+
+#include <libavutil/hwcontext.h>
+
+#include <QDeadlineTimer>
 
 #ifdef Q_OS_WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -28,6 +33,10 @@
 // V-sync happens.
 #define TIMER_SLACK_MS 3
 
+// With just-in-time presentation, this much time is reserved on top of the
+// estimated render cost to absorb jitter in waking up for the deadline.
+#define JIT_SAFETY_MARGIN_US 1000
+
 Pacer::Pacer(IFFmpegRenderer* renderer, PVIDEO_STATS videoStats) :
     m_RenderThread(nullptr),
     m_VsyncThread(nullptr),
@@ -36,7 +45,15 @@ Pacer::Pacer(IFFmpegRenderer* renderer, PVIDEO_STATS videoStats) :
     m_VsyncRenderer(renderer),
     m_MaxVideoFps(0),
     m_DisplayFps(0),
-    m_VideoStats(videoStats)
+    m_VideoStats(videoStats),
+    m_LatencyProbeUnsupported(false),
+    m_JitPresentation(false),
+    m_VsyncPhaseUs(0),
+    m_VsyncPeriodUs(0),
+    m_RenderCostUs(TIMER_SLACK_MS * 1000),
+    m_RenderCostDevUs(0),
+    m_JitTargetVsyncUs(0),
+    m_JitEnqueueUs(0)
 {
 
 }
@@ -102,6 +119,8 @@ int Pacer::vsyncThread(void *context)
     SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
 #endif
 
+    me->applyLowLatencyProfile("PacerVsync");
+
     bool async = me->m_VsyncSource->isAsync();
     while (!me->m_Stopping) {
         if (async) {
@@ -119,12 +138,22 @@ int Pacer::vsyncThread(void *context)
             break;
         }
 
+        me->updateVsyncModel(LiGetMicroseconds());
         me->handleVsync(1000 / me->m_DisplayFps);
     }
 
     return 0;
 }
 
+void Pacer::applyLowLatencyProfile(const char* threadName)
+{
+    Session* session = Session::get();
+    LowLatencyProfile* lowLatencyProfile = session != nullptr ? session->getLowLatencyProfile() : nullptr;
+    if (lowLatencyProfile != nullptr) {
+        lowLatencyProfile->applyToCurrentThread(threadName, LowLatencyProfile::TR_RENDER);
+    }
+}
+
 int Pacer::renderThread(void* context)
 {
     Pacer* me = reinterpret_cast<Pacer*>(context);
@@ -135,6 +164,8 @@ int Pacer::renderThread(void* context)
                     SDL_GetError());
     }
 
+    me->applyLowLatencyProfile("PacerRender");
+
     while (!me->m_Stopping) {
         // Wait for the renderer to be ready for the next frame
         me->m_VsyncRenderer->waitToRender();
@@ -200,6 +231,11 @@ void Pacer::handleVsync(int timeUntilNextVsyncMillis)
 
     m_FrameQueueLock.lock();
 
+    if (m_JitPresentation) {
+        presentJustInTimeAndUnlock();
+        return;
+    }
+
     // If the queue length history entries are large, be strict
     // about dropping excess frames.
     int frameDropTarget = 1;
@@ -258,6 +294,103 @@ void Pacer::handleVsync(int timeUntilNextVsyncMillis)
     enqueueFrameForRenderingAndUnlock(std::move(frame));
 }
 
+void Pacer::updateVsyncModel(uint64_t vsyncUs)
+{
+    double nominalPeriodUs = 1000000.0 / m_DisplayFps;
+
+    if (m_VsyncPhaseUs == 0) {
+        m_VsyncPhaseUs = vsyncUs;
+        m_VsyncPeriodUs = nominalPeriodUs;
+        return;
+    }
+
+    double predictedUs = m_VsyncPhaseUs + m_VsyncPeriodUs;
+    double errorUs = vsyncUs - predictedUs;
+
+    if (qAbs(errorUs) < m_VsyncPeriodUs / 4) {
+        // Track the V-sync source like a PLL, so jitter in when this thread
+        // wakes up only nudges the phase and period instead of replacing them.
+        m_VsyncPhaseUs = predictedUs + errorUs / 4;
+        m_VsyncPeriodUs = qBound(nominalPeriodUs * 0.9, m_VsyncPeriodUs + errorUs / 32, nominalPeriodUs * 1.1);
+    }
+    else {
+        // We missed V-syncs or the source stalled, so just resync the phase
+        m_VsyncPhaseUs = vsyncUs;
+    }
+}
+
+void Pacer::presentJustInTimeAndUnlock()
+{
+    uint64_t targetVsyncUs = (uint64_t)(m_VsyncPhaseUs + m_VsyncPeriodUs);
+    uint64_t renderBudgetUs = (uint64_t)(m_RenderCostUs + 4 * m_RenderCostDevUs) + JIT_SAFETY_MARGIN_US;
+    uint64_t deadlineUs = targetVsyncUs > renderBudgetUs ? targetVsyncUs - renderBudgetUs : 0;
+
+    // Hold off until the deadline, so any frame that arrives in the meantime
+    // is the one that makes this V-sync rather than waiting for the next one.
+    for (;;) {
+        uint64_t nowUs = LiGetMicroseconds();
+        if (m_Stopping || nowUs >= deadlineUs) {
+            break;
+        }
+
+        QDeadlineTimer timer(Qt::PreciseTimer);
+        timer.setPreciseRemainingTime(0, (qint64)(deadlineUs - nowUs) * 1000, Qt::PreciseTimer);
+        m_PacingQueueNotEmpty.wait(&m_FrameQueueLock, timer);
+    }
+
+    if (m_Stopping || m_PacingQueue.empty()) {
+        // Nothing new to show on this V-sync
+        m_FrameQueueLock.unlock();
+        return;
+    }
+
+    // Only the newest frame is rendered. Older frames, including any the renderer
+    // hasn't picked up yet, would just make it miss the V-sync.
+    std::deque<ScopedAVFrame> staleFrames;
+    while (!m_RenderQueue.empty()) {
+        staleFrames.push_back(std::move(m_RenderQueue.front()));
+        m_RenderQueue.pop_front();
+    }
+    while (m_PacingQueue.size() > 1) {
+        staleFrames.push_back(std::move(m_PacingQueue.front()));
+        m_PacingQueue.pop_front();
+    }
+    m_VideoStats->pacerDroppedFrames += (uint32_t)staleFrames.size();
+
+    ScopedAVFrame frame = std::move(m_PacingQueue.front());
+    m_PacingQueue.pop_front();
+
+    m_JitTargetVsyncUs = targetVsyncUs;
+    m_JitEnqueueUs = LiGetMicroseconds();
+    enqueueFrameForRenderingAndUnlock(std::move(frame));
+
+    // The stale frames are freed here outside the lock
+}
+
+void Pacer::recordVsyncSlack(uint64_t enqueueUs, uint64_t afterRenderUs, uint64_t targetVsyncUs)
+{
+    double renderCostUs = (double)(afterRenderUs - enqueueUs);
+
+    if (afterRenderUs > targetVsyncUs) {
+        m_VideoStats->missedVsyncFrames++;
+
+        // Late frames still count, or a renderer that got slower would never
+        // move the deadline earlier. Renderers that block in present until
+        // V-sync report that wait as render time, so cap it at one period.
+        renderCostUs = qMin(renderCostUs, m_VsyncPeriodUs);
+    }
+    else {
+        m_VideoStats->totalVsyncSlackUs += targetVsyncUs - afterRenderUs;
+        m_VideoStats->framesWithVsyncSlack++;
+    }
+
+    // Smoothed mean and deviation of the hand-off plus render time, as
+    // done for TCP's retransmission timeout
+    double errorUs = renderCostUs - m_RenderCostUs;
+    m_RenderCostUs += errorUs / 8;
+    m_RenderCostDevUs += (qAbs(errorUs) - m_RenderCostDevUs) / 4;
+}
+
 bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing)
 {
     m_MaxVideoFps = maxVideoFps;
@@ -317,6 +450,15 @@ bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing)
     }
 
     if (m_VsyncSource != nullptr) {
+        // Render each frame at the last moment before V-sync instead of as soon
+        // as possible. This minimizes latency for the newest frame, at the cost
+        // of dropping frames that arrive with less than a refresh between them.
+        m_JitPresentation = qEnvironmentVariableIntValue("JIT_FRAME_PACING") != 0;
+        if (m_JitPresentation) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Using just-in-time frame presentation");
+        }
+
         m_VsyncThread = SDL_CreateThread(Pacer::vsyncThread, "PacerVsync", this);
     }
 
@@ -332,8 +474,75 @@ void Pacer::signalVsync()
     m_VsyncSignalled.wakeOne();
 }
 
+bool Pacer::sampleProbeLuma(AVFrame* frame, int& luma)
+{
+    ScopedAVFrame mappedFrame;
+
+    // Hardware frames must be mapped (or copied as a last resort) into system memory
+    if (frame->hw_frames_ctx != nullptr) {
+        mappedFrame.reset(av_frame_alloc());
+        if (!mappedFrame) {
+            return false;
+        }
+
+        if (av_hwframe_map(mappedFrame.get(), frame, AV_HWFRAME_MAP_READ) < 0) {
+            av_frame_unref(mappedFrame.get());
+            if (av_hwframe_transfer_data(mappedFrame.get(), frame, 0) < 0) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Unable to read back frame for latency probe");
+                return false;
+            }
+        }
+
+        frame = mappedFrame.get();
+    }
+
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    if (desc == nullptr || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM)) ||
+            desc->comp[0].depth < 8 || desc->comp[0].depth > 16) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Unsupported pixel format for latency probe: %d",
+                    frame->format);
+        return false;
+    }
+
+    // Average the luma component over the probe region in the top-left corner
+    const AVComponentDescriptor& comp = desc->comp[0];
+    int regionWidth = qMin(frame->width, LatencyProbe::k_RegionSize);
+    int regionHeight = qMin(frame->height, LatencyProbe::k_RegionSize);
+    if (regionWidth <= 0 || regionHeight <= 0) {
+        return false;
+    }
+
+    uint64_t total = 0;
+    for (int y = 0; y < regionHeight; y++) {
+        const uint8_t* row = frame->data[comp.plane] + (ptrdiff_t)y * frame->linesize[comp.plane] + comp.offset;
+        for (int x = 0; x < regionWidth; x++) {
+            const uint8_t* pixel = row + x * comp.step;
+            unsigned int value = comp.depth > 8 ? *(const uint16_t*)pixel : *pixel;
+            value = (value >> comp.shift) & ((1U << comp.depth) - 1);
+            total += value >> (comp.depth - 8);
+        }
+    }
+
+    luma = (int)(total / ((uint64_t)regionWidth * regionHeight));
+    return true;
+}
+
 void Pacer::renderFrame(ScopedAVFrame frame)
 {
+    uint64_t targetVsyncUs = 0;
+    uint64_t enqueueUs = 0;
+
+    // Claim the V-sync this frame was scheduled for, if any
+    if (m_JitPresentation) {
+        m_FrameQueueLock.lock();
+        targetVsyncUs = m_JitTargetVsyncUs;
+        enqueueUs = m_JitEnqueueUs;
+        m_JitTargetVsyncUs = 0;
+        m_FrameQueueLock.unlock();
+    }
+
     // Count time spent in Pacer's queues
     uint64_t beforeRender = LiGetMicroseconds();
     m_VideoStats->totalPacerTimeUs += (beforeRender - (uint64_t)frame->pkt_dts);
@@ -344,6 +553,30 @@ void Pacer::renderFrame(ScopedAVFrame frame)
 
     m_VideoStats->totalRenderTimeUs += (afterRender - beforeRender);
     m_VideoStats->renderedFrames++;
+
+    Session* session = Session::get();
+    if (session != nullptr) {
+        session->notifyFrameRendered();
+
+        // The decoder stores the RTP timestamp of the frame in pts
+        if (frame->pts != AV_NOPTS_VALUE) {
+            session->getAvSyncController().submitVideoPresented((uint32_t)frame->pts, afterRender);
+        }
+    }
+
+    // Feed the latency probe after the render timestamp is captured
+    // so the sampling cost isn't counted in the measured latency.
+    LatencyProbe* latencyProbe = session != nullptr ? session->getLatencyProbe() : nullptr;
+    if (latencyProbe != nullptr && !m_LatencyProbeUnsupported && latencyProbe->wantsSample()) {
+        int luma;
+        if (sampleProbeLuma(frame.get(), luma)) {
+            latencyProbe->submitLuma(luma, afterRender);
+        }
+        else {
+            // Don't retry (and log) on every frame
+            m_LatencyProbeUnsupported = true;
+        }
+    }
     
     // The frame will be freed when ScopedAVFrame goes out of scope here
     frame.reset();
@@ -351,6 +584,10 @@ void Pacer::renderFrame(ScopedAVFrame frame)
     // Drop frames if we have too many queued up for a while
     m_FrameQueueLock.lock();
 
+    if (targetVsyncUs != 0) {
+        recordVsyncSlack(enqueueUs, afterRender, targetVsyncUs);
+    }
+
     int frameDropTarget;
 
     if (m_RendererAttributes & RENDERER_ATTRIBUTE_NO_BUFFERING) {
@@ -53,12 +53,27 @@ private:
 
     static int renderThread(void* context);
 
+    void applyLowLatencyProfile(const char* threadName);
+
     void handleVsync(int timeUntilNextVsyncMillis);
 
+    // Refines the V-sync phase and period estimates with a new V-sync timestamp
+    void updateVsyncModel(uint64_t vsyncUs);
+
+    // Waits until the latest point a frame can be rendered in time for the next
+    // V-sync, then renders the newest frame. Called with m_FrameQueueLock held.
+    void presentJustInTimeAndUnlock();
+
+    // Called with m_FrameQueueLock held
+    void recordVsyncSlack(uint64_t enqueueUs, uint64_t afterRenderUs, uint64_t targetVsyncUs);
+
     void enqueueFrameForRenderingAndUnlock(ScopedAVFrame frame);
 
     void renderFrame(ScopedAVFrame frame);
 
+    // Computes the mean luma of the latency probe region of a frame
+    bool sampleProbeLuma(AVFrame* frame, int& luma);
+
     // Returns the dropped frame (if any) so it can be freed outside the lock
     ScopedAVFrame dropFrameForEnqueue(std::deque<ScopedAVFrame>& queue);
 
@@ -82,4 +97,16 @@ private:
     int m_DisplayFps;
     PVIDEO_STATS m_VideoStats;
     int m_RendererAttributes;
+    bool m_LatencyProbeUnsupported;
+
+    // Just-in-time presentation state. The V-sync model is only touched by
+    // the V-sync thread, while the render cost estimate and the target V-sync
+    // of the frame being handed to the renderer are protected by m_FrameQueueLock.
+    bool m_JitPresentation;
+    double m_VsyncPhaseUs;
+    double m_VsyncPeriodUs;
+    double m_RenderCostUs;
+    double m_RenderCostDevUs;
+    uint64_t m_JitTargetVsyncUs;
+    uint64_t m_JitEnqueueUs;
 };
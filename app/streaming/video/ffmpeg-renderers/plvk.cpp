@@ -1,4 +1,5 @@
 #include "plvk.h"
+#include "../ffmpeg.h"
 
 #include "streaming/session.h"
 #include "streaming/streamutils.h"
@@ -10,10 +11,17 @@
 #include <SDL_vulkan.h>
 
 #include <libavutil/hwcontext_vulkan.h>
+#include <libavutil/imgutil.h>
+#include <libavutil/pixdesc.h>
+
+#include <QMutexLocker>
 
 #include <vector>
 #include <set>
 
+// Enough for a full H.264 DPB plus the frames held by the decoder thread and Pacer
+#define MAX_MAPPED_UPLOAD_BUFFERS 32
+
 #ifndef VK_KHR_video_decode_av1
 #define VK_KHR_VIDEO_DECODE_AV1_EXTENSION_NAME "VK_KHR_video_decode_av1"
 #define VK_VIDEO_CODEC_OPERATION_DECODE_AV1_BIT_KHR ((VkVideoCodecOperationFlagBitsKHR)0x00000004)
@@ -98,10 +106,168 @@ void PlVkRenderer::overlayUploadComplete(void* opaque)
     SDL_FreeSurface((SDL_Surface*)opaque);
 }
 
+int PlVkRenderer::getMappedBuffer2(AVCodecContext* context, AVFrame* frame, int flags)
+{
+    PlVkRenderer* me = (PlVkRenderer*)((FFmpegVideoDecoder*)context->opaque)->getBackendRenderer();
+
+    // Decoders without DR1 can't take frames from a custom allocator
+    if (!(context->codec->capabilities & AV_CODEC_CAP_DR1) || !me->allocateMappedFrame(context, frame)) {
+        return avcodec_default_get_buffer2(context, frame, flags);
+    }
+
+    return 0;
+}
+
+bool PlVkRenderer::allocateMappedFrame(AVCodecContext* context, AVFrame* frame)
+{
+    AVPixelFormat format = (AVPixelFormat)frame->format;
+    pl_plane_data planeData[4] = {};
+    pl_bit_encoding bits;
+
+    // Anything we can't upload from a buffer ourselves gets a regular allocation
+    if ((av_pix_fmt_desc_get(format)->flags & AV_PIX_FMT_FLAG_HWACCEL) ||
+            pl_plane_data_from_pixfmt(planeData, &bits, format) == 0) {
+        return false;
+    }
+
+    // The decoder may write past the visible frame, so we need its padded dimensions
+    int width = frame->width;
+    int height = frame->height;
+    int linesizeAlign[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(context, &width, &height, linesizeAlign);
+
+    // Align the planes for both FFmpeg's SIMD code and the GPU's buffer transfers
+    size_t align = SDL_max((size_t)64, SDL_max(m_Vulkan->gpu->limits.align_tex_xfer_pitch,
+                                               m_Vulkan->gpu->limits.align_tex_xfer_offset));
+    int linesizes[4];
+    if (av_image_fill_linesizes(linesizes, format, width) < 0) {
+        return false;
+    }
+
+    ptrdiff_t alignedLinesizes[4];
+    for (int i = 0; i < 4; i++) {
+        alignedLinesizes[i] = (ptrdiff_t)(((linesizes[i] + align - 1) / align) * align);
+    }
+
+    size_t planeSizes[4];
+    if (av_image_fill_plane_sizes(planeSizes, format, height, alignedLinesizes) < 0) {
+        return false;
+    }
+
+    size_t planeOffsets[4] = {};
+    size_t totalSize = 0;
+    for (int i = 0; i < 4 && planeSizes[i] != 0; i++) {
+        planeOffsets[i] = totalSize;
+
+        // Leave some slack after each plane for decoders that overread
+        totalSize += ((planeSizes[i] + 16 + align - 1) / align) * align;
+    }
+
+    MappedBuffer* mappedBuffer = acquireMappedBuffer(totalSize);
+    if (mappedBuffer == nullptr) {
+        // We're out of buffers, so this frame will be copied instead
+        return false;
+    }
+
+    frame->buf[0] = av_buffer_create(mappedBuffer->buf->data, totalSize, releaseMappedBuffer, mappedBuffer, 0);
+    if (frame->buf[0] == nullptr) {
+        releaseMappedBuffer(mappedBuffer, nullptr);
+        return false;
+    }
+
+    for (int i = 0; i < 4 && planeSizes[i] != 0; i++) {
+        frame->data[i] = mappedBuffer->buf->data + planeOffsets[i];
+        frame->linesize[i] = (int)alignedLinesizes[i];
+    }
+    frame->extended_data = frame->data;
+
+    return true;
+}
+
+void PlVkRenderer::releaseMappedBuffer(void* opaque, uint8_t*)
+{
+    MappedBuffer* mappedBuffer = (MappedBuffer*)opaque;
+    QMutexLocker locker(&mappedBuffer->renderer->m_MappedBufferLock);
+
+    // The GPU may still be reading from the buffer, which acquireMappedBuffer() checks
+    mappedBuffer->inUse = false;
+}
+
+PlVkRenderer::MappedBuffer* PlVkRenderer::acquireMappedBuffer(size_t size)
+{
+    QMutexLocker locker(&m_MappedBufferLock);
+
+    for (auto it = m_MappedBuffers.begin(); it != m_MappedBuffers.end();) {
+        MappedBuffer* mappedBuffer = *it;
+
+        // Skip buffers the decoder is using or the GPU is still uploading from
+        if (mappedBuffer->inUse || pl_buf_poll(m_Vulkan->gpu, mappedBuffer->buf, 0)) {
+            it++;
+            continue;
+        }
+
+        if (mappedBuffer->buf->params.size == size) {
+            mappedBuffer->inUse = true;
+            return mappedBuffer;
+        }
+
+        // This is left over from a different frame size
+        pl_buf_destroy(m_Vulkan->gpu, &mappedBuffer->buf);
+        delete mappedBuffer;
+        it = m_MappedBuffers.erase(it);
+    }
+
+    if (m_MappedBuffers.size() >= MAX_MAPPED_UPLOAD_BUFFERS) {
+        return nullptr;
+    }
+
+    pl_buf_params bufParams = {};
+    bufParams.size = size;
+    bufParams.host_mapped = true;
+    bufParams.memory_type = PL_BUF_MEM_HOST;
+    bufParams.debug_tag = PL_DEBUG_TAG;
+
+    MappedBuffer* mappedBuffer = new MappedBuffer();
+    mappedBuffer->renderer = this;
+    mappedBuffer->buf = pl_buf_create(m_Vulkan->gpu, &bufParams);
+    if (mappedBuffer->buf == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "pl_buf_create() failed for mapped upload buffer");
+        delete mappedBuffer;
+        return nullptr;
+    }
+
+    mappedBuffer->inUse = true;
+    m_MappedBuffers.push_back(mappedBuffer);
+    return mappedBuffer;
+}
+
+PlVkRenderer::MappedBuffer* PlVkRenderer::findMappedBuffer(const AVFrame* frame)
+{
+    if (!m_MappedUpload || frame->buf[0] == nullptr || frame->buf[1] != nullptr) {
+        return nullptr;
+    }
+
+    // Only buffers from getMappedBuffer2() have one of our entries as their opaque value
+    void* opaque = av_buffer_get_opaque(frame->buf[0]);
+
+    QMutexLocker locker(&m_MappedBufferLock);
+    for (MappedBuffer* mappedBuffer : m_MappedBuffers) {
+        if (mappedBuffer == opaque) {
+            return mappedBuffer;
+        }
+    }
+
+    return nullptr;
+}
+
 PlVkRenderer::PlVkRenderer(bool hwaccel, IFFmpegRenderer *backendRenderer) :
     IFFmpegRenderer(RendererType::Vulkan),
     m_Backend(backendRenderer),
-    m_HwAccelBackend(hwaccel)
+    m_HwAccelBackend(hwaccel),
+    m_Headless(qEnvironmentVariableIntValue("PLVK_HEADLESS") != 0),
+    m_MappedUpload(false),
+    m_LogFrameTimings(qEnvironmentVariableIntValue("PLVK_FRAME_TIMINGS") != 0)
 {
     bool ok;
 
@@ -124,7 +290,29 @@ PlVkRenderer::~PlVkRenderer()
     // The render context must have been cleaned up by now
     SDL_assert(!m_HasPendingSwapchainFrame);
 
+    if (m_FrameTimings.frames != 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Vulkan renderer timings for %u frames (%u from mapped buffers): upload %.2f ms avg / %.2f ms max, render %.2f ms avg / %.2f ms max%s",
+                    m_FrameTimings.frames,
+                    m_FrameTimings.mappedUploadFrames,
+                    m_FrameTimings.totalUploadUs / 1000.0 / m_FrameTimings.frames,
+                    m_FrameTimings.maxUploadUs / 1000.0,
+                    m_FrameTimings.totalRenderUs / 1000.0 / m_FrameTimings.frames,
+                    m_FrameTimings.maxRenderUs / 1000.0,
+                    m_Headless ? "" : " (CPU time only)");
+    }
+
     if (m_Vulkan != nullptr) {
+        // The decoder has been freed by now, so all frames have been released
+        for (MappedBuffer* mappedBuffer : m_MappedBuffers) {
+            SDL_assert(!mappedBuffer->inUse);
+            pl_buf_destroy(m_Vulkan->gpu, &mappedBuffer->buf);
+            delete mappedBuffer;
+        }
+        m_MappedBuffers.clear();
+
+        pl_tex_destroy(m_Vulkan->gpu, &m_HeadlessTarget);
+
         for (int i = 0; i < (int)SDL_arraysize(m_Overlays); i++) {
             pl_tex_destroy(m_Vulkan->gpu, &m_Overlays[i].overlay.tex);
             pl_tex_destroy(m_Vulkan->gpu, &m_Overlays[i].stagingOverlay.tex);
@@ -291,22 +479,23 @@ bool PlVkRenderer::tryInitializeDevice(VkPhysicalDevice device, VkPhysicalDevice
         }
     }
 
-    if (!isSurfacePresentationSupportedByPhysicalDevice(device)) {
+    // There's nothing to present to in headless mode
+    if (!m_Headless && !isSurfacePresentationSupportedByPhysicalDevice(device)) {
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                     "Vulkan device '%s' does not support presenting on window surface",
                     deviceProps->deviceName);
         return false;
     }
 
-    if (hdrOutputRequired && !isColorSpaceSupportedByPhysicalDevice(device, VK_COLOR_SPACE_HDR10_ST2084_EXT)) {
+    if (!m_Headless && hdrOutputRequired && !isColorSpaceSupportedByPhysicalDevice(device, VK_COLOR_SPACE_HDR10_ST2084_EXT)) {
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                     "Vulkan device '%s' does not support HDR10 (ST.2084 PQ)",
                     deviceProps->deviceName);
         return false;
     }
 
-    // Avoid software GPUs
-    if (deviceProps->deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU && qgetenv("PLVK_ALLOW_SOFTWARE") != "1") {
+    // Avoid software GPUs, unless we're in headless mode where lavapipe is the point
+    if (deviceProps->deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU && !m_Headless && qgetenv("PLVK_ALLOW_SOFTWARE") != "1") {
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                     "Vulkan device '%s' is a (probably slow) software renderer. Set PLVK_ALLOW_SOFTWARE=1 to allow using this device.",
                     deviceProps->deviceName);
@@ -363,22 +552,30 @@ bool PlVkRenderer::initialize(PDECODER_PARAMETERS params)
 {
     m_Window = params->window;
 
-    unsigned int instanceExtensionCount = 0;
-    if (!SDL_Vulkan_GetInstanceExtensions(params->window, &instanceExtensionCount, nullptr)) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "SDL_Vulkan_GetInstanceExtensions() #1 failed: %s",
-                     SDL_GetError());
-        m_InitFailureReason = InitFailureReason::NoSoftwareSupport;
-        return false;
-    }
+    // Headless mode doesn't need any of the window surface extensions
+    std::vector<const char*> instanceExtensions;
+    if (!m_Headless) {
+        unsigned int instanceExtensionCount = 0;
+        if (!SDL_Vulkan_GetInstanceExtensions(params->window, &instanceExtensionCount, nullptr)) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "SDL_Vulkan_GetInstanceExtensions() #1 failed: %s",
+                         SDL_GetError());
+            m_InitFailureReason = InitFailureReason::NoSoftwareSupport;
+            return false;
+        }
 
-    std::vector<const char*> instanceExtensions(instanceExtensionCount);
-    if (!SDL_Vulkan_GetInstanceExtensions(params->window, &instanceExtensionCount, instanceExtensions.data())) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "SDL_Vulkan_GetInstanceExtensions() #2 failed: %s",
-                     SDL_GetError());
-        m_InitFailureReason = InitFailureReason::NoSoftwareSupport;
-        return false;
+        instanceExtensions.resize(instanceExtensionCount);
+        if (!SDL_Vulkan_GetInstanceExtensions(params->window, &instanceExtensionCount, instanceExtensions.data())) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "SDL_Vulkan_GetInstanceExtensions() #2 failed: %s",
+                         SDL_GetError());
+            m_InitFailureReason = InitFailureReason::NoSoftwareSupport;
+            return false;
+        }
+    }
+    else {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Using headless Vulkan rendering");
     }
 
     pl_vk_inst_params vkInstParams = pl_vk_inst_default_params;
@@ -386,6 +583,9 @@ bool PlVkRenderer::initialize(PDECODER_PARAMETERS params)
         vkInstParams.debug_extra = !!qEnvironmentVariableIntValue("PLVK_DEBUG_EXTRA");
         vkInstParams.debug = vkInstParams.debug_extra || !!qEnvironmentVariableIntValue("PLVK_DEBUG");
     }
+
+    // Without a Vulkan window, SDL may not have loaded Vulkan. In that case,
+    // libplacebo uses the Vulkan loader it was linked with.
     vkInstParams.get_proc_addr = (PFN_vkGetInstanceProcAddr)SDL_Vulkan_GetVkGetInstanceProcAddr();
     vkInstParams.extensions = instanceExtensions.data();
     vkInstParams.num_extensions = (int)instanceExtensions.size();
@@ -398,21 +598,24 @@ bool PlVkRenderer::initialize(PDECODER_PARAMETERS params)
     }
 
     // Lookup all Vulkan functions we require
-    POPULATE_FUNCTION(vkDestroySurfaceKHR);
     POPULATE_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties2);
-    POPULATE_FUNCTION(vkGetPhysicalDeviceSurfacePresentModesKHR);
-    POPULATE_FUNCTION(vkGetPhysicalDeviceSurfaceFormatsKHR);
     POPULATE_FUNCTION(vkEnumeratePhysicalDevices);
     POPULATE_FUNCTION(vkGetPhysicalDeviceProperties);
-    POPULATE_FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR);
     POPULATE_FUNCTION(vkEnumerateDeviceExtensionProperties);
 
-    if (!SDL_Vulkan_CreateSurface(params->window, m_PlVkInstance->instance, &m_VkSurface)) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "SDL_Vulkan_CreateSurface() failed: %s",
-                     SDL_GetError());
-        m_InitFailureReason = InitFailureReason::NoSoftwareSupport;
-        return false;
+    if (!m_Headless) {
+        POPULATE_FUNCTION(vkDestroySurfaceKHR);
+        POPULATE_FUNCTION(vkGetPhysicalDeviceSurfacePresentModesKHR);
+        POPULATE_FUNCTION(vkGetPhysicalDeviceSurfaceFormatsKHR);
+        POPULATE_FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR);
+
+        if (!SDL_Vulkan_CreateSurface(params->window, m_PlVkInstance->instance, &m_VkSurface)) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "SDL_Vulkan_CreateSurface() failed: %s",
+                         SDL_GetError());
+            m_InitFailureReason = InitFailureReason::NoSoftwareSupport;
+            return false;
+        }
     }
 
     // Enumerate physical devices and choose one that is suitable for our needs.
@@ -424,56 +627,58 @@ bool PlVkRenderer::initialize(PDECODER_PARAMETERS params)
         return false;
     }
 
-    VkPresentModeKHR presentMode;
-    if (params->enableVsync) {
-        // FIFO mode improves frame pacing compared with Mailbox, especially for
-        // platforms like X11 that lack a VSyncSource implementation for Pacer.
-        presentMode = VK_PRESENT_MODE_FIFO_KHR;
-    }
-    else {
-        // We want immediate mode for V-Sync disabled if possible
-        if (isPresentModeSupportedByPhysicalDevice(m_Vulkan->phys_device, VK_PRESENT_MODE_IMMEDIATE_KHR)) {
-            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                        "Using Immediate present mode with V-Sync disabled");
-            presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    if (!m_Headless) {
+        VkPresentModeKHR presentMode;
+        if (params->enableVsync) {
+            // FIFO mode improves frame pacing compared with Mailbox, especially for
+            // platforms like X11 that lack a VSyncSource implementation for Pacer.
+            presentMode = VK_PRESENT_MODE_FIFO_KHR;
         }
         else {
-            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                        "Immediate present mode is not supported by the Vulkan driver. Latency may be higher than normal with V-Sync disabled.");
-
-            // FIFO Relaxed can tear if the frame is running late
-            if (isPresentModeSupportedByPhysicalDevice(m_Vulkan->phys_device, VK_PRESENT_MODE_FIFO_RELAXED_KHR)) {
-                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                            "Using FIFO Relaxed present mode with V-Sync disabled");
-                presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
-            }
-            // Mailbox at least provides non-blocking behavior
-            else if (isPresentModeSupportedByPhysicalDevice(m_Vulkan->phys_device, VK_PRESENT_MODE_MAILBOX_KHR)) {
+            // We want immediate mode for V-Sync disabled if possible
+            if (isPresentModeSupportedByPhysicalDevice(m_Vulkan->phys_device, VK_PRESENT_MODE_IMMEDIATE_KHR)) {
                 SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                            "Using Mailbox present mode with V-Sync disabled");
-                presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+                            "Using Immediate present mode with V-Sync disabled");
+                presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
             }
-            // FIFO is always supported
             else {
-                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                            "Using FIFO present mode with V-Sync disabled");
-                presentMode = VK_PRESENT_MODE_FIFO_KHR;
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Immediate present mode is not supported by the Vulkan driver. Latency may be higher than normal with V-Sync disabled.");
+
+                // FIFO Relaxed can tear if the frame is running late
+                if (isPresentModeSupportedByPhysicalDevice(m_Vulkan->phys_device, VK_PRESENT_MODE_FIFO_RELAXED_KHR)) {
+                    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                                "Using FIFO Relaxed present mode with V-Sync disabled");
+                    presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+                }
+                // Mailbox at least provides non-blocking behavior
+                else if (isPresentModeSupportedByPhysicalDevice(m_Vulkan->phys_device, VK_PRESENT_MODE_MAILBOX_KHR)) {
+                    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                                "Using Mailbox present mode with V-Sync disabled");
+                    presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+                }
+                // FIFO is always supported
+                else {
+                    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                                "Using FIFO present mode with V-Sync disabled");
+                    presentMode = VK_PRESENT_MODE_FIFO_KHR;
+                }
             }
         }
-    }
 
-    pl_vulkan_swapchain_params vkSwapchainParams = {};
-    vkSwapchainParams.surface = m_VkSurface;
-    vkSwapchainParams.present_mode = presentMode;
-    vkSwapchainParams.swapchain_depth = 1; // No queued frames
+        pl_vulkan_swapchain_params vkSwapchainParams = {};
+        vkSwapchainParams.surface = m_VkSurface;
+        vkSwapchainParams.present_mode = presentMode;
+        vkSwapchainParams.swapchain_depth = 1; // No queued frames
 #if PL_API_VER >= 338
-    vkSwapchainParams.disable_10bit_sdr = true; // Some drivers don't dither 10-bit SDR output correctly
+        vkSwapchainParams.disable_10bit_sdr = true; // Some drivers don't dither 10-bit SDR output correctly
 #endif
-    m_Swapchain = pl_vulkan_create_swapchain(m_Vulkan, &vkSwapchainParams);
-    if (m_Swapchain == nullptr) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "pl_vulkan_create_swapchain() failed");
-        return false;
+        m_Swapchain = pl_vulkan_create_swapchain(m_Vulkan, &vkSwapchainParams);
+        if (m_Swapchain == nullptr) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "pl_vulkan_create_swapchain() failed");
+            return false;
+        }
     }
 
     m_Renderer = pl_renderer_create(m_Log, m_Vulkan->gpu);
@@ -536,20 +741,78 @@ bool PlVkRenderer::prepareDecoderContext(AVCodecContext *context, AVDictionary *
     else {
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                     "Using Vulkan renderer");
+
+        // Have software decoders write directly into buffers the GPU can upload from.
+        // This needs buffers that stay mapped and can be allocated from any thread.
+        bool ok;
+        int mappedUpload = qEnvironmentVariableIntValue("PLVK_MAPPED_UPLOAD", &ok);
+        if (m_Backend == nullptr && (!ok || mappedUpload != 0) &&
+                m_Vulkan->gpu->limits.max_mapped_size != 0 && m_Vulkan->gpu->limits.thread_safe &&
+                context->codec != nullptr && (context->codec->capabilities & AV_CODEC_CAP_DR1)) {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Using mapped buffers for frame uploads");
+
+            m_MappedUpload = true;
+            context->get_buffer2 = getMappedBuffer2;
+#if LIBAVCODEC_VERSION_MAJOR < 60
+            AV_NOWARN_DEPRECATED(
+                context->thread_safe_callbacks = 1;
+            )
+#endif
+        }
     }
 
     return true;
 }
 
+bool PlVkRenderer::uploadMappedFrame(const AVFrame* frame, MappedBuffer* mappedBuffer, pl_frame* mappedFrame)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    pl_plane_data planeData[4] = {};
+
+    pl_frame_from_avframe(mappedFrame, frame);
+
+    int planes = pl_plane_data_from_pixfmt(planeData, &mappedFrame->repr.bits, (AVPixelFormat)frame->format);
+    for (int i = 0; i < planes; i++) {
+        // This matches how pl_map_avframe_ex() uploads from host memory, except the
+        // GPU copies straight out of the buffer the decoder wrote the frame into.
+        bool chroma = i == 1 || i == 2;
+        planeData[i].width = AV_CEIL_RSHIFT(frame->width, chroma ? desc->log2_chroma_w : 0);
+        planeData[i].height = AV_CEIL_RSHIFT(frame->height, chroma ? desc->log2_chroma_h : 0);
+        planeData[i].row_stride = frame->linesize[i];
+        planeData[i].buf = mappedBuffer->buf;
+        planeData[i].buf_offset = frame->data[i] - mappedBuffer->buf->data;
+
+        if (!pl_upload_plane(m_Vulkan->gpu, &mappedFrame->planes[i], &m_Textures[i], &planeData[i])) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "pl_upload_plane() failed");
+            return false;
+        }
+    }
+
+    // There's nothing to unmap for frames we uploaded ourselves
+    mappedFrame->user_data = nullptr;
+    return planes != 0;
+}
+
 bool PlVkRenderer::mapAvFrameToPlacebo(const AVFrame *frame, pl_frame* mappedFrame)
 {
-    pl_avframe_params mapParams = {};
-    mapParams.frame = frame;
-    mapParams.tex = m_Textures;
-    if (!pl_map_avframe_ex(m_Vulkan->gpu, mappedFrame, &mapParams)) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "pl_map_avframe_ex() failed");
-        return false;
+    MappedBuffer* mappedBuffer = findMappedBuffer(frame);
+    if (mappedBuffer != nullptr) {
+        if (!uploadMappedFrame(frame, mappedBuffer, mappedFrame)) {
+            // This function logs internally
+            return false;
+        }
+    }
+    else {
+        pl_avframe_params mapParams = {};
+        mapParams.frame = frame;
+        mapParams.tex = m_Textures;
+        if (!pl_map_avframe_ex(m_Vulkan->gpu, mappedFrame, &mapParams)) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "pl_map_avframe_ex() failed");
+            return false;
+        }
     }
 
     // libplacebo assumes a minimum luminance value of 0 means the actual value was unknown.
@@ -571,6 +834,71 @@ bool PlVkRenderer::mapAvFrameToPlacebo(const AVFrame *frame, pl_frame* mappedFra
     return true;
 }
 
+void PlVkRenderer::unmapPlaceboFrame(pl_frame* mappedFrame)
+{
+    if (mappedFrame->user_data != nullptr) {
+        pl_unmap_avframe(m_Vulkan->gpu, mappedFrame);
+    }
+}
+
+bool PlVkRenderer::getHeadlessTargetFrame(const pl_frame* mappedFrame, pl_frame* targetFrame)
+{
+    int width = (int)(mappedFrame->crop.x1 - mappedFrame->crop.x0);
+    int height = (int)(mappedFrame->crop.y1 - mappedFrame->crop.y0);
+
+    // Render at the video resolution, since there's no window to scale to
+    pl_tex_params texParams = {};
+    texParams.w = width;
+    texParams.h = height;
+    texParams.format = pl_find_fmt(m_Vulkan->gpu, PL_FMT_UNORM, 4, 8, 8, PL_FMT_CAP_RENDERABLE);
+    texParams.renderable = true;
+    texParams.debug_tag = PL_DEBUG_TAG;
+    if (texParams.format == nullptr || !pl_tex_recreate(m_Vulkan->gpu, &m_HeadlessTarget, &texParams)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to create %dx%d headless render target",
+                     width,
+                     height);
+        return false;
+    }
+
+    *targetFrame = {};
+    targetFrame->num_planes = 1;
+    targetFrame->planes[0].texture = m_HeadlessTarget;
+    targetFrame->planes[0].components = 4;
+    for (int i = 0; i < 4; i++) {
+        targetFrame->planes[0].component_mapping[i] = i;
+    }
+    targetFrame->repr = pl_color_repr_rgb;
+    targetFrame->color = pl_color_space_srgb;
+    targetFrame->crop = { 0, 0, (float)width, (float)height };
+    return true;
+}
+
+void PlVkRenderer::recordFrameTimings(uint64_t uploadUs, uint64_t renderUs, bool mappedUpload)
+{
+    m_FrameTimings.frames++;
+    m_FrameTimings.lastUploadUs = uploadUs;
+    m_FrameTimings.lastRenderUs = renderUs;
+    m_FrameTimings.lastMappedUpload = mappedUpload;
+    m_FrameTimings.hasLastFrame = true;
+    if (mappedUpload) {
+        m_FrameTimings.mappedUploadFrames++;
+    }
+    m_FrameTimings.totalUploadUs += uploadUs;
+    m_FrameTimings.maxUploadUs = SDL_max(m_FrameTimings.maxUploadUs, uploadUs);
+    m_FrameTimings.totalRenderUs += renderUs;
+    m_FrameTimings.maxRenderUs = SDL_max(m_FrameTimings.maxRenderUs, renderUs);
+
+    if (m_LogFrameTimings) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Vulkan frame %u: upload %.3f ms%s, render %.3f ms",
+                    m_FrameTimings.frames,
+                    uploadUs / 1000.0,
+                    mappedUpload ? " (mapped)" : "",
+                    renderUs / 1000.0);
+    }
+}
+
 bool PlVkRenderer::populateQueues(int videoFormat)
 {
     auto vkDeviceContext = (AVVulkanDeviceContext*)((AVHWDeviceContext *)m_HwDeviceCtx->data)->hwctx;
@@ -714,6 +1042,11 @@ void PlVkRenderer::waitToRender()
         return;
     }
 
+    // In headless mode, renderFrame() never has to wait for a swapchain image
+    if (m_Headless) {
+        return;
+    }
+
 #ifndef Q_OS_WIN32
     // With libplacebo's Vulkan backend, all swap_buffers does is wait for queued
     // presents to finish. This happens to be exactly what we want to do here, since
@@ -757,37 +1090,91 @@ void PlVkRenderer::cleanupRenderContext()
 void PlVkRenderer::renderFrame(AVFrame *frame)
 {
     pl_frame mappedFrame, targetFrame;
+    uint64_t uploadStartUs, uploadUs, renderStartUs;
 
     // If waitToRender() failed to get the next swapchain frame, skip
     // rendering this frame. It probably means the window is occluded.
-    if (!m_HasPendingSwapchainFrame) {
+    if (!m_Headless && !m_HasPendingSwapchainFrame) {
         return;
     }
 
+    uploadStartUs = LiGetMicroseconds();
     if (!mapAvFrameToPlacebo(frame, &mappedFrame)) {
         // This function logs internally
         return;
     }
 
+    // Only frames uploaded from our mapped buffers have no libplacebo mapping state
+    bool mappedUpload = mappedFrame.user_data == nullptr;
+
+    if (m_Headless) {
+        // Wait for the upload to finish, so we measure what it actually costs
+        pl_gpu_finish(m_Vulkan->gpu);
+        uploadUs = LiGetMicroseconds() - uploadStartUs;
+
+        if (!getHeadlessTargetFrame(&mappedFrame, &targetFrame)) {
+            unmapPlaceboFrame(&mappedFrame);
+            return;
+        }
+    }
+    else {
+        uploadUs = LiGetMicroseconds() - uploadStartUs;
+        pl_frame_from_swapchain(&targetFrame, &m_SwapchainFrame);
+    }
+
     // Adjust the swapchain if the colorspace of incoming frames has changed
-    if (!pl_color_space_equal(&mappedFrame.color, &m_LastColorspace)) {
+    if (!m_Headless && !pl_color_space_equal(&mappedFrame.color, &m_LastColorspace)) {
         m_LastColorspace = mappedFrame.color;
         SDL_assert(pl_color_space_equal(&mappedFrame.color, &m_LastColorspace));
         pl_swapchain_colorspace_hint(m_Swapchain, &mappedFrame.color);
     }
 
+    // Overlays belong to the session, which the render benchmark runs without
+    Overlay::OverlayManager* overlayManager = Session::get() != nullptr ? &Session::get()->getOverlayManager() : nullptr;
+
+    // Pick up new overlay text and position its glyphs. This only touches
+    // render thread state, so it's done before taking the overlay lock.
+    for (int i = 0; overlayManager != nullptr && i < Overlay::OverlayMax; i++) {
+        int width;
+        int quadCount = overlayManager->getUpdatedOverlayLayout((Overlay::OverlayType)i,
+                                                                &m_Overlays[i].layoutSerial,
+                                                                m_Overlays[i].quads,
+                                                                &width, &m_Overlays[i].height);
+        if (quadCount >= 0) {
+            m_Overlays[i].quadCount = quadCount;
+        }
+
+        float originX = 0;
+        float originY = 0;
+        if (i == Overlay::OverlayStatusUpdate) {
+            // Bottom Left
+            originY = SDL_max(0, targetFrame.crop.y1 - m_Overlays[i].height);
+        }
+        else if (i == Overlay::OverlayDebug) {
+            // Top left
+            originY = 0;
+        }
+
+        for (int j = 0; j < m_Overlays[i].quadCount; j++) {
+            const Overlay::GlyphQuad& quad = m_Overlays[i].quads[j];
+            pl_overlay_part& part = m_Overlays[i].parts[j];
+
+            part.src = { (float)quad.src.x, (float)quad.src.y,
+                         (float)(quad.src.x + quad.src.w), (float)(quad.src.y + quad.src.h) };
+            part.dst = { originX + quad.dst.x, originY + quad.dst.y,
+                         originX + quad.dst.x + quad.dst.w, originY + quad.dst.y + quad.dst.h };
+        }
+    }
+
     // Reserve enough space to avoid allocating under the overlay lock
-    pl_overlay_part overlayParts[Overlay::OverlayMax] = {};
     std::vector<pl_tex> texturesToDestroy;
     std::vector<pl_overlay> overlays;
     texturesToDestroy.reserve(Overlay::OverlayMax);
     overlays.reserve(Overlay::OverlayMax);
 
-    pl_frame_from_swapchain(&targetFrame, &m_SwapchainFrame);
-
     // We perform minimal processing under the overlay lock to avoid blocking threads updating the overlay
     SDL_AtomicLock(&m_OverlayLock);
-    for (int i = 0; i < Overlay::OverlayMax; i++) {
+    for (int i = 0; overlayManager != nullptr && i < Overlay::OverlayMax; i++) {
         // If we have a staging overlay, we need to transfer ownership to us
         if (m_Overlays[i].hasStagingOverlay) {
             if (m_Overlays[i].hasOverlay) {
@@ -804,30 +1191,15 @@ void PlVkRenderer::renderFrame(AVFrame *frame)
         }
 
         // If we have an overlay but it's been disabled, free the overlay texture
-        if (m_Overlays[i].hasOverlay && !Session::get()->getOverlayManager().isOverlayEnabled((Overlay::OverlayType)i)) {
+        if (m_Overlays[i].hasOverlay && !overlayManager->isOverlayEnabled((Overlay::OverlayType)i)) {
             texturesToDestroy.push_back(m_Overlays[i].overlay.tex);
             m_Overlays[i].hasOverlay = false;
         }
 
         // We have an overlay to draw
-        if (m_Overlays[i].hasOverlay) {
-            // Position the overlay
-            overlayParts[i].src = { 0, 0, (float)m_Overlays[i].overlay.tex->params.w, (float)m_Overlays[i].overlay.tex->params.h };
-            if (i == Overlay::OverlayStatusUpdate) {
-                // Bottom Left
-                overlayParts[i].dst.x0 = 0;
-                overlayParts[i].dst.y0 = SDL_max(0, targetFrame.crop.y1 - overlayParts[i].src.y1);
-            }
-            else if (i == Overlay::OverlayDebug) {
-                // Top left
-                overlayParts[i].dst.x0 = 0;
-                overlayParts[i].dst.y0 = 0;
-            }
-            overlayParts[i].dst.x1 = overlayParts[i].dst.x0 + overlayParts[i].src.x1;
-            overlayParts[i].dst.y1 = overlayParts[i].dst.y0 + overlayParts[i].src.y1;
-
-            m_Overlays[i].overlay.parts = &overlayParts[i];
-            m_Overlays[i].overlay.num_parts = 1;
+        if (m_Overlays[i].hasOverlay && m_Overlays[i].quadCount > 0) {
+            m_Overlays[i].overlay.parts = m_Overlays[i].parts;
+            m_Overlays[i].overlay.num_parts = m_Overlays[i].quadCount;
 
             overlays.push_back(m_Overlays[i].overlay);
         }
@@ -857,12 +1229,22 @@ void PlVkRenderer::renderFrame(AVFrame *frame)
     // Render the video image and overlays into the swapchain buffer
     targetFrame.num_overlays = (int)overlays.size();
     targetFrame.overlays = overlays.data();
+    renderStartUs = LiGetMicroseconds();
     if (!pl_render_image(m_Renderer, &mappedFrame, &targetFrame, &pl_render_fast_params)) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "pl_render_image() failed");
         // NB: We must fallthrough to call pl_swapchain_submit_frame()
     }
 
+    // There's nothing to present in headless mode, so we just wait for the GPU instead
+    if (m_Headless) {
+        pl_gpu_finish(m_Vulkan->gpu);
+        recordFrameTimings(uploadUs, LiGetMicroseconds() - renderStartUs, mappedUpload);
+        goto UnmapExit;
+    }
+
+    recordFrameTimings(uploadUs, LiGetMicroseconds() - renderStartUs, mappedUpload);
+
     // Submit the frame for display and swap buffers
     m_HasPendingSwapchainFrame = false;
     if (!pl_swapchain_submit_frame(m_Swapchain)) {
@@ -888,7 +1270,20 @@ UnmapExit:
         pl_tex_destroy(m_Vulkan->gpu, &texture);
     }
 
-    pl_unmap_avframe(m_Vulkan->gpu, &mappedFrame);
+    unmapPlaceboFrame(&mappedFrame);
+}
+
+bool PlVkRenderer::takeLastFrameTimings(uint64_t* uploadUs, uint64_t* renderUs, bool* mappedUpload)
+{
+    if (!m_FrameTimings.hasLastFrame) {
+        return false;
+    }
+
+    *uploadUs = m_FrameTimings.lastUploadUs;
+    *renderUs = m_FrameTimings.lastRenderUs;
+    *mappedUpload = m_FrameTimings.lastMappedUpload;
+    m_FrameTimings.hasLastFrame = false;
+    return true;
 }
 
 bool PlVkRenderer::testRenderFrame(AVFrame *frame)
@@ -899,16 +1294,43 @@ bool PlVkRenderer::testRenderFrame(AVFrame *frame)
         return false;
     }
 
-    pl_unmap_avframe(m_Vulkan->gpu, &mappedFrame);
+    unmapPlaceboFrame(&mappedFrame);
+    return true;
+}
+
+bool PlVkRenderer::usesGlyphAtlas()
+{
     return true;
 }
 
 void PlVkRenderer::notifyOverlayUpdated(Overlay::OverlayType type)
 {
-    SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type);
-    if (newSurface == nullptr && Session::get()->getOverlayManager().isOverlayEnabled(type)) {
-        // The overlay is enabled and there is no new surface. Leave the old texture alone.
-        return;
+    Overlay::OverlayManager& overlayManager = Session::get()->getOverlayManager();
+    SDL_Surface* newSurface = nullptr;
+
+    if (overlayManager.isOverlayEnabled(type)) {
+        // The render thread picks up new text by itself. The texture only needs
+        // to be replaced when a new glyph was added to the atlas.
+        SDL_Surface* atlas = overlayManager.lockUpdatedGlyphAtlas(type, &m_Overlays[type].atlasGeneration);
+        if (atlas == nullptr) {
+            // Leave the old texture alone.
+            return;
+        }
+
+        // The upload may complete after the atlas changes again, so it gets its own copy
+        newSurface = SDL_DuplicateSurface(atlas);
+        overlayManager.unlockGlyphAtlas();
+        if (newSurface == nullptr) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "SDL_DuplicateSurface() failed: %s",
+                         SDL_GetError());
+            return;
+        }
+    }
+    else {
+        // The render thread frees the texture of a disabled overlay, so the
+        // atlas must be uploaded again when it's re-enabled
+        m_Overlays[type].atlasGeneration = 0;
     }
 
     SDL_AtomicLock(&m_OverlayLock);
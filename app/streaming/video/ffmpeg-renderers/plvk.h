@@ -10,6 +10,25 @@
 #include <libplacebo/renderer.h>
 #include <libplacebo/vulkan.h>
 
+#include <QMutex>
+
+#include <vector>
+
+// Renders decoded frames with libplacebo on Vulkan.
+//
+// With PLVK_HEADLESS=1, frames are rendered into an offscreen texture instead of
+// a swapchain, so no window surface or presentation support is needed. Combined
+// with PLVK_ALLOW_SOFTWARE=1 (implied by headless mode), this lets the renderer
+// run against Mesa's lavapipe on machines without a GPU. Headless mode waits for
+// the GPU after each upload and render, so the reported times are the real cost.
+//
+// Software decoders write their frames straight into persistently mapped host
+// buffers that are uploaded by the GPU, rather than being copied into a staging
+// buffer first. PLVK_MAPPED_UPLOAD=0 disables this for comparison.
+//
+// PLVK_FRAME_TIMINGS=1 logs the upload and render time of each frame. A summary
+// is always logged when the renderer is destroyed. The renderbench command runs
+// synthetic frames through headless mode to measure these without a stream.
 class PlVkRenderer : public IFFmpegRenderer {
 public:
     PlVkRenderer(bool hwaccel = false, IFFmpegRenderer *backendRenderer = nullptr);
@@ -21,6 +40,7 @@ public:
     virtual void waitToRender() override;
     virtual void cleanupRenderContext() override;
     virtual void notifyOverlayUpdated(Overlay::OverlayType) override;
+    virtual bool usesGlyphAtlas() override;
     virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO) override;
     virtual int getRendererAttributes() override;
     virtual int getDecoderColorspace() override;
@@ -29,12 +49,35 @@ public:
     virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
     virtual AVPixelFormat getPreferredPixelFormat(int videoFormat) override;
 
+    // Allocates a software frame in a mapped upload buffer, like the buffers
+    // software decoders get after prepareDecoderContext(). Returns false if the
+    // frame should be allocated normally instead.
+    bool allocateMappedFrame(AVCodecContext* context, AVFrame* frame);
+
+    // Returns the upload and render time of the frame rendered since the last
+    // call, or false if no frame was rendered successfully since then
+    bool takeLastFrameTimings(uint64_t* uploadUs, uint64_t* renderUs, bool* mappedUpload);
+
 private:
     static void lockQueue(AVHWDeviceContext *dev_ctx, uint32_t queue_family, uint32_t index);
     static void unlockQueue(AVHWDeviceContext *dev_ctx, uint32_t queue_family, uint32_t index);
     static void overlayUploadComplete(void* opaque);
+    static int getMappedBuffer2(AVCodecContext* context, AVFrame* frame, int flags);
+    static void releaseMappedBuffer(void* opaque, uint8_t* data);
+
+    struct MappedBuffer {
+        PlVkRenderer* renderer;
+        pl_buf buf;
+        bool inUse;
+    };
 
+    MappedBuffer* acquireMappedBuffer(size_t size);
+    MappedBuffer* findMappedBuffer(const AVFrame* frame);
+    bool uploadMappedFrame(const AVFrame* frame, MappedBuffer* mappedBuffer, pl_frame* mappedFrame);
     bool mapAvFrameToPlacebo(const AVFrame *frame, pl_frame* mappedFrame);
+    void unmapPlaceboFrame(pl_frame* mappedFrame);
+    bool getHeadlessTargetFrame(const pl_frame* mappedFrame, pl_frame* targetFrame);
+    void recordFrameTimings(uint64_t uploadUs, uint64_t renderUs, bool mappedUpload);
     bool populateQueues(int videoFormat);
     bool chooseVulkanDevice(PDECODER_PARAMETERS params, bool hdrOutputRequired);
     bool tryInitializeDevice(VkPhysicalDevice device, VkPhysicalDeviceProperties* deviceProps,
@@ -48,6 +91,10 @@ private:
     IFFmpegRenderer* m_Backend;
     bool m_HwAccelBackend;
 
+    // Render offscreen without a swapchain (PLVK_HEADLESS)
+    bool m_Headless;
+    pl_tex m_HeadlessTarget = nullptr;
+
     // SDL state
     SDL_Window* m_Window = nullptr;
 
@@ -86,11 +133,44 @@ private:
         // as long as hasStagingOverlay is false.
         bool hasStagingOverlay;
         pl_overlay stagingOverlay;
+
+        // The overlay texture is the glyph atlas, so it's only replaced when the atlas
+        // changes. This is written by the overlay update thread.
+        int atlasGeneration;
+
+        // The text layout is fetched and turned into overlay parts by the render thread
+        int layoutSerial;
+        int quadCount;
+        int height;
+        Overlay::GlyphQuad quads[OVERLAY_MAX_GLYPHS];
+        pl_overlay_part parts[OVERLAY_MAX_GLYPHS];
     } m_Overlays[Overlay::OverlayMax] = {};
 
     // Device context used for hwaccel decoders
     AVBufferRef* m_HwDeviceCtx = nullptr;
 
+    // Persistently mapped upload buffers that software decoders decode into.
+    // These are allocated from the decoder threads and released by whichever
+    // thread drops the last reference to the frame.
+    bool m_MappedUpload;
+    QMutex m_MappedBufferLock;
+    std::vector<MappedBuffer*> m_MappedBuffers;
+
+    // Upload and render timings, only touched by the render thread
+    bool m_LogFrameTimings;
+    struct {
+        uint32_t frames;
+        uint32_t mappedUploadFrames;
+        uint64_t totalUploadUs;
+        uint64_t maxUploadUs;
+        uint64_t totalRenderUs;
+        uint64_t maxRenderUs;
+        uint64_t lastUploadUs;
+        uint64_t lastRenderUs;
+        bool lastMappedUpload;
+        bool hasLastFrame;
+    } m_FrameTimings = {};
+
     // Vulkan functions we call directly
     PFN_vkDestroySurfaceKHR fn_vkDestroySurfaceKHR = nullptr;
     PFN_vkGetPhysicalDeviceQueueFamilyProperties2 fn_vkGetPhysicalDeviceQueueFamilyProperties2 = nullptr;
@@ -22,7 +22,7 @@ SdlRenderer::SdlRenderer()
       m_RgbFrame(av_frame_alloc()),
       m_SwFrameMapper(this)
 {
-    SDL_zero(m_OverlayTextures);
+    SDL_zero(m_Overlays);
 
 #ifdef HAVE_CUDA
     m_CudaGLHelper = nullptr;
@@ -38,8 +38,8 @@ SdlRenderer::~SdlRenderer()
 #endif
 
     for (int i = 0; i < Overlay::OverlayMax; i++) {
-        if (m_OverlayTextures[i] != nullptr) {
-            SDL_DestroyTexture(m_OverlayTextures[i]);
+        if (m_Overlays[i].atlasTexture != nullptr) {
+            SDL_DestroyTexture(m_Overlays[i].atlasTexture);
         }
     }
 
@@ -221,41 +221,61 @@ bool SdlRenderer::initialize(PDECODER_PARAMETERS params)
     return true;
 }
 
+bool SdlRenderer::usesGlyphAtlas()
+{
+    return true;
+}
+
 void SdlRenderer::renderOverlay(Overlay::OverlayType type)
 {
-    if (Session::get()->getOverlayManager().isOverlayEnabled(type)) {
-        // If a new surface has been created for updated overlay data, convert it into a texture.
+    Overlay::OverlayManager& overlayManager = Session::get()->getOverlayManager();
+
+    if (overlayManager.isOverlayEnabled(type)) {
+        // If the glyph atlas has changed, convert it into a texture. This only happens
+        // when a glyph is drawn for the first time, not for each overlay update.
         // NB: We have to do this conversion at render-time because we can only interact
         // with the renderer on a single thread.
-        SDL_Surface* newSurface = Session::get()->getOverlayManager().getUpdatedOverlaySurface(type);
-        if (newSurface != nullptr) {
-            if (m_OverlayTextures[type] != nullptr) {
-                SDL_DestroyTexture(m_OverlayTextures[type]);
+        SDL_Surface* atlas = overlayManager.lockUpdatedGlyphAtlas(type, &m_Overlays[type].atlasGeneration);
+        if (atlas != nullptr) {
+            if (m_Overlays[type].atlasTexture != nullptr) {
+                SDL_DestroyTexture(m_Overlays[type].atlasTexture);
             }
 
-            if (type == Overlay::OverlayStatusUpdate) {
-                // Bottom Left
-                SDL_Rect viewportRect;
-                SDL_RenderGetViewport(m_Renderer, &viewportRect);
-                m_OverlayRects[type].x = 0;
-                m_OverlayRects[type].y = viewportRect.h - newSurface->h;
-            }
-            else if (type == Overlay::OverlayDebug) {
-                // Top left
-                m_OverlayRects[type].x = 0;
-                m_OverlayRects[type].y = 0;
-            }
+            m_Overlays[type].atlasTexture = SDL_CreateTextureFromSurface(m_Renderer, atlas);
+            overlayManager.unlockGlyphAtlas();
+        }
 
-            m_OverlayRects[type].w = newSurface->w;
-            m_OverlayRects[type].h = newSurface->h;
+        int width;
+        int quadCount = overlayManager.getUpdatedOverlayLayout(type, &m_Overlays[type].layoutSerial,
+                                                               m_Overlays[type].quads,
+                                                               &width, &m_Overlays[type].height);
+        if (quadCount >= 0) {
+            m_Overlays[type].quadCount = quadCount;
+        }
 
-            m_OverlayTextures[type] = SDL_CreateTextureFromSurface(m_Renderer, newSurface);
-            SDL_FreeSurface(newSurface);
+        if (m_Overlays[type].atlasTexture == nullptr) {
+            return;
+        }
+
+        SDL_Point origin;
+        if (type == Overlay::OverlayStatusUpdate) {
+            // Bottom Left
+            SDL_Rect viewportRect;
+            SDL_RenderGetViewport(m_Renderer, &viewportRect);
+            origin.x = 0;
+            origin.y = viewportRect.h - m_Overlays[type].height;
+        }
+        else {
+            // Top left
+            origin.x = 0;
+            origin.y = 0;
         }
 
-        // If we have an overlay texture, render it too
-        if (m_OverlayTextures[type] != nullptr) {
-            SDL_RenderCopy(m_Renderer, m_OverlayTextures[type], nullptr, &m_OverlayRects[type]);
+        // SDL batches these copies into a single draw where the backend supports it
+        for (int i = 0; i < m_Overlays[type].quadCount; i++) {
+            const Overlay::GlyphQuad& quad = m_Overlays[type].quads[i];
+            SDL_Rect dstRect = { origin.x + quad.dst.x, origin.y + quad.dst.y, quad.dst.w, quad.dst.h };
+            SDL_RenderCopy(m_Renderer, m_Overlays[type].atlasTexture, &quad.src, &dstRect);
         }
     }
 }
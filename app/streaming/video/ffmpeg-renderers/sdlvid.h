@@ -23,6 +23,7 @@ public:
     virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
     virtual bool testRenderFrame(AVFrame* frame) override;
     virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO) override;
+    virtual bool usesGlyphAtlas() override;
 
 private:
     void renderOverlay(Overlay::OverlayType type);
@@ -32,8 +33,16 @@ private:
     int m_VideoFormat;
     SDL_Renderer* m_Renderer;
     SDL_Texture* m_Texture;
-    SDL_Texture* m_OverlayTextures[Overlay::OverlayMax];
-    SDL_Rect m_OverlayRects[Overlay::OverlayMax];
+
+    // Overlays are drawn glyph by glyph from a texture of the glyph atlas
+    struct {
+        SDL_Texture* atlasTexture;
+        int atlasGeneration;
+        int layoutSerial;
+        int quadCount;
+        int height;
+        Overlay::GlyphQuad quads[OVERLAY_MAX_GLYPHS];
+    } m_Overlays[Overlay::OverlayMax];
 
     // Used for CPU conversion of YUV to RGB if needed
     bool m_NeedsYuvToRgbConversion;
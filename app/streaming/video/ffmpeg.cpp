@@ -5,6 +5,9 @@
 
 #include <h264_stream.h>
 
+#include <QMutexLocker>
+#include <QVarLengthArray>
+
 extern "C" {
 #include <libavutil/mastering_display_metadata.h>
 #include <libavutil/pixdesc.h>
@@ -56,6 +59,7 @@ extern "C" {
 #define MAX_DECODER_PASS 2
 
 #define MAX_SPS_EXTRA_SIZE 16
+#define MAX_PARAMETER_SET_FIXUP_CACHE_SIZE 8
 
 #define FAILED_DECODES_RESET_THRESHOLD 20
 
@@ -134,6 +138,11 @@ int FFmpegVideoDecoder::getDecoderCapabilities()
 
             // Enable AV1 RFI when using the libdav1d software decoder
             capabilities |= CAPABILITY_REFERENCE_FRAME_INVALIDATION_AV1;
+
+            // Receive slices as soon as they arrive if we can decode them early
+            if (m_SubframeDecode) {
+                capabilities |= CAPABILITY_SUBFRAME_SUBMIT;
+            }
         }
         else if (m_HwDecodeCfg == nullptr) {
             // We have a non-hwaccel hardware decoder. This will always
@@ -231,11 +240,18 @@ FFmpegVideoDecoder::FFmpegVideoDecoder(bool testOnly)
       m_FramesIn(0),
       m_FramesOut(0),
       m_LastFrameNumber(0),
+      m_LastJitterReceiveTimeUs(0),
+      m_LastJitterRtpTimestamp(0),
+      m_NetworkJitterUs(0),
       m_StreamFps(0),
       m_VideoFormat(0),
       m_NeedsSpsFixup(false),
+      m_SubframeDecode(false),
+      m_PartialFrameNumber(0),
       m_TestOnly(testOnly),
-      m_DecoderThread(nullptr)
+      m_DecoderThread(nullptr),
+      m_ReceiveThread(nullptr),
+      m_AvgAsyncOutputLatencyUs(0)
 {
     SDL_zero(m_ActiveWndVideoStats);
     SDL_zero(m_LastWndVideoStats);
@@ -273,16 +289,32 @@ void FFmpegVideoDecoder::reset()
 {
     // Terminate the decoder thread before doing anything else.
     // It might be touching things we're about to free.
-    if (m_DecoderThread != nullptr) {
+    if (m_DecoderThread != nullptr || m_ReceiveThread != nullptr) {
         SDL_AtomicSet(&m_DecoderThreadShouldQuit, 1);
-        LiWakeWaitForVideoFrame();
-        SDL_WaitThread(m_DecoderThread, NULL);
+
+        if (m_DecoderThread != nullptr) {
+            LiWakeWaitForVideoFrame();
+            SDL_WaitThread(m_DecoderThread, NULL);
+            m_DecoderThread = nullptr;
+        }
+
+        if (m_ReceiveThread != nullptr) {
+            m_DecoderLock.lock();
+            m_FramesInFlight.wakeAll();
+            m_DecoderLock.unlock();
+
+            SDL_WaitThread(m_ReceiveThread, NULL);
+            m_ReceiveThread = nullptr;
+        }
+
         SDL_AtomicSet(&m_DecoderThreadShouldQuit, 0);
-        m_DecoderThread = nullptr;
     }
 
     m_FramesIn = m_FramesOut = 0;
     m_FrameInfoQueue.clear();
+    m_AvgAsyncOutputLatencyUs = 0;
+    m_SubframeDecode = false;
+    m_PartialFrameNumber = 0;
 
     delete m_Pacer;
     m_Pacer = nullptr;
@@ -533,6 +565,14 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, enum AVP
     if (!isHardwareAccelerated()) {
         m_VideoDecoderCtx->thread_type = FF_THREAD_SLICE;
         m_VideoDecoderCtx->thread_count = qMin(MAX_SLICES, SDL_GetCPUCount());
+
+        // FFmpeg's H.264 decoder can decode slices before the rest of the frame
+        // has arrived, which lets us overlap decoding with the network transfer
+        // of large multi-slice frames. This is opt-in for now.
+        if ((params->videoFormat & VIDEO_FORMAT_MASK_H264) && qEnvironmentVariableIntValue("SUBFRAME_DECODE") != 0) {
+            m_VideoDecoderCtx->flags2 |= AV_CODEC_FLAG2_CHUNKS;
+            m_SubframeDecode = true;
+        }
     }
     else {
         // No threading for HW decode
@@ -728,6 +768,19 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, enum AVP
 
         // Only create the decoder thread when instantiating the decoder for real. It will use APIs from
     // moonlight-common-c that can only be legally called with an established connection.
+    //
+    // Hardware decoders that aren't FFmpeg hwaccels (V4L2 M2M, MMAL, RKMPP, etc.) return EAGAIN
+    // while the hardware is still working on a frame, so they get a separate thread to wait for
+    // their output. Every other decoder produces output synchronously as input is submitted.
+    if (m_HwDecodeCfg == nullptr && (getAVCodecCapabilities(decoder) & AV_CODEC_CAP_HARDWARE)) {
+        m_ReceiveThread = SDL_CreateThread(FFmpegVideoDecoder::receiveThreadProcThunk, "FFReceive", (void*)this);
+        if (m_ReceiveThread == nullptr) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Failed to create receive thread: %s", SDL_GetError());
+            return false;
+        }
+    }
+
     m_DecoderThread = SDL_CreateThread(FFmpegVideoDecoder::decoderThreadProcThunk, "FFDecoder", (void*)this);
     if (m_DecoderThread == nullptr) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -759,10 +812,27 @@ void FFmpegVideoDecoder::addVideoStats(VIDEO_STATS& src, VIDEO_STATS& dst)
     dst.totalFrames += src.totalFrames;
     dst.networkDroppedFrames += src.networkDroppedFrames;
     dst.pacerDroppedFrames += src.pacerDroppedFrames;
+    dst.latencySkippedFrames += src.latencySkippedFrames;
     dst.totalReassemblyTimeUs += src.totalReassemblyTimeUs;
     dst.totalDecodeTimeUs += src.totalDecodeTimeUs;
     dst.totalPacerTimeUs += src.totalPacerTimeUs;
     dst.totalRenderTimeUs += src.totalRenderTimeUs;
+    dst.totalVsyncSlackUs += src.totalVsyncSlackUs;
+    dst.framesWithVsyncSlack += src.framesWithVsyncSlack;
+    dst.missedVsyncFrames += src.missedVsyncFrames;
+    dst.totalDecodeQueueWaitUs += src.totalDecodeQueueWaitUs;
+    dst.maxDecodeQueueWaitUs = qMax(dst.maxDecodeQueueWaitUs, src.maxDecodeQueueWaitUs);
+    for (int i = 0; i < DECODE_QUEUE_WAIT_BUCKETS; i++) {
+        dst.decodeQueueWaitBuckets[i] += src.decodeQueueWaitBuckets[i];
+    }
+    dst.totalReceiveDelayUs += src.totalReceiveDelayUs;
+    dst.maxReceiveDelayUs = qMax(dst.maxReceiveDelayUs, src.maxReceiveDelayUs);
+    dst.framesWithReceiveDelay += src.framesWithReceiveDelay;
+
+    // Jitter is a running estimate, so the most recent one wins
+    if (src.networkJitterUs != 0) {
+        dst.networkJitterUs = src.networkJitterUs;
+    }
 
     if (dst.minHostProcessingLatency == 0) {
         dst.minHostProcessingLatency = src.minHostProcessingLatency;
@@ -935,12 +1005,119 @@ void FFmpegVideoDecoder::stringifyVideoStats(VIDEO_STATS& stats, char* output, i
 
         offset += ret;
     }
+
+    if (stats.latencySkippedFrames != 0) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Frames skipped for latency: %.2f%%\n",
+                       stats.totalFrames > 0 ? (float)stats.latencySkippedFrames / stats.totalFrames * 100 : 0.0f);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    if (stats.framesWithVsyncSlack != 0 || stats.missedVsyncFrames != 0) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "V-sync slack: %.1f ms (%u missed)\n",
+                       stats.framesWithVsyncSlack > 0 ? (double)(stats.totalVsyncSlackUs / 1000.0) / stats.framesWithVsyncSlack : 0.0,
+                       stats.missedVsyncFrames);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    uint32_t framesWithQueueWait = 0;
+    for (int i = 0; i < DECODE_QUEUE_WAIT_BUCKETS; i++) {
+        framesWithQueueWait += stats.decodeQueueWaitBuckets[i];
+    }
+    if (framesWithQueueWait != 0) {
+        const uint32_t* buckets = stats.decodeQueueWaitBuckets;
+
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Decode queue wait: %.2f ms (max %.2f ms)\n"
+                       "<0.25/0.5/1/2/4/4+ ms: %.0f/%.0f/%.0f/%.0f/%.0f/%.0f%%\n",
+                       (double)(stats.totalDecodeQueueWaitUs / 1000.0) / framesWithQueueWait,
+                       stats.maxDecodeQueueWaitUs / 1000.0,
+                       (double)buckets[0] / framesWithQueueWait * 100,
+                       (double)buckets[1] / framesWithQueueWait * 100,
+                       (double)buckets[2] / framesWithQueueWait * 100,
+                       (double)buckets[3] / framesWithQueueWait * 100,
+                       (double)buckets[4] / framesWithQueueWait * 100,
+                       (double)buckets[5] / framesWithQueueWait * 100);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    if (stats.networkJitterUs != 0 || stats.framesWithReceiveDelay != 0) {
+        // Receive delay is only known with kernel receive timestamps
+        if (stats.framesWithReceiveDelay != 0) {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Network jitter: %.2f ms, receive delay: %.2f ms (max %.2f ms)\n",
+                           stats.networkJitterUs / 1000.0,
+                           (double)(stats.totalReceiveDelayUs / 1000.0) / stats.framesWithReceiveDelay,
+                           stats.maxReceiveDelayUs / 1000.0);
+        }
+        else {
+            ret = snprintf(&output[offset],
+                           length - offset,
+                           "Network jitter: %.2f ms\n",
+                           stats.networkJitterUs / 1000.0);
+        }
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    Session* session = Session::get();
+    int avSyncOffsetMs;
+    if (session != nullptr && session->getAvSyncController().getOffsetMs(&avSyncOffsetMs)) {
+        // Positive when audio is ahead of video
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "A/V offset: %+d ms\n",
+                       avSyncOffsetMs);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
+    if (session != nullptr && session->getLastVideoReconfigureTimeMs() != 0) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "Video mode change: %d ms to first frame\n",
+                       session->getLastVideoReconfigureTimeMs());
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
 }
 
 void FFmpegVideoDecoder::logVideoStats(VIDEO_STATS& stats, const char* title)
 {
     if (stats.renderedFps > 0 || stats.renderedFrames != 0) {
-        char videoStatsStr[512];
+        char videoStatsStr[1024];
         stringifyVideoStats(stats, videoStatsStr, sizeof(videoStatsStr));
 
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
@@ -1712,52 +1889,107 @@ bool FFmpegVideoDecoder::initialize(PDECODER_PARAMETERS params)
     return false;
 }
 
+bool FFmpegVideoDecoder::fixupH264Sps(const char* data, int length, QByteArray& fixedSps)
+{
+    int nalStart, nalEnd;
+
+    // Find the old NALU
+    find_nal_unit((uint8_t*)data, length, &nalStart, &nalEnd);
+
+    SDL_assert(nalStart == 3 || nalStart == 4); // 3 or 4 byte Annex B start sequence
+    SDL_assert(nalEnd == length);
+    if (nalStart != 3 && nalStart != 4) {
+        return false;
+    }
+
+    // Parse just the SPS on the stack rather than allocating a whole h264_stream_t.
+    // An SPS is small enough that the RBSP buffers don't need the heap either.
+    int nalSize = nalEnd - nalStart;
+    int rbspSize = nalSize;
+    QVarLengthArray<uint8_t, 256> rbsp(rbspSize);
+    if (nal_to_rbsp((const uint8_t*)&data[nalStart], &nalSize, rbsp.data(), &rbspSize) < 0 || rbspSize < 2) {
+        return false;
+    }
+
+    sps_t sps;
+    bs_t bs;
+
+    // Skip the NALU header byte
+    bs_init(&bs, rbsp.data() + 1, rbspSize - 1);
+    read_seq_parameter_set_rbsp(&sps, &bs);
+    if (bs_overrun(&bs)) {
+        return false;
+    }
+
+    // Fixup the SPS to what OS X needs to use hardware acceleration
+    // This is also critical for decoding latency on the Pi 2.
+    sps.num_ref_frames = 1;
+    sps.vui.max_dec_frame_buffering = 1;
+
+    // NVENC doesn't seem to add bitstream restrictions anymore (591.59),
+    // so we need to add them ourselves if not present to ensure that
+    // the max_dec_frame_buffering option actually takes effect.
+    // We use the defaults for everything except max_dec_frame_buffering.
+    if (!sps.vui.bitstream_restriction_flag) {
+        sps.vui.bitstream_restriction_flag = 1;
+        sps.vui.motion_vectors_over_pic_boundaries_flag = 1;
+        sps.vui.max_bytes_per_pic_denom = 2;
+        sps.vui.max_bits_per_mb_denom = 1;
+        sps.vui.log2_max_mv_length_horizontal = 16;
+        sps.vui.log2_max_mv_length_vertical = 16;
+        sps.vui.num_reorder_frames = 0;
+    }
+
+    QVarLengthArray<uint8_t, 256> fixedRbsp(rbspSize + MAX_SPS_EXTRA_SIZE);
+    bs_init(&bs, fixedRbsp.data(), fixedRbsp.size());
+    bs_write_u8(&bs, rbsp[0]);
+    write_seq_parameter_set_rbsp(&sps, &bs);
+    write_rbsp_trailing_bits(&bs);
+    if (bs_overrun(&bs)) {
+        return false;
+    }
+    rbspSize = bs_pos(&bs);
+
+    // Escaping can grow the RBSP by half in the worst case. rbsp_to_nal() starts
+    // writing NALU data at byte 1, so we point it at the last start sequence byte
+    // and put the start sequence back afterwards.
+    nalSize = rbspSize + (rbspSize + 1) / 2 + 1;
+    fixedSps.resize(nalStart - 1 + nalSize);
+    if (rbsp_to_nal(fixedRbsp.data(), &rbspSize, (uint8_t*)&fixedSps.data()[nalStart - 1], &nalSize) < 0) {
+        return false;
+    }
+    memcpy(fixedSps.data(), data, nalStart);
+    fixedSps.resize(nalStart - 1 + nalSize);
+
+    return true;
+}
+
 void FFmpegVideoDecoder::writeBuffer(PLENTRY entry, int& offset)
 {
     if (m_NeedsSpsFixup && entry->bufferType == BUFFER_TYPE_SPS) {
-        h264_stream_t* stream = h264_new();
-        int nalStart, nalEnd;
-
-        // Read the old NALU
-        find_nal_unit((uint8_t*)entry->data, entry->length, &nalStart, &nalEnd);
-        read_nal_unit(stream,
-                      (unsigned char *)&entry->data[nalStart],
-                      nalEnd - nalStart);
-
-        SDL_assert(nalStart == 3 || nalStart == 4); // 3 or 4 byte Annex B start sequence
-        SDL_assert(nalEnd == entry->length);
-
-        // Fixup the SPS to what OS X needs to use hardware acceleration
-        // This is also critical for decoding latency on the Pi 2.
-        stream->sps->num_ref_frames = 1;
-        stream->sps->vui.max_dec_frame_buffering = 1;
-
-        // NVENC doesn't seem to add bitstream restrictions anymore (591.59),
-        // so we need to add them ourselves if not present to ensure that
-        // the max_dec_frame_buffering option actually takes effect.
-        // We use the defaults for everything except max_dec_frame_buffering.
-        if (!stream->sps->vui.bitstream_restriction_flag) {
-            stream->sps->vui.bitstream_restriction_flag = 1;
-            stream->sps->vui.motion_vectors_over_pic_boundaries_flag = 1;
-            stream->sps->vui.max_bytes_per_pic_denom = 2;
-            stream->sps->vui.max_bits_per_mb_denom = 1;
-            stream->sps->vui.log2_max_mv_length_horizontal = 16;
-            stream->sps->vui.log2_max_mv_length_vertical = 16;
-            stream->sps->vui.num_reorder_frames = 0;
-        }
-
-        int initialOffset = offset;
-
-        // Copy the modified NALU data. This clobbers byte 0 and starts NALU data at byte 1.
-        // Since it prepended one extra byte, subtract one from the returned length.
-        offset += write_nal_unit(stream, (uint8_t*)&m_DecodeBuffer.data()[initialOffset + nalStart - 1],
-                                 MAX_SPS_EXTRA_SIZE + entry->length - nalStart) - 1;
-
-        // Copy the NALU prefix over from the original SPS
-        memcpy(&m_DecodeBuffer.data()[initialOffset], entry->data, nalStart);
-        offset += nalStart;
-
-        h264_free(stream);
+        // Hosts send the same SPS with every IDR frame, so each one is only
+        // rewritten the first time we see it.
+        auto it = m_ParameterSetFixupCache.constFind(QByteArray::fromRawData(entry->data, entry->length));
+        if (it == m_ParameterSetFixupCache.constEnd()) {
+            QByteArray fixedSps;
+
+            // Only room for MAX_SPS_EXTRA_SIZE more bytes was reserved in the decode buffer
+            if (!fixupH264Sps(entry->data, entry->length, fixedSps) || fixedSps.size() > entry->length + MAX_SPS_EXTRA_SIZE) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                            "Failed to fix up SPS; passing it through unmodified");
+                fixedSps = QByteArray(entry->data, entry->length);
+            }
+
+            // A stream only uses a few different SPSs, so this never really fills up
+            if (m_ParameterSetFixupCache.size() >= MAX_PARAMETER_SET_FIXUP_CACHE_SIZE) {
+                m_ParameterSetFixupCache.clear();
+            }
+
+            it = m_ParameterSetFixupCache.insert(QByteArray(entry->data, entry->length), fixedSps);
+        }
+
+        memcpy(&m_DecodeBuffer.data()[offset], it->constData(), it->size());
+        offset += it->size();
     }
     else {
         // Write the buffer as-is
@@ -1834,7 +2066,13 @@ void FFmpegVideoDecoder::processQueuedFrames()
                 // Count time in avcodec_send_packet() and avcodec_receive_frame()
                 // as time spent decoding. Also count time spent in the decode unit
                 // queue because that's directly caused by decoder latency.
-                m_ActiveWndVideoStats.totalDecodeTimeUs += (LiGetMicroseconds() - du.enqueueTimeUs);
+                uint64_t decodeTimeUs = LiGetMicroseconds() - du.enqueueTimeUs;
+                m_ActiveWndVideoStats.totalDecodeTimeUs += decodeTimeUs;
+
+                // The receive thread uses this to estimate when the next frame will be ready
+                m_AvgAsyncOutputLatencyUs = m_AvgAsyncOutputLatencyUs != 0 ?
+                                                (m_AvgAsyncOutputLatencyUs * 7 + decodeTimeUs) / 8 :
+                                                decodeTimeUs;
 
                 // Store the presentation time (90 kHz timebase)
                 frame->pts = (int64_t)du.rtpTimestamp;
@@ -1893,47 +2131,116 @@ void FFmpegVideoDecoder::decoderThreadProc()
 {
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Decoder thread started (Thread ID: %lu)", SDL_ThreadID());
 
-    while (!SDL_AtomicGet(&m_DecoderThreadShouldQuit)) {
-        if (m_FramesIn == m_FramesOut) {
-            VIDEO_FRAME_HANDLE handle;
-            PDECODE_UNIT du;
-
-            // Waiting for input. All output frames have been received.
-            // Block until we receive a new frame from the host.
-            // SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Waiting for next video frame (In: %d, Out: %d)", m_FramesIn, m_FramesOut);
-            if (!LiWaitForNextVideoFrame(&handle, &du)) {
-                // This might be a signal from the main thread to exit
-                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "LiWaitForNextVideoFrame returned false");
-                continue;
-            }
+    Session* session = Session::get();
+    LowLatencyProfile* lowLatencyProfile = session != nullptr ? session->getLowLatencyProfile() : nullptr;
+    if (lowLatencyProfile != nullptr) {
+        lowLatencyProfile->applyToCurrentThread("FFDecoder", LowLatencyProfile::TR_DECODE);
+    }
 
-            // SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Received video frame %d", du->frameNumber);
-            LiCompleteVideoFrame(handle, submitDecodeUnit(du));
+    while (!SDL_AtomicGet(&m_DecoderThreadShouldQuit)) {
+        VIDEO_FRAME_HANDLE handle;
+        PDECODE_UNIT du;
+        int drStatus;
+
+        // Block until we receive a new frame from the host. This is the only place
+        // the decoder thread waits. Decoders without a receive thread produce their
+        // output in response to input, so there's nothing to poll for in between.
+        // SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Waiting for next video frame (In: %d, Out: %d)", m_FramesIn, m_FramesOut);
+        if (!LiWaitForNextVideoFrame(&handle, &du)) {
+            // This might be a signal from the main thread to exit
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "LiWaitForNextVideoFrame returned false");
+            continue;
         }
 
-        if (m_FramesIn != m_FramesOut) {
-            SDL_assert(m_FramesIn > m_FramesOut);
+        {
+            QMutexLocker locker(&m_DecoderLock);
+
+            recordDecodeQueueWait(du);
 
-            // We have output frames to receive. Let's poll until we get one,
-            // and submit new input data if/when we get it.
-            processQueuedFrames();
+            // SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Received video frame %d", du->frameNumber);
+            drStatus = submitDecodeUnit(du);
 
-            if (m_FramesIn != m_FramesOut && !SDL_AtomicGet(&m_DecoderThreadShouldQuit)) {
-                VIDEO_FRAME_HANDLE handle;
-                PDECODE_UNIT du;
+            if (m_FramesIn != m_FramesOut) {
+                SDL_assert(m_FramesIn > m_FramesOut);
 
-                // No output data, so let's try to submit more input data,
-                // while we're waiting for this to frame to come back.
-                if (LiPollNextVideoFrame(&handle, &du)) {
-                    LiCompleteVideoFrame(handle, submitDecodeUnit(du));
+                if (m_ReceiveThread != nullptr) {
+                    m_FramesInFlight.wakeOne();
                 }
                 else {
-                    // No output data or input data. Let's wait a little bit.
-                    SDL_Delay(2);
+                    // Receive everything this input produced. If the decoder returns EAGAIN
+                    // with frames still in flight, it needs more input to produce them.
+                    processQueuedFrames();
                 }
             }
         }
+
+        LiCompleteVideoFrame(handle, drStatus);
+    }
+
+    // Make sure the receive thread notices if we're the one that decided to quit
+    if (m_ReceiveThread != nullptr) {
+        QMutexLocker locker(&m_DecoderLock);
+        m_FramesInFlight.wakeAll();
+    }
+}
+
+int FFmpegVideoDecoder::receiveThreadProcThunk(void *context)
+{
+    ((FFmpegVideoDecoder*)context)->receiveThreadProc();
+    return 0;
+}
+
+void FFmpegVideoDecoder::receiveThreadProc()
+{
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Receive thread started (Thread ID: %lu)", SDL_ThreadID());
+
+    Session* session = Session::get();
+    LowLatencyProfile* lowLatencyProfile = session != nullptr ? session->getLowLatencyProfile() : nullptr;
+    if (lowLatencyProfile != nullptr) {
+        lowLatencyProfile->applyToCurrentThread("FFReceive", LowLatencyProfile::TR_DECODE);
+    }
+
+    QMutexLocker locker(&m_DecoderLock);
+
+    while (!SDL_AtomicGet(&m_DecoderThreadShouldQuit)) {
+        if (m_FramesIn == m_FramesOut) {
+            // Nothing is in flight, so wait for the decoder thread to submit a frame
+            m_FramesInFlight.wait(&m_DecoderLock);
+            continue;
+        }
+
+        processQueuedFrames();
+
+        if (m_FramesIn != m_FramesOut && !SDL_AtomicGet(&m_DecoderThreadShouldQuit) && !m_FrameInfoQueue.isEmpty()) {
+            // The hardware is still working, and FFmpeg can't tell us when it's done.
+            // Wait until the oldest frame in flight should be ready based on how long
+            // recent frames took, or until more input arrives. If it's already late,
+            // check back in a fraction of the usual decode time.
+            uint64_t nowUs = LiGetMicroseconds();
+            uint64_t expectedUs = m_FrameInfoQueue.head().enqueueTimeUs + m_AvgAsyncOutputLatencyUs;
+            uint64_t waitUs = expectedUs > nowUs ? expectedUs - nowUs : m_AvgAsyncOutputLatencyUs / 4;
+
+            m_FramesInFlight.wait(&m_DecoderLock, (unsigned long)qMax<uint64_t>(1, (waitUs + 999) / 1000));
+        }
     }
+
+    // A decoder failure seen here must also stop the decoder thread
+    LiWakeWaitForVideoFrame();
+}
+
+void FFmpegVideoDecoder::recordDecodeQueueWait(PDECODE_UNIT du)
+{
+    static const uint32_t k_BucketLimitsUs[DECODE_QUEUE_WAIT_BUCKETS - 1] = { 250, 500, 1000, 2000, 4000 };
+    uint32_t waitUs = (uint32_t)qMin<uint64_t>(LiGetMicroseconds() - du->enqueueTimeUs, UINT32_MAX);
+    int bucket = 0;
+
+    while (bucket < DECODE_QUEUE_WAIT_BUCKETS - 1 && waitUs >= k_BucketLimitsUs[bucket]) {
+        bucket++;
+    }
+
+    m_ActiveWndVideoStats.totalDecodeQueueWaitUs += waitUs;
+    m_ActiveWndVideoStats.maxDecodeQueueWaitUs = qMax(m_ActiveWndVideoStats.maxDecodeQueueWaitUs, waitUs);
+    m_ActiveWndVideoStats.decodeQueueWaitBuckets[bucket]++;
 }
 
 int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
@@ -1943,26 +2250,52 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
 
     SDL_assert(!m_TestOnly);
 
+    // If we were given part of a frame that never completed, the decoder is
+    // holding a partial picture. Throw it away, since the depacketizer will
+    // have started over with an IDR frame.
+    if (m_PartialFrameNumber != 0 && du->frameNumber != m_PartialFrameNumber) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Discarding incomplete frame %d",
+                    m_PartialFrameNumber);
+        avcodec_flush_buffers(m_VideoDecoderCtx);
+        m_FrameInfoQueue.clear();
+        m_FramesOut = m_FramesIn;
+        m_PartialFrameNumber = 0;
+
+        if (du->frameType != FRAME_TYPE_IDR) {
+            return DR_NEED_IDR;
+        }
+    }
+
     // If this is the first frame, reject anything that's not an IDR frame
     if (m_FramesIn == 0 && du->frameType != FRAME_TYPE_IDR) {
         return DR_NEED_IDR;
     }
 
-    if (!m_LastFrameNumber) {
+    // Continuations of a partially submitted frame only carry more slice data
+    bool continuation = (m_PartialFrameNumber != 0);
+    m_PartialFrameNumber = du->partialFrame ? du->frameNumber : 0;
+
+    m_BwTracker.AddBytes(du->fullLength);
+
+    // Frame stats are only accounted for with the first part of each frame
+    if (!continuation && !m_LastFrameNumber) {
         m_ActiveWndVideoStats.measurementStartUs = LiGetMicroseconds();
         m_LastFrameNumber = du->frameNumber;
     }
-    else {
-        // Any frame number greater than m_LastFrameNumber + 1 represents a dropped frame
-        m_ActiveWndVideoStats.networkDroppedFrames += du->frameNumber - (m_LastFrameNumber + 1);
-        m_ActiveWndVideoStats.totalFrames += du->frameNumber - (m_LastFrameNumber + 1);
+    else if (!continuation) {
+        // Any frame number greater than m_LastFrameNumber + 1 represents a dropped frame,
+        // though not a lost one if it was skipped to stay within the latency budget.
+        uint32_t droppedFrames = du->frameNumber - (m_LastFrameNumber + 1);
+        uint32_t skippedFrames = qMin(du->framesSkippedForLatency, droppedFrames);
+        m_ActiveWndVideoStats.networkDroppedFrames += droppedFrames - skippedFrames;
+        m_ActiveWndVideoStats.latencySkippedFrames += skippedFrames;
+        m_ActiveWndVideoStats.totalFrames += droppedFrames;
         m_LastFrameNumber = du->frameNumber;
     }
 
-    m_BwTracker.AddBytes(du->fullLength);
-
     // Flip stats windows roughly every second
-    if (LiGetMicroseconds() > m_ActiveWndVideoStats.measurementStartUs + 1000000) {
+    if (!continuation && LiGetMicroseconds() > m_ActiveWndVideoStats.measurementStartUs + 1000000) {
         // Update overlay stats if it's enabled
         if (Session::get()->getOverlayManager().isOverlayEnabled(Overlay::OverlayDebug)) {
             VIDEO_STATS lastTwoWndStats = {};
@@ -1984,20 +2317,49 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
         m_ActiveWndVideoStats.measurementStartUs = LiGetMicroseconds();
     }
 
-    if (du->frameHostProcessingLatency != 0) {
-        if (m_ActiveWndVideoStats.minHostProcessingLatency != 0) {
-            m_ActiveWndVideoStats.minHostProcessingLatency = qMin(m_ActiveWndVideoStats.minHostProcessingLatency, du->frameHostProcessingLatency);
+    if (!continuation) {
+        if (du->frameHostProcessingLatency != 0) {
+            if (m_ActiveWndVideoStats.minHostProcessingLatency != 0) {
+                m_ActiveWndVideoStats.minHostProcessingLatency = qMin(m_ActiveWndVideoStats.minHostProcessingLatency, du->frameHostProcessingLatency);
+            }
+            else {
+                m_ActiveWndVideoStats.minHostProcessingLatency = du->frameHostProcessingLatency;
+            }
+            m_ActiveWndVideoStats.framesWithHostProcessingLatency += 1;
         }
-        else {
-            m_ActiveWndVideoStats.minHostProcessingLatency = du->frameHostProcessingLatency;
+        m_ActiveWndVideoStats.maxHostProcessingLatency = qMax(m_ActiveWndVideoStats.maxHostProcessingLatency, du->frameHostProcessingLatency);
+        m_ActiveWndVideoStats.totalHostProcessingLatency += du->frameHostProcessingLatency;
+
+        m_ActiveWndVideoStats.receivedFrames++;
+        m_ActiveWndVideoStats.totalFrames++;
+
+        // The receive time is the kernel's arrival time when the platform supports it,
+        // so this measures the network rather than how promptly we were scheduled.
+        if (m_LastJitterReceiveTimeUs != 0) {
+            int64_t arrivalDeltaUs = (int64_t)(du->receiveTimeUs - m_LastJitterReceiveTimeUs);
+            int64_t rtpDeltaUs = (int64_t)(int32_t)(du->rtpTimestamp - m_LastJitterRtpTimestamp) * 1000 / 90;
+            int64_t transitDeltaUs = qAbs(arrivalDeltaUs - rtpDeltaUs);
+
+            // Ignore gaps like the host pausing the stream, which aren't jitter
+            if (transitDeltaUs < 1000000) {
+                m_NetworkJitterUs += (transitDeltaUs - m_NetworkJitterUs) / 16.0;
+                m_ActiveWndVideoStats.networkJitterUs = (uint32_t)m_NetworkJitterUs;
+            }
         }
-        m_ActiveWndVideoStats.framesWithHostProcessingLatency += 1;
-    }
-    m_ActiveWndVideoStats.maxHostProcessingLatency = qMax(m_ActiveWndVideoStats.maxHostProcessingLatency, du->frameHostProcessingLatency);
-    m_ActiveWndVideoStats.totalHostProcessingLatency += du->frameHostProcessingLatency;
+        m_LastJitterReceiveTimeUs = du->receiveTimeUs;
+        m_LastJitterRtpTimestamp = du->rtpTimestamp;
 
-    m_ActiveWndVideoStats.receivedFrames++;
-    m_ActiveWndVideoStats.totalFrames++;
+        Session* session = Session::get();
+        if (session != nullptr) {
+            session->getAvSyncController().submitVideoReceived(du->rtpTimestamp, du->receiveTimeUs);
+        }
+
+        if (LiGetRtpSocketOptions()->videoKernelTimestamps) {
+            m_ActiveWndVideoStats.totalReceiveDelayUs += du->receiveDelayUs;
+            m_ActiveWndVideoStats.maxReceiveDelayUs = qMax(m_ActiveWndVideoStats.maxReceiveDelayUs, du->receiveDelayUs);
+            m_ActiveWndVideoStats.framesWithReceiveDelay++;
+        }
+    }
 
     int requiredBufferSize = du->fullLength;
     if (du->frameType == FRAME_TYPE_IDR) {
@@ -2026,7 +2388,9 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
         m_Pkt->flags = 0;
     }
 
-    m_ActiveWndVideoStats.totalReassemblyTimeUs += (du->enqueueTimeUs - du->receiveTimeUs);
+    if (!du->partialFrame) {
+        m_ActiveWndVideoStats.totalReassemblyTimeUs += (du->enqueueTimeUs - du->receiveTimeUs);
+    }
 
     // SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Calling avcodec_send_packet frame %d", du->frameNumber);
     err = avcodec_send_packet(m_VideoDecoderCtx, m_Pkt);
@@ -2067,12 +2431,16 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
             SDL_AtomicSet(&m_DecoderThreadShouldQuit, 1);
         }
 
+        m_PartialFrameNumber = 0;
         return DR_NEED_IDR;
     }
 
-    m_FrameInfoQueue.enqueue(*du);
+    // We'll only get a decoded frame once the final part of the frame is submitted
+    if (!du->partialFrame) {
+        m_FrameInfoQueue.enqueue(*du);
+        m_FramesIn++;
+    }
 
-    m_FramesIn++;
     return DR_OK;
 }
 
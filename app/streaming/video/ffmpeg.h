@@ -1,7 +1,10 @@
 #pragma once
 
 #include <functional>
+#include <QHash>
+#include <QMutex>
 #include <QQueue>
+#include <QWaitCondition>
 #include <set>
 
 #include "../bandwidth.h"
@@ -85,16 +88,24 @@ private:
 
     void writeBuffer(PLENTRY entry, int& offset);
 
+    static bool fixupH264Sps(const char* data, int length, QByteArray& fixedSps);
+
     static
     enum AVPixelFormat ffGetFormat(AVCodecContext* context,
                                    const enum AVPixelFormat* pixFmts);
 
     void decoderThreadProc();
 
+    void receiveThreadProc();
+
     void processQueuedFrames();
 
+    void recordDecodeQueueWait(PDECODE_UNIT du);
+
     static int decoderThreadProcThunk(void* context);
 
+    static int receiveThreadProcThunk(void* context);
+
     AVPacket* m_Pkt;
     AVCodecContext* m_VideoDecoderCtx;
     enum AVPixelFormat m_RequiredPixelFormat;
@@ -114,13 +125,31 @@ private:
     int m_FramesOut;
 
     int m_LastFrameNumber;
+
+    // Interarrival jitter state, using the first packet of each frame
+    uint64_t m_LastJitterReceiveTimeUs;
+    uint32_t m_LastJitterRtpTimestamp;
+    double m_NetworkJitterUs;
     int m_StreamFps;
     int m_VideoFormat;
     bool m_NeedsSpsFixup;
+
+    // Rewritten parameter sets, keyed by the NALU the host sent
+    QHash<QByteArray, QByteArray> m_ParameterSetFixupCache;
+    bool m_SubframeDecode;
+    int m_PartialFrameNumber;
     bool m_TestOnly;
     SDL_Thread* m_DecoderThread;
     SDL_atomic_t m_DecoderThreadShouldQuit;
 
+    // Hardware decoders that aren't FFmpeg hwaccels finish frames asynchronously,
+    // so their output is received on a separate thread. m_DecoderLock serializes
+    // the two threads' use of the codec context and frame accounting.
+    SDL_Thread* m_ReceiveThread;
+    QMutex m_DecoderLock;
+    QWaitCondition m_FramesInFlight;
+    uint64_t m_AvgAsyncOutputLatencyUs;
+
     // Data buffers in the queued DU are not valid
     QQueue<DECODE_UNIT> m_FrameInfoQueue;
 
@@ -1,11 +1,57 @@
 #include "overlaymanager.h"
 #include "path.h"
 
+// The atlas is sized to fit at least this many glyphs of the overlay font, which
+// covers printable ASCII with room for the symbols used in the overlays
+#define ATLAS_MIN_GLYPHS 128
+#define ATLAS_MAX_SIZE 2048
+
+// Keeps linear filtering from sampling neighboring glyphs
+#define ATLAS_GLYPH_PADDING 1
+
 using namespace Overlay;
 
+static Uint32 decodeUtf8(const char** ptr)
+{
+    const unsigned char* p = (const unsigned char*)*ptr;
+    Uint32 ch;
+    int len;
+
+    if ((p[0] & 0x80) == 0) {
+        ch = p[0];
+        len = 1;
+    }
+    else if ((p[0] & 0xE0) == 0xC0) {
+        ch = p[0] & 0x1F;
+        len = 2;
+    }
+    else if ((p[0] & 0xF0) == 0xE0) {
+        ch = p[0] & 0x0F;
+        len = 3;
+    }
+    else {
+        ch = p[0] & 0x07;
+        len = 4;
+    }
+
+    for (int i = 1; i < len; i++) {
+        // Don't read past the end of a truncated sequence
+        if ((p[i] & 0xC0) != 0x80) {
+            *ptr += i;
+            return 0xFFFD;
+        }
+
+        ch = (ch << 6) | (p[i] & 0x3F);
+    }
+
+    *ptr += len;
+    return ch;
+}
+
 OverlayManager::OverlayManager() :
     m_Renderer(nullptr),
     m_RendererLock(SDL_CreateMutex()),
+    m_GlyphLock(SDL_CreateMutex()),
     m_FontData(Path::readDataFile("ModeSeven.ttf")),
     m_FontSymbolData(Path::readDataFile("FontAwesome.otf"))
 {
@@ -36,6 +82,9 @@ OverlayManager::~OverlayManager()
         if (m_Overlays[i].surface != nullptr) {
             SDL_FreeSurface(m_Overlays[i].surface);
         }
+        if (m_Overlays[i].atlas != nullptr) {
+            SDL_FreeSurface(m_Overlays[i].atlas);
+        }
         if (m_Overlays[i].font != nullptr) {
             TTF_CloseFont(m_Overlays[i].font);
         }
@@ -47,6 +96,7 @@ OverlayManager::~OverlayManager()
     TTF_Quit();
     
     SDL_DestroyMutex(m_RendererLock);
+    SDL_DestroyMutex(m_GlyphLock);
 
     // For similar reasons to the comment in the constructor, this will usually,
     // but not always, deinitialize TTF. In the cases where Session objects overlap
@@ -89,6 +139,43 @@ SDL_Surface* OverlayManager::getUpdatedOverlaySurface(OverlayType type)
     return (SDL_Surface*)SDL_AtomicSetPtr((void**)&m_Overlays[type].surface, nullptr);
 }
 
+SDL_Surface* OverlayManager::lockUpdatedGlyphAtlas(OverlayType type, int* generation)
+{
+    SDL_LockMutex(m_GlyphLock);
+
+    if (m_Overlays[type].atlas == nullptr || m_Overlays[type].atlasGeneration == *generation) {
+        SDL_UnlockMutex(m_GlyphLock);
+        return nullptr;
+    }
+
+    *generation = m_Overlays[type].atlasGeneration;
+    return m_Overlays[type].atlas;
+}
+
+void OverlayManager::unlockGlyphAtlas()
+{
+    SDL_UnlockMutex(m_GlyphLock);
+}
+
+int OverlayManager::getUpdatedOverlayLayout(OverlayType type, int* serial, GlyphQuad* quads, int* width, int* height)
+{
+    SDL_LockMutex(m_GlyphLock);
+
+    if (m_Overlays[type].layoutSerial == *serial) {
+        SDL_UnlockMutex(m_GlyphLock);
+        return -1;
+    }
+
+    int quadCount = m_Overlays[type].quadCount;
+    memcpy(quads, m_Overlays[type].quads, quadCount * sizeof(*quads));
+    *serial = m_Overlays[type].layoutSerial;
+    *width = m_Overlays[type].width;
+    *height = m_Overlays[type].height;
+
+    SDL_UnlockMutex(m_GlyphLock);
+    return quadCount;
+}
+
 void OverlayManager::setOverlayTextUpdated(OverlayType type)
 {
     // Only update the overlay state if it's enabled. If it's not enabled,
@@ -126,6 +213,243 @@ void OverlayManager::setOverlayRenderer(IOverlayRenderer* renderer)
     SDL_UnlockMutex(m_RendererLock);
 }
 
+
+bool OverlayManager::loadFonts(OverlayType type)
+{
+    if (m_FontData.isEmpty() || m_FontSymbolData.isEmpty()) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "SDL overlay font failed to load");
+        return false;
+    }
+
+    // m_FontData must stay around until the font is closed
+    m_Overlays[type].font = TTF_OpenFontRW(SDL_RWFromConstMem(m_FontData.constData(), m_FontData.size()),
+                                           1,
+                                           m_Overlays[type].fontSize);
+    m_Overlays[type].fontSymbol = TTF_OpenFontRW(SDL_RWFromConstMem(m_FontSymbolData.constData(), m_FontSymbolData.size()),
+                                           1,
+                                           m_Overlays[type].fontSize);
+
+    if (m_Overlays[type].font == nullptr || m_Overlays[type].fontSymbol == nullptr) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "TTF_OpenFont() failed: %s",
+                    TTF_GetError());
+
+        if (m_Overlays[type].font != nullptr) {
+            TTF_CloseFont(m_Overlays[type].font);
+            m_Overlays[type].font = nullptr;
+        }
+        if (m_Overlays[type].fontSymbol != nullptr) {
+            TTF_CloseFont(m_Overlays[type].fontSymbol);
+            m_Overlays[type].fontSymbol = nullptr;
+        }
+        return false;
+    }
+
+    // Enable hinting for sharper text at small sizes
+    TTF_SetFontHinting(m_Overlays[type].font, TTF_HINTING_LIGHT);
+    TTF_SetFontHinting(m_Overlays[type].fontSymbol, TTF_HINTING_LIGHT);
+
+    // Size the atlas from the cell of a wide glyph. Glyphs are rendered at the full font height.
+    int minx, maxx, miny, maxy, advance;
+    int cellHeight = SDL_max(TTF_FontHeight(m_Overlays[type].font), TTF_FontHeight(m_Overlays[type].fontSymbol)) + ATLAS_GLYPH_PADDING;
+    int cellWidth = cellHeight;
+    if (TTF_GlyphMetrics(m_Overlays[type].font, 'W', &minx, &maxx, &miny, &maxy, &advance) == 0) {
+        cellWidth = SDL_max(advance, maxx) + ATLAS_GLYPH_PADDING;
+    }
+
+    int atlasSize = 256;
+    while (atlasSize < ATLAS_MAX_SIZE && (atlasSize / cellWidth) * (atlasSize / cellHeight) < ATLAS_MIN_GLYPHS) {
+        atlasSize *= 2;
+    }
+
+    // New surfaces are fully transparent
+    m_Overlays[type].atlas = SDL_CreateRGBSurfaceWithFormat(0, atlasSize, atlasSize, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (m_Overlays[type].atlas == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "SDL_CreateRGBSurfaceWithFormat() failed: %s",
+                     SDL_GetError());
+
+        // Callers check the font to see if we're loaded, so close them
+        // to try again on the next update
+        TTF_CloseFont(m_Overlays[type].font);
+        m_Overlays[type].font = nullptr;
+        TTF_CloseFont(m_Overlays[type].fontSymbol);
+        m_Overlays[type].fontSymbol = nullptr;
+        return false;
+    }
+    m_Overlays[type].atlasGeneration = 1;
+
+    // Build the atlas with printable ASCII up front, so updating the overlay
+    // normally never touches the atlas again
+    for (Uint32 ch = 0x20; ch < 0x7F; ch++) {
+        getGlyph(type, ch);
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Built %dx%d overlay glyph atlas for %d pt font",
+                atlasSize, atlasSize,
+                m_Overlays[type].fontSize);
+    return true;
+}
+
+const OverlayManager::Glyph* OverlayManager::getGlyph(OverlayType type, Uint32 codepoint)
+{
+    Glyph* glyph;
+
+    if (codepoint < SDL_arraysize(m_Overlays[type].asciiGlyphs)) {
+        glyph = &m_Overlays[type].asciiGlyphs[codepoint];
+        if (glyph->codepoint != codepoint) {
+            addGlyph(type, codepoint, glyph);
+        }
+        return glyph;
+    }
+
+    for (int i = 0; i < m_Overlays[type].otherGlyphCount; i++) {
+        if (m_Overlays[type].otherGlyphs[i].codepoint == codepoint) {
+            return &m_Overlays[type].otherGlyphs[i];
+        }
+    }
+
+    if (m_Overlays[type].otherGlyphCount == SDL_arraysize(m_Overlays[type].otherGlyphs)) {
+        return nullptr;
+    }
+
+    glyph = &m_Overlays[type].otherGlyphs[m_Overlays[type].otherGlyphCount++];
+    addGlyph(type, codepoint, glyph);
+    return glyph;
+}
+
+void OverlayManager::addGlyph(OverlayType type, Uint32 codepoint, Glyph* glyph)
+{
+    SDL_Surface* atlas = m_Overlays[type].atlas;
+
+    glyph->codepoint = codepoint;
+    SDL_zero(glyph->rect);
+    glyph->advance = 0;
+
+    // Manually implement font fallback rendering
+    TTF_Font* fontToUse = m_Overlays[type].font;
+    if (codepoint >= 0xE000 && codepoint <= 0xF8FF) { // Private Use Area where FontAwesome icons live
+        fontToUse = m_Overlays[type].fontSymbol;
+    }
+
+    SDL_Surface* surface = TTF_RenderGlyph_Blended(fontToUse, codepoint, m_Overlays[type].color);
+
+    // Use glyph advance for accurate spacing
+    int minx, maxx, miny, maxy, advance;
+    if (TTF_GlyphMetrics(fontToUse, codepoint, &minx, &maxx, &miny, &maxy, &advance) == 0) {
+        glyph->advance = advance;
+    }
+    else if (surface != nullptr) {
+        // Fallback if metrics fail
+        glyph->advance = surface->w;
+    }
+
+    if (surface == nullptr) {
+        return;
+    }
+
+    // Whitespace doesn't need a place in the atlas or a quad
+    bool visible = false;
+    SDL_assert(!SDL_MUSTLOCK(surface));
+    SDL_assert(surface->format->format == SDL_PIXELFORMAT_ARGB8888);
+    for (int y = 0; y < surface->h && !visible; y++) {
+        const Uint32* row = (const Uint32*)((const Uint8*)surface->pixels + y * surface->pitch);
+        for (int x = 0; x < surface->w; x++) {
+            if (row[x] & 0xFF000000) {
+                visible = true;
+                break;
+            }
+        }
+    }
+    if (!visible) {
+        SDL_FreeSurface(surface);
+        return;
+    }
+
+    // Start a new row if the glyph doesn't fit on this one
+    if (m_Overlays[type].atlasNextX + surface->w > atlas->w) {
+        m_Overlays[type].atlasNextX = 0;
+        m_Overlays[type].atlasNextY += m_Overlays[type].atlasRowHeight;
+        m_Overlays[type].atlasRowHeight = 0;
+    }
+    if (surface->w > atlas->w || m_Overlays[type].atlasNextY + surface->h > atlas->h) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Overlay glyph atlas is full - not drawing U+%04X",
+                    codepoint);
+        SDL_FreeSurface(surface);
+        return;
+    }
+
+    // Copy the glyph as is rather than blending it with the empty atlas
+    glyph->rect = { m_Overlays[type].atlasNextX, m_Overlays[type].atlasNextY, surface->w, surface->h };
+    SDL_Rect dstRect = glyph->rect;
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(surface, nullptr, atlas, &dstRect);
+    SDL_FreeSurface(surface);
+
+    m_Overlays[type].atlasNextX += glyph->rect.w + ATLAS_GLYPH_PADDING;
+    m_Overlays[type].atlasRowHeight = SDL_max(m_Overlays[type].atlasRowHeight, glyph->rect.h + ATLAS_GLYPH_PADDING);
+    m_Overlays[type].atlasGeneration++;
+}
+
+void OverlayManager::layoutOverlayText(OverlayType type)
+{
+    int lineSkip = TTF_FontLineSkip(m_Overlays[type].font);
+    int currentX = 0;
+    int currentY = 0;
+    int maxLineWidth = 0;
+    int quadCount = 0;
+    const char* ptr = m_Overlays[type].text;
+
+    while (*ptr) {
+        Uint32 ch = decodeUtf8(&ptr);
+
+        if (ch == '\n') {
+            maxLineWidth = SDL_max(maxLineWidth, currentX);
+            currentX = 0;
+            currentY += lineSkip;
+            continue;
+        }
+
+        const Glyph* glyph = getGlyph(type, ch);
+        if (glyph == nullptr) {
+            continue;
+        }
+
+        if (glyph->rect.w != 0) {
+            SDL_assert(quadCount < OVERLAY_MAX_GLYPHS);
+            m_Overlays[type].quads[quadCount].src = glyph->rect;
+            m_Overlays[type].quads[quadCount].dst = { currentX, currentY, glyph->rect.w, glyph->rect.h };
+            quadCount++;
+        }
+
+        currentX += glyph->advance;
+    }
+    maxLineWidth = SDL_max(maxLineWidth, currentX);
+
+    m_Overlays[type].quadCount = quadCount;
+    m_Overlays[type].width = SDL_max(maxLineWidth, 1);
+    m_Overlays[type].height = currentY + lineSkip;
+    m_Overlays[type].layoutSerial++;
+}
+
+SDL_Surface* OverlayManager::composeOverlaySurface(OverlayType type)
+{
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, m_Overlays[type].width, m_Overlays[type].height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr) {
+        return nullptr;
+    }
+
+    for (int i = 0; i < m_Overlays[type].quadCount; i++) {
+        SDL_Rect dstRect = m_Overlays[type].quads[i].dst;
+        SDL_BlitSurface(m_Overlays[type].atlas, &m_Overlays[type].quads[i].src, surface, &dstRect);
+    }
+
+    return surface;
+}
+
 void OverlayManager::notifyOverlayUpdated(OverlayType type)
 {
     SDL_LockMutex(m_RendererLock);
@@ -135,36 +459,14 @@ void OverlayManager::notifyOverlayUpdated(OverlayType type)
         return;
     }
 
-    // Construct the required font to render the overlay
-    if (m_Overlays[type].font == nullptr) {
-        if (m_FontData.isEmpty() || m_FontSymbolData.isEmpty()) {
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                         "SDL overlay font failed to load");
-            SDL_UnlockMutex(m_RendererLock);
-            return;
-        }
-
-        // m_FontData must stay around until the font is closed
-        m_Overlays[type].font = TTF_OpenFontRW(SDL_RWFromConstMem(m_FontData.constData(), m_FontData.size()),
-                                               1,
-                                               m_Overlays[type].fontSize);
-        m_Overlays[type].fontSymbol = TTF_OpenFontRW(SDL_RWFromConstMem(m_FontSymbolData.constData(), m_FontSymbolData.size()),
-                                               1,
-                                               m_Overlays[type].fontSize);
-
-        if (m_Overlays[type].font == nullptr || m_Overlays[type].fontSymbol == nullptr) {
-            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                        "TTF_OpenFont() failed: %s",
-                        TTF_GetError());
-
-            // Can't proceed without a font
-            SDL_UnlockMutex(m_RendererLock);
-            return;
-        }
+    SDL_LockMutex(m_GlyphLock);
 
-        // Enable hinting for sharper text at small sizes
-        TTF_SetFontHinting(m_Overlays[type].font, TTF_HINTING_LIGHT);
-        TTF_SetFontHinting(m_Overlays[type].fontSymbol, TTF_HINTING_LIGHT);
+    // Construct the required fonts and glyph atlas to render the overlay
+    if (m_Overlays[type].font == nullptr && !loadFonts(type)) {
+        // Can't proceed without a font
+        SDL_UnlockMutex(m_GlyphLock);
+        SDL_UnlockMutex(m_RendererLock);
+        return;
     }
 
     SDL_Surface* oldSurface = (SDL_Surface*)SDL_AtomicSetPtr((void**)&m_Overlays[type].surface, nullptr);
@@ -174,125 +476,25 @@ void OverlayManager::notifyOverlayUpdated(OverlayType type)
         SDL_FreeSurface(oldSurface);
     }
 
+    SDL_Surface* surface = nullptr;
     if (m_Overlays[type].enabled) {
-        // Manually implement font fallback rendering
-        int lineSkip = TTF_FontLineSkip(m_Overlays[type].font);
-        
-        // Calculate total dimensions
-        int maxLineWidth = 0;
-        int currentLineWidth = 0;
-        int totalHeight = lineSkip;
-        const char* ptr = m_Overlays[type].text;
-        
-        while (*ptr) {
-            Uint32 ch;
-            int len = 0;
-            
-            // Get next UTF-8 character
-            if ((*ptr & 0x80) == 0) {
-                ch = *ptr;
-                len = 1;
-            }
-            else if ((*ptr & 0xE0) == 0xC0) {
-                ch = ((*ptr & 0x1F) << 6) | (*(ptr + 1) & 0x3F);
-                len = 2;
-            }
-            else if ((*ptr & 0xF0) == 0xE0) {
-                ch = ((*ptr & 0x0F) << 12) | ((*(ptr + 1) & 0x3F) << 6) | (*(ptr + 2) & 0x3F);
-                len = 3;
-            }
-            else {
-                ch = ((*ptr & 0x07) << 18) | ((*(ptr + 1) & 0x3F) << 12) | ((*(ptr + 2) & 0x3F) << 6) | (*(ptr + 3) & 0x3F);
-                len = 4;
-            }
-            
-            if (ch == '\n') {
-                if (currentLineWidth > maxLineWidth) maxLineWidth = currentLineWidth;
-                currentLineWidth = 0;
-                totalHeight += lineSkip;
-                ptr += len;
-                continue;
-            }
-            
-            TTF_Font* fontToUse = m_Overlays[type].font;
-            if (ch >= 0xE000 && ch <= 0xF8FF) { // Private Use Area where FontAwesome icons live
-                fontToUse = m_Overlays[type].fontSymbol;
-            }
-            
-            int minx, maxx, miny, maxy, advance;
-            if (TTF_GlyphMetrics(fontToUse, ch, &minx, &maxx, &miny, &maxy, &advance) == 0) {
-                currentLineWidth += advance;
-            }
-            else {
-                // Fallback width calculation if metrics fail
-                // We render a temp glyph to measure it
-                SDL_Surface* tempGlyph = TTF_RenderGlyph_Blended(fontToUse, ch, m_Overlays[type].color);
-                if (tempGlyph) {
-                    currentLineWidth += tempGlyph->w;
-                    SDL_FreeSurface(tempGlyph);
-                }
-            }
-            
-            ptr += len;
+        layoutOverlayText(type);
+
+        // Renderers that can't draw from the atlas get the text as a surface
+        if (!m_Renderer->usesGlyphAtlas()) {
+            surface = composeOverlaySurface(type);
         }
-        if (currentLineWidth > maxLineWidth) maxLineWidth = currentLineWidth;
-        
-        // Ensure valid surface dimensions
-        if (maxLineWidth == 0) maxLineWidth = 1;
-        if (totalHeight == 0) totalHeight = 1;
-        
-        // Create the surface
-        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, maxLineWidth, totalHeight, 32, SDL_PIXELFORMAT_ARGB8888);
-        
-        // Render pass
-        int currentX = 0;
-        int currentY = 0;
-        ptr = m_Overlays[type].text;
-        
-        while (*ptr) {
-            Uint32 ch;
-            int len = 0;
-            
-            if ((*ptr & 0x80) == 0) { ch = *ptr; len = 1; }
-            else if ((*ptr & 0xE0) == 0xC0) { ch = ((*ptr & 0x1F) << 6) | (*(ptr + 1) & 0x3F); len = 2; }
-            else if ((*ptr & 0xF0) == 0xE0) { ch = ((*ptr & 0x0F) << 12) | ((*(ptr + 1) & 0x3F) << 6) | (*(ptr + 2) & 0x3F); len = 3; }
-            else { ch = ((*ptr & 0x07) << 18) | ((*(ptr + 1) & 0x3F) << 12) | ((*(ptr + 2) & 0x3F) << 6) | (*(ptr + 3) & 0x3F); len = 4; }
-            
-            if (ch == '\n') {
-                currentX = 0;
-                currentY += lineSkip;
-                ptr += len;
-                continue;
-            }
-            
-            TTF_Font* fontToUse = m_Overlays[type].font;
-             if (ch >= 0xE000 && ch <= 0xF8FF) {
-                 fontToUse = m_Overlays[type].fontSymbol;
-             }
-             
-             SDL_Surface* glyph = TTF_RenderGlyph_Blended(fontToUse, ch, m_Overlays[type].color);
-             if (glyph) {
-                 SDL_Rect dstRect = { currentX, currentY, 0, 0 };
-                 SDL_BlitSurface(glyph, NULL, surface, &dstRect);
-                 
-                 // Use glyph advance for accurate spacing
-                 int minx, maxx, miny, maxy, advance;
-                 if (TTF_GlyphMetrics(fontToUse, ch, &minx, &maxx, &miny, &maxy, &advance) == 0) {
-                      currentX += advance;
-                 }
-                 else {
-                      // Fallback if metrics fail
-                      currentX += glyph->w;
-                 }
-                 
-                 SDL_FreeSurface(glyph);
-             }
-             
-             ptr += len;
-         }
-         
-         SDL_AtomicSetPtr((void**)&m_Overlays[type].surface, surface);
-     }
+    }
+    else {
+        m_Overlays[type].quadCount = 0;
+        m_Overlays[type].layoutSerial++;
+    }
+
+    SDL_UnlockMutex(m_GlyphLock);
+
+    if (surface != nullptr) {
+        SDL_AtomicSetPtr((void**)&m_Overlays[type].surface, surface);
+    }
 
     // Notify the renderer
     m_Renderer->notifyOverlayUpdated(type);
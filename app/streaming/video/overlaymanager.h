@@ -13,12 +13,27 @@ enum OverlayType {
     OverlayMax
 };
 
+// Every glyph takes at least one byte of overlay text
+#define OVERLAY_MAX_GLYPHS 1024
+
+// A glyph of overlay text to draw from the glyph atlas
+struct GlyphQuad {
+    SDL_Rect src; // In the glyph atlas
+    SDL_Rect dst; // Relative to the top left corner of the overlay
+};
+
 class IOverlayRenderer
 {
 public:
     virtual ~IOverlayRenderer() = default;
 
     virtual void notifyOverlayUpdated(OverlayType type) = 0;
+
+    // Renderers that draw the overlay text from the glyph atlas return true,
+    // so no overlay surface is composed for them on each update
+    virtual bool usesGlyphAtlas() {
+        return false;
+    }
 };
 
 class OverlayManager
@@ -37,23 +52,66 @@ public:
     int getOverlayFontSize(OverlayType type);
     SDL_Surface* getUpdatedOverlaySurface(OverlayType type);
 
+    // The glyph atlas is built once per overlay, since each overlay has its own font
+    // size and color. It only changes when a glyph is drawn for the first time. If the
+    // atlas changed since *generation, this returns it locked and updates *generation.
+    // The caller must call unlockGlyphAtlas() once it's done reading the atlas.
+    SDL_Surface* lockUpdatedGlyphAtlas(OverlayType type, int* generation);
+    void unlockGlyphAtlas();
+
+    // If the overlay text changed since *serial, this copies its glyphs into quads,
+    // returns the number of glyphs and updates *serial, *width and *height with the
+    // overlay size. Otherwise, it returns -1 and copies nothing.
+    int getUpdatedOverlayLayout(OverlayType type, int* serial, GlyphQuad* quads, int* width, int* height);
+
     void setOverlayRenderer(IOverlayRenderer* renderer);
 
 private:
+    struct Glyph {
+        Uint32 codepoint;
+        SDL_Rect rect; // Empty if the glyph has no pixels or didn't fit in the atlas
+        int advance;
+    };
+
+    bool loadFonts(OverlayType type);
+    const Glyph* getGlyph(OverlayType type, Uint32 codepoint);
+    void addGlyph(OverlayType type, Uint32 codepoint, Glyph* glyph);
+    void layoutOverlayText(OverlayType type);
+    SDL_Surface* composeOverlaySurface(OverlayType type);
     void notifyOverlayUpdated(OverlayType type);
 
     struct {
         bool enabled;
         int fontSize;
         SDL_Color color;
-        char text[1024];
+        char text[OVERLAY_MAX_GLYPHS];
 
         TTF_Font* font;
         TTF_Font* fontSymbol;
         SDL_Surface* surface;
+
+        // Glyph atlas, packed in rows from the top left
+        SDL_Surface* atlas;
+        int atlasGeneration;
+        int atlasNextX;
+        int atlasNextY;
+        int atlasRowHeight;
+        Glyph asciiGlyphs[128];
+        Glyph otherGlyphs[64];
+        int otherGlyphCount;
+
+        // Layout of the current text
+        GlyphQuad quads[OVERLAY_MAX_GLYPHS];
+        int quadCount;
+        int width;
+        int height;
+        int layoutSerial;
     } m_Overlays[OverlayMax];
     IOverlayRenderer* m_Renderer;
     SDL_mutex* m_RendererLock;
+
+    // Protects the glyph atlases and layouts, which are read by the render thread
+    SDL_mutex* m_GlyphLock;
     QByteArray m_FontData;
     QByteArray m_FontSymbolData;
 };
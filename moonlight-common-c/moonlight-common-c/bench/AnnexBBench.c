@@ -0,0 +1,338 @@
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Raw Annex B elementary streams can be supplied through these environment
+// variables, for example one extracted from a recording with:
+//   ffmpeg -i recording.mkv -c:v copy -bsf:v h264_mp4toannexb -f h264 capture.h264
+// Otherwise a synthetic stream with a similar shape is generated.
+#define BENCH_H264_CAPTURE_ENV "BENCH_H264_CAPTURE"
+#define BENCH_HEVC_CAPTURE_ENV "BENCH_HEVC_CAPTURE"
+
+#define BENCH_MAX_CAPTURE_SIZE (256 * 1024 * 1024)
+
+// Payload carried by each video packet, which is what the depacketizer scans
+#define BENCH_CHUNK_SIZE (BENCH_PACKET_SIZE - (int)sizeof(NV_VIDEO_PACKET))
+
+#define SYNTHETIC_FRAMES 300
+#define SYNTHETIC_FRAME_SIZE (40 * 1024)
+#define SYNTHETIC_SLICES_PER_FRAME 4
+#define SYNTHETIC_IDR_INTERVAL 120
+
+typedef struct _BENCH_STREAM {
+    char* data;
+    unsigned int length;
+    unsigned int capacity;
+} BENCH_STREAM, *PBENCH_STREAM;
+
+typedef unsigned int (*FindStartSequenceFunction)(const char* data, unsigned int length, unsigned int* startSeqLength);
+
+static uint32_t RandomState = 1;
+
+// Keeps the compiler from discarding the results of the timed loops
+static volatile unsigned int ResultSink;
+
+static uint32_t nextRandom(void) {
+    RandomState = RandomState * 1103515245 + 12345;
+    return RandomState >> 16;
+}
+
+// The byte at a time search the depacketizer used before, as a baseline
+static unsigned int findStartSequenceByteLoop(const char* data, unsigned int length, unsigned int* startSeqLength) {
+    unsigned int i;
+
+    for (i = 0; i + 3 < length; i++) {
+        if (data[i] == 0 && data[i + 1] == 0) {
+            if (data[i + 2] == 0) {
+                if (i + 4 < length && data[i + 3] == 1) {
+                    *startSeqLength = 4;
+                    return i;
+                }
+            }
+            else if (data[i + 2] == 1) {
+                *startSeqLength = 3;
+                return i;
+            }
+        }
+    }
+
+    return length;
+}
+
+static void appendByte(PBENCH_STREAM stream, uint8_t byte) {
+    if (stream->length == stream->capacity) {
+        stream->capacity = stream->capacity != 0 ? stream->capacity * 2 : 1024 * 1024;
+        stream->data = realloc(stream->data, stream->capacity);
+        if (stream->data == NULL) {
+            printf("ERROR: Out of memory\n");
+            exit(1);
+        }
+    }
+
+    stream->data[stream->length++] = (char)byte;
+}
+
+// Appends a NALU with the given header and a body of entropy coded data with
+// emulation prevention applied. Zero bytes are more frequent than in real
+// data, so both searches see plenty of near misses.
+static void appendNal(PBENCH_STREAM stream, bool longStartSeq, const uint8_t* header, int headerLength, int bodyLength) {
+    int zeroCount = 0;
+    int i;
+
+    if (longStartSeq) {
+        appendByte(stream, 0x00);
+    }
+    appendByte(stream, 0x00);
+    appendByte(stream, 0x00);
+    appendByte(stream, 0x01);
+
+    for (i = 0; i < headerLength; i++) {
+        appendByte(stream, header[i]);
+    }
+
+    for (i = 0; i < bodyLength; i++) {
+        uint8_t byte = (nextRandom() % 8 == 0) ? 0x00 : (uint8_t)nextRandom();
+
+        if (zeroCount >= 2 && byte <= 0x03) {
+            appendByte(stream, 0x03);
+            zeroCount = 0;
+        }
+
+        appendByte(stream, byte);
+        zeroCount = (byte == 0x00) ? zeroCount + 1 : 0;
+    }
+
+    // A NALU can't end with a zero byte
+    if (zeroCount != 0) {
+        appendByte(stream, 0x80);
+    }
+}
+
+static void generateStream(PBENCH_STREAM stream, bool hevc) {
+    static const uint8_t h264Sps[] = { 0x67 };
+    static const uint8_t h264Pps[] = { 0x68 };
+    static const uint8_t h264IdrSlice[] = { 0x65 };
+    static const uint8_t h264Slice[] = { 0x41 };
+    static const uint8_t hevcVps[] = { 0x40, 0x01 };
+    static const uint8_t hevcSps[] = { 0x42, 0x01 };
+    static const uint8_t hevcPps[] = { 0x44, 0x01 };
+    static const uint8_t hevcIdrSlice[] = { 0x26, 0x01 };
+    static const uint8_t hevcSlice[] = { 0x02, 0x01 };
+    int headerLength = hevc ? 2 : 1;
+    int frame;
+
+    for (frame = 0; frame < SYNTHETIC_FRAMES; frame++) {
+        bool idrFrame = frame % SYNTHETIC_IDR_INTERVAL == 0;
+        int slice;
+
+        if (idrFrame) {
+            if (hevc) {
+                appendNal(stream, true, hevcVps, headerLength, 20);
+            }
+            appendNal(stream, !hevc, hevc ? hevcSps : h264Sps, headerLength, 40);
+            appendNal(stream, false, hevc ? hevcPps : h264Pps, headerLength, 6);
+        }
+
+        // Like most encoders, only the first NALU of an access unit has a 4 byte start sequence
+        for (slice = 0; slice < SYNTHETIC_SLICES_PER_FRAME; slice++) {
+            const uint8_t* header = idrFrame ? (hevc ? hevcIdrSlice : h264IdrSlice) : (hevc ? hevcSlice : h264Slice);
+
+            appendNal(stream, slice == 0 && !idrFrame, header, headerLength,
+                      SYNTHETIC_FRAME_SIZE / SYNTHETIC_SLICES_PER_FRAME);
+        }
+    }
+}
+
+static bool loadCapture(PBENCH_STREAM stream, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("ERROR: Unable to open %s\n", path);
+        return false;
+    }
+
+    stream->capacity = BENCH_MAX_CAPTURE_SIZE;
+    stream->data = malloc(stream->capacity);
+    if (stream->data == NULL) {
+        fclose(file);
+        return false;
+    }
+
+    stream->length = (unsigned int)fread(stream->data, 1, stream->capacity, file);
+    fclose(file);
+
+    return stream->length != 0;
+}
+
+static unsigned int findAllStartSequences(FindStartSequenceFunction find, const char* data, unsigned int length, unsigned int* offsets) {
+    unsigned int count = 0;
+    unsigned int offset = 0;
+
+    for (;;) {
+        unsigned int startSeqLength = 0;
+
+        offset += find(&data[offset], length - offset, &startSeqLength);
+        if (offset == length) {
+            return count;
+        }
+
+        if (offsets != NULL) {
+            offsets[count] = offset;
+        }
+        count++;
+        offset += startSeqLength;
+    }
+}
+
+// Both searches must find the same start sequences in every packet
+static bool validateStream(const char* name, PBENCH_STREAM stream) {
+    static unsigned int expectedOffsets[BENCH_CHUNK_SIZE];
+    static unsigned int actualOffsets[BENCH_CHUNK_SIZE];
+    unsigned int offset;
+
+    for (offset = 0; offset < stream->length; offset += BENCH_CHUNK_SIZE) {
+        unsigned int length = stream->length - offset < BENCH_CHUNK_SIZE ? stream->length - offset : BENCH_CHUNK_SIZE;
+        unsigned int expectedCount = findAllStartSequences(findStartSequenceByteLoop, &stream->data[offset], length, expectedOffsets);
+        unsigned int actualCount = findAllStartSequences(AnnexBFindStartSequence, &stream->data[offset], length, actualOffsets);
+
+        if (expectedCount != actualCount || memcmp(expectedOffsets, actualOffsets, expectedCount * sizeof(expectedOffsets[0])) != 0) {
+            printf("ERROR: %s: start sequence mismatch in packet at offset %u\n", name, offset);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// A packet with more NALUs ahead of the picture data than the scan table holds
+// must still be scanned through to its slice by continuing the scan
+static void validateContinuedScan(const char* codecName, bool hevc) {
+    static const uint8_t h264Sei[] = { 0x06 };
+    static const uint8_t h264Slice[] = { 0x41 };
+    static const uint8_t hevcSei[] = { 0x4E, 0x01 };
+    static const uint8_t hevcSlice[] = { 0x02, 0x01 };
+    BENCH_STREAM stream = { NULL, 0, 0 };
+    ANNEXB_NAL_SCAN scan;
+    unsigned int expectedSliceOffset;
+    unsigned int nalCount;
+    int i;
+
+    for (i = 0; i < ANNEXB_MAX_SCANNED_NALS * 2; i++) {
+        appendNal(&stream, false, hevc ? hevcSei : h264Sei, hevc ? 2 : 1, 8);
+    }
+    expectedSliceOffset = stream.length;
+    appendNal(&stream, false, hevc ? hevcSlice : h264Slice, hevc ? 2 : 1, 64);
+
+    // The last NALU of a truncated scan is recorded again as the first of the next
+    AnnexBScanNals(&scan, stream.data, 0, stream.length, hevc);
+    nalCount = scan.count;
+    while (AnnexBContinueScan(&scan, stream.data, hevc)) {
+        nalCount += scan.count - 1;
+    }
+
+    if (nalCount != ANNEXB_MAX_SCANNED_NALS * 2 + 1 ||
+            !NAL_CLASS_IS_SLICE(scan.nals[scan.count - 1].nalClass) ||
+            scan.nals[scan.count - 1].offset != expectedSliceOffset) {
+        BenchFail("AnnexB %s continued scan found %u NALUs without reaching the slice", codecName, nalCount);
+    }
+
+    free(stream.data);
+}
+
+static void runFind(const char* name, FindStartSequenceFunction find, PBENCH_STREAM stream) {
+    BENCH_ROUND fastestRound = { 0 };
+    uint64_t packets = 0;
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        BENCH_ROUND benchRound;
+        unsigned int found = 0;
+        unsigned int offset;
+
+        BenchBeginRound(&benchRound);
+
+        packets = 0;
+        for (offset = 0; offset < stream->length; offset += BENCH_CHUNK_SIZE) {
+            unsigned int length = stream->length - offset < BENCH_CHUNK_SIZE ? stream->length - offset : BENCH_CHUNK_SIZE;
+
+            found += findAllStartSequences(find, &stream->data[offset], length, NULL);
+            packets++;
+        }
+
+        BenchEndRound(&benchRound);
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+
+        ResultSink = found;
+    }
+
+    BenchReport(name, "packet", packets, &fastestRound);
+}
+
+static void runScan(const char* name, PBENCH_STREAM stream, bool hevc) {
+    BENCH_ROUND fastestRound = { 0 };
+    uint64_t packets = 0;
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        ANNEXB_NAL_SCAN scan;
+        BENCH_ROUND benchRound;
+        unsigned int found = 0;
+        unsigned int offset;
+
+        BenchBeginRound(&benchRound);
+
+        // The depacketizer only scans the first packet of each frame, but
+        // scanning every packet gives us more samples of the same work.
+        packets = 0;
+        for (offset = 0; offset < stream->length; offset += BENCH_CHUNK_SIZE) {
+            unsigned int length = stream->length - offset < BENCH_CHUNK_SIZE ? stream->length - offset : BENCH_CHUNK_SIZE;
+
+            AnnexBScanNals(&scan, stream->data, offset, length, hevc);
+            found += scan.count;
+            packets++;
+        }
+
+        BenchEndRound(&benchRound);
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+
+        ResultSink = found;
+    }
+
+    BenchReport(name, "packet", packets, &fastestRound);
+}
+
+static void benchCodec(const char* codecName, const char* captureEnv, bool hevc) {
+    BENCH_STREAM stream = { NULL, 0, 0 };
+    const char* capturePath = getenv(captureEnv);
+    char name[64];
+
+    if (capturePath != NULL && capturePath[0] != 0) {
+        if (!loadCapture(&stream, capturePath)) {
+            printf("ERROR: Unable to read %s capture from %s\n", codecName, capturePath);
+            free(stream.data);
+            return;
+        }
+        printf("Using %u byte %s capture: %s\n", stream.length, codecName, capturePath);
+    }
+    else {
+        generateStream(&stream, hevc);
+    }
+
+    if (validateStream(codecName, &stream)) {
+        snprintf(name, sizeof(name), "AnnexB %s find (byte loop)", codecName);
+        runFind(name, findStartSequenceByteLoop, &stream);
+        snprintf(name, sizeof(name), "AnnexB %s find (vectorized)", codecName);
+        runFind(name, AnnexBFindStartSequence, &stream);
+        snprintf(name, sizeof(name), "AnnexB %s NAL scan", codecName);
+        runScan(name, &stream, hevc);
+    }
+
+    validateContinuedScan(codecName, hevc);
+
+    free(stream.data);
+}
+
+void BenchAnnexB(void) {
+    benchCodec("H.264", BENCH_H264_CAPTURE_ENV, false);
+    benchCodec("HEVC", BENCH_HEVC_CAPTURE_ENV, true);
+}
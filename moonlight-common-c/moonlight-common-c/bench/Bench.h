@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Limelight-internal.h"
+
+typedef void (*BenchFunction)(void);
+
+typedef struct _BENCH_CASE {
+    const char* name;
+    BenchFunction run;
+} BENCH_CASE, *PBENCH_CASE;
+
+// Rounds each benchmark runs. The fastest round is reported, since
+// anything slower than that is noise from the rest of the system.
+#define BENCH_ROUNDS 5
+
+// Video packet size the benchmarks stream with, as sent by a host
+#define BENCH_PACKET_SIZE 1392
+
+// Value of a counter that isn't available on this system
+#define BENCH_COUNTER_UNAVAILABLE UINT64_MAX
+
+// Measurements of a single round of a benchmark
+typedef struct _BENCH_ROUND {
+    uint64_t elapsedNs;
+    uint64_t allocations;
+    uint64_t cacheMisses;
+
+    // Counter values when the round began
+    uint64_t startNs;
+    uint64_t startAllocations;
+    uint64_t startCacheMisses;
+} BENCH_ROUND, *PBENCH_ROUND;
+
+uint64_t BenchGetNanoseconds(void);
+
+// Returns the number of heap allocations made by the process so far,
+// or BENCH_COUNTER_UNAVAILABLE if they aren't being counted
+uint64_t BenchGetAllocationCount(void);
+
+// Brackets the timed part of a round. Setup that isn't part of the
+// operation being measured should happen outside of these calls.
+void BenchBeginRound(PBENCH_ROUND round);
+void BenchEndRound(PBENCH_ROUND round);
+
+// Keeps the fastest round seen so far. The fastest round starts zeroed.
+void BenchKeepFastestRound(PBENCH_ROUND fastestRound, const BENCH_ROUND* round);
+
+// Reports the fastest round of a benchmark that performed the given
+// number of operations per round
+void BenchReport(const char* name, const char* unit, uint64_t operations, const BENCH_ROUND* fastestRound);
+
+// Reports a benchmark whose time depends on how several threads are scheduled.
+// Its time isn't compared against the baseline, only its allocations are.
+void BenchReportContended(const char* name, const char* unit, uint64_t operations, const BENCH_ROUND* fastestRound);
+
+// Reports a benchmark that didn't do the work it was meant to measure,
+// which fails the run
+void BenchFail(const char* format, ...);
+
+void BenchRtpVideoQueue(void);
+void BenchRtpVideoQueueSubframe(void);
+void BenchVideoDepacketizer(void);
+void BenchAnnexB(void);
+void BenchRtpAudioQueue(void);
+void BenchLinkedBlockingQueue(void);
+void BenchCrypto(void);
+void BenchByteBuffer(void);
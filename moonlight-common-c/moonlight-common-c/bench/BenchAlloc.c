@@ -0,0 +1,43 @@
+#include "Bench.h"
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+
+// The library sources are linked with --wrap for the allocation functions,
+// so their calls land here. Allocations made inside other libraries (like
+// the crypto library) aren't counted.
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void* ptr, size_t size);
+
+static uint64_t AllocationCount;
+
+void* __wrap_malloc(size_t size) {
+    __atomic_fetch_add(&AllocationCount, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    __atomic_fetch_add(&AllocationCount, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    __atomic_fetch_add(&AllocationCount, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+uint64_t BenchGetAllocationCount(void) {
+    return __atomic_load_n(&AllocationCount, __ATOMIC_RELAXED);
+}
+
+#else
+
+uint64_t BenchGetAllocationCount(void) {
+    return BENCH_COUNTER_UNAVAILABLE;
+}
+
+#endif
@@ -0,0 +1,358 @@
+#include "Bench.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Results can be written to a file and compared against a file from an earlier
+// run, so CI can flag regressions between a change and the code it's based on:
+//   moonlight-common-c-bench --output base.txt
+//   moonlight-common-c-bench --baseline base.txt --threshold 10
+// Allocations per operation are deterministic, so any increase is flagged.
+// Times are flagged if they are more than the threshold percentage slower,
+// except for contended benchmarks, whose times depend on how the threads
+// happen to be scheduled and are only printed.
+// Benchmarks that fail their own checks fail the run too, since their
+// results can't be compared.
+#define BENCH_MAX_RESULTS 128
+#define BENCH_DEFAULT_THRESHOLD_PERCENT 10.0
+
+typedef struct _BENCH_RESULT {
+    char name[64];
+    char unit[16];
+    double nsPerOp;
+    double allocationsPerOp;
+    double cacheMissesPerOp; // negative if unavailable
+    bool contended;
+} BENCH_RESULT, *PBENCH_RESULT;
+
+static const BENCH_CASE BenchCases[] = {
+    { "RtpVideoQueue", BenchRtpVideoQueue },
+    { "RtpVideoQueueSubframe", BenchRtpVideoQueueSubframe },
+    { "VideoDepacketizer", BenchVideoDepacketizer },
+    { "AnnexB", BenchAnnexB },
+    { "RtpAudioQueue", BenchRtpAudioQueue },
+    { "LinkedBlockingQueue", BenchLinkedBlockingQueue },
+    { "Crypto", BenchCrypto },
+    { "ByteBuffer", BenchByteBuffer },
+};
+
+static BENCH_RESULT Results[BENCH_MAX_RESULTS];
+static int ResultCount;
+static int FailureCount;
+
+#ifdef __linux__
+static int CacheMissCounterFd = -1;
+#endif
+
+uint64_t BenchGetNanoseconds(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1000000000.0 / frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+#endif
+}
+
+static void openCacheMissCounter(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.inherit = 1;
+
+    // Counting only user mode works with the default perf_event_paranoid setting
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    CacheMissCounterFd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (CacheMissCounterFd < 0) {
+        printf("Cache miss counters are unavailable: %s\n", strerror(errno));
+    }
+#else
+    printf("Cache miss counters are unavailable on this platform\n");
+#endif
+}
+
+static uint64_t readCacheMissCounter(void) {
+#ifdef __linux__
+    uint64_t value;
+
+    if (CacheMissCounterFd >= 0 && read(CacheMissCounterFd, &value, sizeof(value)) == sizeof(value)) {
+        return value;
+    }
+#endif
+
+    return BENCH_COUNTER_UNAVAILABLE;
+}
+
+void BenchBeginRound(PBENCH_ROUND round) {
+    round->startAllocations = BenchGetAllocationCount();
+    round->startCacheMisses = readCacheMissCounter();
+    round->startNs = BenchGetNanoseconds();
+}
+
+void BenchEndRound(PBENCH_ROUND round) {
+    uint64_t endNs = BenchGetNanoseconds();
+    uint64_t endCacheMisses = readCacheMissCounter();
+    uint64_t endAllocations = BenchGetAllocationCount();
+
+    round->elapsedNs = endNs - round->startNs;
+
+    if (round->startAllocations != BENCH_COUNTER_UNAVAILABLE && endAllocations != BENCH_COUNTER_UNAVAILABLE) {
+        round->allocations = endAllocations - round->startAllocations;
+    }
+    else {
+        round->allocations = BENCH_COUNTER_UNAVAILABLE;
+    }
+
+    if (round->startCacheMisses != BENCH_COUNTER_UNAVAILABLE && endCacheMisses != BENCH_COUNTER_UNAVAILABLE) {
+        round->cacheMisses = endCacheMisses - round->startCacheMisses;
+    }
+    else {
+        round->cacheMisses = BENCH_COUNTER_UNAVAILABLE;
+    }
+}
+
+void BenchKeepFastestRound(PBENCH_ROUND fastestRound, const BENCH_ROUND* round) {
+    if (fastestRound->elapsedNs == 0 || round->elapsedNs < fastestRound->elapsedNs) {
+        *fastestRound = *round;
+    }
+}
+
+static void reportResult(const char* name, const char* unit, uint64_t operations, const BENCH_ROUND* fastestRound, bool contended) {
+    double nsPerOp = (double)fastestRound->elapsedNs / operations;
+    char allocationsString[32];
+    char cacheMissesString[32];
+
+    if (fastestRound->allocations != BENCH_COUNTER_UNAVAILABLE) {
+        snprintf(allocationsString, sizeof(allocationsString), "%.2f", (double)fastestRound->allocations / operations);
+    }
+    else {
+        strcpy(allocationsString, "-");
+    }
+
+    if (fastestRound->cacheMisses != BENCH_COUNTER_UNAVAILABLE) {
+        snprintf(cacheMissesString, sizeof(cacheMissesString), "%.1f", (double)fastestRound->cacheMisses / operations);
+    }
+    else {
+        strcpy(cacheMissesString, "-");
+    }
+
+    printf("%-52s %10.1f ns/%-7s %14.0f ops/s %8s allocs/op %10s misses/op\n",
+           name, nsPerOp, unit, 1000000000.0 / nsPerOp, allocationsString, cacheMissesString);
+    fflush(stdout);
+
+    if (ResultCount < BENCH_MAX_RESULTS) {
+        PBENCH_RESULT result = &Results[ResultCount++];
+
+        snprintf(result->name, sizeof(result->name), "%s", name);
+        snprintf(result->unit, sizeof(result->unit), "%s", unit);
+        result->nsPerOp = nsPerOp;
+        result->allocationsPerOp = fastestRound->allocations != BENCH_COUNTER_UNAVAILABLE ?
+            (double)fastestRound->allocations / operations : -1;
+        result->cacheMissesPerOp = fastestRound->cacheMisses != BENCH_COUNTER_UNAVAILABLE ?
+            (double)fastestRound->cacheMisses / operations : -1;
+        result->contended = contended;
+    }
+}
+
+void BenchReport(const char* name, const char* unit, uint64_t operations, const BENCH_ROUND* fastestRound) {
+    reportResult(name, unit, operations, fastestRound, false);
+}
+
+void BenchReportContended(const char* name, const char* unit, uint64_t operations, const BENCH_ROUND* fastestRound) {
+    reportResult(name, unit, operations, fastestRound, true);
+}
+
+void BenchFail(const char* format, ...) {
+    va_list args;
+
+    printf("FAILED: ");
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+    fflush(stdout);
+
+    FailureCount++;
+}
+
+// Results are written one per line as tab-separated values, since the names contain commas
+static bool writeResults(const char* path) {
+    FILE* file = fopen(path, "w");
+    int i;
+
+    if (file == NULL) {
+        printf("ERROR: Unable to write %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    for (i = 0; i < ResultCount; i++) {
+        fprintf(file, "%s\t%s\t%.3f\t%.3f\t%.3f\n",
+                Results[i].name, Results[i].unit, Results[i].nsPerOp,
+                Results[i].allocationsPerOp, Results[i].cacheMissesPerOp);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Returns the number of regressions against the baseline, or -1 if it couldn't be read
+static int compareResults(const char* path, double thresholdPercent) {
+    FILE* file = fopen(path, "r");
+    char line[256];
+    int regressions = 0;
+
+    if (file == NULL) {
+        printf("ERROR: Unable to read %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    printf("\nComparing against %s (threshold %.1f%%)\n", path, thresholdPercent);
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char* name = strtok(line, "\t");
+        char* unit = strtok(NULL, "\t");
+        char* nsPerOp = strtok(NULL, "\t");
+        char* allocationsPerOp = strtok(NULL, "\t");
+        double baselineNsPerOp, baselineAllocationsPerOp;
+        int i;
+
+        if (name == NULL || unit == NULL || nsPerOp == NULL || allocationsPerOp == NULL) {
+            continue;
+        }
+
+        baselineNsPerOp = atof(nsPerOp);
+        baselineAllocationsPerOp = atof(allocationsPerOp);
+
+        for (i = 0; i < ResultCount; i++) {
+            if (strcmp(Results[i].name, name) != 0) {
+                continue;
+            }
+
+            if (Results[i].nsPerOp > baselineNsPerOp * (1.0 + thresholdPercent / 100.0)) {
+                printf("%s: %s: %.1f ns/%s -> %.1f ns/%s (%+.1f%%)\n",
+                       Results[i].contended ? "CONTENDED (not gated)" : "REGRESSION",
+                       name, baselineNsPerOp, unit, Results[i].nsPerOp, unit,
+                       (Results[i].nsPerOp / baselineNsPerOp - 1.0) * 100.0);
+                if (!Results[i].contended) {
+                    regressions++;
+                }
+            }
+
+            // Allow for rounding in the file
+            if (baselineAllocationsPerOp >= 0 && Results[i].allocationsPerOp >= 0 &&
+                    Results[i].allocationsPerOp > baselineAllocationsPerOp + 0.005) {
+                printf("REGRESSION: %s: %.2f allocs/op -> %.2f allocs/op\n",
+                       name, baselineAllocationsPerOp, Results[i].allocationsPerOp);
+                regressions++;
+            }
+            break;
+        }
+    }
+
+    fclose(file);
+
+    if (regressions == 0) {
+        printf("No regressions\n");
+    }
+
+    return regressions;
+}
+
+static void printUsage(const char* program) {
+    printf("Usage: %s [--output FILE] [--baseline FILE] [--threshold PERCENT] [FILTER]\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    const char* filter = NULL;
+    const char* outputPath = NULL;
+    const char* baselinePath = NULL;
+    double thresholdPercent = BENCH_DEFAULT_THRESHOLD_PERCENT;
+    int exitCode = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            thresholdPercent = atof(argv[++i]);
+        }
+        else if (argv[i][0] == '-') {
+            printUsage(argv[0]);
+            return 2;
+        }
+        else {
+            filter = argv[i];
+        }
+    }
+
+#ifdef LC_DEBUG
+    printf("WARNING: This is a debug build. Assertions and FEC validation make the results meaningless.\n");
+#endif
+
+    if (BenchGetAllocationCount() == BENCH_COUNTER_UNAVAILABLE) {
+        printf("Allocation counters are unavailable in this build\n");
+    }
+    openCacheMissCounter();
+
+    // The library's clock starts at zero, which some of its code treats as unset
+    PltTicksInit();
+
+    for (i = 0; i < (int)(sizeof(BenchCases) / sizeof(BenchCases[0])); i++) {
+        if (filter == NULL || strstr(BenchCases[i].name, filter) != NULL) {
+            BenchCases[i].run();
+        }
+    }
+
+    if (FailureCount > 0) {
+        printf("%d benchmark checks failed\n", FailureCount);
+        exitCode = 1;
+    }
+
+    if (outputPath != NULL && !writeResults(outputPath)) {
+        exitCode = 2;
+    }
+
+    if (baselinePath != NULL) {
+        int regressions = compareResults(baselinePath, thresholdPercent);
+        if (regressions < 0) {
+            exitCode = 2;
+        }
+        else if (regressions > 0) {
+            exitCode = 1;
+        }
+    }
+
+    return exitCode;
+}
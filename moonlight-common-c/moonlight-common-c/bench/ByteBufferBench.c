@@ -0,0 +1,89 @@
+#include "Bench.h"
+
+#include <stdio.h>
+
+// Roughly the size of a control stream message
+#define BENCH_BB_MESSAGE_SIZE 64
+#define BENCH_BB_MESSAGES 200000
+
+// Keeps the compiler from discarding the results of the timed loops
+static volatile uint64_t ResultSink;
+
+// Writes a message of mixed field sizes, like the control and input streams build
+static void runPut(const char* name, int byteOrder) {
+    char message[BENCH_BB_MESSAGE_SIZE];
+    BENCH_ROUND fastestRound = { 0 };
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        BENCH_ROUND benchRound;
+        uint64_t sum = 0;
+        int i;
+
+        BenchBeginRound(&benchRound);
+        for (i = 0; i < BENCH_BB_MESSAGES; i++) {
+            BYTE_BUFFER bb;
+
+            BbInitializeWrappedBuffer(&bb, message, 0, sizeof(message), byteOrder);
+            while (BbPut8(&bb, (uint8_t)i) &&
+                   BbPut16(&bb, (uint16_t)i) &&
+                   BbPut32(&bb, (uint32_t)i) &&
+                   BbPut64(&bb, (uint64_t)i)) {
+                // Fill the message
+            }
+            sum += (uint8_t)message[i % sizeof(message)];
+        }
+        BenchEndRound(&benchRound);
+
+        ResultSink = sum;
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+    }
+
+    BenchReport(name, "message", BENCH_BB_MESSAGES, &fastestRound);
+}
+
+static void runGet(const char* name, int byteOrder) {
+    char message[BENCH_BB_MESSAGE_SIZE];
+    BENCH_ROUND fastestRound = { 0 };
+    int round;
+    int i;
+
+    for (i = 0; i < (int)sizeof(message); i++) {
+        message[i] = (char)i;
+    }
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        BENCH_ROUND benchRound;
+        uint64_t sum = 0;
+
+        BenchBeginRound(&benchRound);
+        for (i = 0; i < BENCH_BB_MESSAGES; i++) {
+            BYTE_BUFFER bb;
+            uint8_t c;
+            uint16_t s;
+            uint32_t l;
+            uint64_t ll;
+
+            BbInitializeWrappedBuffer(&bb, message, 0, sizeof(message), byteOrder);
+            while (BbGet8(&bb, &c) &&
+                   BbGet16(&bb, &s) &&
+                   BbGet32(&bb, &l) &&
+                   BbGet64(&bb, &ll)) {
+                sum += c + s + l + ll;
+            }
+        }
+        BenchEndRound(&benchRound);
+
+        ResultSink = sum;
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+    }
+
+    BenchReport(name, "message", BENCH_BB_MESSAGES, &fastestRound);
+}
+
+void BenchByteBuffer(void) {
+    runPut("BbPut* (little endian)", BYTE_ORDER_LITTLE);
+    runPut("BbPut* (big endian)", BYTE_ORDER_BIG);
+    runGet("BbGet* (little endian)", BYTE_ORDER_LITTLE);
+    runGet("BbGet* (big endian)", BYTE_ORDER_BIG);
+}
@@ -0,0 +1,116 @@
+#include "Bench.h"
+
+#include <stdio.h>
+
+#define BENCH_CRYPTO_PACKETS 20000
+
+// Opus packets are small, so their padding to the AES block size matters
+#define BENCH_AUDIO_PAYLOAD_SIZE 240
+
+typedef struct _BENCH_CIPHER_PACKET {
+    unsigned char iv[16];
+    unsigned char tag[16];
+    unsigned char* data;
+    int length;
+} BENCH_CIPHER_PACKET, *PBENCH_CIPHER_PACKET;
+
+static unsigned char Key[16];
+
+// Encrypts random plaintext like a host would, so the decryption has real work to do
+static PBENCH_CIPHER_PACKET encryptPackets(PPLT_CRYPTO_CONTEXT ctx, int algorithm, int plaintextLength) {
+    PBENCH_CIPHER_PACKET packets = calloc(BENCH_CRYPTO_PACKETS, sizeof(*packets));
+    unsigned char* plaintext = malloc(plaintextLength);
+    int i;
+
+    for (i = 0; i < BENCH_CRYPTO_PACKETS; i++) {
+        PltGenerateRandomData(plaintext, plaintextLength);
+        PltGenerateRandomData(packets[i].iv, sizeof(packets[i].iv));
+
+        packets[i].data = malloc(ROUND_TO_PKCS7_PADDED_LEN(plaintextLength) + 16);
+        if (algorithm == ALGORITHM_AES_GCM) {
+            if (!PltEncryptMessage(ctx, ALGORITHM_AES_GCM, 0,
+                                   Key, sizeof(Key),
+                                   packets[i].iv, 12,
+                                   packets[i].tag, sizeof(packets[i].tag),
+                                   plaintext, plaintextLength,
+                                   packets[i].data, &packets[i].length)) {
+                printf("ERROR: AES-GCM encryption failed\n");
+            }
+        }
+        else {
+            if (!PltEncryptMessage(ctx, ALGORITHM_AES_CBC, CIPHER_FLAG_RESET_IV | CIPHER_FLAG_FINISH | CIPHER_FLAG_PAD_TO_BLOCK_SIZE,
+                                   Key, sizeof(Key),
+                                   packets[i].iv, sizeof(packets[i].iv),
+                                   NULL, 0,
+                                   plaintext, plaintextLength,
+                                   packets[i].data, &packets[i].length)) {
+                printf("ERROR: AES-CBC encryption failed\n");
+            }
+        }
+    }
+
+    free(plaintext);
+    return packets;
+}
+
+static void runDecrypt(const char* name, int algorithm, int plaintextLength) {
+    PPLT_CRYPTO_CONTEXT encryptionCtx = PltCreateCryptoContext();
+    PPLT_CRYPTO_CONTEXT decryptionCtx = PltCreateCryptoContext();
+    PBENCH_CIPHER_PACKET packets = encryptPackets(encryptionCtx, algorithm, plaintextLength);
+    unsigned char* plaintext = malloc(ROUND_TO_PKCS7_PADDED_LEN(plaintextLength) + 16);
+    BENCH_ROUND fastestRound = { 0 };
+    int round;
+    int i;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        BENCH_ROUND benchRound;
+        int failures = 0;
+
+        BenchBeginRound(&benchRound);
+        for (i = 0; i < BENCH_CRYPTO_PACKETS; i++) {
+            int length;
+
+            // Match how the video and audio receive threads decrypt
+            if (algorithm == ALGORITHM_AES_GCM) {
+                failures += !PltDecryptMessage(decryptionCtx, ALGORITHM_AES_GCM, 0,
+                                               Key, sizeof(Key),
+                                               packets[i].iv, 12,
+                                               packets[i].tag, sizeof(packets[i].tag),
+                                               packets[i].data, packets[i].length,
+                                               plaintext, &length);
+            }
+            else {
+                failures += !PltDecryptMessage(decryptionCtx, ALGORITHM_AES_CBC, CIPHER_FLAG_RESET_IV | CIPHER_FLAG_FINISH,
+                                               Key, sizeof(Key),
+                                               packets[i].iv, sizeof(packets[i].iv),
+                                               NULL, 0,
+                                               packets[i].data, packets[i].length,
+                                               plaintext, &length);
+            }
+        }
+        BenchEndRound(&benchRound);
+
+        if (failures != 0) {
+            printf("WARNING: %s: %d of %d packets failed to decrypt\n", name, failures, BENCH_CRYPTO_PACKETS);
+        }
+
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+    }
+
+    BenchReport(name, "packet", BENCH_CRYPTO_PACKETS, &fastestRound);
+
+    for (i = 0; i < BENCH_CRYPTO_PACKETS; i++) {
+        free(packets[i].data);
+    }
+    free(packets);
+    free(plaintext);
+    PltDestroyCryptoContext(encryptionCtx);
+    PltDestroyCryptoContext(decryptionCtx);
+}
+
+void BenchCrypto(void) {
+    PltGenerateRandomData(Key, sizeof(Key));
+
+    runDecrypt("PltDecryptMessage (AES-GCM, video packet)", ALGORITHM_AES_GCM, BENCH_PACKET_SIZE + MAX_RTP_HEADER_SIZE);
+    runDecrypt("PltDecryptMessage (AES-CBC, audio packet)", ALGORITHM_AES_CBC, BENCH_AUDIO_PAYLOAD_SIZE);
+}
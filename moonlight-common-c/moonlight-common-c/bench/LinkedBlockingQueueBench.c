@@ -0,0 +1,99 @@
+#include "Bench.h"
+
+#include <stdio.h>
+
+#define BENCH_LBQ_ITEMS 200000
+
+// Like the decode unit queue
+#define BENCH_LBQ_BOUND 15
+
+typedef struct _BENCH_LBQ_PRODUCER {
+    LINKED_BLOCKING_QUEUE queue;
+    PLINKED_BLOCKING_QUEUE_ENTRY entries;
+    int items;
+} BENCH_LBQ_PRODUCER, *PBENCH_LBQ_PRODUCER;
+
+// Offers items as fast as the consumer takes them, like the receive thread
+// handing decode units to the decoder thread
+static void producerThreadProc(void* context) {
+    PBENCH_LBQ_PRODUCER producer = (PBENCH_LBQ_PRODUCER)context;
+    int i;
+
+    for (i = 0; i < producer->items; i++) {
+        while (LbqOfferQueueItem(&producer->queue, &producer->entries[i], &producer->entries[i]) == LBQ_BOUND_EXCEEDED) {
+            PltSleepMs(0);
+        }
+    }
+}
+
+// Offers and takes each item on one thread, so the queue is never contended
+static void runSingleThreaded(PLINKED_BLOCKING_QUEUE_ENTRY entries) {
+    BENCH_ROUND fastestRound = { 0 };
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        LINKED_BLOCKING_QUEUE queue;
+        BENCH_ROUND benchRound;
+        void* data;
+        int i;
+
+        LbqInitializeLinkedBlockingQueue(&queue, BENCH_LBQ_BOUND);
+
+        BenchBeginRound(&benchRound);
+        for (i = 0; i < BENCH_LBQ_ITEMS; i++) {
+            LbqOfferQueueItem(&queue, &entries[i], &entries[i]);
+            LbqWaitForQueueElement(&queue, &data);
+        }
+        BenchEndRound(&benchRound);
+
+        LbqDestroyLinkedBlockingQueue(&queue);
+
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+    }
+
+    BenchReport("LbqOfferQueueItem/LbqWaitForQueueElement", "item", BENCH_LBQ_ITEMS, &fastestRound);
+}
+
+static void runProducerConsumer(PLINKED_BLOCKING_QUEUE_ENTRY entries) {
+    BENCH_ROUND fastestRound = { 0 };
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        BENCH_LBQ_PRODUCER producer;
+        BENCH_ROUND benchRound;
+        PLT_THREAD producerThread;
+        void* data;
+        int i;
+
+        LbqInitializeLinkedBlockingQueue(&producer.queue, BENCH_LBQ_BOUND);
+        producer.entries = entries;
+        producer.items = BENCH_LBQ_ITEMS;
+
+        BenchBeginRound(&benchRound);
+        if (PltCreateThread("BenchLbq", producerThreadProc, &producer, &producerThread) != 0) {
+            printf("ERROR: Unable to create producer thread\n");
+            LbqDestroyLinkedBlockingQueue(&producer.queue);
+            return;
+        }
+        for (i = 0; i < BENCH_LBQ_ITEMS; i++) {
+            LbqWaitForQueueElement(&producer.queue, &data);
+        }
+        PltJoinThread(&producerThread);
+        BenchEndRound(&benchRound);
+
+        LbqDestroyLinkedBlockingQueue(&producer.queue);
+
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+    }
+
+    BenchReportContended("LbqOfferQueueItem/LbqWaitForQueueElement (2 threads)", "item", BENCH_LBQ_ITEMS, &fastestRound);
+}
+
+void BenchLinkedBlockingQueue(void) {
+    PLINKED_BLOCKING_QUEUE_ENTRY entries = malloc(sizeof(*entries) * BENCH_LBQ_ITEMS);
+
+    runSingleThreaded(entries);
+    runProducerConsumer(entries);
+
+    free(entries);
+}
@@ -0,0 +1,185 @@
+#include "Bench.h"
+#include "RtpAudioQueue.h"
+
+#include <stdio.h>
+
+// 5 ms Opus packets, like hosts send for low latency audio
+#define BENCH_AUDIO_PACKET_DURATION 5
+#define BENCH_AUDIO_PAYLOAD_SIZE 240
+#define BENCH_AUDIO_BLOCKS 2000
+#define BENCH_AUDIO_SSRC 0x12345678
+
+typedef enum {
+    AUDIO_PATTERN_IN_ORDER,
+    AUDIO_PATTERN_SINGLE_LOSS, // one data packet of each FEC block lost
+} AUDIO_PACKET_PATTERN;
+
+typedef struct _BENCH_AUDIO_PACKET {
+    PRTP_PACKET packet;
+    uint16_t length;
+} BENCH_AUDIO_PACKET, *PBENCH_AUDIO_PACKET;
+
+static RTP_AUDIO_QUEUE AudioQueue;
+static uint16_t NextAudioSequenceNumber;
+static uint32_t NextAudioTimestamp;
+static uint32_t RandomState = 1;
+
+static uint32_t nextRandom(void) {
+    RandomState = RandomState * 1103515245 + 12345;
+    return RandomState >> 16;
+}
+
+// Appends the data and FEC packets of one FEC block in the order they should
+// be received, and returns the number appended.
+static int buildFecBlock(AUDIO_PACKET_PATTERN pattern, PBENCH_AUDIO_PACKET packets) {
+    uint16_t baseSequenceNumber = NextAudioSequenceNumber;
+    uint32_t baseTimestamp = NextAudioTimestamp;
+    uint8_t* shards[RTPA_TOTAL_SHARDS];
+    int count = 0;
+    int lostIndex;
+    int i, j;
+
+    LC_ASSERT(baseSequenceNumber % RTPA_DATA_SHARDS == 0);
+
+    for (i = 0; i < RTPA_TOTAL_SHARDS; i++) {
+        PRTP_PACKET packet;
+
+        if (i < RTPA_DATA_SHARDS) {
+            packets[i].length = sizeof(RTP_PACKET) + BENCH_AUDIO_PAYLOAD_SIZE;
+            packet = calloc(1, packets[i].length);
+            packet->packetType = RTP_PAYLOAD_TYPE_AUDIO;
+            packet->sequenceNumber = U16(baseSequenceNumber + i);
+            packet->timestamp = baseTimestamp + (i * BENCH_AUDIO_PACKET_DURATION);
+
+            for (j = 0; j < BENCH_AUDIO_PAYLOAD_SIZE; j++) {
+                ((uint8_t*)(packet + 1))[j] = (uint8_t)nextRandom();
+            }
+
+            shards[i] = (uint8_t*)(packet + 1);
+        }
+        else {
+            PAUDIO_FEC_HEADER fecHeader;
+
+            packets[i].length = sizeof(RTP_PACKET) + sizeof(AUDIO_FEC_HEADER) + BENCH_AUDIO_PAYLOAD_SIZE;
+            packet = calloc(1, packets[i].length);
+            packet->packetType = RTP_PAYLOAD_TYPE_FEC;
+
+            // The FEC header stays in network byte order
+            fecHeader = (PAUDIO_FEC_HEADER)(packet + 1);
+            fecHeader->fecShardIndex = (uint8_t)(i - RTPA_DATA_SHARDS);
+            fecHeader->payloadType = RTP_PAYLOAD_TYPE_AUDIO;
+            fecHeader->baseSequenceNumber = BE16(baseSequenceNumber);
+            fecHeader->baseTimestamp = BE32(baseTimestamp);
+            fecHeader->ssrc = BE32(BENCH_AUDIO_SSRC);
+
+            shards[i] = (uint8_t*)(fecHeader + 1);
+        }
+
+        // Fields are in host byte order, as AudioReceiveThreadProc() leaves them
+        packet->header = 0x80;
+        packet->ssrc = BENCH_AUDIO_SSRC;
+        packets[i].packet = packet;
+    }
+
+    // The queue has the parity matrix the host uses
+    reed_solomon_encode(AudioQueue.rs, shards, RTPA_TOTAL_SHARDS, BENCH_AUDIO_PAYLOAD_SIZE);
+
+    NextAudioSequenceNumber = U16(NextAudioSequenceNumber + RTPA_DATA_SHARDS);
+    NextAudioTimestamp += RTPA_DATA_SHARDS * BENCH_AUDIO_PACKET_DURATION;
+
+    count = RTPA_TOTAL_SHARDS;
+    if (pattern == AUDIO_PATTERN_SINGLE_LOSS) {
+        lostIndex = nextRandom() % RTPA_DATA_SHARDS;
+        free(packets[lostIndex].packet);
+        memmove(&packets[lostIndex], &packets[lostIndex + 1], (count - lostIndex - 1) * sizeof(*packets));
+        count--;
+    }
+
+    return count;
+}
+
+static void runPattern(const char* name, AUDIO_PACKET_PATTERN pattern) {
+    PBENCH_AUDIO_PACKET packets = malloc(sizeof(*packets) * RTPA_TOTAL_SHARDS * BENCH_AUDIO_BLOCKS);
+    BENCH_ROUND fastestRound = { 0 };
+    uint64_t totalPackets = 0;
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        BENCH_ROUND benchRound;
+        uint32_t packetsReturned = 0;
+        int packetCount = 0;
+        int block;
+        int i;
+
+        for (block = 0; block < BENCH_AUDIO_BLOCKS; block++) {
+            packetCount += buildFecBlock(pattern, &packets[packetCount]);
+        }
+
+        BenchBeginRound(&benchRound);
+        for (i = 0; i < packetCount; i++) {
+            int queueStatus = RtpaAddPacket(&AudioQueue, packets[i].packet, packets[i].length);
+
+            if (RTPQ_HANDLE_NOW(queueStatus)) {
+                packetsReturned++;
+            }
+            else if (RTPQ_PACKET_READY(queueStatus)) {
+                PRTP_PACKET queuedPacket;
+                uint16_t length;
+
+                // Like the receive thread, drain everything that's ready
+                while ((queuedPacket = RtpaGetQueuedPacket(&AudioQueue, 0, &length)) != NULL) {
+                    packetsReturned++;
+                    free(queuedPacket);
+                }
+            }
+        }
+        BenchEndRound(&benchRound);
+
+        for (i = 0; i < packetCount; i++) {
+            free(packets[i].packet);
+        }
+
+        if (packetsReturned != BENCH_AUDIO_BLOCKS * RTPA_DATA_SHARDS) {
+            printf("WARNING: %s: only %u of %u packets were returned\n",
+                   name, packetsReturned, BENCH_AUDIO_BLOCKS * RTPA_DATA_SHARDS);
+        }
+
+        totalPackets = packetCount;
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+    }
+
+    BenchReport(name, "packet", totalPackets, &fastestRound);
+
+    free(packets);
+}
+
+void BenchRtpAudioQueue(void) {
+    // Stand in for a host new enough to use audio FEC
+    AppVersionQuad[0] = 7;
+    AppVersionQuad[1] = 1;
+    AppVersionQuad[2] = 431;
+    AppVersionQuad[3] = 0;
+    AudioPacketDuration = BENCH_AUDIO_PACKET_DURATION;
+
+    NextAudioSequenceNumber = 0;
+    NextAudioTimestamp = 0;
+    RtpaInitializeQueue(&AudioQueue);
+
+    // The queue synchronizes to the FEC block after the first packet it sees,
+    // so the first block isn't part of any measurement.
+    {
+        BENCH_AUDIO_PACKET packets[RTPA_TOTAL_SHARDS];
+        int packetCount = buildFecBlock(AUDIO_PATTERN_IN_ORDER, packets);
+        int i;
+
+        for (i = 0; i < packetCount; i++) {
+            RtpaAddPacket(&AudioQueue, packets[i].packet, packets[i].length);
+            free(packets[i].packet);
+        }
+    }
+
+    runPattern("RtpaAddPacket (in order)", AUDIO_PATTERN_IN_ORDER);
+    runPattern("RtpaAddPacket (FEC recovery)", AUDIO_PATTERN_SINGLE_LOSS);
+
+    RtpaCleanupQueue(&AudioQueue);
+}
@@ -0,0 +1,637 @@
+#include "Bench.h"
+#include "rs.h"
+
+#include <stdio.h>
+
+// Frames of a typical 1080p stream, frames as large as a single FEC block
+// gets, where per-packet costs that grow with the block size show up, and
+// 4K IDR frames that the host splits across several FEC blocks.
+#define BENCH_SMALL_FRAME_SIZE (40 * 1024 + 123)
+#define BENCH_SMALL_FRAMES 1000
+#define BENCH_LARGE_FRAME_SIZE (250 * 1024 + 123)
+#define BENCH_LARGE_FRAMES 60
+#define BENCH_IDR_FRAME_SIZE (1024 * 1024 + 123)
+#define BENCH_IDR_FRAMES 20
+#define BENCH_MAX_FRAME_SIZE BENCH_IDR_FRAME_SIZE
+
+// Hosts split frames into at most 4 FEC blocks
+#define BENCH_MAX_FEC_BLOCKS 4
+
+// RTP timestamp increment for 60 FPS on the 90 KHz clock
+#define BENCH_RTP_TIMESTAMP_STEP 1500
+
+// Time between the packets of a frame as they arrive from the host
+#define BENCH_PACKET_INTERVAL_US 10
+
+// FEC validation in debug builds drops a packet of every FEC block itself
+// and needs a parity packet to recover it
+#ifdef LC_DEBUG
+#define BENCH_VALIDATION_PARITY_SHARDS 1
+#else
+#define BENCH_VALIDATION_PARITY_SHARDS 0
+#endif
+
+typedef enum {
+    PATTERN_IN_ORDER,
+    PATTERN_REORDERED, // every pair of packets swapped
+    PATTERN_SINGLE_LOSS, // one data packet of each FEC block lost
+    PATTERN_BURST_LOSS, // as many consecutive data packets of each FEC block lost as FEC can recover
+    PATTERN_SECOND_BLOCK_LOSS, // every packet of the second FEC block of every other frame lost
+} PACKET_PATTERN;
+
+typedef struct _BENCH_PACKET {
+    char* buffer;
+    int length;
+} BENCH_PACKET, *PBENCH_PACKET;
+
+typedef struct _BENCH_VIDEO_CASE {
+    const char* name;
+    PACKET_PATTERN pattern;
+    int fecPercentage;
+    int frameSize;
+    uint32_t frames;
+    bool idrFrames;
+    const NETWORK_IMPAIRMENT* impairment; // applied after the pattern, if set
+    uint32_t framesLost; // in each round, which only impaired cases may do
+} BENCH_VIDEO_CASE, *PBENCH_VIDEO_CASE;
+
+// Network conditions for the impaired cases. The seeds are fixed, so every run
+// loses and delays the same packets.
+static const NETWORK_IMPAIRMENT RandomLoss = { .seed = 1, .lossGoodPercent = 1 };
+static const NETWORK_IMPAIRMENT BurstLoss = { .seed = 1, .lossBadPercent = 50, .goodToBadPercent = 0.5f, .badToGoodPercent = 20 };
+static const NETWORK_IMPAIRMENT JitterReordering = { .seed = 1, .reorderPercent = 2, .duplicatePercent = 1, .delayMs = 5, .jitterMs = 3 };
+static const NETWORK_IMPAIRMENT BandwidthLimit = { .seed = 1, .bandwidthKbps = 100000, .queueLimitMs = 50 };
+
+static const BENCH_VIDEO_CASE RtpVideoQueueCases[] = {
+    { "RtpvAddPacket (in order)", PATTERN_IN_ORDER, 20, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (in order, no FEC)", PATTERN_IN_ORDER, 0, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (reordered)", PATTERN_REORDERED, 20, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (FEC recovery)", PATTERN_SINGLE_LOSS, 20, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (large, in order)", PATTERN_IN_ORDER, 20, BENCH_LARGE_FRAME_SIZE, BENCH_LARGE_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (large, reordered)", PATTERN_REORDERED, 20, BENCH_LARGE_FRAME_SIZE, BENCH_LARGE_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (large, FEC recovery)", PATTERN_SINGLE_LOSS, 20, BENCH_LARGE_FRAME_SIZE, BENCH_LARGE_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (4K IDR, in order)", PATTERN_IN_ORDER, 20, BENCH_IDR_FRAME_SIZE, BENCH_IDR_FRAMES, true, NULL, 0 },
+    { "RtpvAddPacket (4K IDR, FEC recovery)", PATTERN_SINGLE_LOSS, 20, BENCH_IDR_FRAME_SIZE, BENCH_IDR_FRAMES, true, NULL, 0 },
+    { "RtpvAddPacket (burst loss, 20% FEC)", PATTERN_BURST_LOSS, 20, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (burst loss, 50% FEC)", PATTERN_BURST_LOSS, 50, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (large, burst loss, 20% FEC)", PATTERN_BURST_LOSS, 20, BENCH_LARGE_FRAME_SIZE, BENCH_LARGE_FRAMES, false, NULL, 0 },
+    { "RtpvAddPacket (4K IDR, burst loss, 20% FEC)", PATTERN_BURST_LOSS, 20, BENCH_IDR_FRAME_SIZE, BENCH_IDR_FRAMES, true, NULL, 0 },
+
+    // Every frame is an IDR frame, so each unrecoverable frame costs only
+    // itself rather than stalling the stream until the next IDR frame.
+    { "RtpvAddPacket (impaired, 1% random loss)", PATTERN_IN_ORDER, 20, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, true, &RandomLoss, 0 },
+    { "RtpvAddPacket (impaired, Gilbert-Elliott loss)", PATTERN_IN_ORDER, 20, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, true, &BurstLoss, 10 },
+    { "RtpvAddPacket (impaired, jitter and reordering)", PATTERN_IN_ORDER, 20, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, true, &JitterReordering, 0 },
+    { "RtpvAddPacket (impaired, large, 100 Mbps limit)", PATTERN_IN_ORDER, 20, BENCH_LARGE_FRAME_SIZE, BENCH_LARGE_FRAMES, true, &BandwidthLimit, 56 },
+};
+
+// Run with CAPABILITY_SUBFRAME_SUBMIT, so the depacketizer gets each FEC block
+// of a frame as it completes. IDR frames are never submitted in parts, so losing
+// a later block abandons a frame the decoder has none of.
+static const BENCH_VIDEO_CASE RtpVideoQueueSubframeCases[] = {
+    { "RtpvAddPacket (subframe, 4K IDR, second block lost)", PATTERN_SECOND_BLOCK_LOSS, 20, BENCH_IDR_FRAME_SIZE, BENCH_IDR_FRAMES, true, NULL, BENCH_IDR_FRAMES / 2 },
+};
+
+// The depacketizer only sees data packets, in order, so only the frame shape matters
+static const BENCH_VIDEO_CASE VideoDepacketizerCases[] = {
+    { "processRtpPayload", PATTERN_IN_ORDER, 0, BENCH_SMALL_FRAME_SIZE, BENCH_SMALL_FRAMES, false, NULL, 0 },
+    { "processRtpPayload (large)", PATTERN_IN_ORDER, 0, BENCH_LARGE_FRAME_SIZE, BENCH_LARGE_FRAMES, false, NULL, 0 },
+    { "processRtpPayload (4K IDR)", PATTERN_IN_ORDER, 0, BENCH_IDR_FRAME_SIZE, BENCH_IDR_FRAMES, true, NULL, 0 },
+};
+
+// Each case starts a new stream with its own queue and depacketizer, so a case
+// that leaves them waiting for an IDR frame doesn't affect the cases after it.
+// The frame tracking of the control stream can't be reset without a connection,
+// so frame numbers keep counting up from one case to the next.
+static RTP_VIDEO_QUEUE Queue;
+static NETWORK_IMPAIRMENT_STATE Impairment;
+static uint16_t NextSequenceNumber;
+static uint32_t NextStreamPacketIndex;
+static uint32_t NextFrameIndex;
+static uint32_t FirstFrameIndex;
+
+static uint32_t FramesSubmitted;
+static uint32_t RandomState;
+
+static int BenchSubmitDecodeUnit(PDECODE_UNIT decodeUnit) {
+    FramesSubmitted++;
+    return DR_OK;
+}
+
+static uint32_t nextRandom(void) {
+    RandomState = RandomState * 1103515245 + 12345;
+    return RandomState >> 16;
+}
+
+static int getReceiveSize(void) {
+    return StreamConfig.packetSize + MAX_RTP_HEADER_SIZE;
+}
+
+static int getPayloadSize(void) {
+    return StreamConfig.packetSize - (int)sizeof(NV_VIDEO_PACKET);
+}
+
+static int getParityShards(int dataShards, int fecPercentage) {
+    return (dataShards * fecPercentage + 99) / 100;
+}
+
+// Returns the number of FEC blocks the host would split a frame into
+static int getFecBlockCount(int dataShards, int fecPercentage) {
+    int blocks = 1;
+
+    while (blocks < BENCH_MAX_FEC_BLOCKS) {
+        int blockDataShards = (dataShards + blocks - 1) / blocks;
+
+        if (blockDataShards + getParityShards(blockDataShards, fecPercentage) <= DATA_SHARDS_MAX) {
+            break;
+        }
+
+        blocks++;
+    }
+
+    return blocks;
+}
+
+static int getMaxFramePackets(int frameSize, int fecPercentage) {
+    int payloadSize = getPayloadSize();
+    int dataShards = (frameSize + payloadSize - 1) / payloadSize;
+    int blocks = getFecBlockCount(dataShards, fecPercentage);
+
+    // Each block rounds its parity shards up
+    return dataShards + getParityShards(dataShards, fecPercentage) + blocks;
+}
+
+static void writeHeaders(char* buffer, uint16_t sequenceNumber, uint32_t frameIndex,
+                         uint32_t fecInfo, uint8_t multiFecBlocks) {
+    PRTP_PACKET rtpPacket = (PRTP_PACKET)buffer;
+    PNV_VIDEO_PACKET nvPacket = (PNV_VIDEO_PACKET)(buffer + MAX_RTP_HEADER_SIZE);
+
+    // Fields are in host byte order, as VideoReceiveThreadProc() leaves them
+    rtpPacket->header = 0x80 | FLAG_EXTENSION;
+    rtpPacket->packetType = 0x60;
+    rtpPacket->sequenceNumber = sequenceNumber;
+    rtpPacket->timestamp = frameIndex * BENCH_RTP_TIMESTAMP_STEP;
+    rtpPacket->ssrc = 0;
+
+    nvPacket->frameIndex = frameIndex;
+    nvPacket->multiFecFlags = 0x10;
+    nvPacket->multiFecBlocks = multiFecBlocks;
+    nvPacket->fecInfo = fecInfo;
+}
+
+// Fills in the Annex B frame data following the frame header, without
+// emulating any start sequences in the filler
+static void fillFrameData(char* frameData, int frameSize, bool idrFrame) {
+    static const unsigned char idrPrefix[] = {
+        0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x2a, 0xac, 0x2b, 0x40, 0x3c, 0x01, 0x13, 0xf2, 0xe0, // SPS
+        0x00, 0x00, 0x00, 0x01, 0x68, 0xee, 0x3c, 0xb0, // PPS
+        0x00, 0x00, 0x00, 0x01, 0x65, 0x88, // IDR slice
+    };
+    static const unsigned char pFramePrefix[] = {
+        0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, // non-IDR slice
+    };
+    int offset = 0;
+    int i;
+
+    // 8 byte frame header with the frame type
+    memset(frameData, 0, 8);
+    frameData[0] = 0x01;
+    frameData[3] = idrFrame ? 2 : 1;
+    offset += 8;
+
+    if (idrFrame) {
+        memcpy(&frameData[offset], idrPrefix, sizeof(idrPrefix));
+        offset += sizeof(idrPrefix);
+    }
+    else {
+        memcpy(&frameData[offset], pFramePrefix, sizeof(pFramePrefix));
+        offset += sizeof(pFramePrefix);
+    }
+
+    for (i = offset; i < frameSize; i++) {
+        frameData[i] = (char)(1 + nextRandom() % 255);
+    }
+}
+
+static void dropPackets(PBENCH_PACKET packets, int* count, int index, int dropCount) {
+    int i;
+
+    for (i = index; i < index + dropCount; i++) {
+        free(packets[i].buffer);
+    }
+    memmove(&packets[index], &packets[index + dropCount], (*count - index - dropCount) * sizeof(*packets));
+    *count -= dropCount;
+}
+
+// Appends the data and parity packets of one FEC block of a frame to the packet list in the
+// order they should be received, and returns the number appended.
+static int buildFecBlock(const BENCH_VIDEO_CASE* benchCase, uint32_t frameIndex, int blockNumber, int lastBlockNumber,
+                         const char* frameData, int firstShard, int dataShards, PBENCH_PACKET packets) {
+    static reed_solomon* rs;
+    int receiveSize = getReceiveSize();
+    int payloadSize = getPayloadSize();
+    int parityShards = getParityShards(dataShards, benchCase->fecPercentage);
+    int totalShards = dataShards + parityShards;
+    uint8_t multiFecBlocks = (uint8_t)((lastBlockNumber << 6) | (blockNumber << 4));
+    unsigned char* shards[DATA_SHARDS_MAX];
+    int count;
+    int lost;
+    int i;
+
+    LC_ASSERT(totalShards <= DATA_SHARDS_MAX);
+
+    for (i = 0; i < totalShards; i++) {
+        uint32_t fecInfo = ((uint32_t)dataShards << 22) | ((uint32_t)i << 12) | ((uint32_t)benchCase->fecPercentage << 4);
+
+        packets[i].buffer = calloc(1, receiveSize + sizeof(RTPV_QUEUE_ENTRY));
+        writeHeaders(packets[i].buffer, U16(NextSequenceNumber + i), frameIndex, fecInfo, multiFecBlocks);
+        shards[i] = (unsigned char*)packets[i].buffer;
+
+        if (i < dataShards) {
+            PNV_VIDEO_PACKET nvPacket = (PNV_VIDEO_PACKET)(packets[i].buffer + MAX_RTP_HEADER_SIZE);
+            int frameShard = firstShard + i;
+            int frameOffset = frameShard * payloadSize;
+            int length = benchCase->frameSize - frameOffset < payloadSize ? benchCase->frameSize - frameOffset : payloadSize;
+
+            nvPacket->streamPacketIndex = NextStreamPacketIndex << 8;
+            // Like the host, mark the boundaries of each FEC block. The queue
+            // checks them on recovered packets.
+            nvPacket->flags = FLAG_CONTAINS_PIC_DATA;
+            if (i == 0) {
+                nvPacket->flags |= FLAG_SOF;
+            }
+            if (i == dataShards - 1) {
+                nvPacket->flags |= FLAG_EOF;
+            }
+            NextStreamPacketIndex = U24(NextStreamPacketIndex + 1);
+
+            memcpy(nvPacket + 1, &frameData[frameOffset], length);
+            packets[i].length = MAX_RTP_HEADER_SIZE + sizeof(*nvPacket) + length;
+        }
+        else {
+            packets[i].length = receiveSize;
+        }
+    }
+
+    // The parity covers the NV_VIDEO_PACKET flags and stream packet index that
+    // the depacketizer needs from recovered packets. The RTP header and the
+    // remaining fields of parity packets are their own, like the host sends them.
+    if (parityShards != 0) {
+        if (rs == NULL || rs->data_shards != dataShards || rs->parity_shards != parityShards) {
+            reed_solomon_release(rs);
+            rs = reed_solomon_new(dataShards, parityShards);
+        }
+        reed_solomon_encode(rs, shards, totalShards, receiveSize);
+        for (i = dataShards; i < totalShards; i++) {
+            uint32_t fecInfo = ((uint32_t)dataShards << 22) | ((uint32_t)i << 12) | ((uint32_t)benchCase->fecPercentage << 4);
+
+            writeHeaders(packets[i].buffer, U16(NextSequenceNumber + i), frameIndex, fecInfo, multiFecBlocks);
+        }
+    }
+    NextSequenceNumber = U16(NextSequenceNumber + totalShards);
+
+    count = totalShards;
+    switch (benchCase->pattern) {
+    case PATTERN_IN_ORDER:
+        break;
+
+    case PATTERN_REORDERED:
+        for (i = 0; i + 1 < count; i += 2) {
+            BENCH_PACKET packet = packets[i];
+            packets[i] = packets[i + 1];
+            packets[i + 1] = packet;
+        }
+        break;
+
+    case PATTERN_SINGLE_LOSS:
+        if (parityShards != 0) {
+            dropPackets(packets, &count, nextRandom() % dataShards, 1);
+        }
+        break;
+
+    case PATTERN_BURST_LOSS:
+        lost = parityShards - BENCH_VALIDATION_PARITY_SHARDS < dataShards ?
+            parityShards - BENCH_VALIDATION_PARITY_SHARDS : dataShards;
+        if (lost > 0) {
+            dropPackets(packets, &count, nextRandom() % (dataShards - lost + 1), lost);
+        }
+        break;
+    case PATTERN_SECOND_BLOCK_LOSS:
+        // Rounds have an even number of frames, so each round loses the same frames
+        if (blockNumber == 1 && (frameIndex - FirstFrameIndex) % 2 == 1) {
+            dropPackets(packets, &count, 0, count);
+        }
+        break;
+    }
+
+    return count;
+}
+
+// Appends the packets of a frame to the packet list in the order they should
+// be received, and returns the number appended.
+static int buildFrame(const BENCH_VIDEO_CASE* benchCase, PBENCH_PACKET packets) {
+    static char frameData[BENCH_MAX_FRAME_SIZE];
+    uint32_t frameIndex = NextFrameIndex++;
+    int payloadSize = getPayloadSize();
+    int dataShards = (benchCase->frameSize + payloadSize - 1) / payloadSize;
+    int blocks = getFecBlockCount(dataShards, benchCase->fecPercentage);
+    int count = 0;
+    int block;
+
+    LC_ASSERT(benchCase->frameSize <= BENCH_MAX_FRAME_SIZE);
+
+    // The stream must start with an IDR frame
+    fillFrameData(frameData, benchCase->frameSize, benchCase->idrFrames || frameIndex == FirstFrameIndex);
+
+    for (block = 0; block < blocks; block++) {
+        int firstShard = block * dataShards / blocks;
+        int nextShard = (block + 1) * dataShards / blocks;
+
+        count += buildFecBlock(benchCase, frameIndex, block, blocks - 1, frameData,
+                               firstShard, nextShard - firstShard, &packets[count]);
+    }
+
+    return count;
+}
+
+// Passes the packets through the network impairment of the case in simulated
+// time, where each frame starts arriving at its RTP timestamp, and returns
+// them in the order they're released.
+static PBENCH_PACKET impairPackets(const BENCH_VIDEO_CASE* benchCase, PBENCH_PACKET packets, int* packetCount) {
+    // Duplication can at most double the packets
+    PBENCH_PACKET impairedPackets = malloc(sizeof(*impairedPackets) * *packetCount * 2);
+    int receiveSize = getReceiveSize();
+    uint64_t arrivalTimeUs = 0;
+    uint32_t frameTimestamp = 0;
+    int impairedCount = 0;
+    int i;
+
+    NiInitialize(&Impairment, benchCase->impairment, NI_STREAM_VIDEO);
+
+    for (i = 0; i <= *packetCount; i++) {
+        uint64_t releaseLimitUs = UINT64_MAX;
+        uint64_t releaseTimeUs;
+
+        if (i < *packetCount) {
+            PRTP_PACKET packet = (PRTP_PACKET)packets[i].buffer;
+
+            if (i == 0 || packet->timestamp != frameTimestamp) {
+                frameTimestamp = packet->timestamp;
+                arrivalTimeUs = ((uint64_t)frameTimestamp * 1000) / 90;
+            }
+            else {
+                arrivalTimeUs += BENCH_PACKET_INTERVAL_US;
+            }
+            releaseLimitUs = arrivalTimeUs;
+        }
+
+        // Take everything released before this packet arrives, or everything left after the last one
+        while ((releaseTimeUs = NiGetNextReleaseTimeUs(&Impairment)) != 0 && releaseTimeUs <= releaseLimitUs) {
+            PBENCH_PACKET impairedPacket = &impairedPackets[impairedCount++];
+
+            impairedPacket->buffer = calloc(1, receiveSize + sizeof(RTPV_QUEUE_ENTRY));
+            impairedPacket->length = NiReceivePacket(&Impairment, releaseTimeUs, impairedPacket->buffer, receiveSize, NULL);
+        }
+
+        if (i < *packetCount) {
+            NiSubmitPacket(&Impairment, packets[i].buffer, packets[i].length, arrivalTimeUs);
+            free(packets[i].buffer);
+        }
+    }
+
+    NiCleanup(&Impairment);
+    free(packets);
+
+    *packetCount = impairedCount;
+    return impairedPackets;
+}
+
+static PBENCH_PACKET buildFrames(const BENCH_VIDEO_CASE* benchCase, int* packetCount) {
+    PBENCH_PACKET packets = malloc(sizeof(*packets) * getMaxFramePackets(benchCase->frameSize, benchCase->fecPercentage) * benchCase->frames);
+    uint32_t frame;
+
+    *packetCount = 0;
+    for (frame = 0; frame < benchCase->frames; frame++) {
+        *packetCount += buildFrame(benchCase, &packets[*packetCount]);
+    }
+
+    if (benchCase->impairment != NULL) {
+        packets = impairPackets(benchCase, packets, packetCount);
+    }
+
+    return packets;
+}
+
+// Otherwise the case measured the wrong path, like dropping frames while waiting for an IDR frame
+static void checkFramesSubmitted(const BENCH_VIDEO_CASE* benchCase, uint32_t framesSubmitted) {
+    uint32_t expectedFrames = benchCase->frames - benchCase->framesLost;
+
+#ifdef LC_DEBUG
+    // FEC validation leaves less parity for the impairment, so more frames are lost
+    if (benchCase->impairment != NULL) {
+        return;
+    }
+#endif
+
+    if (FramesSubmitted - framesSubmitted != expectedFrames) {
+        BenchFail("%s: %u of %u frames were submitted, expected %u",
+                  benchCase->name, FramesSubmitted - framesSubmitted, benchCase->frames, expectedFrames);
+    }
+}
+
+// Reports how well the stream recovered from the impairment in the last round.
+// The impairment and FEC outcome is the same in every round.
+static void reportRecovery(const BENCH_VIDEO_CASE* benchCase, uint32_t framesSubmitted, const RTP_VIDEO_STATS* startStats) {
+    const NETWORK_IMPAIRMENT_STATS* stats = &Impairment.stats;
+
+    printf("    %u of %u frames lost, %u FEC recovered, %u FEC failed; %u packets lost, %u over bandwidth, "
+           "%u reordered, %u duplicated, %.2f ms average added delay\n",
+           benchCase->frames - (FramesSubmitted - framesSubmitted), benchCase->frames,
+           Queue.stats.packetCountFecRecovered - startStats->packetCountFecRecovered,
+           Queue.stats.packetCountFecFailed - startStats->packetCountFecFailed,
+           stats->packetsLost, stats->packetsOverBandwidth, stats->packetsReordered, stats->packetsDuplicated,
+           stats->packetsDelivered != 0 ? (double)stats->totalAddedDelayUs / stats->packetsDelivered / 1000 : 0.0);
+}
+
+static void runRtpVideoQueueCase(const BENCH_VIDEO_CASE* benchCase) {
+    BENCH_ROUND fastestRound = { 0 };
+    uint64_t totalPackets = 0;
+    uint32_t framesSubmitted = 0;
+    RTP_VIDEO_STATS startStats;
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        BENCH_ROUND benchRound;
+        PBENCH_PACKET packets;
+        int packetCount;
+        int i;
+
+        framesSubmitted = FramesSubmitted;
+        startStats = Queue.stats;
+        packets = buildFrames(benchCase, &packetCount);
+
+        BenchBeginRound(&benchRound);
+        for (i = 0; i < packetCount; i++) {
+            char* buffer = packets[i].buffer;
+            PRTPV_QUEUE_ENTRY entry = (PRTPV_QUEUE_ENTRY)&buffer[getReceiveSize()];
+
+            // Like the receive thread, sample the receive time for each packet
+            entry->receiveTimeUs = PltGetMicroseconds();
+            entry->receiveDelayUs = 0;
+
+            if (RtpvAddPacket(&Queue, (PRTP_PACKET)buffer, packets[i].length, entry) != RTPF_RET_QUEUED) {
+                // Like the receive thread, we still own rejected packets
+                free(buffer);
+            }
+        }
+        BenchEndRound(&benchRound);
+
+        checkFramesSubmitted(benchCase, framesSubmitted);
+
+        // Every round has the same number of packets
+        totalPackets = packetCount;
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+
+        free(packets);
+    }
+
+    BenchReport(benchCase->name, "packet", totalPackets, &fastestRound);
+
+    if (benchCase->impairment != NULL) {
+        reportRecovery(benchCase, framesSubmitted, &startStats);
+    }
+}
+
+// Feeds the data packets straight to the depacketizer, as the RTP queue
+// does once it has a complete FEC block
+static void runVideoDepacketizerCase(const BENCH_VIDEO_CASE* benchCase) {
+    BENCH_ROUND fastestRound = { 0 };
+    uint64_t totalPackets = 0;
+    int round;
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        uint32_t framesSubmitted = FramesSubmitted;
+        BENCH_ROUND benchRound;
+        PBENCH_PACKET packets;
+        int packetCount;
+        int i;
+
+        packets = buildFrames(benchCase, &packetCount);
+
+        BenchBeginRound(&benchRound);
+        for (i = 0; i < packetCount; i++) {
+            PRTP_PACKET packet = (PRTP_PACKET)packets[i].buffer;
+            PRTPV_QUEUE_ENTRY entry = (PRTPV_QUEUE_ENTRY)&packets[i].buffer[getReceiveSize()];
+
+            entry->packet = packet;
+            entry->length = packets[i].length;
+            entry->isParity = false;
+            entry->receiveTimeUs = PltGetMicroseconds();
+            entry->receiveDelayUs = 0;
+            entry->presentationTimeUs = ((uint64_t)packet->timestamp * 1000) / 90;
+            entry->rtpTimestamp = packet->timestamp;
+
+            // The depacketizer owns the packet now
+            queueRtpPacket(entry);
+        }
+        BenchEndRound(&benchRound);
+
+        checkFramesSubmitted(benchCase, framesSubmitted);
+
+        totalPackets = packetCount;
+        BenchKeepFastestRound(&fastestRound, &benchRound);
+
+        free(packets);
+    }
+
+    BenchReport(benchCase->name, "packet", totalPackets, &fastestRound);
+}
+
+// Sets up the parts of the library that the video benchmarks use
+static void setUpVideoStream(void) {
+    static bool started;
+    DECODER_RENDERER_CALLBACKS drCallbacks;
+    PDECODER_RENDERER_CALLBACKS drCallbacksPtr = &drCallbacks;
+    PAUDIO_RENDERER_CALLBACKS arCallbacksPtr = NULL;
+    PCONNECTION_LISTENER_CALLBACKS clCallbacksPtr = NULL;
+
+    if (started) {
+        return;
+    }
+    started = true;
+
+    // Stand in for a GFE host, so no FEC status is sent to a control stream
+    AppVersionQuad[0] = 7;
+    AppVersionQuad[1] = 1;
+    AppVersionQuad[2] = 431;
+    AppVersionQuad[3] = 0;
+
+    LiInitializeStreamConfiguration(&StreamConfig);
+    StreamConfig.packetSize = BENCH_PACKET_SIZE;
+    NegotiatedVideoFormat = VIDEO_FORMAT_H264;
+
+    LiInitializeVideoCallbacks(&drCallbacks);
+    drCallbacks.submitDecodeUnit = BenchSubmitDecodeUnit;
+    drCallbacks.capabilities = CAPABILITY_DIRECT_SUBMIT;
+    fixupMissingCallbacks(&drCallbacksPtr, &arCallbacksPtr, &clCallbacksPtr);
+    memcpy(&VideoCallbacks, drCallbacksPtr, sizeof(VideoCallbacks));
+    memcpy(&ListenerCallbacks, clCallbacksPtr, sizeof(ListenerCallbacks));
+
+    NextFrameIndex = 1;
+}
+
+static void beginVideoCase(void) {
+    NextSequenceNumber = 0;
+    NextStreamPacketIndex = 0;
+    FirstFrameIndex = NextFrameIndex;
+
+    initializeVideoDepacketizer(StreamConfig.packetSize);
+    RtpvInitializeQueue(&Queue);
+
+    // A new queue expects frame 1, but the frame numbers continue from the last case
+    Queue.currentFrameNumber = FirstFrameIndex;
+}
+
+static void endVideoCase(void) {
+    RtpvCleanupQueue(&Queue);
+    destroyVideoDepacketizer();
+}
+
+void BenchRtpVideoQueue(void) {
+    unsigned int i;
+
+    setUpVideoStream();
+
+    for (i = 0; i < sizeof(RtpVideoQueueCases) / sizeof(RtpVideoQueueCases[0]); i++) {
+        beginVideoCase();
+        runRtpVideoQueueCase(&RtpVideoQueueCases[i]);
+        endVideoCase();
+    }
+}
+
+void BenchRtpVideoQueueSubframe(void) {
+    unsigned int i;
+
+    setUpVideoStream();
+    VideoCallbacks.capabilities |= CAPABILITY_SUBFRAME_SUBMIT;
+
+    for (i = 0; i < sizeof(RtpVideoQueueSubframeCases) / sizeof(RtpVideoQueueSubframeCases[0]); i++) {
+        beginVideoCase();
+        runRtpVideoQueueCase(&RtpVideoQueueSubframeCases[i]);
+        endVideoCase();
+    }
+
+    VideoCallbacks.capabilities &= ~CAPABILITY_SUBFRAME_SUBMIT;
+}
+
+void BenchVideoDepacketizer(void) {
+    unsigned int i;
+
+    setUpVideoStream();
+
+    for (i = 0; i < sizeof(VideoDepacketizerCases) / sizeof(VideoDepacketizerCases[0]); i++) {
+        beginVideoCase();
+        runVideoDepacketizerCase(&VideoDepacketizerCases[i]);
+        endVideoCase();
+    }
+}
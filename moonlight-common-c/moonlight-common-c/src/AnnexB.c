@@ -0,0 +1,252 @@
+#include "AnnexB.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ANNEXB_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ANNEXB_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define ANNEXB_NEON
+#endif
+
+#if defined(_MSC_VER) && (defined(ANNEXB_AVX2) || defined(ANNEXB_SSE2) || defined(ANNEXB_NEON))
+#include <intrin.h>
+#endif
+
+#if defined(ANNEXB_AVX2) || defined(ANNEXB_SSE2)
+static unsigned int findFirstSetBit32(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+#elif defined(ANNEXB_NEON)
+static unsigned int findFirstSetBit64(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctzll(mask);
+#endif
+}
+#endif
+
+unsigned int AnnexBFindStartSequence(const char* data, unsigned int length, unsigned int* startSeqLength) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    unsigned int i = 0;
+
+    // The start sequence must be followed by a NALU header byte
+    if (length < 4) {
+        return length;
+    }
+
+    // Look for 00 00 01 at each position by comparing the data against itself
+    // shifted by one and two bytes. Each block only tests positions that have
+    // room for the NALU header byte, so the scalar loop handles the tail.
+#if defined(ANNEXB_AVX2)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    for (; i + 32 + 3 <= length; i += 32) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)&bytes[i]);
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)&bytes[i + 1]);
+        __m256i b2 = _mm256_loadu_si256((const __m256i*)&bytes[i + 2]);
+        __m256i match = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, zero),
+                                                          _mm256_cmpeq_epi8(b1, zero)),
+                                         _mm256_cmpeq_epi8(b2, one));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(match);
+        if (mask != 0) {
+            i += findFirstSetBit32(mask);
+            goto Found;
+        }
+    }
+#elif defined(ANNEXB_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 + 3 <= length; i += 16) {
+        __m128i b0 = _mm_loadu_si128((const __m128i*)&bytes[i]);
+        __m128i b1 = _mm_loadu_si128((const __m128i*)&bytes[i + 1]);
+        __m128i b2 = _mm_loadu_si128((const __m128i*)&bytes[i + 2]);
+        __m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero),
+                                                    _mm_cmpeq_epi8(b1, zero)),
+                                      _mm_cmpeq_epi8(b2, one));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(match);
+        if (mask != 0) {
+            i += findFirstSetBit32(mask);
+            goto Found;
+        }
+    }
+#elif defined(ANNEXB_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+    for (; i + 16 + 3 <= length; i += 16) {
+        uint8x16_t b0 = vld1q_u8(&bytes[i]);
+        uint8x16_t b1 = vld1q_u8(&bytes[i + 1]);
+        uint8x16_t b2 = vld1q_u8(&bytes[i + 2]);
+        uint8x16_t match = vandq_u8(vandq_u8(vceqq_u8(b0, zero), vceqq_u8(b1, zero)), vceqq_u8(b2, one));
+
+        // NEON has no movemask, so narrow each byte to a nibble instead
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+        if (mask != 0) {
+            i += findFirstSetBit64(mask) / 4;
+            goto Found;
+        }
+    }
+#endif
+
+    for (; i + 3 < length; i++) {
+        if (bytes[i] == 0 && bytes[i + 1] == 0 && bytes[i + 2] == 1) {
+            goto Found;
+        }
+    }
+
+    return length;
+
+Found:
+    // Include the leading zero of a 4 byte start sequence
+    if (i > 0 && bytes[i - 1] == 0) {
+        *startSeqLength = 4;
+        return i - 1;
+    }
+    else {
+        *startSeqLength = 3;
+        return i;
+    }
+}
+
+int AnnexBClassifyNal(uint8_t nalHeader, bool hevc) {
+    if (hevc) {
+        int type = HEVC_NAL_TYPE(nalHeader);
+
+        switch (type) {
+        case 16:
+        case 17:
+        case 18:
+        case 19:
+        case 20:
+        case 21:
+            return NAL_CLASS_REFERENCE_SLICE;
+
+        case HEVC_NAL_TYPE_VPS:
+            return NAL_CLASS_VPS;
+
+        case HEVC_NAL_TYPE_SPS:
+            return NAL_CLASS_SPS;
+
+        case HEVC_NAL_TYPE_PPS:
+            return NAL_CLASS_PPS;
+
+        case HEVC_NAL_TYPE_AUD:
+            return NAL_CLASS_AUD;
+
+        case HEVC_NAL_TYPE_FILLER:
+            return NAL_CLASS_FILLER;
+
+        case HEVC_NAL_TYPE_SEI:
+            return NAL_CLASS_SEI;
+
+        default:
+            // Types 0-31 are all VCL NALUs
+            return type < 32 ? NAL_CLASS_SLICE : NAL_CLASS_OTHER;
+        }
+    }
+    else {
+        int type = H264_NAL_TYPE(nalHeader);
+
+        switch (type) {
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+            return NAL_CLASS_SLICE;
+
+        case H264_NAL_TYPE_IDR:
+            return NAL_CLASS_REFERENCE_SLICE;
+
+        case H264_NAL_TYPE_SEI:
+            return NAL_CLASS_SEI;
+
+        case H264_NAL_TYPE_SPS:
+            return NAL_CLASS_SPS;
+
+        case H264_NAL_TYPE_PPS:
+            return NAL_CLASS_PPS;
+
+        case H264_NAL_TYPE_AUD:
+            return NAL_CLASS_AUD;
+
+        case H264_NAL_TYPE_FILLER:
+            return NAL_CLASS_FILLER;
+
+        default:
+            return NAL_CLASS_OTHER;
+        }
+    }
+}
+
+bool AnnexBIsDiscardableSlice(uint8_t nalHeader, bool hevc) {
+    if (hevc) {
+        int type = HEVC_NAL_TYPE(nalHeader);
+
+        // TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N and the reserved RSV_VCL_N types
+        return type < 16 && (type % 2) == 0;
+    }
+    else {
+        // nal_ref_idc
+        return (nalHeader & 0x60) == 0;
+    }
+}
+
+void AnnexBScanNals(PANNEXB_NAL_SCAN scan, const char* data, unsigned int offset, unsigned int length, bool hevc) {
+    unsigned int end = offset + length;
+    unsigned int startSeqLength;
+    unsigned int position;
+
+    scan->count = 0;
+    scan->end = end;
+    scan->truncated = false;
+
+    position = offset + AnnexBFindStartSequence(&data[offset], length, &startSeqLength);
+    while (position != end) {
+        PANNEXB_NAL nal = &scan->nals[scan->count++];
+
+        nal->offset = position;
+        nal->startSeqLength = (uint8_t)startSeqLength;
+        nal->nalClass = (uint8_t)AnnexBClassifyNal((uint8_t)data[position + startSeqLength], hevc);
+
+        // Everything after the first slice is picture data, so there's nothing left
+        // for us to find. If we run out of room first, the caller can continue the
+        // scan from this NALU.
+        if (NAL_CLASS_IS_SLICE(nal->nalClass)) {
+            nal->length = end - position;
+            break;
+        }
+        else if (scan->count == ANNEXB_MAX_SCANNED_NALS) {
+            nal->length = end - position;
+            scan->truncated = true;
+            break;
+        }
+
+        // The next start sequence ends this NALU
+        position += startSeqLength;
+        position += AnnexBFindStartSequence(&data[position], end - position, &startSeqLength);
+        nal->length = position - nal->offset;
+    }
+}
+
+bool AnnexBContinueScan(PANNEXB_NAL_SCAN scan, const char* data, bool hevc) {
+    unsigned int offset;
+
+    if (!scan->truncated) {
+        return false;
+    }
+
+    offset = scan->nals[scan->count - 1].offset;
+    AnnexBScanNals(scan, data, offset, scan->end - offset, hevc);
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Platform.h"
+
+#define H264_NAL_TYPE(x) ((x) & 0x1F)
+#define HEVC_NAL_TYPE(x) (((x) & 0x7E) >> 1)
+
+#define H264_NAL_TYPE_IDR 5
+#define H264_NAL_TYPE_SEI 6
+#define H264_NAL_TYPE_SPS 7
+#define H264_NAL_TYPE_PPS 8
+#define H264_NAL_TYPE_AUD 9
+#define H264_NAL_TYPE_FILLER 12
+#define HEVC_NAL_TYPE_VPS 32
+#define HEVC_NAL_TYPE_SPS 33
+#define HEVC_NAL_TYPE_PPS 34
+#define HEVC_NAL_TYPE_AUD 35
+#define HEVC_NAL_TYPE_FILLER 38
+#define HEVC_NAL_TYPE_SEI 39
+
+// Codec-independent classes of the NALUs the depacketizer cares about
+#define NAL_CLASS_NONE 0
+#define NAL_CLASS_OTHER 1
+#define NAL_CLASS_AUD 2
+#define NAL_CLASS_SEI 3
+#define NAL_CLASS_VPS 4
+#define NAL_CLASS_SPS 5
+#define NAL_CLASS_PPS 6
+#define NAL_CLASS_FILLER 7
+#define NAL_CLASS_SLICE 8
+#define NAL_CLASS_REFERENCE_SLICE 9
+
+#define NAL_CLASS_IS_SLICE(x) ((x) == NAL_CLASS_SLICE || (x) == NAL_CLASS_REFERENCE_SLICE)
+
+typedef struct _ANNEXB_NAL {
+    // Offset of the start sequence within the scanned data
+    unsigned int offset;
+
+    // Length including the start sequence, up to the next start sequence
+    unsigned int length;
+
+    uint8_t startSeqLength;
+    uint8_t nalClass;
+} ANNEXB_NAL, *PANNEXB_NAL;
+
+// A host sends a handful of parameter set and SEI NALUs ahead of the
+// picture data, so this is plenty for any first packet of a frame.
+// Scans that need more are continued with AnnexBContinueScan().
+#define ANNEXB_MAX_SCANNED_NALS 16
+
+typedef struct _ANNEXB_NAL_SCAN {
+    unsigned int count;
+
+    // End of the scanned data
+    unsigned int end;
+
+    // Set if the table filled up before the scan reached a slice NALU
+    bool truncated;
+
+    ANNEXB_NAL nals[ANNEXB_MAX_SCANNED_NALS];
+} ANNEXB_NAL_SCAN, *PANNEXB_NAL_SCAN;
+
+// Returns the offset of the first 3 or 4 byte start sequence that is followed by a
+// NALU header byte, or length if there is none. The start sequence length is returned
+// in startSeqLength. Leading zero bytes beyond the 4 byte form are not included.
+unsigned int AnnexBFindStartSequence(const char* data, unsigned int length, unsigned int* startSeqLength);
+
+// Classifies the NALU with the given header byte
+int AnnexBClassifyNal(uint8_t nalHeader, bool hevc);
+
+// Returns true if the slice NALU with the given header belongs to a picture that no
+// other picture references (nal_ref_idc of 0 for H.264, or a sub-layer non-reference
+// picture for HEVC streams with a single temporal layer, which hosts always send).
+// Such a picture can be left out without corrupting the pictures that follow it.
+bool AnnexBIsDiscardableSlice(uint8_t nalHeader, bool hevc);
+
+// Records the offset and class of each NALU in the data in one pass. The scan stops
+// after the first slice NALU (or when the table is full) and the last NALU recorded
+// always extends to the end of the data. Bytes before the first start sequence are
+// not part of any NALU.
+void AnnexBScanNals(PANNEXB_NAL_SCAN scan, const char* data, unsigned int offset, unsigned int length, bool hevc);
+
+// Continues a truncated scan from the last NALU it recorded, which becomes the
+// first NALU in the table. Returns false if the scan wasn't truncated.
+bool AnnexBContinueScan(PANNEXB_NAL_SCAN scan, const char* data, bool hevc);
@@ -12,7 +12,10 @@ static PLT_THREAD decoderThread;
 static PPLT_CRYPTO_CONTEXT audioDecryptionCtx;
 static uint32_t avRiKeyId;
 
+static NETWORK_IMPAIRMENT_STATE networkImpairment;
+
 static unsigned short lastSeq;
+static uint32_t currentSampleTimestamp;
 
 static bool pingThreadStarted;
 static bool receivedDataFromPeer;
@@ -69,10 +72,13 @@ int initializeAudioStream(void) {
     LbqInitializeLinkedBlockingQueue(&packetQueue, 30);
     RtpaInitializeQueue(&rtpAudioQueue);
     lastSeq = 0;
+    currentSampleTimestamp = 0;
     receivedDataFromPeer = false;
     pingThreadStarted = false;
     firstReceiveTime = 0;
     audioDecryptionCtx = PltCreateCryptoContext();
+    NiInitialize(&networkImpairment, &StreamConfig.networkImpairment, NI_STREAM_AUDIO);
+    NiLogConfiguration(&networkImpairment, "Audio");
 #ifdef LC_DEBUG
     opusHeaderByte = INVALID_OPUS_HEADER;
 #endif
@@ -93,11 +99,14 @@ int notifyAudioPortNegotiationComplete(void) {
 
     // For GFE 3.22 compatibility, we must start the audio ping thread before the RTSP handshake.
     // It will not reply to our RTSP PLAY request until the audio ping has been received.
-    rtpSocket = bindUdpSocket(RemoteAddr.ss_family, &LocalAddr, AddrLen, 0, SOCK_QOS_TYPE_AUDIO);
+    rtpSocket = bindUdpSocket(RemoteAddr.ss_family, &LocalAddr, AddrLen, StreamConfig.rtpReceiveBufferSize, SOCK_QOS_TYPE_AUDIO);
     if (rtpSocket == INVALID_SOCKET) {
         return LastSocketFail();
     }
 
+    setRtpSocketOptions(rtpSocket, StreamConfig.rtpReceiveBufferSize, StreamConfig.rtpBusyPollUs,
+                        &RtpSocketOptions.audioReceiveBufferSize, &RtpSocketOptions.audioBusyPollUs);
+
     // We may receive audio before our threads are started, but that's okay. We'll
     // drop the first 1 second of audio packets to catch up with the backlog.
     int err = PltCreateThread("AudioPing", AudioPingThreadProc, NULL, &udpPingThread);
@@ -137,6 +146,7 @@ void destroyAudioStream(void) {
     PltDestroyCryptoContext(audioDecryptionCtx);
     freePacketList(LbqDestroyLinkedBlockingQueue(&packetQueue));
     RtpaCleanupQueue(&rtpAudioQueue);
+    NiCleanup(&networkImpairment);
 }
 
 static bool queuePacketToLbq(PQUEUED_AUDIO_PACKET* packet) {
@@ -164,11 +174,14 @@ static void decodeInputData(PQUEUED_AUDIO_PACKET packet) {
     // packet. Trigger packet loss concealment logic in libopus by
     // invoking the decoder with a NULL buffer.
     if (packet->header.size == 0) {
+        // The concealed sample takes the place of the one after the last sample
+        currentSampleTimestamp += AudioPacketDuration;
         AudioCallbacks.decodeAndPlaySample(NULL, 0);
         return;
     }
 
     PRTP_PACKET rtp = (PRTP_PACKET)&packet->data[0];
+    currentSampleTimestamp = rtp->timestamp;
     if (lastSeq != 0 && (unsigned short)(lastSeq + 1) != rtp->sequenceNumber) {
         Limelog("Network dropped audio data (expected %d, but received %d)\n", lastSeq + 1, rtp->sequenceNumber);
     }
@@ -267,7 +280,12 @@ static void AudioReceiveThreadProc(void* context) {
             }
         }
 
-        packet->header.size = recvUdpSocket(rtpSocket, &packet->data[0], MAX_PACKET_SIZE, useSelect);
+        if (NiIsEnabled(&networkImpairment)) {
+            packet->header.size = NiRecvUdpSocket(&networkImpairment, rtpSocket, &packet->data[0], MAX_PACKET_SIZE, useSelect, NULL);
+        }
+        else {
+            packet->header.size = recvUdpSocket(rtpSocket, &packet->data[0], MAX_PACKET_SIZE, useSelect);
+        }
         if (packet->header.size < 0) {
             Limelog("Audio Receive: recvUdpSocket() failed: %d\n", (int)LastSocketError());
             ListenerCallbacks.connectionTerminated(LastSocketFail());
@@ -477,6 +495,14 @@ int LiGetPendingAudioDuration(void) {
     return LiGetPendingAudioFrames() * AudioPacketDuration;
 }
 
+uint32_t LiGetCurrentAudioSampleTimestamp(void) {
+    return currentSampleTimestamp;
+}
+
 const RTP_AUDIO_STATS* LiGetRTPAudioStats(void) {
     return &rtpAudioQueue.stats;
 }
+
+const NETWORK_IMPAIRMENT_STATS* LiGetAudioImpairmentStats(void) {
+    return &networkImpairment.stats;
+}
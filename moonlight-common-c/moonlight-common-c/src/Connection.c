@@ -36,6 +36,7 @@ uint32_t SunshineFeatureFlags;
 uint32_t EncryptionFeaturesSupported;
 uint32_t EncryptionFeaturesRequested;
 uint32_t EncryptionFeaturesEnabled;
+RTP_SOCKET_OPTIONS RtpSocketOptions;
 
 // Connection stages
 static const char* stageNames[STAGE_MAX] = {
@@ -209,6 +210,7 @@ static bool parseRtspPortNumberFromUrl(const char* rtspSessionUrl, uint16_t* por
 int LiStartConnection(PSERVER_INFORMATION serverInfo, PSTREAM_CONFIGURATION streamConfig, PCONNECTION_LISTENER_CALLBACKS clCallbacks,
     PDECODER_RENDERER_CALLBACKS drCallbacks, PAUDIO_RENDERER_CALLBACKS arCallbacks, void* renderContext, int drFlags,
     void* audioContext, int arFlags) {
+    int preferredFamily;
     int err;
 
     if (drCallbacks != NULL && (drCallbacks->capabilities & CAPABILITY_PULL_RENDERER) && drCallbacks->submitDecodeUnit) {
@@ -259,6 +261,7 @@ int LiStartConnection(PSERVER_INFORMATION serverInfo, PSTREAM_CONFIGURATION stre
     ListenerCallbacks.connectionTerminated = ClInternalConnectionTerminated;
 
     memset(&LocalAddr, 0, sizeof(LocalAddr));
+    memset(&RtpSocketOptions, 0, sizeof(RtpSocketOptions));
     NegotiatedVideoFormat = 0;
     memcpy(&StreamConfig, streamConfig, sizeof(StreamConfig));
     RemoteAddrString = strdup(serverInfo->address);
@@ -345,16 +348,33 @@ int LiStartConnection(PSERVER_INFORMATION serverInfo, PSTREAM_CONFIGURATION stre
     Limelog("Resolving host name...");
     ListenerCallbacks.stageStarting(STAGE_NAME_RESOLUTION);
     LC_ASSERT(RtspPortNumber != 0);
+
+    // Start with the address family that won the last time the client connected
+    // to this host. Retries start with the family that won the last attempt.
+    switch (serverInfo->preferredAddressFamily) {
+    case ADDRESS_FAMILY_IPV4:
+        preferredFamily = AF_INET;
+        break;
+#ifdef AF_INET6
+    case ADDRESS_FAMILY_IPV6:
+        preferredFamily = AF_INET6;
+        break;
+#endif
+    default:
+        preferredFamily = AF_UNSPEC;
+        break;
+    }
+
     if (RtspPortNumber != 48010) {
         // If we have an alternate RTSP port, use that as our test port. The host probably
         // isn't listening on 47989 or 47984 anyway, since they're using alternate ports.
-        err = resolveHostName(serverInfo->address, AF_UNSPEC, RtspPortNumber, &RemoteAddr, &AddrLen);
+        err = resolveHostName(serverInfo->address, AF_UNSPEC, RtspPortNumber, &preferredFamily, &RemoteAddr, &AddrLen);
         if (err != 0) {
             // Sleep for a second and try again. It's possible that we've attempt to connect
             // before the host has gotten around to listening on the RTSP port. Give it some
             // time before retrying.
             PltSleepMs(1000);
-            err = resolveHostName(serverInfo->address, AF_UNSPEC, RtspPortNumber, &RemoteAddr, &AddrLen);
+            err = resolveHostName(serverInfo->address, AF_UNSPEC, RtspPortNumber, &preferredFamily, &RemoteAddr, &AddrLen);
         }
     }
     else {
@@ -364,12 +384,12 @@ int LiStartConnection(PSERVER_INFORMATION serverInfo, PSTREAM_CONFIGURATION stre
         // TCP 48010 is a last resort because:
         // a) it's not always listening and there's a race between listen() on the host and our connect()
         // b) it's not used at all by certain host versions which perform RTSP over ENet
-        err = resolveHostName(serverInfo->address, AF_UNSPEC, 47984, &RemoteAddr, &AddrLen);
+        err = resolveHostName(serverInfo->address, AF_UNSPEC, 47984, &preferredFamily, &RemoteAddr, &AddrLen);
         if (err != 0) {
-            err = resolveHostName(serverInfo->address, AF_UNSPEC, 47989, &RemoteAddr, &AddrLen);
+            err = resolveHostName(serverInfo->address, AF_UNSPEC, 47989, &preferredFamily, &RemoteAddr, &AddrLen);
         }
         if (err != 0) {
-            err = resolveHostName(serverInfo->address, AF_UNSPEC, 48010, &RemoteAddr, &AddrLen);
+            err = resolveHostName(serverInfo->address, AF_UNSPEC, 48010, &preferredFamily, &RemoteAddr, &AddrLen);
         }
     }
     if (err != 0) {
@@ -377,6 +397,11 @@ int LiStartConnection(PSERVER_INFORMATION serverInfo, PSTREAM_CONFIGURATION stre
         ListenerCallbacks.stageFailed(STAGE_NAME_RESOLUTION, err);
         goto Cleanup;
     }
+#ifdef AF_INET6
+    serverInfo->preferredAddressFamily = RemoteAddr.ss_family == AF_INET6 ? ADDRESS_FAMILY_IPV6 : ADDRESS_FAMILY_IPV4;
+#else
+    serverInfo->preferredAddressFamily = ADDRESS_FAMILY_IPV4;
+#endif
     stage++;
     LC_ASSERT(stage == STAGE_NAME_RESOLUTION);
     ListenerCallbacks.stageComplete(STAGE_NAME_RESOLUTION);
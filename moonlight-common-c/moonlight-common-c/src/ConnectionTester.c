@@ -132,7 +132,7 @@ unsigned int LiTestClientConnectivity(const char* testServer, unsigned short ref
         return ML_TEST_RESULT_INCONCLUSIVE;
     }
 
-    err = resolveHostName(testServer, AF_UNSPEC, TCP_PORT_FLAG_ALWAYS_TEST | referencePort, &address, &address_length);
+    err = resolveHostName(testServer, AF_UNSPEC, TCP_PORT_FLAG_ALWAYS_TEST | referencePort, NULL, &address, &address_length);
     if (err != 0) {
         failingPortFlags = ML_TEST_RESULT_INCONCLUSIVE;
         goto Exit;
@@ -118,6 +118,21 @@ static LINKED_BLOCKING_QUEUE frameFecStatusQueue;
 static LINKED_BLOCKING_QUEUE asyncCallbackQueue;
 static PLT_EVENT idrFrameRequiredEvent;
 
+// Loss recovery request scheduling state. This is shared by the decoder's
+// IDR requests, the depacketizer and the recovery request threads, so it's
+// protected by recoveryStateMutex.
+static PLT_MUTEX recoveryStateMutex;
+static PLT_EVENT idrFrameReceivedEvent;
+static uint32_t idrFrameRequestCount;
+static uint32_t idrFrameSatisfiedCount;
+static bool idrFrameInFlight;
+static uint64_t idrFrameRequestSentTimeMs;
+static bool rfiInFlight;
+static uint32_t rfiInFlightStartFrame;
+static uint32_t rfiInFlightEndFrame;
+static uint64_t rfiRequestSentTimeMs;
+static RECOVERY_REQUEST_STATS recoveryStats;
+
 static PPLT_CRYPTO_CONTEXT encryptionCtx;
 static PPLT_CRYPTO_CONTEXT decryptionCtx;
 
@@ -294,6 +309,15 @@ static char**preconstructedPayloads;
 static bool supportsIdrFrameRequest;
 
 #define LOSS_REPORT_INTERVAL_MS 50
+
+// Time to wait for the rest of a burst of losses before sending an RFI request
+#define RFI_COALESCE_WINDOW_MS 3
+
+// Bounds on how long we wait for a requested recovery frame before asking
+// again. The actual timeout scales with the measured recovery time.
+#define RECOVERY_TIMEOUT_DEFAULT_MS 250
+#define RECOVERY_TIMEOUT_MIN_MS 50
+#define RECOVERY_TIMEOUT_MAX_MS 1000
 #define PERIODIC_PING_INTERVAL_MS 100
 
 // Initializes the control stream
@@ -304,6 +328,8 @@ int initializeControlStream(void) {
     LbqInitializeLinkedBlockingQueue(&frameFecStatusQueue, 8); // Limits number of frame status reports per periodic ping interval
     LbqInitializeLinkedBlockingQueue(&asyncCallbackQueue, 30);
     PltCreateMutex(&enetMutex);
+    PltCreateMutex(&recoveryStateMutex);
+    PltCreateEvent(&idrFrameReceivedEvent);
 
     encryptedControlStream = APP_VERSION_AT_LEAST(7, 1, 431);
 
@@ -355,6 +381,15 @@ int initializeControlStream(void) {
     decryptionCtx = PltCreateCryptoContext();
     hdrEnabled = false;
     memset(&hdrMetadata, 0, sizeof(hdrMetadata));
+    idrFrameRequestCount = 0;
+    idrFrameSatisfiedCount = 0;
+    idrFrameInFlight = false;
+    idrFrameRequestSentTimeMs = 0;
+    rfiInFlight = false;
+    rfiInFlightStartFrame = 0;
+    rfiInFlightEndFrame = 0;
+    rfiRequestSentTimeMs = 0;
+    memset(&recoveryStats, 0, sizeof(recoveryStats));
 
     return 0;
 }
@@ -375,11 +410,13 @@ void destroyControlStream(void) {
     PltDestroyCryptoContext(encryptionCtx);
     PltDestroyCryptoContext(decryptionCtx);
     PltCloseEvent(&idrFrameRequiredEvent);
+    PltCloseEvent(&idrFrameReceivedEvent);
     freeBasicLbqList(LbqDestroyLinkedBlockingQueue(&invalidReferenceFrameTuples));
     freeBasicLbqList(LbqDestroyLinkedBlockingQueue(&frameFecStatusQueue));
     freeBasicLbqList(LbqDestroyLinkedBlockingQueue(&asyncCallbackQueue));
 
     PltDeleteMutex(&enetMutex);
+    PltDeleteMutex(&recoveryStateMutex);
 }
 
 static void queueFrameInvalidationTuple(uint32_t startFrame, uint32_t endFrame) {
@@ -414,9 +451,78 @@ void LiRequestIdrFrame(void) {
     freeBasicLbqList(LbqFlushQueueItems(&invalidReferenceFrameTuples));
 
     // Request the IDR frame
+    PltLockMutex(&recoveryStateMutex);
+    idrFrameRequestCount++;
+    PltUnlockMutex(&recoveryStateMutex);
     PltSetEvent(&idrFrameRequiredEvent);
 }
 
+static void updateRecoveryTime(uint32_t* recoveryTimeMs, uint64_t sampleMs) {
+    if (sampleMs > RECOVERY_TIMEOUT_MAX_MS) {
+        sampleMs = RECOVERY_TIMEOUT_MAX_MS;
+    }
+
+    // Smooth the samples like TCP's SRTT
+    if (*recoveryTimeMs == 0) {
+        *recoveryTimeMs = (uint32_t)sampleMs;
+    }
+    else {
+        *recoveryTimeMs = (uint32_t)((*recoveryTimeMs * 7 + sampleMs) / 8);
+    }
+}
+
+static uint64_t getRecoveryTimeoutMs(uint32_t recoveryTimeMs) {
+    if (recoveryTimeMs == 0) {
+        return RECOVERY_TIMEOUT_DEFAULT_MS;
+    }
+
+    // Allow for twice the usual recovery time before assuming the request or recovery frame got lost
+    uint64_t timeoutMs = recoveryTimeMs * 2;
+    if (timeoutMs < RECOVERY_TIMEOUT_MIN_MS) {
+        return RECOVERY_TIMEOUT_MIN_MS;
+    }
+    else if (timeoutMs > RECOVERY_TIMEOUT_MAX_MS) {
+        return RECOVERY_TIMEOUT_MAX_MS;
+    }
+    else {
+        return timeoutMs;
+    }
+}
+
+// Called by the depacketizer when the host's response to an RFI or IDR request begins arriving
+void connectionReceivedRecoveryFrame(bool isIdrFrame) {
+    uint64_t now = PltGetMillis();
+
+    PltLockMutex(&recoveryStateMutex);
+    if (isIdrFrame) {
+        // Every IDR request made up to this point is satisfied by this frame
+        idrFrameSatisfiedCount = idrFrameRequestCount;
+        if (idrFrameInFlight) {
+            updateRecoveryTime(&recoveryStats.idrRecoveryTimeMs, now - idrFrameRequestSentTimeMs);
+            idrFrameInFlight = false;
+        }
+
+        // An IDR frame doesn't reference anything we invalidated either
+        rfiInFlight = false;
+    }
+    else if (rfiInFlight) {
+        updateRecoveryTime(&recoveryStats.rfiRecoveryTimeMs, now - rfiRequestSentTimeMs);
+        rfiInFlight = false;
+    }
+    PltUnlockMutex(&recoveryStateMutex);
+
+    if (isIdrFrame) {
+        // Wake the IDR request thread if it's waiting on this frame
+        PltSetEvent(&idrFrameReceivedEvent);
+    }
+}
+
+void LiGetRecoveryRequestStats(PRECOVERY_REQUEST_STATS stats) {
+    PltLockMutex(&recoveryStateMutex);
+    *stats = recoveryStats;
+    PltUnlockMutex(&recoveryStateMutex);
+}
+
 // Invalidate reference frames lost by the network
 void connectionDetectedFrameLoss(uint32_t startFrame, uint32_t endFrame) {
     queueFrameInvalidationTuple(startFrame, endFrame);
@@ -1552,14 +1658,51 @@ static void invalidateRefFramesFunc(void* context) {
         startFrame = qfit->startFrame;
         endFrame = qfit->endFrame;
 
+        // Losses tend to come in bursts. If another loss report is already
+        // queued, we're in one, so give the rest of it a moment to arrive and
+        // share a single request. A lone loss is requested right away.
+        if (LbqGetItemCount(&invalidReferenceFrameTuples) > 0) {
+            PltSleepMsInterruptible(&invalidateRefFramesThread, RFI_COALESCE_WINDOW_MS);
+        }
+
         // Aggregate all lost frames into one range
+        int rangeCount = 0;
         do {
             LC_ASSERT(qfit->endFrame >= endFrame);
+            if (isBefore32(qfit->startFrame, startFrame)) {
+                startFrame = qfit->startFrame;
+            }
             endFrame = qfit->endFrame;
             free(qfit);
+            rangeCount++;
         } while (LbqPollQueueElement(&invalidReferenceFrameTuples, (void**)&qfit) == LBQ_SUCCESS);
 
+        PltLockMutex(&recoveryStateMutex);
+        recoveryStats.rfiRequestsAvoided += rangeCount - 1;
+
+        // While the depacketizer waits for the host to respond to an invalidation, it
+        // drops each new frame and extends the lost range from the same start frame.
+        // The host's recovery frame doesn't reference anything from the original range,
+        // so these extensions are redundant unless the recovery frame is overdue.
+        if (rfiInFlight &&
+                !isBefore32(startFrame, rfiInFlightStartFrame) &&
+                !isBefore32(rfiInFlightEndFrame + 1, startFrame) &&
+                PltGetMillis() < rfiRequestSentTimeMs + getRecoveryTimeoutMs(recoveryStats.rfiRecoveryTimeMs)) {
+            if (isBefore32(rfiInFlightEndFrame, endFrame)) {
+                rfiInFlightEndFrame = endFrame;
+            }
+            recoveryStats.rfiRequestsAvoided++;
+            PltUnlockMutex(&recoveryStateMutex);
+            continue;
+        }
+
         // Send the reference frame invalidation request
+        rfiInFlightStartFrame = startFrame;
+        rfiInFlightEndFrame = endFrame;
+        rfiRequestSentTimeMs = PltGetMillis();
+        rfiInFlight = true;
+        recoveryStats.rfiRequestsSent++;
+        PltUnlockMutex(&recoveryStateMutex);
         requestInvalidateReferenceFrames(startFrame, endFrame);
     }
 }
@@ -1574,21 +1717,76 @@ static void requestIdrFrameFunc(void* context) {
             return;
         }
 
+        // If we've already asked for an IDR frame, a second request would just cost
+        // the host another IDR frame. Wait for the first one to arrive instead, unless
+        // it's taking much longer than recoveries have taken so far.
+        PltLockMutex(&recoveryStateMutex);
+        while (idrFrameInFlight && idrFrameSatisfiedCount != idrFrameRequestCount) {
+            uint64_t now = PltGetMillis();
+            uint64_t deadline = idrFrameRequestSentTimeMs + getRecoveryTimeoutMs(recoveryStats.idrRecoveryTimeMs);
+
+            if (now >= deadline) {
+                break;
+            }
+
+            // connectionReceivedRecoveryFrame() updates the state before it sets
+            // the event, so clearing it under the lock can't miss the IDR frame.
+            PltClearEvent(&idrFrameReceivedEvent);
+            PltUnlockMutex(&recoveryStateMutex);
+
+            PltWaitForEventTimeout(&idrFrameReceivedEvent, (int)(deadline - now));
+            if (stopping) {
+                return;
+            }
+
+            PltLockMutex(&recoveryStateMutex);
+        }
+
+        // Whatever we decide below also covers any requests made while we waited
+        PltClearEvent(&idrFrameRequiredEvent);
+
+        if (idrFrameSatisfiedCount == idrFrameRequestCount) {
+            // An IDR frame arrived after all outstanding requests were made
+            recoveryStats.idrRequestsAvoided++;
+            PltUnlockMutex(&recoveryStateMutex);
+            continue;
+        }
+
         // Any pending reference frame invalidation requests are now redundant
         freeBasicLbqList(LbqFlushQueueItems(&invalidReferenceFrameTuples));
+        rfiInFlight = false;
 
         // Request the IDR frame
+        idrFrameRequestSentTimeMs = PltGetMillis();
+        idrFrameInFlight = true;
+        recoveryStats.idrRequestsSent++;
+        PltUnlockMutex(&recoveryStateMutex);
         requestIdrFrame();
     }
 }
 
 // Stops the control stream
 int stopControlStream(void) {
+    RECOVERY_REQUEST_STATS recoveryStatsSnapshot;
+
     stopping = true;
+
+    LiGetRecoveryRequestStats(&recoveryStatsSnapshot);
+    if (recoveryStatsSnapshot.rfiRequestsSent != 0 || recoveryStatsSnapshot.idrRequestsSent != 0) {
+        Limelog("Loss recovery: %u RFI requests sent (%u avoided, %u ms recovery), %u IDR requests sent (%u avoided, %u ms recovery)\n",
+                recoveryStatsSnapshot.rfiRequestsSent,
+                recoveryStatsSnapshot.rfiRequestsAvoided,
+                recoveryStatsSnapshot.rfiRecoveryTimeMs,
+                recoveryStatsSnapshot.idrRequestsSent,
+                recoveryStatsSnapshot.idrRequestsAvoided,
+                recoveryStatsSnapshot.idrRecoveryTimeMs);
+    }
+
     LbqSignalQueueShutdown(&invalidReferenceFrameTuples);
     LbqSignalQueueShutdown(&frameFecStatusQueue);
     LbqSignalQueueDrain(&asyncCallbackQueue);
     PltSetEvent(&idrFrameRequiredEvent);
+    PltSetEvent(&idrFrameReceivedEvent);
 
     // This must be set to stop in a timely manner
     LC_ASSERT(ConnectionInterrupted);
@@ -10,6 +10,8 @@
 #include "RtpAudioQueue.h"
 #include "RtpVideoQueue.h"
 #include "ByteBuffer.h"
+#include "AnnexB.h"
+#include "NetworkImpairment.h"
 
 #include <enet/enet.h>
 
@@ -38,6 +40,8 @@ extern uint16_t ControlPortNumber;
 extern uint16_t AudioPortNumber;
 extern uint16_t VideoPortNumber;
 
+extern RTP_SOCKET_OPTIONS RtpSocketOptions;
+
 extern SS_PING AudioPingPayload;
 extern SS_PING VideoPingPayload;
 extern uint32_t ControlConnectData;
@@ -122,6 +126,7 @@ void connectionDetectedFrameLoss(uint32_t startFrame, uint32_t endFrame);
 void connectionReceivedCompleteFrame(uint32_t frameIndex);
 void connectionSawFrame(uint32_t frameIndex);
 void connectionSendFrameFecStatus(PSS_FRAME_FEC_STATUS fecStatus);
+void connectionReceivedRecoveryFrame(bool isIdrFrame);
 int sendInputPacketOnControlStream(unsigned char* data, int length, uint8_t channelId, uint32_t flags, bool moreData);
 void flushInputOnControlStream(void);
 bool isControlDataInTransit(void);
@@ -131,6 +136,7 @@ int performRtspHandshake(PSERVER_INFORMATION serverInfo);
 void initializeVideoDepacketizer(int pktSize);
 void destroyVideoDepacketizer(void);
 void queueRtpPacket(PRTPV_QUEUE_ENTRY queueEntry);
+void submitPartialFrame(void);
 void stopVideoDepacketizer(void);
 void requestDecoderRefresh(void);
 void notifyFrameLost(unsigned int frameNumber, bool speculative);
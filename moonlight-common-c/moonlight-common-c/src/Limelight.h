@@ -41,6 +41,42 @@ extern "C" {
 // should not be freed by the caller.
 const char* LiGetLaunchUrlQueryParameters(void);
 
+// Simulated network conditions applied to received RTP packets before they reach
+// the RTP queues. Loss follows a Gilbert-Elliott model: each packet first moves
+// the link between its good and bad state with the given transition probability,
+// then is lost with the loss probability of the state it's in. Setting only
+// lossGoodPercent gives uniform random loss. All percentages are 0-100.
+//
+// Each random decision is drawn from a generator seeded with seed, so the same
+// seed and packet sequence always produce the same impairment. Delays are
+// applied in real time, so they are only as precise as the receive threads'
+// millisecond wake-ups.
+typedef struct _NETWORK_IMPAIRMENT {
+    uint32_t seed;
+
+    float lossGoodPercent;
+    float lossBadPercent;
+    float goodToBadPercent;
+    float badToGoodPercent;
+
+    // Percentage of packets held back by reorderDelayMs (default 5 ms if zero),
+    // which lets the packets behind them overtake them
+    float reorderPercent;
+    int reorderDelayMs;
+
+    float duplicatePercent;
+
+    // Fixed delay plus a uniformly distributed random delay of up to jitterMs.
+    // Jitter never reorders packets by itself.
+    int delayMs;
+    int jitterMs;
+
+    // If non-zero, packets are serialized at this rate through a queue that
+    // tail-drops packets which would wait longer than queueLimitMs (default 200 ms if zero)
+    int bandwidthKbps;
+    int queueLimitMs;
+} NETWORK_IMPAIRMENT, *PNETWORK_IMPAIRMENT;
+
 typedef struct _STREAM_CONFIGURATION {
     // Dimensions in pixels of the desired video stream
     int width;
@@ -100,6 +136,28 @@ typedef struct _STREAM_CONFIGURATION {
     // in /launch and /resume requests.
     char remoteInputAesKey[16];
     char remoteInputAesIv[16];
+
+    // If non-zero, the receive buffer size to request for the audio and video RTP
+    // sockets. It is only used if larger than the default for the socket. On Linux,
+    // sizes above net.core.rmem_max are only granted with CAP_NET_ADMIN.
+    int rtpReceiveBufferSize;
+
+    // If non-zero, enables busy polling (SO_BUSY_POLL) on the audio and video RTP
+    // sockets for the specified number of microseconds. This trades CPU time for
+    // lower receive latency. It is only supported on Linux.
+    int rtpBusyPollUs;
+
+    // If non-zero, the longest time in milliseconds that queued decode units should wait
+    // for the decoder. When the oldest queued decode unit is older than this, complete
+    // frames that nothing references are skipped, and otherwise a frame is dropped and
+    // recovered with reference frame invalidation rather than waiting for the queue to
+    // overflow and an IDR frame. It has no effect with CAPABILITY_DIRECT_SUBMIT.
+    int decodeLatencyBudgetMs;
+
+    // Network impairment to simulate on the audio and video RTP streams. This is
+    // intended for testing and benchmarking recovery from packet loss. It is
+    // disabled when all fields are zero, as LiInitializeStreamConfiguration() leaves them.
+    NETWORK_IMPAIRMENT networkImpairment;
 } STREAM_CONFIGURATION, *PSTREAM_CONFIGURATION;
 
 // Use this function to zero the stream configuration when allocated on the stack or heap
@@ -154,9 +212,16 @@ typedef struct _DECODE_UNIT {
     // (happens when the frame is repeated).
     uint16_t frameHostProcessingLatency;
 
-    // Receive time of first buffer in microseconds.
+    // Receive time of first buffer in microseconds. Where the platform supports it,
+    // this is when the kernel received the packet rather than when our receive
+    // thread got around to reading it.
     uint64_t receiveTimeUs;
 
+    // Time the first buffer waited in the socket before our receive thread read it,
+    // in microseconds. This is client scheduling delay rather than network delay.
+    // Zero when the platform doesn't provide kernel receive timestamps.
+    uint32_t receiveDelayUs;
+
     // Time the frame was fully assembled and queued for the video decoder to process.
     // This is also approximately the same time as the final packet was received, so
     // enqueueTimeUs - receiveTimeUs is the time taken to receive the frame. At the
@@ -191,6 +256,16 @@ typedef struct _DECODE_UNIT {
     // Note: This is not currently parsed from the actual bitstream, so if your
     // client has access to a bitstream parser, prefer that over this field.
     uint8_t colorspace;
+
+    // Only set when CAPABILITY_SUBFRAME_SUBMIT is used. This decode unit contains the
+    // leading complete slice NALUs of the frame, and more decode units with the same
+    // frameNumber will follow. The last decode unit of the frame has this flag cleared.
+    bool partialFrame;
+
+    // Number of frames between the previous decode unit and this one that were not
+    // submitted to stay within the decodeLatencyBudgetMs of the STREAM_CONFIGURATION.
+    // These frame numbers are skipped, but unlike other gaps, were not lost.
+    uint32_t framesSkippedForLatency;
 } DECODE_UNIT, *PDECODE_UNIT;
 
 // Specifies that the audio stream should be encoded in stereo (default)
@@ -276,6 +351,13 @@ typedef struct _DECODE_UNIT {
 // supports reference frame invalidation for AV1 streams. This flag is only valid on video renderers.
 #define CAPABILITY_REFERENCE_FRAME_INVALIDATION_AV1 0x40
 
+// If set in the video renderer capabilities field, this flag specifies that the renderer can
+// start decoding H.264/HEVC P-frames before the entire frame has arrived. Whenever an FEC block
+// of a multi-block frame is complete, the complete slice NALUs received so far are submitted in
+// a decode unit with partialFrame set. If the frame is lost after a partial submission, the next
+// decode unit will be an IDR frame and the renderer must discard the incomplete frame.
+#define CAPABILITY_SUBFRAME_SUBMIT 0x80
+
 // If set in the video renderer capabilities field, this macro specifies that the renderer
 // supports slicing to increase decoding performance. The parameter specifies the desired
 // number of slices per frame. This capability is only valid on video renderers.
@@ -483,6 +565,11 @@ typedef void(*ConnListenerSetAdaptiveTriggers)(uint16_t controllerNumber, uint8_
 // This callback is invoked to set a controller's RGB LED (if present).
 typedef void(*ConnListenerSetControllerLED)(uint16_t controllerNumber, uint8_t r, uint8_t g, uint8_t b);
 
+// This callback is invoked on each thread created by this library when it starts running,
+// before it does any work. The client may adjust the scheduling of the thread here (priority,
+// CPU affinity, etc.) based on its name, such as "VideoRecv", "AudioRecv" or "InputSend".
+typedef void(*ConnListenerThreadStarted)(const char* threadName);
+
 typedef struct _CONNECTION_LISTENER_CALLBACKS {
     ConnListenerStageStarting stageStarting;
     ConnListenerStageComplete stageComplete;
@@ -497,6 +584,7 @@ typedef struct _CONNECTION_LISTENER_CALLBACKS {
     ConnListenerSetMotionEventState setMotionEventState;
     ConnListenerSetControllerLED setControllerLED;
     ConnListenerSetAdaptiveTriggers setAdaptiveTriggers;
+    ConnListenerThreadStarted threadStarted;
 } CONNECTION_LISTENER_CALLBACKS, *PCONNECTION_LISTENER_CALLBACKS;
 
 // Use this function to zero the connection callbacks when allocated on the stack or heap
@@ -536,8 +624,19 @@ typedef struct _SERVER_INFORMATION {
 
     // Specifies the 'ServerCodecModeSupport' from the /serverinfo response.
     int serverCodecModeSupport;
+
+    // Address family to try first if the address resolves to both IPv4 and IPv6
+    // addresses. LiStartConnection() sets this to the family that connected, so
+    // the client can persist it for this host and pass it to the next connection.
+    // ADDRESS_FAMILY_ANY uses the order returned by the system resolver.
+    int preferredAddressFamily;
 } SERVER_INFORMATION, *PSERVER_INFORMATION;
 
+// Values for SERVER_INFORMATION.preferredAddressFamily
+#define ADDRESS_FAMILY_ANY  0
+#define ADDRESS_FAMILY_IPV4 1
+#define ADDRESS_FAMILY_IPV6 2
+
 // Use this function to zero the server information when allocated on the stack or heap
 void LiInitializeServerInformation(PSERVER_INFORMATION serverInfo);
 
@@ -865,6 +964,12 @@ int LiGetPendingAudioFrames(void);
 // negotiated audio frame duration.
 int LiGetPendingAudioDuration(void);
 
+// Returns the RTP timestamp (in milliseconds) of the audio sample currently being
+// passed to the decodeAndPlaySample() callback. Only valid when called from within
+// that callback. Concealed samples for lost packets are given the timestamp that
+// the lost packet would have had.
+uint32_t LiGetCurrentAudioSampleTimestamp(void);
+
 // Returns a pointer to a struct containing various statistics about the RTP audio stream.
 // The data should be considered read-only and must not be modified.
 typedef struct _RTP_AUDIO_STATS {
@@ -895,6 +1000,51 @@ typedef struct _RTP_VIDEO_STATS {
 
 const RTP_VIDEO_STATS* LiGetRTPVideoStats(void);
 
+// Copies statistics about the loss recovery requests (reference frame invalidation and
+// IDR frame requests) sent to the host into the provided struct. Requests are avoided
+// when they are merged with another request or are already covered by a recovery frame
+// the host is sending. This must only be called while a connection is active.
+typedef struct _RECOVERY_REQUEST_STATS {
+    uint32_t rfiRequestsSent;          // reference frame invalidation requests sent
+    uint32_t rfiRequestsAvoided;       // lost frame ranges that didn't need their own RFI request
+    uint32_t idrRequestsSent;          // IDR frame requests sent
+    uint32_t idrRequestsAvoided;       // IDR frame requests satisfied by an IDR frame already on its way
+    uint32_t rfiRecoveryTimeMs;        // smoothed time from an RFI request to the host's recovery frame
+    uint32_t idrRecoveryTimeMs;        // smoothed time from an IDR request to the IDR frame
+} RECOVERY_REQUEST_STATS, *PRECOVERY_REQUEST_STATS;
+
+void LiGetRecoveryRequestStats(PRECOVERY_REQUEST_STATS stats);
+
+// Returns a pointer to a struct containing the receive options that the OS actually granted
+// for the RTP sockets, which may differ from what was requested in the STREAM_CONFIGURATION.
+// The values are valid once the respective stream has been initialized. The data should be
+// considered read-only and must not be modified.
+typedef struct _RTP_SOCKET_OPTIONS {
+    int videoReceiveBufferSize;        // as reported by the OS (Linux reports double the usable size)
+    int audioReceiveBufferSize;
+    int videoBusyPollUs;               // 0 if busy polling isn't enabled
+    int audioBusyPollUs;
+    bool videoKernelTimestamps;        // video receive times come from the kernel rather than the receive thread
+} RTP_SOCKET_OPTIONS, *PRTP_SOCKET_OPTIONS;
+
+const RTP_SOCKET_OPTIONS* LiGetRtpSocketOptions(void);
+
+// Returns a pointer to a struct containing statistics of the network impairment
+// applied to the video or audio stream, as configured in the STREAM_CONFIGURATION.
+// The data should be considered read-only and must not be modified.
+typedef struct _NETWORK_IMPAIRMENT_STATS {
+    uint32_t packetsReceived;          // packets received from the socket
+    uint32_t packetsLost;              // packets dropped by the loss model
+    uint32_t packetsOverBandwidth;     // packets dropped by the bandwidth limit's queue
+    uint32_t packetsReordered;
+    uint32_t packetsDuplicated;
+    uint32_t packetsDelivered;         // packets passed on to the RTP queue, including duplicates
+    uint64_t totalAddedDelayUs;        // sum of the delay added to the delivered packets
+} NETWORK_IMPAIRMENT_STATS, *PNETWORK_IMPAIRMENT_STATS;
+
+const NETWORK_IMPAIRMENT_STATS* LiGetVideoImpairmentStats(void);
+const NETWORK_IMPAIRMENT_STATS* LiGetAudioImpairmentStats(void);
+
 // Port index flags for use with LiGetPortFromPortFlagIndex() and LiGetProtocolFromPortFlagIndex()
 #define ML_PORT_INDEX_TCP_47984 0
 #define ML_PORT_INDEX_TCP_47989 1
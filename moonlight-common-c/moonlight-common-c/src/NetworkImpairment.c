@@ -0,0 +1,290 @@
+#include "Limelight-internal.h"
+#include "NetworkImpairment.h"
+
+#define NI_DEFAULT_REORDER_DELAY_MS 5
+#define NI_DEFAULT_QUEUE_LIMIT_MS 200
+
+void NiInitialize(PNETWORK_IMPAIRMENT_STATE state, const NETWORK_IMPAIRMENT* config, uint32_t streamId) {
+    memset(state, 0, sizeof(*state));
+    state->config = *config;
+
+    if (state->config.reorderDelayMs <= 0) {
+        state->config.reorderDelayMs = NI_DEFAULT_REORDER_DELAY_MS;
+    }
+    if (state->config.queueLimitMs <= 0) {
+        state->config.queueLimitMs = NI_DEFAULT_QUEUE_LIMIT_MS;
+    }
+    if (state->config.delayMs < 0) {
+        state->config.delayMs = 0;
+    }
+    if (state->config.jitterMs < 0) {
+        state->config.jitterMs = 0;
+    }
+
+    state->enabled = state->config.lossGoodPercent > 0 ||
+                     (state->config.lossBadPercent > 0 && state->config.goodToBadPercent > 0) ||
+                     state->config.reorderPercent > 0 ||
+                     state->config.duplicatePercent > 0 ||
+                     state->config.delayMs > 0 ||
+                     state->config.jitterMs > 0 ||
+                     state->config.bandwidthKbps > 0;
+
+    state->rngState = ((uint64_t)state->config.seed << 32) | streamId;
+}
+
+static void freePendingList(PNI_PENDING_LIST list) {
+    while (list->head != NULL) {
+        PNI_PENDING_PACKET next = list->head->next;
+        free(list->head);
+        list->head = next;
+    }
+    list->tail = NULL;
+}
+
+void NiCleanup(PNETWORK_IMPAIRMENT_STATE state) {
+    // The stats are left intact, so they can still be read after the stream stops
+    freePendingList(&state->inOrderPackets);
+    freePendingList(&state->reorderedPackets);
+}
+
+bool NiIsEnabled(PNETWORK_IMPAIRMENT_STATE state) {
+    return state->enabled;
+}
+
+void NiLogConfiguration(PNETWORK_IMPAIRMENT_STATE state, const char* streamName) {
+    if (!state->enabled) {
+        return;
+    }
+
+    Limelog("%s network impairment (seed %u): loss %.2f%%/%.2f%% (good->bad %.2f%%, bad->good %.2f%%), "
+            "reorder %.2f%% by %d ms, duplicate %.2f%%, delay %d ms, jitter %d ms, bandwidth %d Kbps (queue %d ms)\n",
+            streamName,
+            state->config.seed,
+            state->config.lossGoodPercent, state->config.lossBadPercent,
+            state->config.goodToBadPercent, state->config.badToGoodPercent,
+            state->config.reorderPercent, state->config.reorderDelayMs,
+            state->config.duplicatePercent,
+            state->config.delayMs, state->config.jitterMs,
+            state->config.bandwidthKbps, state->config.queueLimitMs);
+}
+
+// SplitMix64, which is fast and has no bad seeds
+static uint64_t nextRandom(PNETWORK_IMPAIRMENT_STATE state) {
+    uint64_t z = (state->rngState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static bool randomChance(PNETWORK_IMPAIRMENT_STATE state, float percent) {
+    // 53 random bits scaled to [0, 100)
+    return (double)(nextRandom(state) >> 11) * (100.0 / 9007199254740992.0) < percent;
+}
+
+static void insertPendingPacket(PNI_PENDING_LIST list, PNI_PENDING_PACKET packet) {
+    PNI_PENDING_PACKET* link;
+
+    // Packets are almost always due after everything already queued
+    if (list->tail == NULL || list->tail->releaseTimeUs <= packet->releaseTimeUs) {
+        packet->next = NULL;
+        if (list->tail != NULL) {
+            list->tail->next = packet;
+        }
+        else {
+            list->head = packet;
+        }
+        list->tail = packet;
+        return;
+    }
+
+    // Insert after any packets due at the same time to keep them in order
+    link = &list->head;
+    while ((*link)->releaseTimeUs <= packet->releaseTimeUs) {
+        link = &(*link)->next;
+    }
+    packet->next = *link;
+    *link = packet;
+}
+
+static bool queuePacket(PNI_PENDING_LIST list, const char* data, int length, uint64_t arrivalTimeUs, uint64_t releaseTimeUs) {
+    PNI_PENDING_PACKET packet = (PNI_PENDING_PACKET)malloc(sizeof(*packet) + length);
+    if (packet == NULL) {
+        return false;
+    }
+
+    packet->arrivalTimeUs = arrivalTimeUs;
+    packet->releaseTimeUs = releaseTimeUs;
+    packet->length = length;
+    memcpy(packet + 1, data, length);
+
+    insertPendingPacket(list, packet);
+    return true;
+}
+
+void NiSubmitPacket(PNETWORK_IMPAIRMENT_STATE state, const char* data, int length, uint64_t arrivalTimeUs) {
+    uint64_t releaseTimeUs;
+    uint64_t jitterUs;
+    PNI_PENDING_LIST list;
+    bool lost, reordered, duplicated;
+
+    state->stats.packetsReceived++;
+
+    // Every decision is drawn for every packet, so the fate of each packet only
+    // depends on the seed and its position in the stream, not on which other
+    // impairments are enabled.
+    if (state->badState) {
+        state->badState = !randomChance(state, state->config.badToGoodPercent);
+    }
+    else {
+        state->badState = randomChance(state, state->config.goodToBadPercent);
+    }
+    lost = randomChance(state, state->badState ? state->config.lossBadPercent : state->config.lossGoodPercent);
+    jitterUs = nextRandom(state) % ((uint64_t)state->config.jitterMs * 1000 + 1);
+    reordered = randomChance(state, state->config.reorderPercent);
+    duplicated = randomChance(state, state->config.duplicatePercent);
+
+    if (lost) {
+        state->stats.packetsLost++;
+        return;
+    }
+
+    releaseTimeUs = arrivalTimeUs;
+
+    if (state->config.bandwidthKbps > 0) {
+        uint64_t sendStartTimeUs = state->linkFreeTimeUs > arrivalTimeUs ? state->linkFreeTimeUs : arrivalTimeUs;
+
+        // Tail-drop packets that would wait too long for the link, like a router would
+        if (sendStartTimeUs - arrivalTimeUs > (uint64_t)state->config.queueLimitMs * 1000) {
+            state->stats.packetsOverBandwidth++;
+            return;
+        }
+
+        state->linkFreeTimeUs = sendStartTimeUs + ((uint64_t)length * 8000) / (uint64_t)state->config.bandwidthKbps;
+        releaseTimeUs = state->linkFreeTimeUs;
+    }
+
+    releaseTimeUs += (uint64_t)state->config.delayMs * 1000 + jitterUs;
+
+    if (reordered) {
+        releaseTimeUs += (uint64_t)state->config.reorderDelayMs * 1000;
+        list = &state->reorderedPackets;
+        state->stats.packetsReordered++;
+    }
+    else {
+        // A packet held up by jitter holds up the packets behind it too
+        if (releaseTimeUs < state->lastInOrderReleaseTimeUs) {
+            releaseTimeUs = state->lastInOrderReleaseTimeUs;
+        }
+        state->lastInOrderReleaseTimeUs = releaseTimeUs;
+        list = &state->inOrderPackets;
+    }
+
+    if (!queuePacket(list, data, length, arrivalTimeUs, releaseTimeUs)) {
+        return;
+    }
+
+    if (duplicated && queuePacket(list, data, length, arrivalTimeUs, releaseTimeUs)) {
+        state->stats.packetsDuplicated++;
+    }
+}
+
+static PNI_PENDING_LIST getNextPendingList(PNETWORK_IMPAIRMENT_STATE state) {
+    PNI_PENDING_PACKET inOrder = state->inOrderPackets.head;
+    PNI_PENDING_PACKET reordered = state->reorderedPackets.head;
+
+    if (reordered == NULL) {
+        return inOrder != NULL ? &state->inOrderPackets : NULL;
+    }
+    else if (inOrder == NULL || reordered->releaseTimeUs < inOrder->releaseTimeUs) {
+        return &state->reorderedPackets;
+    }
+    else {
+        return &state->inOrderPackets;
+    }
+}
+
+uint64_t NiGetNextReleaseTimeUs(PNETWORK_IMPAIRMENT_STATE state) {
+    PNI_PENDING_LIST list = getNextPendingList(state);
+    return list != NULL ? list->head->releaseTimeUs : 0;
+}
+
+int NiReceivePacket(PNETWORK_IMPAIRMENT_STATE state, uint64_t nowUs, char* buffer, int size, uint64_t* releaseTimeUs) {
+    PNI_PENDING_LIST list = getNextPendingList(state);
+    PNI_PENDING_PACKET packet;
+    int length;
+
+    if (list == NULL || list->head->releaseTimeUs > nowUs) {
+        return 0;
+    }
+
+    packet = list->head;
+    list->head = packet->next;
+    if (list->head == NULL) {
+        list->tail = NULL;
+    }
+
+    // Truncate like recv() would
+    length = packet->length < size ? packet->length : size;
+    memcpy(buffer, packet + 1, length);
+
+    state->stats.packetsDelivered++;
+    state->stats.totalAddedDelayUs += packet->releaseTimeUs - packet->arrivalTimeUs;
+    if (releaseTimeUs != NULL) {
+        *releaseTimeUs = packet->releaseTimeUs;
+    }
+
+    free(packet);
+    return length;
+}
+
+int NiRecvUdpSocket(PNETWORK_IMPAIRMENT_STATE state, SOCKET s, char* buffer, int size, bool useSelect, uint64_t* receiveTimeUs) {
+    // Like a plain receive, give up after UDP_RECV_POLL_TIMEOUT_MS even if packets kept
+    // arriving, so a lossy stretch doesn't keep the caller from checking for interruption.
+    uint64_t deadlineUs = PltGetMicroseconds() + UDP_RECV_POLL_TIMEOUT_MS * 1000;
+
+    for (;;) {
+        uint64_t nowUs = PltGetMicroseconds();
+        uint64_t nextReleaseTimeUs;
+        uint64_t waitUntilUs;
+        uint64_t arrivalTimeUs;
+        struct pollfd pfd;
+        int err;
+
+        err = NiReceivePacket(state, nowUs, buffer, size, receiveTimeUs);
+        if (err > 0) {
+            return err;
+        }
+        else if (nowUs >= deadlineUs) {
+            return 0;
+        }
+
+        // Wait for the socket, but no longer than until the next pending packet is due
+        nextReleaseTimeUs = NiGetNextReleaseTimeUs(state);
+        waitUntilUs = nextReleaseTimeUs != 0 && nextReleaseTimeUs < deadlineUs ? nextReleaseTimeUs : deadlineUs;
+
+        pfd.fd = s;
+        pfd.events = POLLIN;
+        err = pollSockets(&pfd, 1, (int)((waitUntilUs - nowUs + 999) / 1000));
+        if (err < 0) {
+            return err;
+        }
+        else if (err == 0) {
+            // Either a pending packet is due or we've waited long enough
+            continue;
+        }
+
+        // The socket is readable, so this won't wait. The packet is received into
+        // the caller's buffer, since it's copied into the pending list anyway.
+        arrivalTimeUs = 0;
+        err = recvUdpSocketWithTimestamp(s, buffer, size, useSelect, receiveTimeUs != NULL ? &arrivalTimeUs : NULL);
+        if (err <= 0) {
+            return err;
+        }
+
+        if (arrivalTimeUs == 0) {
+            arrivalTimeUs = PltGetMicroseconds();
+        }
+
+        NiSubmitPacket(state, buffer, err, arrivalTimeUs);
+    }
+}
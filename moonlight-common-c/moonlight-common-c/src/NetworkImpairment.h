@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Limelight.h"
+#include "PlatformSockets.h"
+
+// Seed offsets so the audio and video streams don't see the same impairment
+#define NI_STREAM_VIDEO 0
+#define NI_STREAM_AUDIO 1
+
+typedef struct _NI_PENDING_PACKET {
+    struct _NI_PENDING_PACKET* next;
+    uint64_t arrivalTimeUs;
+    uint64_t releaseTimeUs;
+    int length;
+
+    // The packet data follows this header in the same allocation
+} NI_PENDING_PACKET, *PNI_PENDING_PACKET;
+
+typedef struct _NI_PENDING_LIST {
+    PNI_PENDING_PACKET head;
+    PNI_PENDING_PACKET tail;
+} NI_PENDING_LIST, *PNI_PENDING_LIST;
+
+typedef struct _NETWORK_IMPAIRMENT_STATE {
+    NETWORK_IMPAIRMENT config;
+    bool enabled;
+
+    uint64_t rngState;
+    bool badState;
+
+    // The time the simulated link finishes sending the last accepted packet
+    uint64_t linkFreeTimeUs;
+
+    // Packets in release order. Reordered packets are kept apart so the
+    // in-order ones can always be appended.
+    NI_PENDING_LIST inOrderPackets;
+    NI_PENDING_LIST reorderedPackets;
+    uint64_t lastInOrderReleaseTimeUs;
+
+    NETWORK_IMPAIRMENT_STATS stats;
+} NETWORK_IMPAIRMENT_STATE, *PNETWORK_IMPAIRMENT_STATE;
+
+void NiInitialize(PNETWORK_IMPAIRMENT_STATE state, const NETWORK_IMPAIRMENT* config, uint32_t streamId);
+void NiCleanup(PNETWORK_IMPAIRMENT_STATE state);
+bool NiIsEnabled(PNETWORK_IMPAIRMENT_STATE state);
+void NiLogConfiguration(PNETWORK_IMPAIRMENT_STATE state, const char* streamName);
+
+// Applies the impairment to a packet that arrived at arrivalTimeUs. The packet is copied.
+void NiSubmitPacket(PNETWORK_IMPAIRMENT_STATE state, const char* data, int length, uint64_t arrivalTimeUs);
+
+// Copies the next packet due by nowUs into the buffer and returns its length, or 0
+// if no packet is due yet. releaseTimeUs is set to the time the packet was due.
+int NiReceivePacket(PNETWORK_IMPAIRMENT_STATE state, uint64_t nowUs, char* buffer, int size, uint64_t* releaseTimeUs);
+
+// Returns the time the next pending packet is due, or 0 if none are pending
+uint64_t NiGetNextReleaseTimeUs(PNETWORK_IMPAIRMENT_STATE state);
+
+// A drop-in replacement for recvUdpSocketWithTimestamp() that passes the received
+// packets through the impairment. The receive time returned is when the packet was
+// released, so it includes the added delay. Like a receive timeout, 0 is returned if
+// no packet is released within UDP_RECV_POLL_TIMEOUT_MS.
+int NiRecvUdpSocket(PNETWORK_IMPAIRMENT_STATE state, SOCKET s, char* buffer, int size, bool useSelect, uint64_t* receiveTimeUs);
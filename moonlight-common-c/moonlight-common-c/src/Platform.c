@@ -84,6 +84,11 @@ void* ThreadProc(void* context) {
     pthread_setname_np(ctx->name);
 #endif
 
+    // ListenerCallbacks is only populated once a connection has been started
+    if (ListenerCallbacks.threadStarted != NULL) {
+        ListenerCallbacks.threadStarted(ctx->name);
+    }
+
     ctx->entry(ctx->context);
 
 #if defined(__vita__)
@@ -368,6 +373,54 @@ void PltWaitForEvent(PLT_EVENT* event) {
 #endif
 }
 
+#if !defined(LC_WINDOWS)
+static void waitForConditionVariableTimeout(PLT_COND* cond, PLT_MUTEX* mutex, int timeoutMs) {
+#if defined(__WIIU__)
+    // OSFastCondition has no timed wait, so poll instead
+    PltUnlockMutex(mutex);
+    PltSleepMs(1);
+    PltLockMutex(mutex);
+#elif defined(__3DS__)
+    CondVar_WaitTimeout(cond, mutex, (s64)timeoutMs * 1000000);
+#else
+    struct timespec deadline;
+
+    // The condition variable uses the default realtime clock
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(cond, mutex, &deadline);
+#endif
+}
+#endif
+
+// Returns true if the event was signalled or false if the timeout elapsed first
+bool PltWaitForEventTimeout(PLT_EVENT* event, int timeoutMs) {
+#if defined(LC_WINDOWS)
+    return WaitForSingleObjectEx(*event, timeoutMs, FALSE) == WAIT_OBJECT_0;
+#else
+    uint64_t deadlineMs = PltGetMillis() + timeoutMs;
+    bool signalled;
+
+    PltLockMutex(&event->mutex);
+    while (!event->signalled) {
+        uint64_t nowMs = PltGetMillis();
+        if (nowMs >= deadlineMs) {
+            break;
+        }
+        waitForConditionVariableTimeout(&event->cond, &event->mutex, (int)(deadlineMs - nowMs));
+    }
+    signalled = event->signalled;
+    PltUnlockMutex(&event->mutex);
+
+    return signalled;
+#endif
+}
+
 int PltCreateConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex) {
 #if defined(LC_WINDOWS)
     InitializeConditionVariable(cond);
@@ -5,6 +5,10 @@
 #define RCV_BUFFER_SIZE_MIN  32767
 #define RCV_BUFFER_SIZE_STEP 16384
 
+// Kernel receive timestamps older than this are assumed to be bogus
+// (like when the wall clock is stepped) and ignored
+#define MAX_KERNEL_TIMESTAMP_AGE_US 1000000
+
 #if defined(__vita__)
 #define TCPv4_MSS 512
 #else
@@ -178,7 +182,88 @@ bool isSocketReadable(SOCKET s) {
     return true;
 }
 
+bool enableKernelReceiveTimestamps(SOCKET s) {
+#if defined(SO_TIMESTAMPNS) && defined(SCM_TIMESTAMPNS)
+    int val = 1;
+
+    if (setsockopt(s, SOL_SOCKET, SO_TIMESTAMPNS, (char*)&val, sizeof(val)) < 0) {
+        Limelog("setsockopt(SO_TIMESTAMPNS) failed: %d\n", (int)LastSocketError());
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Receives a single datagram. If kernelReceiveTimeUs is non-NULL, it returns the time
+// the kernel received the datagram in the PltGetMicroseconds() timebase, or 0 if the
+// kernel didn't provide a timestamp.
+static int recvUdpDatagram(SOCKET s, char* buffer, int size, uint64_t* kernelReceiveTimeUs) {
+#if defined(SO_TIMESTAMPNS) && defined(SCM_TIMESTAMPNS)
+    if (kernelReceiveTimeUs != NULL) {
+        union {
+            char buf[CMSG_SPACE(sizeof(struct timespec))];
+            struct cmsghdr align;
+        } control;
+        struct cmsghdr* cmsg;
+        struct msghdr msg;
+        struct iovec iov;
+        int err;
+
+        *kernelReceiveTimeUs = 0;
+
+        iov.iov_base = buffer;
+        iov.iov_len = size;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        err = (int)recvmsg(s, &msg, 0);
+        if (err < 0) {
+            return err;
+        }
+
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec arrival, now;
+                uint64_t nowUs;
+                int64_t ageUs;
+
+                // The timestamp is from the realtime clock, so we use the age
+                // of the packet to move it onto our monotonic timebase.
+                memcpy(&arrival, CMSG_DATA(cmsg), sizeof(arrival));
+                nowUs = PltGetMicroseconds();
+                if (clock_gettime(CLOCK_REALTIME, &now) == 0) {
+                    ageUs = ((int64_t)(now.tv_sec - arrival.tv_sec) * 1000000) + ((now.tv_nsec - arrival.tv_nsec) / 1000);
+                    if (ageUs >= 0 && ageUs < MAX_KERNEL_TIMESTAMP_AGE_US && (uint64_t)ageUs < nowUs) {
+                        *kernelReceiveTimeUs = nowUs - (uint64_t)ageUs;
+                    }
+                }
+                break;
+            }
+        }
+
+        return err;
+    }
+#endif
+
+    if (kernelReceiveTimeUs != NULL) {
+        *kernelReceiveTimeUs = 0;
+    }
+
+    return (int)recvfrom(s, buffer, size, 0, NULL, NULL);
+}
+
 int recvUdpSocket(SOCKET s, char* buffer, int size, bool useSelect) {
+    return recvUdpSocketWithTimestamp(s, buffer, size, useSelect, NULL);
+}
+
+int recvUdpSocketWithTimestamp(SOCKET s, char* buffer, int size, bool useSelect, uint64_t* kernelReceiveTimeUs) {
     int err;
 
     do {
@@ -195,13 +280,13 @@ int recvUdpSocket(SOCKET s, char* buffer, int size, bool useSelect) {
             }
 
             // This won't block since the socket is readable
-            err = (int)recvfrom(s, buffer, size, 0, NULL, NULL);
+            err = recvUdpDatagram(s, buffer, size, kernelReceiveTimeUs);
         }
         else {
             // The caller has already configured a timeout on this
             // socket via SO_RCVTIMEO, so we can avoid a syscall
             // for each packet.
-            err = (int)recvfrom(s, buffer, size, 0, NULL, NULL);
+            err = recvUdpDatagram(s, buffer, size, kernelReceiveTimeUs);
             if (err < 0 &&
                     (LastSocketError() == EWOULDBLOCK ||
                      LastSocketError() == EINTR ||
@@ -405,6 +490,44 @@ SOCKET bindUdpSocket(int addressFamily, struct sockaddr_storage* localAddr, SOCK
     return s;
 }
 
+// Applies the optional receive options from the stream configuration to an RTP socket
+// after bindUdpSocket() and reports what the OS actually granted.
+void setRtpSocketOptions(SOCKET s, int receiveBufferSize, int busyPollUs, int* grantedReceiveBufferSize, int* grantedBusyPollUs) {
+    SOCKADDR_LEN len;
+    int val;
+
+#ifdef SO_RCVBUFFORCE
+    if (receiveBufferSize != 0) {
+        // This allows exceeding net.core.rmem_max if we have CAP_NET_ADMIN.
+        // Without it, we keep the size that bindUdpSocket() was able to set.
+        setsockopt(s, SOL_SOCKET, SO_RCVBUFFORCE, (char*)&receiveBufferSize, sizeof(receiveBufferSize));
+    }
+#endif
+
+    *grantedReceiveBufferSize = 0;
+    len = sizeof(val);
+    if (getsockopt(s, SOL_SOCKET, SO_RCVBUF, (char*)&val, &len) == 0) {
+        *grantedReceiveBufferSize = val;
+    }
+
+    *grantedBusyPollUs = 0;
+    if (busyPollUs != 0) {
+#ifdef SO_BUSY_POLL
+        // Raising the busy poll time above net.core.busy_read requires CAP_NET_ADMIN
+        if (setsockopt(s, SOL_SOCKET, SO_BUSY_POLL, (char*)&busyPollUs, sizeof(busyPollUs)) < 0) {
+            Limelog("setsockopt(SO_BUSY_POLL, %d) failed: %d\n", busyPollUs, (int)LastSocketError());
+        }
+
+        len = sizeof(val);
+        if (getsockopt(s, SOL_SOCKET, SO_BUSY_POLL, (char*)&val, &len) == 0) {
+            *grantedBusyPollUs = val;
+        }
+#else
+        Limelog("Busy polling is not supported on this platform\n");
+#endif
+    }
+}
+
 int setSocketNonBlocking(SOCKET s, bool enabled) {
 #if defined(__vita__) || defined(__HAIKU__)
     int val = enabled ? 1 : 0;
@@ -447,10 +570,10 @@ SOCKET createSocket(int addressFamily, int socketType, int protocol, bool nonBlo
     return s;
 }
 
-SOCKET connectTcpSocket(struct sockaddr_storage* dstaddr, SOCKADDR_LEN addrlen, unsigned short port, int timeoutSec) {
+// Creates a non-blocking TCP socket and starts connecting it to the target
+static SOCKET startTcpConnect(struct sockaddr_storage* dstaddr, SOCKADDR_LEN addrlen, unsigned short port) {
     SOCKET s;
     LC_SOCKADDR addr;
-    struct pollfd pfd;
     int err;
     int val;
 
@@ -509,10 +632,50 @@ SOCKET connectTcpSocket(struct sockaddr_storage* dstaddr, SOCKADDR_LEN addrlen,
     if (err < 0) {
         err = (int)LastSocketError();
         if (err != EWOULDBLOCK && err != EAGAIN && err != EINPROGRESS) {
-            goto Exit;
+            Limelog("connect() failed: %d\n", err);
+            closeSocket(s);
+            SetLastSocketError(err);
+            return INVALID_SOCKET;
         }
     }
 
+    return s;
+}
+
+// Returns the result of a connection attempt after pollSockets() signalled the socket
+static int finishTcpConnect(SOCKET s, struct pollfd* pfd) {
+    int err;
+
+#ifdef __3DS__ //SO_ERROR is unreliable on 3DS
+    char test_buffer[1];
+    err = (int)recv(s, test_buffer, 1, MSG_PEEK);
+    if (err < 0 &&
+        (LastSocketError() == EWOULDBLOCK ||
+        LastSocketError() == EAGAIN)) {
+        err = 0;
+    }
+#else
+    SOCKADDR_LEN len = sizeof(err);
+    getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+    if (err != 0 || (pfd->revents & POLLERR)) {
+        // Get the error code
+        err = (err != 0) ? err : LastSocketFail();
+    }
+#endif
+
+    return err;
+}
+
+SOCKET connectTcpSocket(struct sockaddr_storage* dstaddr, SOCKADDR_LEN addrlen, unsigned short port, int timeoutSec) {
+    SOCKET s;
+    struct pollfd pfd;
+    int err;
+
+    s = startTcpConnect(dstaddr, addrlen, port);
+    if (s == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
     // Wait for the connection to complete or the timeout to elapse
     pfd.fd = s;
     pfd.events = POLLOUT;
@@ -532,32 +695,9 @@ SOCKET connectTcpSocket(struct sockaddr_storage* dstaddr, SOCKADDR_LEN addrlen,
         SetLastSocketError(ETIMEDOUT);
         return INVALID_SOCKET;
     }
-#ifdef __3DS__ //SO_ERROR is unreliable on 3DS
-    else {
-        char test_buffer[1];
-        err = (int)recv(s, test_buffer, 1, MSG_PEEK);
-        if (err < 0 &&
-            (LastSocketError() == EWOULDBLOCK ||
-            LastSocketError() == EAGAIN)) {
-            err = 0;
-        }
-    }
-#else
-    else {
-        // The socket was signalled
-        SOCKADDR_LEN len = sizeof(err);
-        getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
-        if (err != 0 || (pfd.revents & POLLERR)) {
-            // Get the error code
-            err = (err != 0) ? err : LastSocketFail();
-        }
-    }
-#endif
 
-    // Disable non-blocking I/O now that the connection is established
-    setSocketNonBlocking(s, false);
-
-Exit:
+    // The socket was signalled
+    err = finishTcpConnect(s, &pfd);
     if (err != 0) {
         Limelog("connect() failed: %d\n", err);
         closeSocket(s);
@@ -565,6 +705,9 @@ Exit:
         return INVALID_SOCKET;
     }
 
+    // Disable non-blocking I/O now that the connection is established
+    setSocketNonBlocking(s, false);
+
     return s;
 }
 
@@ -632,9 +775,150 @@ static bool isPrivateNetworkAddressV4(struct sockaddr_in* address, bool matchCGN
     }
 }
 
-int resolveHostName(const char* host, int family, int tcpTestPort, struct sockaddr_storage* addr, SOCKADDR_LEN* addrLen)
+// Orders the addresses for connection attempts by interleaving address families,
+// starting with the preferred family. Addresses of the same family keep the
+// getaddrinfo() order. Returns the number of candidates.
+static int orderConnectionCandidates(struct addrinfo* res, int preferredFamily, struct addrinfo** candidates) {
+    struct addrinfo* preferred[MAX_CONNECTION_ATTEMPTS];
+    struct addrinfo* others[MAX_CONNECTION_ATTEMPTS];
+    int preferredCount = 0;
+    int otherCount = 0;
+    int count = 0;
+
+    if (preferredFamily == AF_UNSPEC) {
+        // Use the family getaddrinfo() sorted first
+        preferredFamily = res->ai_family;
+    }
+
+    for (struct addrinfo* currentAddr = res; currentAddr != NULL; currentAddr = currentAddr->ai_next) {
+        if (currentAddr->ai_family == preferredFamily) {
+            if (preferredCount < MAX_CONNECTION_ATTEMPTS) {
+                preferred[preferredCount++] = currentAddr;
+            }
+        }
+        else if (otherCount < MAX_CONNECTION_ATTEMPTS) {
+            others[otherCount++] = currentAddr;
+        }
+    }
+
+    for (int i = 0; count < MAX_CONNECTION_ATTEMPTS && (i < preferredCount || i < otherCount); i++) {
+        if (i < preferredCount) {
+            candidates[count++] = preferred[i];
+        }
+        if (i < otherCount && count < MAX_CONNECTION_ATTEMPTS) {
+            candidates[count++] = others[i];
+        }
+    }
+
+    return count;
+}
+
+int raceTcpConnections(struct addrinfo** candidates, int candidateCount, unsigned short port) {
+    SOCKET sockets[MAX_CONNECTION_ATTEMPTS];
+    struct pollfd pfds[MAX_CONNECTION_ATTEMPTS];
+    int pfdCandidates[MAX_CONNECTION_ATTEMPTS];
+    uint64_t nextAttemptTimeMs;
+    uint64_t deadlineMs;
+    int nextAttempt;
+    int inFlight;
+    int winner;
+    int i;
+
+    nextAttemptTimeMs = PltGetMillis();
+    deadlineMs = 0;
+    nextAttempt = 0;
+    inFlight = 0;
+    winner = -1;
+
+    while (winner < 0) {
+        uint64_t now = PltGetMillis();
+        int pfdCount;
+        int timeoutMs;
+        int err;
+
+        // Start the next attempt when it's due or if nothing else is in progress
+        if (nextAttempt < candidateCount && (now >= nextAttemptTimeMs || inFlight == 0)) {
+            sockets[nextAttempt] = startTcpConnect((struct sockaddr_storage*)candidates[nextAttempt]->ai_addr,
+                                                   (SOCKADDR_LEN)candidates[nextAttempt]->ai_addrlen,
+                                                   port);
+            if (sockets[nextAttempt] != INVALID_SOCKET) {
+                inFlight++;
+
+                // Give each attempt the same time to connect as a lone connection would get
+                deadlineMs = now + TEST_PORT_TIMEOUT_SEC * 1000;
+            }
+
+            nextAttempt++;
+            nextAttemptTimeMs = now + CONNECTION_ATTEMPT_DELAY_MS;
+            continue;
+        }
+
+        if (inFlight == 0) {
+            // Every attempt has failed
+            break;
+        }
+        else if (now >= deadlineMs) {
+            Limelog("Connection timed out after %d seconds (TCP port %u)\n", TEST_PORT_TIMEOUT_SEC, port);
+            break;
+        }
+
+        pfdCount = 0;
+        for (i = 0; i < nextAttempt; i++) {
+            if (sockets[i] != INVALID_SOCKET) {
+                pfds[pfdCount].fd = sockets[i];
+                pfds[pfdCount].events = POLLOUT;
+                pfdCandidates[pfdCount] = i;
+                pfdCount++;
+            }
+        }
+
+        timeoutMs = (int)(deadlineMs - now);
+        if (nextAttempt < candidateCount && nextAttemptTimeMs - now < (uint64_t)timeoutMs) {
+            timeoutMs = (int)(nextAttemptTimeMs - now);
+        }
+
+        err = pollSockets(pfds, pfdCount, timeoutMs);
+        if (err < 0) {
+            Limelog("pollSockets() failed: %d\n", (int)LastSocketError());
+            break;
+        }
+
+        for (i = 0; i < pfdCount && err > 0; i++) {
+            int candidate = pfdCandidates[i];
+
+            if (pfds[i].revents == 0) {
+                continue;
+            }
+
+            err = finishTcpConnect(sockets[candidate], &pfds[i]);
+            if (err == 0) {
+                winner = candidate;
+                break;
+            }
+
+            Limelog("connect() failed: %d\n", err);
+            closeSocket(sockets[candidate]);
+            sockets[candidate] = INVALID_SOCKET;
+            inFlight--;
+
+            // Keep scanning the remaining signalled sockets
+            err = 1;
+        }
+    }
+
+    // We only test connectivity here, so close the winner too
+    for (i = 0; i < nextAttempt; i++) {
+        if (sockets[i] != INVALID_SOCKET) {
+            closeSocket(sockets[i]);
+        }
+    }
+
+    return winner;
+}
+
+int resolveHostName(const char* host, int family, int tcpTestPort, int* preferredFamily, struct sockaddr_storage* addr, SOCKADDR_LEN* addrLen)
 {
-    struct addrinfo hints, *res, *currentAddr;
+    struct addrinfo hints, *res, *chosenAddr;
     int err;
     bool needsFallbackV4 = false;
 
@@ -673,27 +957,36 @@ int resolveHostName(const char* host, int family, int tcpTestPort, struct sockad
     }
 #endif
 
-    for (currentAddr = res; currentAddr != NULL; currentAddr = currentAddr->ai_next) {
-        // Use the test port to ensure this address is working if:
-        // a) We have multiple addresses
-        // b) The caller asked us to test even with a single address
-        // c) We got an IPv6 address synthesized from an IPv4 address
-        if (tcpTestPort != 0 && (res->ai_next != NULL || (tcpTestPort & TCP_PORT_FLAG_ALWAYS_TEST) || needsFallbackV4)) {
-            SOCKET testSocket = connectTcpSocket((struct sockaddr_storage*)currentAddr->ai_addr,
-                                                 (SOCKADDR_LEN)currentAddr->ai_addrlen,
-                                                 tcpTestPort & TCP_PORT_MASK,
-                                                 TEST_PORT_TIMEOUT_SEC);
-            if (testSocket == INVALID_SOCKET) {
-                // Try the next address
-                continue;
-            }
-            else {
-                closeSocket(testSocket);
+    // Use the test port to ensure the address is working if:
+    // a) We have multiple addresses
+    // b) The caller asked us to test even with a single address
+    // c) We got an IPv6 address synthesized from an IPv4 address
+    if (tcpTestPort != 0 && (res->ai_next != NULL || (tcpTestPort & TCP_PORT_FLAG_ALWAYS_TEST) || needsFallbackV4)) {
+        struct addrinfo* candidates[MAX_CONNECTION_ATTEMPTS] = { NULL };
+        int candidateCount;
+        int winner;
+
+        // Race the addresses rather than trying them one at a time, so a dead
+        // route for one address family doesn't stall us for the full timeout
+        candidateCount = orderConnectionCandidates(res, preferredFamily != NULL ? *preferredFamily : AF_UNSPEC, candidates);
+        winner = raceTcpConnections(candidates, candidateCount, tcpTestPort & TCP_PORT_MASK);
+        chosenAddr = winner >= 0 ? candidates[winner] : NULL;
+
+        if (chosenAddr != NULL && candidateCount > 1) {
+            Limelog("Connection race to %s won by address %d of %d (family %d)\n",
+                    host, winner + 1, candidateCount, chosenAddr->ai_family);
+            if (preferredFamily != NULL) {
+                *preferredFamily = chosenAddr->ai_family;
             }
         }
+    }
+    else {
+        chosenAddr = res;
+    }
 
-        memcpy(addr, currentAddr->ai_addr, currentAddr->ai_addrlen);
-        *addrLen = (SOCKADDR_LEN)currentAddr->ai_addrlen;
+    if (chosenAddr != NULL) {
+        memcpy(addr, chosenAddr->ai_addr, chosenAddr->ai_addrlen);
+        *addrLen = (SOCKADDR_LEN)chosenAddr->ai_addrlen;
 
         freeaddrinfo(res);
         return 0;
@@ -703,7 +996,7 @@ int resolveHostName(const char* host, int family, int tcpTestPort, struct sockad
 
     if (needsFallbackV4) {
         // Fallback to IPv4-only if we didn't find a working address (see comment above)
-        return resolveHostName(host, AF_INET, tcpTestPort, addr, addrLen);
+        return resolveHostName(host, AF_INET, tcpTestPort, preferredFamily, addr, addrLen);
     }
     else {
         Limelog("No working addresses found for host: %s\n", host);
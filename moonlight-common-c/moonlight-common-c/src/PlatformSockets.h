@@ -110,8 +110,11 @@ SOCKET connectTcpSocket(struct sockaddr_storage* dstaddr, SOCKADDR_LEN addrlen,
 int sendMtuSafe(SOCKET s, char* buffer, int size);
 SOCKET bindUdpSocket(int addressFamily, struct sockaddr_storage* localAddr, SOCKADDR_LEN addrLen, int bufferSize, int socketQosType);
 int enableNoDelay(SOCKET s);
+void setRtpSocketOptions(SOCKET s, int receiveBufferSize, int busyPollUs, int* grantedReceiveBufferSize, int* grantedBusyPollUs);
 int setSocketNonBlocking(SOCKET s, bool enabled);
 int recvUdpSocket(SOCKET s, char* buffer, int size, bool useSelect);
+int recvUdpSocketWithTimestamp(SOCKET s, char* buffer, int size, bool useSelect, uint64_t* kernelReceiveTimeUs);
+bool enableKernelReceiveTimestamps(SOCKET s);
 void shutdownTcpSocket(SOCKET s);
 int setNonFatalRecvTimeoutMs(SOCKET s, int timeoutMs);
 void closeSocket(SOCKET s);
@@ -122,7 +125,19 @@ bool isSocketReadable(SOCKET s);
 
 #define TCP_PORT_MASK 0xFFFF
 #define TCP_PORT_FLAG_ALWAYS_TEST 0x10000
-int resolveHostName(const char* host, int family, int tcpTestPort, struct sockaddr_storage* addr, SOCKADDR_LEN* addrLen);
+// If preferredFamily isn't NULL, that address family is tried first when racing
+// the test port connections, and it's updated with the family of the winner
+int resolveHostName(const char* host, int family, int tcpTestPort, int* preferredFamily, struct sockaddr_storage* addr, SOCKADDR_LEN* addrLen);
+
+// Connection racing parameters from RFC 8305
+#define CONNECTION_ATTEMPT_DELAY_MS 250
+#define MAX_CONNECTION_ATTEMPTS 8
+
+// Races TCP connections to the candidate addresses. A new attempt is started every
+// CONNECTION_ATTEMPT_DELAY_MS (or as soon as all in-flight attempts have failed),
+// and the first connection to succeed wins. Returns the index of the winning
+// candidate or -1 if none could connect.
+int raceTcpConnections(struct addrinfo** candidates, int candidateCount, unsigned short port);
 
 void enterLowLatencyMode(void);
 void exitLowLatencyMode(void);
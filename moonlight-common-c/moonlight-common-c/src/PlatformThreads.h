@@ -63,6 +63,7 @@ void PltCloseEvent(PLT_EVENT* event);
 void PltSetEvent(PLT_EVENT* event);
 void PltClearEvent(PLT_EVENT* event);
 void PltWaitForEvent(PLT_EVENT* event);
+bool PltWaitForEventTimeout(PLT_EVENT* event, int timeoutMs);
 
 int PltCreateConditionVariable(PLT_COND* cond, PLT_MUTEX* mutex);
 void PltDeleteConditionVariable(PLT_COND* cond);
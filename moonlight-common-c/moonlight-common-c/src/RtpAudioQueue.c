@@ -15,8 +15,6 @@
 #define FEC_VERBOSE
 #endif
 
-#define RTP_PAYLOAD_TYPE_AUDIO   97
-#define RTP_PAYLOAD_TYPE_FEC     127
 
 void RtpaInitializeQueue(PRTP_AUDIO_QUEUE queue) {
     memset(queue, 0, sizeof(*queue));
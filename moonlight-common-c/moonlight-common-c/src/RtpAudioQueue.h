@@ -8,6 +8,9 @@
 // after the entire FEC block should have been received
 #define RTPQ_OOS_WAIT_TIME_MS 10
 
+#define RTP_PAYLOAD_TYPE_AUDIO   97
+#define RTP_PAYLOAD_TYPE_FEC     127
+
 #define RTPA_DATA_SHARDS 4
 #define RTPA_FEC_SHARDS 2
 #define RTPA_TOTAL_SHARDS (RTPA_DATA_SHARDS + RTPA_FEC_SHARDS)
@@ -22,6 +22,66 @@ void RtpvInitializeQueue(PRTP_VIDEO_QUEUE queue) {
 
     queue->currentFrameNumber = 1;
     queue->multiFecCapable = APP_VERSION_AT_LEAST(7, 1, 431);
+
+    // All FEC block slots start out missing
+    memset(queue->fecBlockMarks, 1, sizeof(queue->fecBlockMarks));
+}
+
+static bool isShardPresent(PRTP_VIDEO_QUEUE queue, unsigned int index) {
+    return (queue->fecBlockPresent[index / 64] & (1ULL << (index % 64))) != 0;
+}
+
+static void insertShard(PRTP_VIDEO_QUEUE queue, unsigned int index, PRTPV_QUEUE_ENTRY entry) {
+    LC_ASSERT(!isShardPresent(queue, index));
+
+    queue->fecBlockEntries[index] = entry;
+    queue->fecBlockShards[index] = (unsigned char*)entry->packet;
+    queue->fecBlockMarks[index] = 0;
+    queue->fecBlockPresent[index / 64] |= 1ULL << (index % 64);
+    queue->fecBlockShardCount++;
+
+    if (queue->fecBlockFirstEntry == NULL) {
+        queue->fecBlockFirstEntry = entry;
+    }
+}
+
+// Returns the entry and leaves the slot empty. The caller owns the entry afterwards.
+static PRTPV_QUEUE_ENTRY removeShard(PRTP_VIDEO_QUEUE queue, unsigned int index) {
+    PRTPV_QUEUE_ENTRY entry = queue->fecBlockEntries[index];
+
+    LC_ASSERT(isShardPresent(queue, index));
+    LC_ASSERT(queue->fecBlockShardCount != 0);
+
+    queue->fecBlockEntries[index] = NULL;
+    queue->fecBlockShards[index] = NULL;
+    queue->fecBlockMarks[index] = 1;
+    queue->fecBlockPresent[index / 64] &= ~(1ULL << (index % 64));
+    queue->fecBlockShardCount--;
+
+    if (queue->fecBlockShardCount == 0) {
+        queue->fecBlockFirstEntry = NULL;
+    }
+
+    return entry;
+}
+
+static void purgeFecBlock(PRTP_VIDEO_QUEUE queue) {
+    unsigned int word;
+
+    // Only words with shards in them need to be visited
+    for (word = 0; queue->fecBlockShardCount != 0; word++) {
+        uint64_t present = queue->fecBlockPresent[word];
+        unsigned int index;
+
+        LC_ASSERT(word < sizeof(queue->fecBlockPresent) / sizeof(queue->fecBlockPresent[0]));
+
+        for (index = word * 64; present != 0; index++, present >>= 1) {
+            if (present & 1) {
+                // The entry is contained within the packet buffer
+                free(removeShard(queue, index)->packet);
+            }
+        }
+    }
 }
 
 static void purgeListEntries(PRTPV_QUEUE_LIST list) {
@@ -36,8 +96,11 @@ static void purgeListEntries(PRTPV_QUEUE_LIST list) {
 }
 
 void RtpvCleanupQueue(PRTP_VIDEO_QUEUE queue) {
-    purgeListEntries(&queue->pendingFecBlockList);
+    purgeFecBlock(queue);
     purgeListEntries(&queue->completedFecBlockList);
+
+    reed_solomon_release(queue->reedSolomon);
+    queue->reedSolomon = NULL;
 }
 
 static void insertEntryIntoList(PRTPV_QUEUE_LIST list, PRTPV_QUEUE_ENTRY entry) {
@@ -109,39 +172,38 @@ static void reportFinalFrameFecStatus(PRTP_VIDEO_QUEUE queue) {
 
 // newEntry is contained within the packet buffer so we free the whole entry by freeing entry->packet
 static bool queuePacket(PRTP_VIDEO_QUEUE queue, PRTPV_QUEUE_ENTRY newEntry, PRTP_PACKET packet, int length, bool isParity, bool isFecRecovery) {
-    PRTPV_QUEUE_ENTRY entry;
+    unsigned int index = U16(packet->sequenceNumber - queue->bufferLowestSequenceNumber);
     bool outOfSequence;
 
     LC_ASSERT(!(isFecRecovery && isParity));
     LC_ASSERT(!isBefore16(packet->sequenceNumber, queue->nextContiguousSequenceNumber));
 
-    // If the packet is in order, we can take the fast path and avoid having
-    // to loop through the whole list. If we get an out of order or missing
-    // packet, the fast path will stop working and we'll use the loop instead.
+    // RtpvAddPacket() only lets packets within the FEC block through
+    LC_ASSERT(index < queue->bufferDataPackets + queue->bufferParityPackets);
+    if (index >= queue->bufferDataPackets + queue->bufferParityPackets) {
+        return false;
+    }
+
+    // Check for duplicates
+    if (isShardPresent(queue, index)) {
+        return false;
+    }
+
+    // If the packet is in order, we can take the fast path which also advances
+    // the next contiguous sequence number we report to the host.
     //
     // NB: It's not enough to just check next contiguous sequence number because
     // it's possible that we hit the OOS path earlier which doesn't update the
     // next contiguous sequence number. If that happens, we need to use the slow
-    // path for this entire frame to avoid possibly mishandling a duplicate packet.
+    // path for this entire frame to keep the reported value consistent.
     if (queue->useFastQueuePath && packet->sequenceNumber == queue->nextContiguousSequenceNumber) {
         queue->nextContiguousSequenceNumber = U16(packet->sequenceNumber + 1);
         outOfSequence = false;
     }
     else {
-        outOfSequence = false;
-
-        // Check for duplicates
-        entry = queue->pendingFecBlockList.head;
-        while (entry != NULL) {
-            if (packet->sequenceNumber == entry->packet->sequenceNumber) {
-                return false;
-            }
-            else if (isBefore16(packet->sequenceNumber, entry->packet->sequenceNumber)) {
-                outOfSequence = true;
-            }
-
-            entry = entry->next;
-        }
+        // This packet is out of order if we've already queued one with a higher sequence number
+        outOfSequence = queue->fecBlockShardCount != 0 &&
+                isBefore16(packet->sequenceNumber, queue->receivedHighestSequenceNumber);
 
         // If we make it here, we cannot use the fast queue path for this frame because
         // we're about to queue a non-duplicate packet out of order. This will not update
@@ -160,6 +222,15 @@ static bool queuePacket(PRTP_VIDEO_QUEUE queue, PRTPV_QUEUE_ENTRY newEntry, PRTP
     // FEC recovery packets are synthesized by us, so don't use them to determine OOS data
     if (!isFecRecovery) {
         if (outOfSequence) {
+            queue->stats.packetCountOOS++;
+
+            // Remember how far packets get reordered, so we can still predict losses
+            // for holes that are too old to be filled by late packets.
+            uint32_t oosDistance = U16(queue->receivedHighestSequenceNumber - packet->sequenceNumber);
+            if (oosDistance > queue->maxOosDistance) {
+                queue->maxOosDistance = oosDistance;
+            }
+
             // This packet was received after a higher sequence number packet, so note that we
             // received an out of order packet to disable our speculative RFI recovery logic.
             queue->lastOosFramePresentationTimestamp = newEntry->presentationTimeUs;
@@ -173,10 +244,11 @@ static bool queuePacket(PRTP_VIDEO_QUEUE queue, PRTPV_QUEUE_ENTRY newEntry, PRTP
             Limelog("Entering speculative RFI mode after sequenced video data at frame %u\n",
                     queue->currentFrameNumber);
             queue->receivedOosData = false;
+            queue->maxOosDistance = 0;
         }
     }
 
-    insertEntryIntoList(&queue->pendingFecBlockList, newEntry);
+    insertShard(queue, index, newEntry);
 
     return true;
 }
@@ -186,7 +258,7 @@ static bool queuePacket(PRTP_VIDEO_QUEUE queue, PRTPV_QUEUE_ENTRY newEntry, PRTP
     Limelog("FEC recovery returned corrupt packet %d" \
             " (frame %d)", rtpPacket->sequenceNumber, \
             queue->currentFrameNumber);               \
-    free(packets[i]);                                 \
+    free(rtpPacket);                                  \
     continue
 
 // Returns 0 if the frame is completely constructed
@@ -206,21 +278,24 @@ static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
 
     LC_ASSERT(totalPackets - neededPackets <= queue->bufferParityPackets);
 
-    if (queue->pendingFecBlockList.count < neededPackets) {
-        // If we've never received OOS data from this host, we can predict whether this frame will be recoverable
-        // based on the packets we've received (or not) so far. If the number of missing shards exceeds the total
-        // needed shards, there is no hope of recovering the data. The only way we could recover this frame is by
-        // receiving OOS data, which is unlikely because we've not seen any recently from this host.
-        if (!queue->reportedLostFrame && !queue->receivedOosData) {
+    if (queue->fecBlockShardCount < neededPackets) {
+        // We can predict whether this frame will be recoverable based on the packets we've received (or not) so far.
+        // If the number of missing shards exceeds the total needed shards, there is no hope of recovering the data.
+        // The only way we could recover this frame is by receiving OOS data. If we've never received OOS data from
+        // this host, that is unlikely. If we have, only holes within the reordering distance we've observed can
+        // still be filled by late packets, so we allow for that many extra missing shards before predicting loss.
+        if (!queue->reportedLostFrame) {
+            uint32_t reorderAllowance = queue->receivedOosData ? queue->maxOosDistance : 0;
+
             // NB: We use totalPackets - neededPackets instead of just bufferParityPackets here because we require
             // one extra parity shard for recovery if we're in FEC validation mode.
-            if (queue->missingPackets > totalPackets - neededPackets) {
+            if (queue->missingPackets > totalPackets - neededPackets + reorderAllowance) {
                 notifyFrameLost(queue->currentFrameNumber, true);
                 queue->reportedLostFrame = true;
             }
-            else {
+            else if (!queue->receivedOosData) {
                 // Assert that there are enough remaining packets to possibly recover this frame.
-                LC_ASSERT(neededPackets - queue->pendingFecBlockList.count <= U16(queue->bufferHighestSequenceNumber - queue->receivedHighestSequenceNumber));
+                LC_ASSERT(neededPackets - queue->fecBlockShardCount <= U16(queue->bufferHighestSequenceNumber - queue->receivedHighestSequenceNumber));
             }
         }
 
@@ -235,7 +310,7 @@ static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
     if (queue->reportedLostFrame && !queue->receivedOosData) {
         // If it turns out that we lied to the host, stop further speculative RFI requests for a while.
         queue->receivedOosData = true;
-        queue->lastOosFramePresentationTimestamp = queue->pendingFecBlockList.head->presentationTimeUs;
+        queue->lastOosFramePresentationTimestamp = queue->fecBlockFirstEntry->presentationTimeUs;
         Limelog("Leaving speculative RFI mode due to incorrect loss prediction of frame %u\n", queue->currentFrameNumber);
     }
 
@@ -257,26 +332,28 @@ static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
         return -1;
     }
 
-    reed_solomon* rs = NULL;
-    unsigned char** packets = calloc(totalPackets, sizeof(unsigned char*));
-    unsigned char* marks = calloc(totalPackets, sizeof(unsigned char));
-    if (packets == NULL || marks == NULL) {
-        ret = -2;
-        goto cleanup;
-    }
+    // The FEC block slots are already laid out the way the decoder wants them,
+    // with the received shards in place and every missing one marked.
+    unsigned char** packets = queue->fecBlockShards;
+    unsigned char* marks = queue->fecBlockMarks;
+    PRTP_PACKET templatePacket = queue->fecBlockFirstEntry->packet;
+    unsigned int i;
 
-    rs = reed_solomon_new(queue->bufferDataPackets, queue->bufferParityPackets);
+    // FEC blocks of a stream mostly share the same geometry, so we keep the
+    // decoder around rather than rebuilding its matrices for every recovery.
+    reed_solomon* rs = queue->reedSolomon;
+    if (rs == NULL || rs->data_shards != (int)queue->bufferDataPackets || rs->parity_shards != (int)queue->bufferParityPackets) {
+        reed_solomon_release(rs);
+        rs = queue->reedSolomon = reed_solomon_new(queue->bufferDataPackets, queue->bufferParityPackets);
+    }
 
     // This could happen in an OOM condition, but it could also mean the FEC data
     // that we fed to reed_solomon_new() is bogus, so we'll assert to get a better look.
     LC_ASSERT(rs != NULL);
     if (rs == NULL) {
-        ret = -3;
-        goto cleanup;
+        return -3;
     }
 
-    memset(marks, 1, sizeof(char) * (totalPackets));
-
     int receiveSize = StreamConfig.packetSize + MAX_RTP_HEADER_SIZE;
     int packetBufferSize = receiveSize + sizeof(RTPV_QUEUE_ENTRY);
 
@@ -285,41 +362,30 @@ static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
     unsigned int dropIndex = rand() % queue->bufferDataPackets;
     PRTP_PACKET droppedRtpPacket = NULL;
     int droppedRtpPacketLength = 0;
-#endif
-
-    PRTPV_QUEUE_ENTRY entry = queue->pendingFecBlockList.head;
-    while (entry != NULL) {
-        unsigned int index = U16(entry->packet->sequenceNumber - queue->bufferLowestSequenceNumber);
 
-#ifdef FEC_VALIDATION_MODE
-        if (index == dropIndex) {
-            // If this was the drop choice, remember the original contents
-            // and "drop" it.
-            droppedRtpPacket = entry->packet;
-            droppedRtpPacketLength = entry->length;
-            entry = entry->next;
-            continue;
-        }
+    if (isShardPresent(queue, dropIndex)) {
+        // If the drop choice was received, remember the original contents
+        // and "drop" it. The slot is restored after recovery.
+        droppedRtpPacket = queue->fecBlockEntries[dropIndex]->packet;
+        droppedRtpPacketLength = queue->fecBlockEntries[dropIndex]->length;
+        packets[dropIndex] = NULL;
+        marks[dropIndex] = 1;
+    }
 #endif
 
-        // We should never have duplicate packets enqueued
-        LC_ASSERT(packets[index] == NULL);
-        LC_ASSERT(marks[index] != 0);
-
-        packets[index] = (unsigned char*) entry->packet;
-        marks[index] = 0;
-
-        //Set padding to zero
-        if (entry->length < receiveSize) {
-            memset(&packets[index][entry->length], 0, receiveSize - entry->length);
+    for (i = 0; i < totalPackets; i++) {
+        if (!marks[i]) {
+            //Set padding to zero
+            PRTPV_QUEUE_ENTRY entry = queue->fecBlockEntries[i];
+            if (entry->length < receiveSize) {
+                memset(&packets[i][entry->length], 0, receiveSize - entry->length);
+            }
         }
-
-        entry = entry->next;
     }
 
-    unsigned int i;
     for (i = 0; i < totalPackets; i++) {
         if (marks[i]) {
+            LC_ASSERT(packets[i] == NULL);
             packets[i] = malloc(packetBufferSize);
             if (packets[i] == NULL) {
                 ret = -4;
@@ -335,6 +401,8 @@ static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
     LC_ASSERT(ret == 0);
 
     if (queue->bufferDataPackets != queue->receivedDataPackets) {
+        queue->stats.packetCountFecRecovered += queue->bufferDataPackets - queue->receivedDataPackets;
+
 #ifdef FEC_VERBOSE
         Limelog("Recovered %d video data shards from frame %d\n",
                 queue->bufferDataPackets - queue->receivedDataPackets,
@@ -348,14 +416,18 @@ static int reconstructFrame(PRTP_VIDEO_QUEUE queue) {
 cleanup_packets:
     for (i = 0; i < totalPackets; i++) {
         if (marks[i]) {
+            PRTP_PACKET rtpPacket = (PRTP_PACKET) packets[i];
+
+            // The slot stays missing unless the recovered packet is queued below
+            packets[i] = NULL;
+
             // Only submit frame data, not FEC packets
             if (ret == 0 && i < queue->bufferDataPackets) {
-                PRTPV_QUEUE_ENTRY queueEntry = (PRTPV_QUEUE_ENTRY)&packets[i][receiveSize];
-                PRTP_PACKET rtpPacket = (PRTP_PACKET) packets[i];
+                PRTPV_QUEUE_ENTRY queueEntry = (PRTPV_QUEUE_ENTRY)&((unsigned char*)rtpPacket)[receiveSize];
                 rtpPacket->sequenceNumber = U16(i + queue->bufferLowestSequenceNumber);
-                rtpPacket->header = queue->pendingFecBlockList.head->packet->header;
-                rtpPacket->timestamp = queue->pendingFecBlockList.head->packet->timestamp;
-                rtpPacket->ssrc = queue->pendingFecBlockList.head->packet->ssrc;
+                rtpPacket->header = templatePacket->header;
+                rtpPacket->timestamp = templatePacket->timestamp;
+                rtpPacket->ssrc = templatePacket->ssrc;
 
                 int dataOffset = sizeof(*rtpPacket);
                 if (rtpPacket->header & FLAG_EXTENSION) {
@@ -414,7 +486,7 @@ cleanup_packets:
 
                     // This drop was fake, so we don't want to actually submit it to the depacketizer.
                     // It will get confused because it's already seen this packet before.
-                    free(packets[i]);
+                    free(rtpPacket);
                     continue;
                 }
 #endif
@@ -444,82 +516,55 @@ cleanup_packets:
 
                 LC_ASSERT(isBefore16(rtpPacket->sequenceNumber, queue->bufferFirstParitySequenceNumber));
                 queuePacket(queue, queueEntry, rtpPacket, StreamConfig.packetSize + dataOffset, false, true);
-            } else if (packets[i] != NULL) {
-                free(packets[i]);
+            } else if (rtpPacket != NULL) {
+                free(rtpPacket);
             }
         }
     }
 
-cleanup:
-    reed_solomon_release(rs);
-
-    if (packets != NULL)
-        free(packets);
-
-    if (marks != NULL)
-        free(marks);
+#ifdef FEC_VALIDATION_MODE
+    if (droppedRtpPacket != NULL) {
+        // Put back the packet we pretended to lose
+        packets[dropIndex] = (unsigned char*)droppedRtpPacket;
+        marks[dropIndex] = 0;
+    }
+#endif
 
     return ret;
 }
 
 static void stageCompleteFecBlock(PRTP_VIDEO_QUEUE queue) {
-    unsigned int nextSeqNum = queue->bufferLowestSequenceNumber;
-
-    while (queue->pendingFecBlockList.count > 0) {
-        PRTPV_QUEUE_ENTRY entry = queue->pendingFecBlockList.head;
-
-        unsigned int lowestRtpSequenceNumber = entry->packet->sequenceNumber;
-
-        do {
-            // We should never encounter a packet that's lower than our next seq num
-            LC_ASSERT(!isBefore16(entry->packet->sequenceNumber, nextSeqNum));
-
-            // Never return parity packets
-            if (entry->isParity) {
-                PRTPV_QUEUE_ENTRY parityEntry = entry;
-
-                // Skip this entry
-                entry = parityEntry->next;
-
-                // Remove this entry
-                removeEntryFromList(&queue->pendingFecBlockList, parityEntry);
-
-                // Free the entry and packet
-                free(parityEntry->packet);
+    unsigned int totalPackets = queue->bufferDataPackets + queue->bufferParityPackets;
+    unsigned int i;
 
-                continue;
-            }
+    // The slots are in sequence number order, so this is a single pass
+    for (i = 0; i < totalPackets && queue->fecBlockShardCount != 0; i++) {
+        if (!isShardPresent(queue, i)) {
+            continue;
+        }
 
-            // Check for the next packet in sequence. This will be O(1) for non-reordered packet streams.
-            if (entry->packet->sequenceNumber == nextSeqNum) {
-                removeEntryFromList(&queue->pendingFecBlockList, entry);
+        PRTPV_QUEUE_ENTRY entry = removeShard(queue, i);
 
-                // To avoid having to sample the system time for each packet, we cheat
-                // and use the first packet's receive time for all packets. This ends up
-                // actually being better for the measurements that the depacketizer does,
-                // since it properly handles out of order packets.
-                LC_ASSERT(queue->bufferFirstRecvTimeUs != 0);
-                entry->receiveTimeUs = queue->bufferFirstRecvTimeUs;
+        // Never return parity packets
+        if (entry->isParity) {
+            LC_ASSERT(i >= queue->bufferDataPackets);
 
-                // Move this packet to the completed FEC block list
-                insertEntryIntoList(&queue->completedFecBlockList, entry);
-                break;
-            }
-            else if (isBefore16(entry->packet->sequenceNumber, lowestRtpSequenceNumber)) {
-                lowestRtpSequenceNumber = entry->packet->sequenceNumber;
-            }
+            // Free the entry and packet
+            free(entry->packet);
+            continue;
+        }
 
-            entry = entry->next;
-        } while (entry != NULL);
+        // We use the first packet's receive time for all packets. This is better
+        // for the measurements that the depacketizer does, since it properly
+        // handles out of order packets, and it covers recovered packets too.
+        LC_ASSERT(queue->bufferFirstRecvTimeUs != 0);
+        entry->receiveTimeUs = queue->bufferFirstRecvTimeUs;
+        entry->receiveDelayUs = queue->bufferFirstRecvDelayUs;
 
-        if (entry == NULL) {
-            // Start at the lowest we found last enumeration
-            nextSeqNum = lowestRtpSequenceNumber;
-        }
-        else {
-            // We found this packet so move on to the next one in sequence
-            nextSeqNum = U16(nextSeqNum + 1);
-        }
+        // Move this packet to the completed FEC block list
+        entry->prev = NULL;
+        entry->next = NULL;
+        insertEntryIntoList(&queue->completedFecBlockList, entry);
     }
 }
 
@@ -590,11 +635,12 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
 
     // Reinitialize the queue if it's empty after a frame delivery or
     // if we can't finish a frame before receiving the next one.
-    if (queue->pendingFecBlockList.count == 0 || queue->currentFrameNumber != nvPacket->frameIndex ||
+    if (queue->fecBlockShardCount == 0 || queue->currentFrameNumber != nvPacket->frameIndex ||
             queue->multiFecCurrentBlockNumber != fecCurrentBlockNumber) {
-        if (queue->pendingFecBlockList.count != 0) {
+        if (queue->fecBlockShardCount != 0) {
             // Report the final status of the FEC queue before dropping this frame
             reportFinalFrameFecStatus(queue);
+            queue->stats.packetCountFecFailed++;
 
             if (queue->multiFecLastBlockNumber != 0) {
                 Limelog("Unrecoverable frame %d (block %d of %d): %d+%d=%d received < %d needed\n",
@@ -602,7 +648,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
                         queue->multiFecLastBlockNumber+1,
                         queue->receivedDataPackets,
                         queue->receivedParityPackets,
-                        queue->pendingFecBlockList.count,
+                        queue->fecBlockShardCount,
                         queue->bufferDataPackets);
 
                 // If we just missed a block of this frame rather than the whole thing,
@@ -610,7 +656,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
                 // frame further is not possible.
                 if (queue->currentFrameNumber == nvPacket->frameIndex) {
                     // Discard any unsubmitted buffers from the previous frame
-                    purgeListEntries(&queue->pendingFecBlockList);
+                    purgeFecBlock(queue);
                     purgeListEntries(&queue->completedFecBlockList);
 
                     // Notify the host of the loss of this frame
@@ -628,7 +674,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
                 Limelog("Unrecoverable frame %d: %d+%d=%d received < %d needed\n",
                         queue->currentFrameNumber, queue->receivedDataPackets,
                         queue->receivedParityPackets,
-                        queue->pendingFecBlockList.count,
+                        queue->fecBlockShardCount,
                         queue->bufferDataPackets);
             }
         }
@@ -639,6 +685,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
         if (fecCurrentBlockNumber != expectedFecBlockNumber) {
             // Report the final status of the FEC queue before dropping this frame
             reportFinalFrameFecStatus(queue);
+            queue->stats.packetCountFecFailed++;
 
             Limelog("Unrecoverable frame %d: lost FEC blocks %d to %d\n",
                     nvPacket->frameIndex,
@@ -646,7 +693,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
                     fecCurrentBlockNumber);
 
             // Discard any unsubmitted buffers from the previous frame
-            purgeListEntries(&queue->pendingFecBlockList);
+            purgeFecBlock(queue);
             purgeListEntries(&queue->completedFecBlockList);
 
             // Notify the host of the loss of this frame
@@ -662,7 +709,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
         }
 
         // Discard any pending buffers from the previous FEC block
-        purgeListEntries(&queue->pendingFecBlockList);
+        purgeFecBlock(queue);
 
         // Discard any completed FEC blocks from the previous frame
         if (queue->currentFrameNumber != nvPacket->frameIndex) {
@@ -691,7 +738,8 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
         // being able to reconstruct a full frame from it.
         connectionSawFrame(queue->currentFrameNumber);
 
-        queue->bufferFirstRecvTimeUs = PltGetMicroseconds();
+        queue->bufferFirstRecvTimeUs = packetEntry->receiveTimeUs;
+        queue->bufferFirstRecvDelayUs = packetEntry->receiveDelayUs;
         queue->bufferLowestSequenceNumber = U16(packet->sequenceNumber - fecIndex);
         queue->nextContiguousSequenceNumber = queue->bufferLowestSequenceNumber;
         queue->receivedDataPackets = 0;
@@ -735,7 +783,7 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
     }
     else {
         // Update total missing packet count
-        if (queue->pendingFecBlockList.count == 1) {
+        if (queue->fecBlockShardCount == 1) {
             // Initialize counts and highest seqnum on the first packet
             LC_ASSERT(queue->missingPackets == 0);
             LC_ASSERT(queue->receivedHighestSequenceNumber == 0);
@@ -774,13 +822,19 @@ int RtpvAddPacket(PRTP_VIDEO_QUEUE queue, PRTP_PACKET packet, int length, PRTPV_
             stageCompleteFecBlock(queue);
 
             // stageCompleteFecBlock() should have consumed all pending FEC data
-            LC_ASSERT(queue->pendingFecBlockList.head == NULL);
-            LC_ASSERT(queue->pendingFecBlockList.tail == NULL);
-            LC_ASSERT(queue->pendingFecBlockList.count == 0);
+            LC_ASSERT(queue->fecBlockShardCount == 0);
+            LC_ASSERT(queue->fecBlockFirstEntry == NULL);
 
             // If we're not yet at the last FEC block for this frame, move on to the next block.
             // Otherwise, the frame is complete and we can move on to the next frame.
             if (queue->multiFecCurrentBlockNumber < queue->multiFecLastBlockNumber) {
+                // Renderers that can decode partial frames get each FEC block
+                // as soon as it's complete rather than waiting for the whole frame.
+                if (VideoCallbacks.capabilities & CAPABILITY_SUBFRAME_SUBMIT) {
+                    submitCompletedFrame(queue);
+                    submitPartialFrame();
+                }
+
                 // Move on to the next FEC block for this frame
                 queue->multiFecCurrentBlockNumber++;
             }
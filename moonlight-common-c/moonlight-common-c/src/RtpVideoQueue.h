@@ -6,7 +6,8 @@ typedef struct _RTPV_QUEUE_ENTRY {
     struct _RTPV_QUEUE_ENTRY* next;
     struct _RTPV_QUEUE_ENTRY* prev;
     PRTP_PACKET packet;
-    uint64_t receiveTimeUs;
+    uint64_t receiveTimeUs; // set by the caller of RtpvAddPacket()
+    uint32_t receiveDelayUs; // set by the caller of RtpvAddPacket()
     uint64_t presentationTimeUs;
     uint32_t rtpTimestamp;
     int length;
@@ -19,11 +20,30 @@ typedef struct _RTPV_QUEUE_LIST {
     uint32_t count;
 } RTPV_QUEUE_LIST, *PRTPV_QUEUE_LIST;
 
+// The largest FEC block the host can describe with the 10 bit data shard
+// count and 8 bit FEC percentage in the video packet header
+#define RTPV_MAX_DATA_SHARDS 1023
+#define RTPV_MAX_FEC_PERCENTAGE 255
+#define RTPV_MAX_FEC_BLOCK_SHARDS (RTPV_MAX_DATA_SHARDS + (RTPV_MAX_DATA_SHARDS * RTPV_MAX_FEC_PERCENTAGE + 99) / 100)
+
 typedef struct _RTP_VIDEO_QUEUE {
-    RTPV_QUEUE_LIST pendingFecBlockList;
+    // Shards of the FEC block being received, indexed by their sequence number
+    // relative to bufferLowestSequenceNumber. fecBlockShards and fecBlockMarks
+    // are kept in the layout reed_solomon_reconstruct() takes, so recovery
+    // can use them directly. Slots without a shard have a NULL shard pointer
+    // and a mark of 1.
+    PRTPV_QUEUE_ENTRY fecBlockEntries[RTPV_MAX_FEC_BLOCK_SHARDS];
+    unsigned char* fecBlockShards[RTPV_MAX_FEC_BLOCK_SHARDS];
+    unsigned char fecBlockMarks[RTPV_MAX_FEC_BLOCK_SHARDS];
+    uint64_t fecBlockPresent[(RTPV_MAX_FEC_BLOCK_SHARDS + 63) / 64];
+    uint32_t fecBlockShardCount;
+    PRTPV_QUEUE_ENTRY fecBlockFirstEntry; // the first shard we received
+    struct _reed_solomon* reedSolomon; // decoder for the FEC geometry of the last recovery
+
     RTPV_QUEUE_LIST completedFecBlockList;
 
     uint64_t bufferFirstRecvTimeUs;
+    uint32_t bufferFirstRecvDelayUs;
     uint32_t bufferLowestSequenceNumber;
     uint32_t bufferHighestSequenceNumber;
     uint32_t bufferFirstParitySequenceNumber;
@@ -46,6 +66,7 @@ typedef struct _RTP_VIDEO_QUEUE {
 
     uint64_t lastOosFramePresentationTimestamp;
     bool receivedOosData;
+    uint32_t maxOosDistance; // furthest behind the highest sequence number an OOS packet has arrived
 
     RTP_VIDEO_STATS stats; // the above values are short-lived, this tracks stats for the life of the queue
 } RTP_VIDEO_QUEUE, *PRTP_VIDEO_QUEUE;
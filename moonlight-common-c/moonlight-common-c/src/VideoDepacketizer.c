@@ -20,18 +20,34 @@ static bool strictIdrFrameWait;
 static uint64_t syntheticPtsBaseUs;
 static uint16_t frameHostProcessingLatency;
 static uint64_t firstPacketReceiveTimeUs;
+static uint32_t firstPacketReceiveDelayUs;
 static uint64_t firstPacketPresentationTime;
 static uint32_t firstPacketRtpTimestamp;
 static bool dropStatePending;
 static bool idrFrameProcessed;
 
+// Sub-frame submission state (CAPABILITY_SUBFRAME_SUBMIT)
+static bool partialFrameSubmitted;
+static PLENTRY nalChainScanTail;
+
 #define DR_CLEANUP -1000
 
 #define CONSECUTIVE_DROP_LIMIT 120
 static unsigned int consecutiveFrameDrops;
 
+#define DECODE_UNIT_QUEUE_BOUND 15
 static LINKED_BLOCKING_QUEUE decodeUnitQueue;
 
+// Latency budget state (decodeLatencyBudgetMs). The decoder takes decode units
+// from the queue in order, so the enqueue times of the last ones we queued tell
+// us how long the oldest one still in the queue has been waiting.
+static uint64_t decodeUnitEnqueueTimesUs[DECODE_UNIT_QUEUE_BOUND + 1];
+static unsigned int decodeUnitsEnqueued;
+static uint64_t lastLatencyRfiTimeUs;
+static bool latencyRecoveryPending;
+static bool frameDiscardable;
+static uint32_t framesSkippedForLatency;
+
 typedef struct _BUFFER_DESC {
     char* data;
     unsigned int offset;
@@ -43,24 +59,9 @@ typedef struct _LENTRY_INTERNAL {
     void* allocPtr;
 } LENTRY_INTERNAL, *PLENTRY_INTERNAL;
 
-#define H264_NAL_TYPE(x) ((x) & 0x1F)
-#define HEVC_NAL_TYPE(x) (((x) & 0x7E) >> 1)
-
-#define H264_NAL_TYPE_SEI 6
-#define H264_NAL_TYPE_SPS 7
-#define H264_NAL_TYPE_PPS 8
-#define H264_NAL_TYPE_AUD 9
-#define H264_NAL_TYPE_FILLER 12
-#define HEVC_NAL_TYPE_VPS 32
-#define HEVC_NAL_TYPE_SPS 33
-#define HEVC_NAL_TYPE_PPS 34
-#define HEVC_NAL_TYPE_AUD 35
-#define HEVC_NAL_TYPE_FILLER 38
-#define HEVC_NAL_TYPE_SEI 39
-
 // Init
 void initializeVideoDepacketizer(int pktSize) {
-    LbqInitializeLinkedBlockingQueue(&decodeUnitQueue, 15);
+    LbqInitializeLinkedBlockingQueue(&decodeUnitQueue, DECODE_UNIT_QUEUE_BOUND);
 
     nextFrameNumber = 1;
     startFrameNumber = 0;
@@ -72,37 +73,64 @@ void initializeVideoDepacketizer(int pktSize) {
     syntheticPtsBaseUs = 0;
     frameHostProcessingLatency = 0;
     firstPacketReceiveTimeUs = 0;
+    firstPacketReceiveDelayUs = 0;
     firstPacketPresentationTime = 0;
     firstPacketRtpTimestamp = 0;
     lastPacketPayloadLength = 0;
     dropStatePending = false;
     idrFrameProcessed = false;
+    partialFrameSubmitted = false;
+    nalChainScanTail = NULL;
+    decodeUnitsEnqueued = 0;
+    lastLatencyRfiTimeUs = 0;
+    latencyRecoveryPending = false;
+    frameDiscardable = false;
+    framesSkippedForLatency = 0;
     strictIdrFrameWait = !isReferenceFrameInvalidationEnabled();
 }
 
-// Free the NAL chain
-static void cleanupFrameState(void) {
+// Free a list of NAL chain entries
+static void freeNalChain(PLENTRY head) {
     PLENTRY_INTERNAL lastEntry;
 
-    while (nalChainHead != NULL) {
-        lastEntry = (PLENTRY_INTERNAL)nalChainHead;
-        nalChainHead = lastEntry->entry.next;
+    while (head != NULL) {
+        lastEntry = (PLENTRY_INTERNAL)head;
+        head = lastEntry->entry.next;
         free(lastEntry->allocPtr);
     }
+}
+
+// Free the NAL chain
+static void cleanupFrameState(void) {
+    freeNalChain(nalChainHead);
 
+    nalChainHead = NULL;
     nalChainTail = NULL;
+    nalChainScanTail = NULL;
 
     nalChainDataLength = 0;
 }
 
-// Cleanup frame state and set that we're waiting for an IDR Frame
-static void dropFrameState(void) {
+// Cleanup frame state and set that we're waiting for an IDR Frame. If the
+// caller asks for it, an IDR frame is requested when we end up waiting for
+// one. Either way, there's never more than one request for a drop.
+static void dropFrameState(bool requestIdrFrameIfWaiting) {
+    bool requestIdrFrame = false;
+
     // This may only be called at frame boundaries
     LC_ASSERT(!decodingFrame);
 
     // We're dropping frame state now
     dropStatePending = false;
 
+    // If the decoder already has part of this frame, RFI can't
+    // recover it cleanly. We need an IDR frame to start over.
+    if (partialFrameSubmitted) {
+        partialFrameSubmitted = false;
+        waitingForIdrFrame = true;
+        requestIdrFrame = true;
+    }
+
     if (strictIdrFrameWait || !idrFrameProcessed || waitingForIdrFrame) {
         // We'll need an IDR frame now if we're in non-RFI mode, if we've never
         // received an IDR frame, or if we explicitly need an IDR frame.
@@ -124,10 +152,15 @@ static void dropFrameState(void) {
 
         // Request an IDR frame
         waitingForIdrFrame = true;
-        LiRequestIdrFrame();
+        requestIdrFrame = true;
     }
 
     cleanupFrameState();
+
+    // One request covers every reason we need an IDR frame for this drop
+    if (requestIdrFrame || (requestIdrFrameIfWaiting && waitingForIdrFrame)) {
+        LiRequestIdrFrame();
+    }
 }
 
 // Cleanup the list of decode units
@@ -308,251 +341,304 @@ void LiCompleteVideoFrame(VIDEO_FRAME_HANDLE handle, int drStatus) {
     }
 }
 
-static bool isSeqReferenceFrameStart(PBUFFER_DESC buffer) {
+static int getNalClass(PBUFFER_DESC buffer) {
     BUFFER_DESC startSeq;
 
     if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
+        return NAL_CLASS_NONE;
     }
 
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == 5;
-    }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        switch (HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length])) {
-            case 16:
-            case 17:
-            case 18:
-            case 19:
-            case 20:
-            case 21:
-                return true;
-
-            default:
-                return false;
-        }
-    }
-    else {
-        LC_ASSERT(false);
-        return false;
-    }
+    return AnnexBClassifyNal((uint8_t)startSeq.data[startSeq.offset + startSeq.length],
+                             (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) != 0);
 }
 
-static bool isAccessUnitDelimiter(PBUFFER_DESC buffer) {
+// Advance the buffer descriptor to the start of the next NAL or end of buffer
+static void skipToNextNalOrEnd(PBUFFER_DESC buffer) {
     BUFFER_DESC startSeq;
+    unsigned int startSeqLength;
+    unsigned int skipLength;
 
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
+    // If we're starting on a NAL boundary, skip to the next one
+    if (getAnnexBStartSequence(buffer, &startSeq)) {
+        buffer->offset += startSeq.length;
+        buffer->length -= startSeq.length;
     }
 
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_AUD;
+    // Find the next Annex B start sequence (3 or 4 byte)
+    skipLength = AnnexBFindStartSequence(&buffer->data[buffer->offset], buffer->length, &startSeqLength);
+    buffer->offset += skipLength;
+    buffer->length -= skipLength;
+}
+
+// Advance the buffer descriptor to the given NAL of a scan of it
+static void seekToScannedNal(PBUFFER_DESC buffer, PANNEXB_NAL_SCAN scan, unsigned int nalIndex) {
+    unsigned int end = buffer->offset + buffer->length;
+
+    if (nalIndex < scan->count) {
+        buffer->offset = scan->nals[nalIndex].offset;
+        buffer->length = end - buffer->offset;
     }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_AUD;
+    else if (scan->count != 0) {
+        // We're past the last NAL recorded, so find the next one after it
+        buffer->offset = scan->nals[scan->count - 1].offset;
+        buffer->length = end - buffer->offset;
+        skipToNextNalOrEnd(buffer);
     }
     else {
-        LC_ASSERT(false);
-        return false;
+        buffer->offset = end;
+        buffer->length = 0;
     }
 }
 
-static bool isSeiNal(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
+// Move on to the next NAL of a scan. If the scan filled up before it reached the
+// picture data, it's continued before we get to its last NAL, since that one
+// covers everything that wasn't scanned.
+static void nextScannedNal(PANNEXB_NAL_SCAN scan, unsigned int* nalIndex, const char* data) {
+    (*nalIndex)++;
 
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
+    if (*nalIndex + 1 == scan->count &&
+            AnnexBContinueScan(scan, data, (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) != 0)) {
+        *nalIndex = 0;
     }
+}
 
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_SEI;
+static int getScannedNalClass(PANNEXB_NAL_SCAN scan, unsigned int nalIndex) {
+    return nalIndex < scan->count ? scan->nals[nalIndex].nalClass : NAL_CLASS_NONE;
+}
+
+static bool isScannedNalDiscardable(PANNEXB_NAL_SCAN scan, unsigned int nalIndex, const char* data) {
+    if (getScannedNalClass(scan, nalIndex) != NAL_CLASS_SLICE) {
+        return false;
     }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_SEI;
+
+    return AnnexBIsDiscardableSlice((uint8_t)data[scan->nals[nalIndex].offset + scan->nals[nalIndex].startSeqLength],
+                                    (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) != 0);
+}
+
+static bool isIdrFrameStart(int nalClass) {
+    // IDR frames begin with the VPS on HEVC and the SPS on H.264
+    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
+        return nalClass == NAL_CLASS_VPS;
     }
     else {
-        LC_ASSERT(false);
-        return false;
+        return nalClass == NAL_CLASS_SPS;
     }
 }
 
-#ifdef LC_DEBUG
-static bool isFillerDataNal(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
+// Hand a NAL chain to the decoder. If this returns false, the decode unit
+// queue overflowed and the NAL chain has been freed. The caller must then
+// drop the frame state and request an IDR frame.
+static bool submitNalChain(PLENTRY chainHead, int chainLength, int frameNumber, bool partialFrame) {
+    QUEUED_DECODE_UNIT qduDS;
+    PQUEUED_DECODE_UNIT qdu;
 
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
+    // Use a stack allocation if we won't be queuing this
+    if ((VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
+        qdu = (PQUEUED_DECODE_UNIT)malloc(sizeof(*qdu));
+    }
+    else {
+        qdu = &qduDS;
     }
 
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_FILLER;
+    if (qdu == NULL) {
+        freeNalChain(chainHead);
+        return false;
     }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_FILLER;
+
+    qdu->decodeUnit.bufferList = chainHead;
+    qdu->decodeUnit.fullLength = chainLength;
+    qdu->decodeUnit.frameType = frameType;
+    qdu->decodeUnit.frameNumber = frameNumber;
+    qdu->decodeUnit.frameHostProcessingLatency = frameHostProcessingLatency;
+    qdu->decodeUnit.receiveTimeUs = firstPacketReceiveTimeUs;
+    qdu->decodeUnit.receiveDelayUs = firstPacketReceiveDelayUs;
+    qdu->decodeUnit.presentationTimeUs = firstPacketPresentationTime;
+    qdu->decodeUnit.rtpTimestamp = firstPacketRtpTimestamp;
+    qdu->decodeUnit.enqueueTimeUs = PltGetMicroseconds();
+    qdu->decodeUnit.partialFrame = partialFrame;
+    qdu->decodeUnit.framesSkippedForLatency = framesSkippedForLatency;
+
+    // These might be wrong for a few frames during a transition between SDR and HDR,
+    // but the effects shouldn't very noticable since that's an infrequent operation.
+    //
+    // If we start sending this state in the frame header, we can make it 100% accurate.
+    qdu->decodeUnit.hdrActive = LiGetCurrentHostDisplayHdrMode();
+    qdu->decodeUnit.colorspace = (uint8_t)(qdu->decodeUnit.hdrActive ? COLORSPACE_REC_2020 : StreamConfig.colorSpace);
+
+    // Invoke the key frame callback if needed
+    if (chainHead->bufferType != BUFFER_TYPE_PICDATA || qdu->decodeUnit.frameType == FRAME_TYPE_IDR) {
+        // Partial submission is only done for P-frames
+        LC_ASSERT(!partialFrame);
+
+        qdu->decodeUnit.frameType = FRAME_TYPE_IDR;
+        notifyKeyFrameReceived();
     }
     else {
-        LC_ASSERT(false);
-        return false;
+        qdu->decodeUnit.frameType = FRAME_TYPE_PFRAME;
     }
-}
-#endif
 
-static bool isPictureParameterSetNal(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
+    if ((VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
+        if (LbqOfferQueueItem(&decodeUnitQueue, qdu, &qdu->entry) == LBQ_BOUND_EXCEEDED) {
+            Limelog("Video decode unit queue overflow\n");
 
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
-        return false;
-    }
+            // Free the DU we were going to queue
+            freeNalChain(qdu->decodeUnit.bufferList);
+            free(qdu);
+            return false;
+        }
 
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_PPS;
-    }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_PPS;
+        decodeUnitEnqueueTimesUs[decodeUnitsEnqueued++ % (DECODE_UNIT_QUEUE_BOUND + 1)] = qdu->decodeUnit.enqueueTimeUs;
     }
     else {
-        LC_ASSERT(false);
-        return false;
+        // Submit the frame to the decoder
+        validateDecodeUnitForPlayback(&qdu->decodeUnit);
+        LiCompleteVideoFrame(qdu, VideoCallbacks.submitDecodeUnit(&qdu->decodeUnit));
     }
-}
 
-// Advance the buffer descriptor to the start of the next NAL or end of buffer
-static void skipToNextNalOrEnd(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
+    // The skipped frames have been reported with this one
+    framesSkippedForLatency = 0;
 
-    // If we're starting on a NAL boundary, skip to the next one
-    if (getAnnexBStartSequence(buffer, &startSeq)) {
-        buffer->offset += startSeq.length;
-        buffer->length -= startSeq.length;
-    }
+    return true;
+}
 
-    // Loop until we find an Annex B start sequence (3 or 4 byte)
-    while (!getAnnexBStartSequence(buffer, NULL)) {
-        if (buffer->length == 0) {
-            // Reached the end of the buffer
-            return;
-        }
+// Returns the enqueue time of the oldest decode unit still waiting for the decoder,
+// or 0 if the queue is empty. If the decoder takes one while we look, we may get the
+// one it just took instead, which is close enough for our purposes.
+static uint64_t getOldestQueuedDecodeUnitTimeUs(void) {
+    unsigned int queuedCount = (unsigned int)LbqGetItemCount(&decodeUnitQueue);
 
-        buffer->offset++;
-        buffer->length--;
+    if (queuedCount == 0) {
+        return 0;
     }
+
+    LC_ASSERT(queuedCount <= DECODE_UNIT_QUEUE_BOUND);
+    return decodeUnitEnqueueTimesUs[(decodeUnitsEnqueued - queuedCount) % (DECODE_UNIT_QUEUE_BOUND + 1)];
 }
 
-// Advance the buffer descriptor to the start of the next NAL
-static void skipToNextNal(PBUFFER_DESC buffer) {
-    skipToNextNalOrEnd(buffer);
+// Keeps decode units from waiting longer than the latency budget. If the decoder has
+// fallen behind, a frame that nothing references is simply not submitted. Otherwise,
+// this frame is dropped and the host is asked to invalidate it, which also drops the
+// frames until the host's recovery frame arrives. This catches up well before the
+// queue overflows and a full IDR frame is needed. Returns true if the frame was dropped.
+static bool dropFrameForLatency(PLENTRY chainHead, int frameNumber) {
+    uint64_t oldestQueuedTimeUs;
+    uint64_t queueDelayUs;
 
-    // If we skipped all the data, something has gone horribly wrong
-    LC_ASSERT(buffer->length > 0);
-}
+    if (StreamConfig.decodeLatencyBudgetMs <= 0 || (VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT)) {
+        return false;
+    }
 
-static bool isIdrFrameStart(PBUFFER_DESC buffer) {
-    BUFFER_DESC startSeq;
+    // Frames that start the decoder over and the rest of a frame the decoder
+    // already has part of must always be submitted.
+    if (frameType == FRAME_TYPE_IDR || chainHead->bufferType != BUFFER_TYPE_PICDATA || partialFrameSubmitted) {
+        return false;
+    }
 
-    if (!getAnnexBStartSequence(buffer, &startSeq)) {
+    oldestQueuedTimeUs = getOldestQueuedDecodeUnitTimeUs();
+    if (oldestQueuedTimeUs == 0) {
         return false;
     }
 
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        return H264_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == H264_NAL_TYPE_SPS;
+    queueDelayUs = PltGetMicroseconds() - oldestQueuedTimeUs;
+    if (queueDelayUs <= (uint64_t)StreamConfig.decodeLatencyBudgetMs * 1000) {
+        return false;
     }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        return HEVC_NAL_TYPE(startSeq.data[startSeq.offset + startSeq.length]) == HEVC_NAL_TYPE_VPS;
+
+    if (frameDiscardable) {
+        framesSkippedForLatency++;
+        freeNalChain(chainHead);
+
+        // Nothing references this frame, so the stream continues just as if it had been decoded
+        connectionReceivedCompleteFrame(frameNumber);
+        consecutiveFrameDrops = 0;
+        startFrameNumber = nextFrameNumber;
+        return true;
     }
-    else {
-        LC_ASSERT(false);
+
+    // Reference frames can only be dropped if the host can recover with RFI. We don't
+    // request another invalidation until everything that was queued when we requested
+    // the last one has been decoded, since the host's recovery frame is stuck behind it.
+    if (strictIdrFrameWait || !idrFrameProcessed || waitingForIdrFrame ||
+            latencyRecoveryPending || oldestQueuedTimeUs <= lastLatencyRfiTimeUs) {
         return false;
     }
+
+    Limelog("Decode queue delay of %u ms exceeds latency budget. Invalidating frame %d\n",
+            (uint32_t)(queueDelayUs / 1000), frameNumber);
+
+    framesSkippedForLatency++;
+    freeNalChain(chainHead);
+    dropFrameState(false);
+
+    // The consecutive drop limit may have forced an IDR frame already
+    if (!waitingForIdrFrame) {
+        latencyRecoveryPending = true;
+        lastLatencyRfiTimeUs = PltGetMicroseconds();
+        connectionDetectedFrameLoss(startFrameNumber, frameNumber);
+    }
+
+    return true;
 }
 
 // Reassemble the frame with the given frame number
 static void reassembleFrame(int frameNumber) {
     if (nalChainHead != NULL) {
-        QUEUED_DECODE_UNIT qduDS;
-        PQUEUED_DECODE_UNIT qdu;
+        PLENTRY chainHead = nalChainHead;
+        int chainLength = nalChainDataLength;
 
-        // Use a stack allocation if we won't be queuing this
-        if ((VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
-            qdu = (PQUEUED_DECODE_UNIT)malloc(sizeof(*qdu));
-        }
-        else {
-            qdu = &qduDS;
+        nalChainHead = nalChainTail = nalChainScanTail = NULL;
+        nalChainDataLength = 0;
+
+        if (dropFrameForLatency(chainHead, frameNumber)) {
+            return;
         }
 
-        if (qdu != NULL) {
-            qdu->decodeUnit.bufferList = nalChainHead;
-            qdu->decodeUnit.fullLength = nalChainDataLength;
-            qdu->decodeUnit.frameType = frameType;
-            qdu->decodeUnit.frameNumber = frameNumber;
-            qdu->decodeUnit.frameHostProcessingLatency = frameHostProcessingLatency;
-            qdu->decodeUnit.receiveTimeUs = firstPacketReceiveTimeUs;
-            qdu->decodeUnit.presentationTimeUs = firstPacketPresentationTime;
-            qdu->decodeUnit.rtpTimestamp = firstPacketRtpTimestamp;
-            qdu->decodeUnit.enqueueTimeUs = PltGetMicroseconds();
-
-            // These might be wrong for a few frames during a transition between SDR and HDR,
-            // but the effects shouldn't very noticable since that's an infrequent operation.
-            //
-            // If we start sending this state in the frame header, we can make it 100% accurate.
-            qdu->decodeUnit.hdrActive = LiGetCurrentHostDisplayHdrMode();
-            qdu->decodeUnit.colorspace = (uint8_t)(qdu->decodeUnit.hdrActive ? COLORSPACE_REC_2020 : StreamConfig.colorSpace);
-
-            // Invoke the key frame callback if needed
-            if (nalChainHead->bufferType != BUFFER_TYPE_PICDATA || qdu->decodeUnit.frameType == FRAME_TYPE_IDR) {
-                qdu->decodeUnit.frameType = FRAME_TYPE_IDR;
-                notifyKeyFrameReceived();
-            }
-            else {
-                qdu->decodeUnit.frameType = FRAME_TYPE_PFRAME;
-            }
+        if (!submitNalChain(chainHead, chainLength, frameNumber, false)) {
+            // RFI recovery is not supported here
+            waitingForIdrFrame = true;
 
-            nalChainHead = nalChainTail = NULL;
-            nalChainDataLength = 0;
+            // Clear NAL state for the frame that we failed to enqueue
+            // and request an IDR frame to recover
+            dropFrameState(true);
 
-            if ((VideoCallbacks.capabilities & CAPABILITY_DIRECT_SUBMIT) == 0) {
-                if (LbqOfferQueueItem(&decodeUnitQueue, qdu, &qdu->entry) == LBQ_BOUND_EXCEEDED) {
-                    Limelog("Video decode unit queue overflow\n");
+            // Free all frames in the decode unit queue
+            freeDecodeUnitList(LbqFlushQueueItems(&decodeUnitQueue));
+            return;
+        }
 
-                    // RFI recovery is not supported here
-                    waitingForIdrFrame = true;
+        // The decoder has the whole frame now
+        partialFrameSubmitted = false;
+        latencyRecoveryPending = false;
 
-                    // Clear NAL state for the frame that we failed to enqueue
-                    nalChainHead = qdu->decodeUnit.bufferList;
-                    nalChainDataLength = qdu->decodeUnit.fullLength;
-                    dropFrameState();
+        // Notify the control connection
+        connectionReceivedCompleteFrame(frameNumber);
 
-                    // Free the DU we were going to queue
-                    free(qdu);
+        // Clear frame drops
+        consecutiveFrameDrops = 0;
 
-                    // Free all frames in the decode unit queue
-                    freeDecodeUnitList(LbqFlushQueueItems(&decodeUnitQueue));
+        // Move the start of our (potential) RFI window to the next frame
+        startFrameNumber = nextFrameNumber;
+    }
+}
 
-                    // Request an IDR frame to recover
-                    LiRequestIdrFrame();
-                    return;
-                }
-            }
-            else {
-                // Submit the frame to the decoder
-                validateDecodeUnitForPlayback(&qdu->decodeUnit);
-                LiCompleteVideoFrame(qdu, VideoCallbacks.submitDecodeUnit(&qdu->decodeUnit));
-            }
+static int getBufferFlagsForNalClass(int nalClass) {
+    switch (nalClass) {
+    case NAL_CLASS_SPS:
+        return BUFFER_TYPE_SPS;
 
-            // Notify the control connection
-            connectionReceivedCompleteFrame(frameNumber);
+    case NAL_CLASS_PPS:
+        return BUFFER_TYPE_PPS;
 
-            // Clear frame drops
-            consecutiveFrameDrops = 0;
+    case NAL_CLASS_VPS:
+        return BUFFER_TYPE_VPS;
 
-            // Move the start of our (potential) RFI window to the next frame
-            startFrameNumber = nextFrameNumber;
-        }
+    default:
+        return BUFFER_TYPE_PICDATA;
     }
 }
 
 static int getBufferFlags(char* data, int length) {
     BUFFER_DESC buffer;
-    BUFFER_DESC candidate;
 
     // We only parse H.264 and HEVC bitstreams
     if (!(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265))) {
@@ -563,46 +649,13 @@ static int getBufferFlags(char* data, int length) {
     buffer.length = (unsigned int)length;
     buffer.offset = 0;
 
-    if (!getAnnexBStartSequence(&buffer, &candidate)) {
-        return BUFFER_TYPE_PICDATA;
-    }
-
-    if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H264) {
-        switch (H264_NAL_TYPE(candidate.data[candidate.offset + candidate.length])) {
-        case H264_NAL_TYPE_SPS:
-            return BUFFER_TYPE_SPS;
-
-        case H264_NAL_TYPE_PPS:
-            return BUFFER_TYPE_PPS;
-
-        default:
-            return BUFFER_TYPE_PICDATA;
-        }
-    }
-    else if (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) {
-        switch (HEVC_NAL_TYPE(candidate.data[candidate.offset + candidate.length])) {
-            case HEVC_NAL_TYPE_SPS:
-                return BUFFER_TYPE_SPS;
-
-            case HEVC_NAL_TYPE_PPS:
-                return BUFFER_TYPE_PPS;
-
-            case HEVC_NAL_TYPE_VPS:
-                return BUFFER_TYPE_VPS;
-
-            default:
-                return BUFFER_TYPE_PICDATA;
-        }
-    }
-    else {
-        LC_ASSERT(false);
-        return BUFFER_TYPE_PICDATA;
-    }
+    return getBufferFlagsForNalClass(getNalClass(&buffer));
 }
 
 // As an optimization, we can cast the existing packet buffer to a PLENTRY and avoid
-// a malloc() and a memcpy() of the packet data.
-static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offset, int length) {
+// a malloc() and a memcpy() of the packet data. The caller passes the buffer type
+// since it has usually classified the NALU already.
+static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offset, int length, int bufferType) {
     PLENTRY_INTERNAL entry;
 
     if (existingEntry == NULL || *existingEntry == NULL) {
@@ -634,7 +687,7 @@ static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offse
             *existingEntry = NULL;
         }
 
-        entry->entry.bufferType = getBufferFlags(entry->entry.data, entry->entry.length);
+        entry->entry.bufferType = bufferType;
 
         nalChainDataLength += entry->entry.length;
 
@@ -650,39 +703,40 @@ static void queueFragment(PLENTRY_INTERNAL* existingEntry, char* data, int offse
     }
 }
 
-// Process an RTP Payload using the slow path that handles multiple NALUs per packet
-static void processAvcHevcRtpPayloadSlow(PBUFFER_DESC currentPos, PLENTRY_INTERNAL* existingEntry) {
+// Process an RTP Payload using the slow path that handles multiple NALUs per packet.
+// The scan covers the rest of the packet and nalIndex is the NALU we're currently at.
+static void processAvcHevcRtpPayloadSlow(PBUFFER_DESC currentPos, PANNEXB_NAL_SCAN scan, unsigned int nalIndex, PLENTRY_INTERNAL* existingEntry) {
     // We should not have any NALUs when processing the first packet in an IDR frame
     LC_ASSERT(nalChainHead == NULL);
     LC_ASSERT(nalChainTail == NULL);
 
-    while (currentPos->length != 0) {
-        // Skip through any padding bytes
-        if (!getAnnexBStartSequence(currentPos, NULL)) {
-            skipToNextNal(currentPos);
-        }
+    // Padding bytes between NALUs are never part of a scanned NALU, so they're skipped too
+    for (; nalIndex < scan->count; nextScannedNal(scan, &nalIndex, currentPos->data)) {
+        PANNEXB_NAL nal = &scan->nals[nalIndex];
+        unsigned int start = nal->offset;
+        unsigned int length = nal->length;
+        bool containsPicData = false;
 
         // Skip any prepended AUD or SEI NALUs. We may have padding between
         // these on IDR frames, so the check in processRtpPayload() is not
         // completely sufficient to handle that case.
-        while (isAccessUnitDelimiter(currentPos) || isSeiNal(currentPos)) {
-            skipToNextNal(currentPos);
+        if (nal->nalClass == NAL_CLASS_AUD || nal->nalClass == NAL_CLASS_SEI) {
+            continue;
         }
 
-        int start = currentPos->offset;
-        bool containsPicData = false;
-
 #ifdef FORCE_3_BYTE_START_SEQUENCES
         start++;
+        length--;
 #endif
 
-        if (isSeqReferenceFrameStart(currentPos)) {
+        if (nal->nalClass == NAL_CLASS_REFERENCE_SLICE) {
             // No longer waiting for an IDR frame
             waitingForIdrFrame = false;
             waitingForRefInvalFrame = false;
 
             // Cancel any pending IDR frame request
             waitingForNextSuccessfulFrame = false;
+            connectionReceivedRecoveryFrame(true);
 
             // Use the cached LENTRY for this NALU since it will be
             // the bulk of the data in this packet.
@@ -690,26 +744,33 @@ static void processAvcHevcRtpPayloadSlow(PBUFFER_DESC currentPos, PLENTRY_INTERN
 
             // This is an IDR frame
             frameType = FRAME_TYPE_IDR;
-        }
 
-        // Move to the next NALU
-        skipToNextNalOrEnd(currentPos);
+#ifdef LC_DEBUG
+            BUFFER_DESC picData;
 
-        // If this is the picture data, we expect it to extend to the end of the packet
-        if (containsPicData) {
-            while (currentPos->length != 0) {
+            picData.data = currentPos->data;
+            picData.offset = nal->offset;
+            picData.length = nal->length;
+            skipToNextNalOrEnd(&picData);
+            while (picData.length != 0) {
                 // Any NALUs we encounter on the way to the end of the packet must be
                 // reference frame slices or filler data.
-                LC_ASSERT_VT(isSeqReferenceFrameStart(currentPos) || isFillerDataNal(currentPos));
-                skipToNextNalOrEnd(currentPos);
+                LC_ASSERT_VT(getNalClass(&picData) == NAL_CLASS_REFERENCE_SLICE || getNalClass(&picData) == NAL_CLASS_FILLER);
+                skipToNextNalOrEnd(&picData);
             }
+#endif
         }
 
+        // The scan stops at the picture data, so it extends to the end of the packet.
+        //
         // To minimize copies, we'll allocate for SPS, PPS, and VPS to allow
         // us to reuse the packet buffer for the picture data in the I-frame.
         queueFragment(containsPicData ? existingEntry : NULL,
-                      currentPos->data, start, currentPos->offset - start);
+                      currentPos->data, start, length, getBufferFlagsForNalClass(nal->nalClass));
     }
+
+    currentPos->offset += currentPos->length;
+    currentPos->length = 0;
 }
 
 // Dumps the decode unit queue and ensures the next frame submitted to the decoder will be
@@ -743,13 +804,16 @@ static bool isFirstPacket(uint8_t flags, uint8_t fecBlockNumber) {
 // Process an RTP Payload
 // The caller will free *existingEntry unless we NULL it
 static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
-                       uint64_t receiveTimeUs, uint64_t presentationTimeUs, uint32_t rtpTimestamp,
+                       uint64_t receiveTimeUs, uint32_t receiveDelayUs,
+                       uint64_t presentationTimeUs, uint32_t rtpTimestamp,
                        PLENTRY_INTERNAL* existingEntry) {
     BUFFER_DESC currentPos;
     uint32_t frameIndex;
     uint8_t flags;
     bool firstPacket, lastPacket;
     uint32_t streamPacketIndex;
+    ANNEXB_NAL_SCAN nalScan;
+    unsigned int nalIndex = 0;
     uint8_t fecCurrentBlockNumber;
     uint8_t fecLastBlockNumber;
 
@@ -761,6 +825,10 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
     currentPos.offset = 0;
     currentPos.length = length - sizeof(*videoPacket);
 
+    // Only the first packet of a frame gets its NALUs scanned
+    nalScan.count = 0;
+    nalScan.truncated = false;
+
     fecCurrentBlockNumber = (videoPacket->multiFecBlocks >> 4) & 0x3;
     fecLastBlockNumber = (videoPacket->multiFecBlocks >> 6) & 0x3;
     frameIndex = videoPacket->frameIndex;
@@ -785,11 +853,8 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
         Limelog("Depacketizer detected corrupt frame: %d", frameIndex);
         decodingFrame = false;
         nextFrameNumber = frameIndex + 1;
-        dropFrameState();
-        if (waitingForIdrFrame) {
-            LiRequestIdrFrame();
-        }
-        else {
+        dropFrameState(true);
+        if (!waitingForIdrFrame) {
             connectionDetectedFrameLoss(startFrameNumber, frameIndex);
         }
         return;
@@ -817,7 +882,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
 
             // Wait until next complete frame
             waitingForNextSuccessfulFrame = true;
-            dropFrameState();
+            dropFrameState(false);
         }
         else {
             LC_ASSERT(nextFrameNumber == frameIndex);
@@ -826,7 +891,9 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
         // We're now decoding a frame
         decodingFrame = true;
         frameType = FRAME_TYPE_PFRAME;
+        frameDiscardable = false;
         firstPacketReceiveTimeUs = receiveTimeUs;
+        firstPacketReceiveDelayUs = receiveDelayUs;
 
         // Some versions of Sunshine don't send a valid PTS, so we will
         // synthesize one using the receive time as the time base.
@@ -863,6 +930,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
                     waitingForIdrFrame = false;
                     waitingForNextSuccessfulFrame = false;
                     frameType = FRAME_TYPE_IDR;
+                    connectionReceivedRecoveryFrame(true);
                 }
                 // Fall-through
             case 4: // Intra-refresh
@@ -873,6 +941,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
                             currentPos.data[currentPos.offset + 3] == 5 ? "P" : "I");
                     waitingForRefInvalFrame = false;
                     waitingForNextSuccessfulFrame = false;
+                    connectionReceivedRecoveryFrame(false);
                 }
                 break;
             case 104: // Sunshine hardcoded header
@@ -971,28 +1040,33 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
 
         // We only parse H.264 and HEVC at the NALU level
         if (NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265)) {
+            // Find and classify the NALUs ahead of the picture data in one pass.
+            // Everything below works from this scan rather than the bitstream.
+            AnnexBScanNals(&nalScan, currentPos.data, currentPos.offset, currentPos.length,
+                           (NegotiatedVideoFormat & VIDEO_FORMAT_MASK_H265) != 0);
+
             // The Annex B NALU start prefix must be next
-            if (!getAnnexBStartSequence(&currentPos, NULL)) {
+            if (nalScan.count == 0 || nalScan.nals[0].offset != currentPos.offset) {
                 // If we aren't starting on a start prefix, something went wrong.
+                // For release builds, we will try to recover by using the first
+                // one we found. This mimics the way most decoders handle this situation.
                 LC_ASSERT_VT(false);
-
-                // For release builds, we will try to recover by searching for one.
-                // This mimics the way most decoders handle this situation.
-                skipToNextNal(&currentPos);
             }
 
             // If an AUD NAL is prepended to this frame data, remove it.
             // Other parts of this code are not prepared to deal with a
             // NAL of that type, so stripping it is the easiest option.
-            if (isAccessUnitDelimiter(&currentPos)) {
-                skipToNextNal(&currentPos);
+            if (getScannedNalClass(&nalScan, nalIndex) == NAL_CLASS_AUD) {
+                nextScannedNal(&nalScan, &nalIndex, currentPos.data);
             }
 
             // There may be one or more SEI NAL units prepended to the
             // frame data *after* the (optional) AUD.
-            while (isSeiNal(&currentPos)) {
-                skipToNextNal(&currentPos);
+            while (getScannedNalClass(&nalScan, nalIndex) == NAL_CLASS_SEI) {
+                nextScannedNal(&nalScan, &nalIndex, currentPos.data);
             }
+
+            seekToScannedNal(&currentPos, &nalScan, nalIndex);
         }
     }
     else {
@@ -1001,15 +1075,27 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
     }
 
     if (NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265)) {
-        if (firstPacket && isIdrFrameStart(&currentPos)) {
+        if (firstPacket && isIdrFrameStart(getScannedNalClass(&nalScan, nalIndex))) {
             // SPS and PPS prefix is padded between NALs, so we must decode it with the slow path
-            processAvcHevcRtpPayloadSlow(&currentPos, existingEntry);
+            processAvcHevcRtpPayloadSlow(&currentPos, &nalScan, nalIndex, existingEntry);
         }
         else {
-            // Intel's H.264 Media Foundation encoder prepends a PPS to each P-frame.
-            // Skip it to avoid confusing clients.
-            if (firstPacket && isPictureParameterSetNal(&currentPos)) {
-                skipToNextNal(&currentPos);
+            int bufferType;
+
+            if (firstPacket) {
+                // Intel's H.264 Media Foundation encoder prepends a PPS to each P-frame.
+                // Skip it to avoid confusing clients.
+                if (getScannedNalClass(&nalScan, nalIndex) == NAL_CLASS_PPS) {
+                    nextScannedNal(&nalScan, &nalIndex, currentPos.data);
+                    seekToScannedNal(&currentPos, &nalScan, nalIndex);
+                }
+
+                bufferType = getBufferFlagsForNalClass(getScannedNalClass(&nalScan, nalIndex));
+                frameDiscardable = isScannedNalDiscardable(&nalScan, nalIndex, currentPos.data);
+            }
+            else {
+                // Later packets only begin with a NALU if it happens to line up with the packet
+                bufferType = getBufferFlags(&currentPos.data[currentPos.offset], (int)currentPos.length);
             }
 
 #ifdef FORCE_3_BYTE_START_SEQUENCES
@@ -1019,7 +1105,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
             }
 #endif
 
-            queueFragment(existingEntry, currentPos.data, currentPos.offset, currentPos.length);
+            queueFragment(existingEntry, currentPos.data, currentPos.offset, currentPos.length, bufferType);
         }
     }
     else {
@@ -1050,11 +1136,8 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
                 // Skip to the next frame and tell the host we lost this one
                 decodingFrame = false;
                 nextFrameNumber = frameIndex + 1;
-                dropFrameState();
-                if (waitingForIdrFrame) {
-                    LiRequestIdrFrame();
-                }
-                else {
+                dropFrameState(true);
+                if (!waitingForIdrFrame) {
                     connectionDetectedFrameLoss(startFrameNumber, frameIndex);
                 }
 
@@ -1063,7 +1146,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
         }
 
         // Other codecs are just passed through as is.
-        queueFragment(existingEntry, currentPos.data, currentPos.offset, currentPos.length);
+        queueFragment(existingEntry, currentPos.data, currentPos.offset, currentPos.length, BUFFER_TYPE_PICDATA);
     }
 
     if (lastPacket) {
@@ -1089,11 +1172,17 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
                 // If we need an RFI frame first, then drop this frame
                 // and update the reference frame invalidation window.
                 Limelog("Waiting for RFI frame\n");
+
+                // Frames dropped while recovering from an invalidation we asked for
+                // to bound the decode latency are skipped for latency too.
+                if (latencyRecoveryPending) {
+                    framesSkippedForLatency++;
+                }
                 connectionDetectedFrameLoss(startFrameNumber, frameIndex);
             }
 
             waitingForNextSuccessfulFrame = false;
-            dropFrameState();
+            dropFrameState(false);
             return;
         }
 
@@ -1114,7 +1203,7 @@ static void processRtpPayload(PNV_VIDEO_PACKET videoPacket, int length,
                 dropStatePending = false;
             }
             else {
-                dropFrameState();
+                dropFrameState(false);
                 return;
             }
         }
@@ -1131,8 +1220,16 @@ void notifyFrameLost(unsigned int frameNumber, bool speculative) {
     // We may not invalidate frames that we've already received
     LC_ASSERT(frameNumber >= startFrameNumber);
 
+    // We're in the middle of a frame here if the RTP queue gave us some of
+    // its FEC blocks before losing a later one. Abandon the rest of that frame.
+    // dropFrameState() needs an IDR frame only if we submitted part of it.
+    if (decodingFrame) {
+        decodingFrame = false;
+        nextFrameNumber = frameNumber + 1;
+    }
+
     // Drop state and determine if we need an IDR frame or if RFI is okay
-    dropFrameState();
+    dropFrameState(false);
 
     // If dropFrameState() determined that RFI was usable, issue it now
     if (!waitingForIdrFrame) {
@@ -1179,6 +1276,7 @@ void queueRtpPacket(PRTPV_QUEUE_ENTRY queueEntryPtr) {
     processRtpPayload((PNV_VIDEO_PACKET)(((char*)queueEntry.packet) + dataOffset),
                       queueEntry.length - dataOffset,
                       queueEntry.receiveTimeUs,
+                      queueEntry.receiveDelayUs,
                       queueEntry.presentationTimeUs,
                       queueEntry.rtpTimestamp,
                       &existingEntry);
@@ -1189,6 +1287,117 @@ void queueRtpPacket(PRTPV_QUEUE_ENTRY queueEntryPtr) {
     }
 }
 
+// Called by the video RTP FEC queue after it has queued the packets of a complete
+// FEC block that isn't the last one in the frame. If the renderer supports it, we
+// submit the complete slice NALUs received so far, so decoding can overlap with
+// the rest of the frame arriving.
+void submitPartialFrame(void) {
+    PLENTRY entry;
+    PLENTRY prevEntry;
+    PLENTRY boundaryEntry;
+    unsigned int boundaryOffset;
+    int releaseLength;
+
+    if (!(VideoCallbacks.capabilities & CAPABILITY_SUBFRAME_SUBMIT) ||
+            !(NegotiatedVideoFormat & (VIDEO_FORMAT_MASK_H264 | VIDEO_FORMAT_MASK_H265))) {
+        return;
+    }
+
+    // Only P-frames that will actually be submitted are eligible. IDR frames
+    // and frames received during loss recovery always use the whole frame path.
+    if (!decodingFrame || nalChainHead == NULL || frameType != FRAME_TYPE_PFRAME ||
+            nalChainHead->bufferType != BUFFER_TYPE_PICDATA ||
+            waitingForIdrFrame || waitingForRefInvalFrame || dropStatePending) {
+        return;
+    }
+
+    // Find the last NAL start sequence in the data we haven't scanned yet. Everything
+    // before it belongs to complete NALUs. We don't look for start sequences that span
+    // packet boundaries, so we may occasionally release less data than possible.
+    boundaryEntry = NULL;
+    boundaryOffset = 0;
+    for (entry = (nalChainScanTail != NULL) ? nalChainScanTail->next : nalChainHead; entry != NULL; entry = entry->next) {
+        unsigned int offset = 0;
+        unsigned int startSeqLength;
+
+        for (;;) {
+            offset += AnnexBFindStartSequence(&entry->data[offset], (unsigned int)entry->length - offset, &startSeqLength);
+            if (offset == (unsigned int)entry->length) {
+                break;
+            }
+
+            boundaryEntry = entry;
+            boundaryOffset = offset;
+            offset += startSeqLength;
+        }
+
+        nalChainScanTail = entry;
+    }
+
+    // Nothing to do unless we found a NALU that starts after the head of the chain
+    if (boundaryEntry == NULL || (boundaryEntry == nalChainHead && boundaryOffset == 0)) {
+        return;
+    }
+
+    // Find the entry preceding the boundary and total up the data before it
+    prevEntry = NULL;
+    releaseLength = 0;
+    for (entry = nalChainHead; entry != boundaryEntry; entry = entry->next) {
+        releaseLength += entry->length;
+        prevEntry = entry;
+    }
+
+    PLENTRY releaseHead = nalChainHead;
+    if (boundaryOffset != 0) {
+        // The boundary is inside this packet, so copy out the end of the previous NALU.
+        // The original entry can't be shared since each entry owns its allocation.
+        PLENTRY_INTERNAL splitEntry = (PLENTRY_INTERNAL)malloc(sizeof(*splitEntry) + boundaryOffset);
+        if (splitEntry == NULL) {
+            return;
+        }
+
+        splitEntry->allocPtr = splitEntry;
+        splitEntry->entry.next = NULL;
+        splitEntry->entry.length = (int)boundaryOffset;
+        splitEntry->entry.data = (char*)(splitEntry + 1);
+        memcpy(splitEntry->entry.data, boundaryEntry->data, boundaryOffset);
+        splitEntry->entry.bufferType = getBufferFlags(splitEntry->entry.data, splitEntry->entry.length);
+
+        boundaryEntry->data += boundaryOffset;
+        boundaryEntry->length -= (int)boundaryOffset;
+        boundaryEntry->bufferType = getBufferFlags(boundaryEntry->data, boundaryEntry->length);
+
+        if (prevEntry == NULL) {
+            releaseHead = (PLENTRY)splitEntry;
+        }
+        else {
+            prevEntry->next = (PLENTRY)splitEntry;
+        }
+
+        releaseLength += (int)boundaryOffset;
+    }
+    else {
+        // The boundary is at the start of a packet, so we can just split the chain
+        LC_ASSERT(prevEntry != NULL);
+        prevEntry->next = NULL;
+    }
+
+    nalChainHead = boundaryEntry;
+    nalChainDataLength -= releaseLength;
+
+    if (!submitNalChain(releaseHead, releaseLength, nextFrameNumber, true)) {
+        // Abandon the rest of this frame and start over with an IDR frame
+        decodingFrame = false;
+        nextFrameNumber++;
+        waitingForIdrFrame = true;
+        dropFrameState(true);
+        freeDecodeUnitList(LbqFlushQueueItems(&decodeUnitQueue));
+        return;
+    }
+
+    partialFrameSubmitted = true;
+}
+
 int LiGetPendingVideoFrames(void) {
     return LbqGetItemCount(&decodeUnitQueue);
 }
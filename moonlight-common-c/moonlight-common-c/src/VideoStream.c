@@ -12,6 +12,8 @@ static SOCKET firstFrameSocket = INVALID_SOCKET;
 
 static PPLT_CRYPTO_CONTEXT decryptionCtx;
 
+static NETWORK_IMPAIRMENT_STATE networkImpairment;
+
 static PLT_THREAD udpPingThread;
 static PLT_THREAD receiveThread;
 static PLT_THREAD decoderThread;
@@ -39,6 +41,8 @@ void initializeVideoStream(void) {
     initializeVideoDepacketizer(StreamConfig.packetSize);
     RtpvInitializeQueue(&rtpQueue);
     decryptionCtx = PltCreateCryptoContext();
+    NiInitialize(&networkImpairment, &StreamConfig.networkImpairment, NI_STREAM_VIDEO);
+    NiLogConfiguration(&networkImpairment, "Video");
     receivedDataFromPeer = false;
     firstDataTimeMs = 0;
     receivedFullFrame = false;
@@ -49,6 +53,7 @@ void destroyVideoStream(void) {
     PltDestroyCryptoContext(decryptionCtx);
     destroyVideoDepacketizer();
     RtpvCleanupQueue(&rtpQueue);
+    NiCleanup(&networkImpairment);
 }
 
 // UDP Ping proc
@@ -91,6 +96,8 @@ static void VideoReceiveThreadProc(void* context) {
     bool useSelect;
     int waitingForVideoMs;
     bool encrypted;
+    uint64_t kernelReceiveTimeUs;
+    uint64_t receiveTimeUs;
 
     encrypted = !!(EncryptionFeaturesEnabled & SS_ENC_VIDEO);
     decryptedSize = StreamConfig.packetSize + MAX_RTP_HEADER_SIZE;
@@ -122,6 +129,7 @@ static void VideoReceiveThreadProc(void* context) {
     }
 
     waitingForVideoMs = 0;
+    kernelReceiveTimeUs = 0;
     while (!PltIsThreadInterrupted(&receiveThread)) {
         PRTP_PACKET packet;
 
@@ -134,10 +142,21 @@ static void VideoReceiveThreadProc(void* context) {
             }
         }
 
-        err = recvUdpSocket(rtpSocket,
-                            encrypted ? encryptedBuffer : buffer,
-                            receiveSize,
-                            useSelect);
+        if (NiIsEnabled(&networkImpairment)) {
+            err = NiRecvUdpSocket(&networkImpairment,
+                                  rtpSocket,
+                                  encrypted ? encryptedBuffer : buffer,
+                                  receiveSize,
+                                  useSelect,
+                                  RtpSocketOptions.videoKernelTimestamps ? &kernelReceiveTimeUs : NULL);
+        }
+        else {
+            err = recvUdpSocketWithTimestamp(rtpSocket,
+                                             encrypted ? encryptedBuffer : buffer,
+                                             receiveSize,
+                                             useSelect,
+                                             RtpSocketOptions.videoKernelTimestamps ? &kernelReceiveTimeUs : NULL);
+        }
         if (err < 0) {
             Limelog("Video Receive: recvUdpSocket() failed: %d\n", (int)LastSocketError());
             ListenerCallbacks.connectionTerminated(LastSocketFail());
@@ -159,6 +178,10 @@ static void VideoReceiveThreadProc(void* context) {
             continue;
         }
 
+        // Sample the time before decryption, so the time we spend decrypting
+        // isn't counted against the network.
+        receiveTimeUs = PltGetMicroseconds();
+
         if (!receivedDataFromPeer) {
             receivedDataFromPeer = true;
             Limelog("Received first video packet after %d ms\n", waitingForVideoMs);
@@ -227,6 +250,21 @@ static void VideoReceiveThreadProc(void* context) {
         packet->timestamp = BE32(packet->timestamp);
         packet->ssrc = BE32(packet->ssrc);
 
+        // If the kernel timestamped the packet, we can tell how long it waited in
+        // the socket buffer for us, which is our delay rather than the network's.
+        {
+            PRTPV_QUEUE_ENTRY entry = (PRTPV_QUEUE_ENTRY)&buffer[decryptedSize];
+
+            if (RtpSocketOptions.videoKernelTimestamps && kernelReceiveTimeUs != 0 && kernelReceiveTimeUs <= receiveTimeUs) {
+                entry->receiveTimeUs = kernelReceiveTimeUs;
+                entry->receiveDelayUs = (uint32_t)(receiveTimeUs - kernelReceiveTimeUs);
+            }
+            else {
+                entry->receiveTimeUs = receiveTimeUs;
+                entry->receiveDelayUs = 0;
+            }
+        }
+
         queueStatus = RtpvAddPacket(&rtpQueue, packet, err, (PRTPV_QUEUE_ENTRY)&buffer[decryptedSize]);
 
         if (queueStatus == RTPF_RET_QUEUED) {
@@ -315,6 +353,7 @@ void stopVideoStream(void) {
 
 // Start the video stream
 int startVideoStream(void* rendererContext, int drFlags) {
+    int bufferSize;
     int err;
 
     firstFrameSocket = INVALID_SOCKET;
@@ -328,14 +367,27 @@ int startVideoStream(void* rendererContext, int drFlags) {
         return err;
     }
 
-    rtpSocket = bindUdpSocket(RemoteAddr.ss_family, &LocalAddr, AddrLen,
-                              RTP_RECV_PACKETS_BUFFERED * (StreamConfig.packetSize + MAX_RTP_HEADER_SIZE),
-                              SOCK_QOS_TYPE_VIDEO);
+    bufferSize = RTP_RECV_PACKETS_BUFFERED * (StreamConfig.packetSize + MAX_RTP_HEADER_SIZE);
+    if (StreamConfig.rtpReceiveBufferSize > bufferSize) {
+        bufferSize = StreamConfig.rtpReceiveBufferSize;
+    }
+
+    rtpSocket = bindUdpSocket(RemoteAddr.ss_family, &LocalAddr, AddrLen, bufferSize, SOCK_QOS_TYPE_VIDEO);
     if (rtpSocket == INVALID_SOCKET) {
         VideoCallbacks.cleanup();
         return LastSocketError();
     }
 
+    setRtpSocketOptions(rtpSocket, StreamConfig.rtpReceiveBufferSize != 0 ? bufferSize : 0, StreamConfig.rtpBusyPollUs,
+                        &RtpSocketOptions.videoReceiveBufferSize, &RtpSocketOptions.videoBusyPollUs);
+
+    // Ask the kernel to timestamp incoming video packets, so we can tell network
+    // jitter apart from delays in scheduling our receive thread.
+    RtpSocketOptions.videoKernelTimestamps = enableKernelReceiveTimestamps(rtpSocket);
+    if (RtpSocketOptions.videoKernelTimestamps) {
+        Limelog("Using kernel receive timestamps for video\n");
+    }
+
     VideoCallbacks.start();
 
     err = PltCreateThread("VideoRecv", VideoReceiveThreadProc, NULL, &receiveThread);
@@ -417,3 +469,11 @@ int startVideoStream(void* rendererContext, int drFlags) {
 const RTP_VIDEO_STATS* LiGetRTPVideoStats(void) {
     return &rtpQueue.stats;
 }
+
+const NETWORK_IMPAIRMENT_STATS* LiGetVideoImpairmentStats(void) {
+    return &networkImpairment.stats;
+}
+
+const RTP_SOCKET_OPTIONS* LiGetRtpSocketOptions(void) {
+    return &RtpSocketOptions;
+}
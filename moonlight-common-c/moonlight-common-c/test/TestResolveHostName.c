@@ -0,0 +1,346 @@
+#include "Limelight-internal.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// Checks resolveHostName() and its connection racing against listeners on
+// the loopback interface. Each listener accepts only one address family, so
+// the race has to find the family that's actually listening.
+
+static int FailureCount;
+
+static void logMessage(const char* format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+static void fail(const char* testName, const char* message) {
+    printf("FAILED: %s: %s\n", testName, message);
+    FailureCount++;
+}
+
+static void makeLoopbackAddress(int family, unsigned short port, struct sockaddr_storage* addr, SOCKADDR_LEN* addrLen) {
+    memset(addr, 0, sizeof(*addr));
+    if (family == AF_INET) {
+        struct sockaddr_in* sin = (struct sockaddr_in*)addr;
+
+        sin->sin_family = AF_INET;
+        sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sin->sin_port = htons(port);
+        *addrLen = sizeof(*sin);
+    }
+    else {
+        struct sockaddr_in6* sin6 = (struct sockaddr_in6*)addr;
+
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_addr = in6addr_loopback;
+        sin6->sin6_port = htons(port);
+        *addrLen = sizeof(*sin6);
+    }
+}
+
+// Starts listening on the loopback address of the given family. If *port is 0,
+// an unused port is picked and returned. Returns INVALID_SOCKET if the family
+// isn't available on this system or the port is taken.
+static SOCKET startListener(int family, int backlog, unsigned short* port) {
+    struct sockaddr_storage addr;
+    SOCKADDR_LEN addrLen;
+    SOCKET s;
+
+    makeLoopbackAddress(family, *port, &addr, &addrLen);
+
+    s = createSocket(family, SOCK_STREAM, IPPROTO_TCP, false);
+    if (s == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+    if (family == AF_INET6) {
+        int val = 1;
+        setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, (char*)&val, sizeof(val));
+    }
+
+    if (bind(s, (struct sockaddr*)&addr, addrLen) == SOCKET_ERROR ||
+        listen(s, backlog) == SOCKET_ERROR ||
+        getsockname(s, (struct sockaddr*)&addr, &addrLen) == SOCKET_ERROR) {
+        closeSocket(s);
+        return INVALID_SOCKET;
+    }
+
+    *port = ntohs(family == AF_INET ?
+                  ((struct sockaddr_in*)&addr)->sin_port :
+                  ((struct sockaddr_in6*)&addr)->sin6_port);
+    return s;
+}
+
+// Starts a non-blocking connection and returns true if it's still
+// in progress after the timeout
+static bool isConnectionStalled(struct sockaddr_storage* addr, SOCKADDR_LEN addrLen, int timeoutMs, SOCKET* s) {
+    struct pollfd pfd;
+
+    *s = createSocket(addr->ss_family, SOCK_STREAM, IPPROTO_TCP, true);
+    if (*s == INVALID_SOCKET) {
+        return false;
+    }
+
+    if (connect(*s, (struct sockaddr*)addr, addrLen) == 0) {
+        return false;
+    }
+    else if (LastSocketError() != EWOULDBLOCK && LastSocketError() != EAGAIN && LastSocketError() != EINPROGRESS) {
+        return false;
+    }
+
+    pfd.fd = *s;
+    pfd.events = POLLOUT;
+    return pollSockets(&pfd, 1, timeoutMs) == 0;
+}
+
+// Races the candidates and checks that the expected one wins within the time bounds
+static void checkRace(const char* testName, struct addrinfo** candidates, int candidateCount, unsigned short port,
+                      int expectedWinner, uint64_t minTimeMs, uint64_t maxTimeMs) {
+    uint64_t startTimeMs;
+    uint64_t elapsedMs;
+    int winner;
+
+    startTimeMs = PltGetMillis();
+    winner = raceTcpConnections(candidates, candidateCount, port);
+    elapsedMs = PltGetMillis() - startTimeMs;
+
+    if (winner != expectedWinner) {
+        printf("FAILED: %s: candidate %d won instead of %d\n", testName, winner, expectedWinner);
+        FailureCount++;
+    }
+    else if (elapsedMs < minTimeMs || elapsedMs > maxTimeMs) {
+        printf("FAILED: %s: took %u ms (expected %u to %u ms)\n", testName,
+               (unsigned int)elapsedMs, (unsigned int)minTimeMs, (unsigned int)maxTimeMs);
+        FailureCount++;
+    }
+    else {
+        printf("PASSED: %s (%u ms)\n", testName, (unsigned int)elapsedMs);
+    }
+}
+
+static void testListener(const char* testName, const char* host, int family) {
+    struct sockaddr_storage addr;
+    SOCKADDR_LEN addrLen;
+    unsigned short port = 0;
+    int preferredFamily;
+    SOCKET listener;
+
+    listener = startListener(family, 8, &port);
+    if (listener == INVALID_SOCKET) {
+        printf("SKIPPED: %s: no loopback address for family %d\n", testName, family);
+        return;
+    }
+
+    preferredFamily = AF_UNSPEC;
+    if (resolveHostName(host, AF_UNSPEC, TCP_PORT_FLAG_ALWAYS_TEST | port, &preferredFamily, &addr, &addrLen) != 0) {
+        fail(testName, "no address connected");
+    }
+    else if (addr.ss_family != family) {
+        fail(testName, "connected to the wrong address family");
+    }
+    else {
+        printf("PASSED: %s\n", testName);
+    }
+
+    closeSocket(listener);
+}
+
+// Races the loopback addresses of both families with only one of them
+// listening. The refused attempt must not hold up the other one.
+static void testRace(const char* testName, int family) {
+    struct sockaddr_storage addrs[2];
+    struct addrinfo candidateInfo[2];
+    struct addrinfo* candidates[2];
+    unsigned short port = 0;
+    SOCKET listener;
+    SOCKADDR_LEN addrLen;
+    int i;
+
+    listener = startListener(family, 8, &port);
+    if (listener == INVALID_SOCKET) {
+        printf("SKIPPED: %s: no loopback address for family %d\n", testName, family);
+        return;
+    }
+
+    // Start with the family that isn't listening, so the race has to move on
+    memset(candidateInfo, 0, sizeof(candidateInfo));
+    for (i = 0; i < 2; i++) {
+        int candidateFamily = (i == 0) == (family == AF_INET) ? AF_INET6 : AF_INET;
+
+        makeLoopbackAddress(candidateFamily, 0, &addrs[i], &addrLen);
+        candidateInfo[i].ai_family = candidateFamily;
+        candidateInfo[i].ai_addr = (struct sockaddr*)&addrs[i];
+        candidateInfo[i].ai_addrlen = addrLen;
+        candidates[i] = &candidateInfo[i];
+    }
+
+    checkRace(testName, candidates, 2, port, 1, 0, CONNECTION_ATTEMPT_DELAY_MS - 1);
+
+    closeSocket(listener);
+}
+
+// Races an IPv6 candidate that never answers against a working IPv4 one.
+// The IPv4 attempt must start after the connection attempt delay rather
+// than after the first attempt times out.
+static void testNonAnsweringCandidate(const char* testName) {
+    struct sockaddr_storage addrs[2];
+    struct addrinfo candidateInfo[2];
+    struct addrinfo* candidates[2];
+    SOCKET fillers[2] = { INVALID_SOCKET, INVALID_SOCKET };
+    SOCKET probe = INVALID_SOCKET;
+    SOCKET listener, stalledListener;
+    unsigned short port = 0;
+    SOCKADDR_LEN addrLen;
+    int i;
+
+    listener = startListener(AF_INET, 8, &port);
+    if (listener == INVALID_SOCKET) {
+        fail(testName, "unable to listen on the IPv4 loopback address");
+        return;
+    }
+
+    // A listener with a full backlog drops new connection attempts on some
+    // platforms, which looks the same as a host that isn't answering
+    stalledListener = startListener(AF_INET6, 0, &port);
+    if (stalledListener == INVALID_SOCKET) {
+        printf("SKIPPED: %s: unable to listen on the IPv6 loopback address\n", testName);
+        closeSocket(listener);
+        return;
+    }
+
+    memset(candidateInfo, 0, sizeof(candidateInfo));
+    for (i = 0; i < 2; i++) {
+        int candidateFamily = i == 0 ? AF_INET6 : AF_INET;
+
+        makeLoopbackAddress(candidateFamily, port, &addrs[i], &addrLen);
+        candidateInfo[i].ai_family = candidateFamily;
+        candidateInfo[i].ai_addr = (struct sockaddr*)&addrs[i];
+        candidateInfo[i].ai_addrlen = addrLen;
+        candidates[i] = &candidateInfo[i];
+    }
+
+    for (i = 0; i < 2; i++) {
+        isConnectionStalled(&addrs[0], (SOCKADDR_LEN)candidateInfo[0].ai_addrlen, 50, &fillers[i]);
+    }
+
+    if (!isConnectionStalled(&addrs[0], (SOCKADDR_LEN)candidateInfo[0].ai_addrlen, 100, &probe)) {
+        printf("SKIPPED: %s: connections to a full backlog aren't dropped on this platform\n", testName);
+    }
+    else {
+        checkRace(testName, candidates, 2, port, 1,
+                  CONNECTION_ATTEMPT_DELAY_MS, CONNECTION_ATTEMPT_DELAY_MS + 1000);
+    }
+
+    if (probe != INVALID_SOCKET) {
+        closeSocket(probe);
+    }
+    for (i = 0; i < 2; i++) {
+        if (fillers[i] != INVALID_SOCKET) {
+            closeSocket(fillers[i]);
+        }
+    }
+    closeSocket(stalledListener);
+    closeSocket(listener);
+}
+
+// Races a candidate without a route against a working one. The failed
+// attempt must hand over to the next candidate without waiting for the
+// connection attempt delay.
+static void testDeadRoute(const char* testName) {
+    struct sockaddr_storage addrs[2];
+    struct addrinfo candidateInfo[2];
+    struct addrinfo* candidates[2];
+    struct sockaddr_in* deadAddr;
+    SOCKET listener, s;
+    unsigned short port = 0;
+    SOCKADDR_LEN addrLen;
+    int i;
+
+    listener = startListener(AF_INET, 8, &port);
+    if (listener == INVALID_SOCKET) {
+        fail(testName, "unable to listen on the IPv4 loopback address");
+        return;
+    }
+
+    memset(candidateInfo, 0, sizeof(candidateInfo));
+    for (i = 0; i < 2; i++) {
+        makeLoopbackAddress(AF_INET, port, &addrs[i], &addrLen);
+        candidateInfo[i].ai_family = AF_INET;
+        candidateInfo[i].ai_addr = (struct sockaddr*)&addrs[i];
+        candidateInfo[i].ai_addrlen = addrLen;
+        candidates[i] = &candidateInfo[i];
+    }
+
+    // TCP can't be routed to the limited broadcast address
+    deadAddr = (struct sockaddr_in*)&addrs[0];
+    deadAddr->sin_addr.s_addr = htonl(INADDR_BROADCAST);
+
+    if (isConnectionStalled(&addrs[0], addrLen, 0, &s)) {
+        printf("SKIPPED: %s: connections to the broadcast address don't fail right away on this platform\n", testName);
+    }
+    else {
+        checkRace(testName, candidates, 2, port, 1, 0, CONNECTION_ATTEMPT_DELAY_MS - 1);
+    }
+
+    if (s != INVALID_SOCKET) {
+        closeSocket(s);
+    }
+    closeSocket(listener);
+}
+
+static void testNoListener(const char* testName, const char* host) {
+    struct sockaddr_storage addr;
+    SOCKADDR_LEN addrLen;
+    unsigned short port = 0;
+    SOCKET listener;
+
+    // Find a port that nothing is listening on
+    listener = startListener(AF_INET, 8, &port);
+    if (listener == INVALID_SOCKET) {
+        fail(testName, "unable to find an unused port");
+        return;
+    }
+    closeSocket(listener);
+
+    if (resolveHostName(host, AF_UNSPEC, TCP_PORT_FLAG_ALWAYS_TEST | port, NULL, &addr, &addrLen) == 0) {
+        fail(testName, "connected without a listener");
+    }
+    else {
+        printf("PASSED: %s\n", testName);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int err;
+
+    ListenerCallbacks.logMessage = logMessage;
+
+    PltTicksInit();
+
+    err = initializePlatformSockets();
+    if (err != 0) {
+        printf("Failed to initialize sockets: %d\n", err);
+        return 1;
+    }
+
+    testListener("IPv4 listener", "127.0.0.1", AF_INET);
+    testListener("IPv6 listener", "::1", AF_INET6);
+    testRace("IPv4 listener racing IPv6", AF_INET);
+    testRace("IPv6 listener racing IPv4", AF_INET6);
+    testNonAnsweringCandidate("Non-answering first candidate");
+    testDeadRoute("Dead route first candidate");
+    testNoListener("No listener", "127.0.0.1");
+
+    cleanupPlatformSockets();
+
+    if (FailureCount != 0) {
+        printf("%d tests failed\n", FailureCount);
+        return 1;
+    }
+
+    return 0;
+}
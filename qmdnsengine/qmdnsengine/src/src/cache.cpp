@@ -28,6 +28,8 @@
 #define USE_QRANDOMGENERATOR
 #endif
 
+#include <limits>
+
 #include <qmdnsengine/cache.h>
 #include <qmdnsengine/dns.h>
 
@@ -35,59 +37,267 @@
 
 using namespace QMdnsEngine;
 
+// Points in the lifetime of a record (in 1/1000ths of the TTL) at which
+// queries are triggered; the last one is the expiry of the record
+static const qint64 TriggerPermille[] = {500, 850, 900, 950, 1000};
+static const int TriggerCount = sizeof(TriggerPermille) / sizeof(TriggerPermille[0]);
+
+static const qint64 WheelRange = Q_INT64_C(1) << (CachePrivate::WheelBits * CachePrivate::WheelLevels);
+
 CachePrivate::CachePrivate(Cache *cache)
     : QObject(cache),
+      nextId(0),
+      baseTick(0),
+      timerTick(-1),
       q(cache)
 {
     connect(&timer, &QTimer::timeout, this, &CachePrivate::onTimeout);
 
     timer.setSingleShot(true);
+    clock.start();
+
+    for (int i = 0; i < WheelLevels; ++i) {
+        wheelCount[i] = 0;
+    }
 }
 
-void CachePrivate::onTimeout()
+qint64 CachePrivate::triggerTime(const Entry &entry) const
+{
+    // The random offset only applies to the queries, not the expiry itself
+    qint64 time = entry.added + entry.record.ttl() * TriggerPermille[entry.trigger];
+    if (entry.trigger < TriggerCount - 1) {
+        time += entry.random;
+    }
+    return time;
+}
+
+void CachePrivate::insertEntry(const Record &record, qint64 random)
+{
+    quint64 id = nextId++;
+
+    Entry &entry = entries[id];
+    entry.record = record;
+    entry.added = clock.elapsed();
+    entry.random = random;
+    entry.trigger = 0;
+    entry.level = -1;
+
+    // Round up so that a trigger never fires early
+    entry.triggerTick = (triggerTime(entry) + TickMs - 1) / TickMs;
+
+    index[Key(record.name(), record.type())].append(id);
+    schedule(id);
+
+    // Restart the timer if the new entry needs attention before the
+    // currently scheduled wakeup
+    qint64 wakeTick = entry.triggerTick;
+    if (entry.level > 0) {
+        wakeTick = (wakeTick >> (WheelBits * entry.level)) << (WheelBits * entry.level);
+    }
+    wakeTick = qMax(wakeTick, baseTick);
+    if (timerTick < 0 || wakeTick < timerTick) {
+        scheduleWakeup(wakeTick);
+    }
+}
+
+void CachePrivate::removeEntry(quint64 id)
+{
+    auto i = entries.find(id);
+    if (i == entries.end()) {
+        return;
+    }
+
+    unschedule(id);
+
+    Key key(i->record.name(), i->record.type());
+    auto j = index.find(key);
+    if (j != index.end()) {
+        j->removeOne(id);
+        if (j->isEmpty()) {
+            index.erase(j);
+        }
+    }
+
+    entries.erase(i);
+}
+
+void CachePrivate::schedule(quint64 id)
+{
+    Entry &entry = entries[id];
+
+    // Pick the lowest level of the wheel whose range covers the deadline;
+    // deadlines beyond the range of the wheel are clamped and simply
+    // rescheduled once they are reached
+    qint64 tick = qMax(entry.triggerTick, baseTick);
+    qint64 delta = qMin(tick - baseTick, WheelRange - 1);
+    tick = baseTick + delta;
+
+    int level = 0;
+    while (delta >= (Q_INT64_C(1) << (WheelBits * (level + 1)))) {
+        ++level;
+    }
+
+    QVector<quint64> &slot = wheel[level][(tick >> (WheelBits * level)) & WheelMask];
+    entry.level = level;
+    entry.slot = (tick >> (WheelBits * level)) & WheelMask;
+    entry.position = slot.size();
+    slot.append(id);
+    ++wheelCount[level];
+}
+
+void CachePrivate::unschedule(quint64 id)
+{
+    Entry &entry = entries[id];
+    if (entry.level < 0) {
+        return;
+    }
+
+    // Swap the last entry of the slot into the position being vacated
+    QVector<quint64> &slot = wheel[entry.level][entry.slot];
+    quint64 last = slot.last();
+    slot[entry.position] = last;
+    entries[last].position = entry.position;
+    slot.removeLast();
+
+    --wheelCount[entry.level];
+    entry.level = -1;
+}
+
+void CachePrivate::cascade(int level, int slot)
+{
+    QVector<quint64> ids;
+    ids.swap(wheel[level][slot]);
+    wheelCount[level] -= ids.size();
+
+    for (quint64 id : ids) {
+        entries[id].level = -1;
+        schedule(id);
+    }
+}
+
+void CachePrivate::advance(qint64 nowTick)
 {
-    // Loop through all of the records in the cache, emitting the appropriate
-    // signal when a trigger has passed, determining when the next trigger
-    // will occur, and removing records that have expired
-    QDateTime now = QDateTime::currentDateTime();
-    QDateTime newNextTrigger;
-
-    for (auto i = entries.begin(); i != entries.end();) {
-
-        // Loop through the triggers and remove ones that have already
-        // passed
-        bool shouldQuery = false;
-        for (auto j = i->triggers.begin(); j != i->triggers.end();) {
-            if ((*j) <= now) {
-                shouldQuery = true;
-                j = i->triggers.erase(j);
-            } else {
+    while (baseTick <= nowTick) {
+
+        // Jump straight to the next tick at which the lowest occupied level
+        // of the wheel needs to be cascaded; nothing can fire before then
+        int lowest = 0;
+        while (lowest < WheelLevels && !wheelCount[lowest]) {
+            ++lowest;
+        }
+        if (lowest == WheelLevels) {
+            baseTick = nowTick + 1;
+            break;
+        }
+        if (lowest > 0) {
+            qint64 granularity = Q_INT64_C(1) << (WheelBits * lowest);
+            qint64 next = (baseTick + granularity - 1) & ~(granularity - 1);
+            if (next > nowTick) {
+                baseTick = nowTick + 1;
+                break;
+            }
+            baseTick = next;
+        }
+
+        // Move entries from higher levels down as their range is entered
+        for (int level = 1; level < WheelLevels; ++level) {
+            if (baseTick & ((Q_INT64_C(1) << (WheelBits * level)) - 1)) {
                 break;
             }
+            cascade(level, (baseTick >> (WheelBits * level)) & WheelMask);
         }
 
-        // If triggers remain, determine the next earliest one; if none
-        // remain, the record has expired and should be removed
-        if (i->triggers.length()) {
-            if (newNextTrigger.isNull() || i->triggers.at(0) < newNextTrigger) {
-                newNextTrigger = i->triggers.at(0);
+        // Process all entries that are due on this tick. The slot is
+        // detached first since the signals emitted below may modify the cache.
+        int slot = baseTick & WheelMask;
+        while (!wheel[0][slot].isEmpty()) {
+            QVector<quint64> ids;
+            ids.swap(wheel[0][slot]);
+            wheelCount[0] -= ids.size();
+            for (quint64 id : ids) {
+                entries[id].level = -1;
             }
-            if (shouldQuery) {
-                emit q->shouldQuery(i->record);
+
+            qint64 now = clock.elapsed();
+            for (quint64 id : ids) {
+                auto i = entries.find(id);
+                if (i == entries.end() || i->level >= 0) {
+                    continue;
+                }
+
+                // Skip past all of the triggers that have passed
+                int previousTrigger = i->trigger;
+                while (i->trigger < TriggerCount && triggerTime(*i) <= now) {
+                    ++i->trigger;
+                }
+
+                if (i->trigger == TriggerCount) {
+                    Record record = i->record;
+                    removeEntry(id);
+                    emit q->recordExpired(record);
+                } else {
+                    i->triggerTick = (triggerTime(*i) + TickMs - 1) / TickMs;
+                    Record record = i->record;
+                    schedule(id);
+                    if (i->trigger != previousTrigger) {
+                        emit q->shouldQuery(record);
+                    }
+                }
             }
-            ++i;
-        } else {
-            emit q->recordExpired(i->record);
-            i = entries.erase(i);
         }
+
+        ++baseTick;
     }
+}
+
+void CachePrivate::scheduleWakeup(qint64 tick)
+{
+    // Very distant wakeups are clamped to the range of QTimer; waking up
+    // early is harmless since the timer is simply restarted
+    qint64 interval = qMax<qint64>(tick * TickMs - clock.elapsed(), 0);
+    timerTick = tick;
+    timer.start(static_cast<int>(qMin<qint64>(interval, std::numeric_limits<int>::max())));
+}
+
+void CachePrivate::updateTimer()
+{
+    // Find the earliest tick at which an entry fires (level 0) or a slot in
+    // a higher level needs to be cascaded
+    qint64 next = -1;
+    for (int level = 0; level < WheelLevels; ++level) {
+        if (!wheelCount[level]) {
+            continue;
+        }
+
+        int shift = WheelBits * level;
+        qint64 window = baseTick >> shift;
 
-    // If newNextTrigger contains a value, it will be the time for the next
-    // trigger and the timer should be started again
-    nextTrigger = newNextTrigger;
-    if (!nextTrigger.isNull()) {
-        timer.start(now.msecsTo(nextTrigger));
+        // The slot for the current window of a higher level has already
+        // been cascaded unless the base is exactly at its start
+        int first = (baseTick & ((Q_INT64_C(1) << shift) - 1)) ? 1 : 0;
+        for (int k = first; k < first + WheelSize; ++k) {
+            if (!wheel[level][(window + k) & WheelMask].isEmpty()) {
+                qint64 tick = (window + k) << shift;
+                if (next < 0 || tick < next) {
+                    next = tick;
+                }
+                break;
+            }
+        }
     }
+
+    if (next < 0) {
+        timerTick = -1;
+        timer.stop();
+    } else {
+        scheduleWakeup(next);
+    }
+}
+
+void CachePrivate::onTimeout()
+{
+    advance(clock.elapsed() / TickMs);
+    updateTimer();
 }
 
 Cache::Cache(QObject *parent)
@@ -103,56 +313,56 @@ void Cache::addRecord(const Record &record)
         return;
     }
 
-    // Use the current time to calculate the triggers and add a random offset
-    QDateTime now = QDateTime::currentDateTime();
+    // Add a random offset to the query triggers
 #ifdef USE_QRANDOMGENERATOR
     qint64 random = QRandomGenerator::global()->bounded(20);
 #else
     qint64 random = qrand() % 20;
 #endif
 
-    QList<QDateTime> triggers{
-        now.addMSecs(record.ttl() * 500 + random),  // 50%
-        now.addMSecs(record.ttl() * 850 + random),  // 85%
-        now.addMSecs(record.ttl() * 900 + random),  // 90%
-        now.addMSecs(record.ttl() * 950 + random),  // 95%
-        now.addSecs(record.ttl())
-    };
-
-    // Append the record and its triggers
-    d->entries.append({record, triggers});
-
-    // Check if the new record's first trigger is earlier than the next
-    // scheduled trigger; if so, restart the timer
-    if (d->nextTrigger.isNull() || triggers.at(0) < d->nextTrigger) {
-        d->nextTrigger = triggers.at(0);
-        d->timer.start(now.msecsTo(d->nextTrigger));
-    }
+    d->insertEntry(record, random);
 }
 
 void Cache::invalidateRecord(const Record &record)
 {
-    // If a record exists that matches, remove it from the cache
-    for (auto i = d->entries.begin(); i != d->entries.end();) {
-        if ((record.flushCache() &&
-                (*i).record.name() == record.name() &&
-                (*i).record.type() == record.type()) ||
-                (*i).record == record) {
+    // Only records with the same name and type can match
+    auto i = d->index.constFind(CachePrivate::Key(record.name(), record.type()));
+    if (i == d->index.constEnd()) {
+        return;
+    }
+
+    // Copy the IDs since the bucket is modified as entries are removed
+    const QVector<quint64> ids = i.value();
+    for (quint64 id : ids) {
+        auto j = d->entries.constFind(id);
+        if (j == d->entries.constEnd()) {
+            continue;
+        }
+
+        // If a record exists that matches, remove it from the cache
+        if (record.flushCache() || j->record == record) {
+            Record removed = j->record;
+            d->removeEntry(id);
 
             // If the TTL is set to 0, indicate that the record was removed
             if (record.ttl() == 0) {
-                emit recordExpired((*i).record);
+                emit recordExpired(removed);
             }
-
-            i = d->entries.erase(i);
-        } else {
-            ++i;
         }
     }
 }
 
 bool Cache::lookupRecord(const QByteArray &name, quint16 type, Record &record) const
 {
+    if (!name.isNull() && type != ANY) {
+        auto i = d->index.constFind(CachePrivate::Key(name, type));
+        if (i == d->index.constEnd()) {
+            return false;
+        }
+        record = d->entries.constFind(i->first())->record;
+        return true;
+    }
+
     QList<Record> records;
     if (lookupRecords(name, type, records)) {
         record = records.at(0);
@@ -163,11 +373,24 @@ bool Cache::lookupRecord(const QByteArray &name, quint16 type, Record &record) c
 
 bool Cache::lookupRecords(const QByteArray &name, quint16 type, QList<Record> &records) const
 {
+    // Exact lookups only need to visit a single bucket of the index
+    if (!name.isNull() && type != ANY) {
+        auto i = d->index.constFind(CachePrivate::Key(name, type));
+        if (i == d->index.constEnd()) {
+            return false;
+        }
+        for (quint64 id : *i) {
+            records.append(d->entries.constFind(id)->record);
+        }
+        return true;
+    }
+
+    // Wildcard lookups have to visit every record
     bool recordsAdded = false;
-    foreach (CachePrivate::Entry entry, d->entries) {
-        if ((name.isNull() || entry.record.name() == name) &&
-                (type == ANY || entry.record.type() == type)) {
-            records.append(entry.record);
+    for (auto i = d->entries.constBegin(); i != d->entries.constEnd(); ++i) {
+        if ((name.isNull() || i->record.name() == name) &&
+                (type == ANY || i->record.type() == type)) {
+            records.append(i->record);
             recordsAdded = true;
         }
     }
@@ -25,10 +25,13 @@
 #ifndef QMDNSENGINE_CACHE_P_H
 #define QMDNSENGINE_CACHE_P_H
 
-#include <QDateTime>
-#include <QList>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
+#include <QPair>
 #include <QTimer>
+#include <QVector>
 
 #include <qmdnsengine/record.h>
 
@@ -37,23 +40,77 @@ namespace QMdnsEngine
 
 class Cache;
 
+/*
+ * Records are indexed by (name, type) so that lookups and invalidation only
+ * touch the handful of records sharing a key. Refresh and expiry deadlines
+ * are tracked by a hierarchical timer wheel driven by a monotonic clock,
+ * which makes scheduling and cancelling a deadline O(1) regardless of the
+ * number of records in the cache.
+ */
 class CachePrivate : public QObject
 {
     Q_OBJECT
 
 public:
 
+    typedef QPair<QByteArray, quint16> Key;
+
+    // Each level of the wheel has 64 slots; the first level has a resolution
+    // of one tick and every subsequent level covers 64 times the range of
+    // the one below it (about 34 years in total)
+    enum {
+        TickMs = 16,
+        WheelBits = 6,
+        WheelSize = 1 << WheelBits,
+        WheelMask = WheelSize - 1,
+        WheelLevels = 6
+    };
+
     struct Entry
     {
         Record record;
-        QList<QDateTime> triggers;
+
+        // Time the record was added (in ms) and the random offset applied
+        // to the query triggers
+        qint64 added;
+        qint64 random;
+
+        // Index of the next trigger (0-3 are queries, 4 is expiry) and the
+        // tick at which it is due
+        int trigger;
+        qint64 triggerTick;
+
+        // Current position of the entry in the timer wheel
+        int level;
+        int slot;
+        int position;
     };
 
     CachePrivate(Cache *cache);
 
+    qint64 triggerTime(const Entry &entry) const;
+
+    void insertEntry(const Record &record, qint64 random);
+    void removeEntry(quint64 id);
+
+    void schedule(quint64 id);
+    void unschedule(quint64 id);
+    void cascade(int level, int slot);
+    void advance(qint64 nowTick);
+    void scheduleWakeup(qint64 tick);
+    void updateTimer();
+
     QTimer timer;
-    QList<Entry> entries;
-    QDateTime nextTrigger;
+    QElapsedTimer clock;
+
+    QHash<quint64, Entry> entries;
+    QHash<Key, QVector<quint64>> index;
+    quint64 nextId;
+
+    QVector<quint64> wheel[WheelLevels][WheelSize];
+    int wheelCount[WheelLevels];
+    qint64 baseTick;
+    qint64 timerTick;
 
 private Q_SLOTS:
 
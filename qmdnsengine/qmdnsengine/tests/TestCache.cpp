@@ -49,6 +49,8 @@ private Q_SLOTS:
     void testExpiry();
     void testRemoval();
     void testCacheFlush();
+    void testWildcardLookup();
+    void benchmarkLoad();
 
 private:
 
@@ -125,6 +127,65 @@ void TestCache::testCacheFlush()
     QCOMPARE(records.length(), 1);
 }
 
+void TestCache::testWildcardLookup()
+{
+    QMdnsEngine::Cache cache;
+    cache.addRecord(createRecord());
+
+    QMdnsEngine::Record srvRecord = createRecord();
+    srvRecord.setType(QMdnsEngine::SRV);
+    cache.addRecord(srvRecord);
+
+    // Both records share a name but are stored under different types
+    QList<QMdnsEngine::Record> records;
+    QVERIFY(cache.lookupRecords(Name, QMdnsEngine::ANY, records));
+    QCOMPARE(records.length(), 2);
+
+    records.clear();
+    QVERIFY(cache.lookupRecords(QByteArray(), QMdnsEngine::SRV, records));
+    QCOMPARE(records.length(), 1);
+    QVERIFY(records.at(0).type() == QMdnsEngine::SRV);
+}
+
+void TestCache::benchmarkLoad()
+{
+    // Simulate a busy network announcing thousands of services, each of
+    // which is made up of PTR, SRV and TXT records that are periodically
+    // refreshed by new announcements
+    const int RecordCount = 10000;
+    const quint16 Types[] = {QMdnsEngine::PTR, QMdnsEngine::SRV, QMdnsEngine::TXT};
+
+    QList<QMdnsEngine::Record> records;
+    for (int i = 0; i < RecordCount; ++i) {
+        QMdnsEngine::Record record;
+        record.setName("Service " + QByteArray::number(i / 3) + "._nvstream._tcp.local.");
+        record.setType(Types[i % 3]);
+        record.setTtl(i % 2 ? 120 : 4500);
+        record.setFlushCache(record.type() != QMdnsEngine::PTR);
+        record.setTarget("host" + QByteArray::number(i / 3) + ".local.");
+        records.append(record);
+    }
+
+    QMdnsEngine::Cache cache;
+    int found = 0;
+    QBENCHMARK {
+        foreach (QMdnsEngine::Record record, records) {
+            cache.invalidateRecord(record);
+            cache.addRecord(record);
+        }
+
+        found = 0;
+        QMdnsEngine::Record record;
+        foreach (QMdnsEngine::Record query, records) {
+            if (cache.lookupRecord(query.name(), query.type(), record)) {
+                ++found;
+            }
+        }
+    }
+
+    QCOMPARE(found, RecordCount);
+}
+
 QMdnsEngine::Record TestCache::createRecord()
 {
     QMdnsEngine::Record record;